@@ -0,0 +1,232 @@
+/*
+   File:        bench.c
+   Author(s):   PS1 MOPS
+   Created:     Fri Oct 16, 2026
+   Description: A synthetic sky generator for benchmarking findTracklets.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "bench.h"
+
+void synth_sky_from_args(synth_sky* S, int argc, char** argv) {
+  char* v_dist = string_from_args("v_dist",argc,argv,"uniform");
+
+  S->RA         = double_from_args("sky_ra",argc,argv,150.0);
+  S->DEC        = double_from_args("sky_dec",argc,argv,0.0);
+  S->width      = double_from_args("width",argc,argv,3.0);
+  S->density    = double_from_args("density",argc,argv,1000.0);
+  S->false_frac = double_from_args("false_frac",argc,argv,0.5);
+  S->minv       = double_from_args("minv",argc,argv,0.0);
+  S->maxv       = double_from_args("maxv",argc,argv,0.5);
+  S->maxv       = double_from_args("sky_maxv",argc,argv,S->maxv);
+  S->num_exp    = int_from_args("num_exp",argc,argv,4);
+  S->cadence    = double_from_args("cadence",argc,argv,15.0);
+  S->t0         = double_from_args("t0",argc,argv,53757.1);
+  S->noise      = double_from_args("noise",argc,argv,0.1);
+  S->obs_code   = 568;
+  S->seed       = int_from_args("seed",argc,argv,1);
+  S->exp_time    = double_from_args("exp_time",argc,argv,0.0);
+  S->trail_noise = double_from_args("trail_noise",argc,argv,0.2);
+
+  S->v_dist = SYNTH_SKY_V_UNIFORM;
+  if(eq_string(v_dist,"log")) { S->v_dist = SYNTH_SKY_V_LOG; }
+
+  if(S->false_frac < 0.0)  { S->false_frac = 0.0; }
+  if(S->false_frac > 0.99) { S->false_frac = 0.99; }
+  if(S->num_exp < 1)       { S->num_exp = 1; }
+  if(S->exp_time < 0.0)    { S->exp_time = 0.0; }
+}
+
+
+/* Draw a speed (degrees per day) from the sky's distribution. */
+double synth_sky_speed(synth_sky* S) {
+  double lo;
+
+  if((S->v_dist == SYNTH_SKY_V_LOG) && (S->maxv > 0.0)) {
+    lo = (S->minv > 0.0) ? S->minv : S->maxv * 1e-3;
+    return exp(range_random(log(lo), log(S->maxv)));
+  }
+  return range_random(S->minv, S->maxv);
+}
+
+
+/* A trail length (degrees) of L degrees plus the trail noise. */
+double synth_sky_trail(synth_sky* S, double L) {
+  return fabs(L + gen_gauss() * S->trail_noise / 3600.0);
+}
+
+
+simple_obs_array* mk_synthetic_sky_obs(synth_sky* S, ivec** true_groups,
+                                       dyv** length, dyv** angle) {
+  simple_obs_array* res;
+  simple_obs* X;
+  ivec* groups;
+  dyv* trail_len = NULL;
+  dyv* trail_ang = NULL;
+  dyv* speed;
+  dyv* RA0;
+  dyv* DEC0;
+  dyv* vRA;
+  dyv* vDEC;
+  double cosd  = cos(S->DEC * DEG_TO_RAD);
+  double half_r, half_d;
+  double noise = S->noise / 3600.0;
+  double etime = S->exp_time / (24.0 * 60.0 * 60.0);
+  double v, ang, t, dt, r, d;
+  int num_obj, num_false;
+  int e, i;
+
+  if(S->seed) { am_srand(S->seed); }
+  if(cosd < 1e-3) { cosd = 1e-3; }
+
+  /* The field spans width degrees on the sky in both directions. */
+  half_d = S->width / 2.0;
+  half_r = half_d / cosd;
+
+  num_obj   = (int)(S->density * S->width * S->width + 0.5);
+  num_false = (int)((double)num_obj * S->false_frac / (1.0 - S->false_frac) + 0.5);
+
+  /* Give every object a starting point and a velocity. */
+  RA0  = mk_dyv(num_obj);
+  DEC0 = mk_dyv(num_obj);
+  vRA  = mk_dyv(num_obj);
+  vDEC = mk_dyv(num_obj);
+  speed = mk_dyv(num_obj);
+  for(i=0;i<num_obj;i++) {
+    v   = synth_sky_speed(S);
+    ang = range_random(0.0, 2.0 * PI);
+    dyv_set(RA0,  i, S->RA  + range_random(-half_r, half_r));
+    dyv_set(DEC0, i, S->DEC + range_random(-half_d, half_d));
+    dyv_set(vRA,  i, v * cos(ang) / cosd);
+    dyv_set(vDEC, i, v * sin(ang));
+    dyv_set(speed, i, v);
+  }
+
+  res    = mk_empty_simple_obs_array(S->num_exp * (num_obj + num_false));
+  groups = mk_ivec(0);
+  if(S->exp_time > 0.0) {
+    trail_len = mk_dyv(0);
+    trail_ang = mk_dyv(0);
+  }
+  for(e=0;e<S->num_exp;e++) {
+    dt = (double)e * S->cadence / (24.0 * 60.0);
+    t  = S->t0 + dt;
+
+    /* The real objects that are still inside the field... */
+    for(i=0;i<num_obj;i++) {
+      r = dyv_ref(RA0,i)  + dyv_ref(vRA,i)  * dt + gen_gauss() * noise / cosd;
+      d = dyv_ref(DEC0,i) + dyv_ref(vDEC,i) * dt + gen_gauss() * noise;
+      if((fabs(r - S->RA) > half_r) || (fabs(d - S->DEC) > half_d)) {
+        continue;
+      }
+
+      X = mk_simple_obs_time(simple_obs_array_size(res), t, r / 15.0, d,
+                             range_random(19.0, 23.0), 'V', S->obs_code,
+                             "SYNTH");
+      simple_obs_array_add_no_copy(res, X);
+      add_to_ivec(groups, i);
+
+      if(trail_len != NULL) {
+        add_to_dyv(trail_len, synth_sky_trail(S, dyv_ref(speed,i) * etime));
+        add_to_dyv(trail_ang, atan2(dyv_ref(vRA,i), dyv_ref(vDEC,i)) *
+                   RAD_TO_DEG);
+      }
+    }
+
+    /* ... and the false detections. */
+    for(i=0;i<num_false;i++) {
+      r = S->RA  + range_random(-half_r, half_r);
+      d = S->DEC + range_random(-half_d, half_d);
+
+      X = mk_simple_obs_time(simple_obs_array_size(res), t, r / 15.0, d,
+                             range_random(19.0, 23.0), 'V', S->obs_code,
+                             "SYNTH");
+      simple_obs_array_add_no_copy(res, X);
+      add_to_ivec(groups, -1);
+
+      if(trail_len != NULL) {
+        add_to_dyv(trail_len, synth_sky_trail(S, 0.0));
+        add_to_dyv(trail_ang, range_random(-180.0, 180.0));
+      }
+    }
+  }
+
+  free_dyv(RA0);
+  free_dyv(DEC0);
+  free_dyv(vRA);
+  free_dyv(vDEC);
+  free_dyv(speed);
+
+  if(true_groups != NULL) {
+    true_groups[0] = groups;
+  } else {
+    free_ivec(groups);
+  }
+
+  if(length != NULL) {
+    length[0] = trail_len;
+  } else if(trail_len != NULL) {
+    free_dyv(trail_len);
+  }
+  if(angle != NULL) {
+    angle[0] = trail_ang;
+  } else if(trail_ang != NULL) {
+    free_dyv(trail_ang);
+  }
+
+  return res;
+}
+
+
+bool write_synthetic_sky_file(char* filename, simple_obs_array* obs,
+                              ivec* true_groups, dyv* length, dyv* angle,
+                              double exp_time) {
+  simple_obs* X;
+  FILE* fp;
+  int N = simple_obs_array_size(obs);
+  int i, g;
+
+  fp = fopen(filename,"w");
+  if(fp == NULL) {
+    printf("ERROR: Unable to open %s for writing.\n", filename);
+    return FALSE;
+  }
+
+  for(i=0;i<N;i++) {
+    X = simple_obs_array_ref(obs,i);
+    g = (true_groups != NULL) ? ivec_ref(true_groups,i) : -1;
+
+    fprintf(fp,"%i %.8f %.9f %.9f %.2f %i ", i, simple_obs_time(X),
+            simple_obs_RA(X) * 15.0, simple_obs_DEC(X),
+            simple_obs_brightness(X), simple_obs_obs_code(X));
+    if(g >= 0) {
+      fprintf(fp,"S%07i", g);
+    } else {
+      fprintf(fp,"NS");
+    }
+    if((length != NULL) && (angle != NULL)) {
+      fprintf(fp," %.9f %.6f %.3f", dyv_ref(length,i), dyv_ref(angle,i),
+              exp_time);
+    }
+    fprintf(fp,"\n");
+  }
+
+  if(fclose(fp) != 0) {
+    printf("ERROR: Unable to write %s.\n", filename);
+    return FALSE;
+  }
+
+  return TRUE;
+}
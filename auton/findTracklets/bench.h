@@ -0,0 +1,78 @@
+/*
+   File:        bench.h
+   Author(s):   PS1 MOPS
+   Created:     Fri Oct 16, 2026
+   Description: A synthetic sky generator for benchmarking findTracklets.
+                The sky is a single field observed by a run of exposures
+                at a fixed cadence.  Each exposure sees every real object
+                inside the field (moving linearly, with astrometric noise)
+                plus a number of uniformly placed false detections.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include "obs.h"
+
+/* The velocity distributions. */
+#define SYNTH_SKY_V_UNIFORM  0   /* Speeds uniform in [minv, maxv].      */
+#define SYNTH_SKY_V_LOG      1   /* log(speed) uniform (more slow ones). */
+
+typedef struct synth_sky {
+  double RA;          /* Field center (degrees)                      */
+  double DEC;
+  double width;       /* Side of the (square) field (degrees)         */
+  double density;     /* Real objects per square degree               */
+  double false_frac;  /* Fraction of each exposure that is false      */
+  double minv;        /* Speed range (degrees per day)                */
+  double maxv;
+  int    v_dist;      /* SYNTH_SKY_V_UNIFORM or SYNTH_SKY_V_LOG       */
+  int    num_exp;     /* Number of exposures                          */
+  double cadence;     /* Time between exposures (minutes)             */
+  double t0;          /* Time of the first exposure (MJD)             */
+  double noise;       /* Astrometric noise, 1-sigma (arcseconds)      */
+  double exp_time;    /* Exposure time (seconds, 0 = no trails)       */
+  double trail_noise; /* Trail length noise, 1-sigma (arcseconds)     */
+  int    obs_code;
+  int    seed;        /* Random seed (0 = leave the generator alone)  */
+} synth_sky;
+
+/* Fill in the sky from the command line arguments ("width", "density", */
+/* "false_frac", "minv", "maxv", "sky_maxv", "v_dist", "num_exp",      */
+/* "cadence", "noise", "sky_ra", "sky_dec", "t0", "seed", "exp_time"  */
+/* and "trail_noise").                                                   */
+void synth_sky_from_args(synth_sky* S, int argc, char** argv);
+
+/* Generate the detections in time order.  true_groups[0] (if not    */
+/* NULL) gets the object number of each detection (-1 = false).      */
+/* If the sky has an exposure time, length[0] and angle[0] (if not   */
+/* NULL) get the trail of each detection: its length (degrees) and   */
+/* its direction (degrees, atan2(dRA, dDEC) with dRA not scaled by    */
+/* cos(DEC)).  False detections get short trails in random          */
+/* directions.  Otherwise they are set to NULL.                      */
+simple_obs_array* mk_synthetic_sky_obs(synth_sky* S, ivec** true_groups,
+                                       dyv** length, dyv** angle);
+
+/* Write detections as a PanSTARRS (MITI) file that the regular  */
+/* loaders read back, with the true groups as object names.  If  */
+/* length and angle are not NULL the trails are written too, with */
+/* an exposure time of exp_time seconds.                          */
+/* Returns FALSE if the file could not be written.               */
+bool write_synthetic_sky_file(char* filename, simple_obs_array* obs,
+                              ivec* true_groups, dyv* length, dyv* angle,
+                              double exp_time);
+
+#endif
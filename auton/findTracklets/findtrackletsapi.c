@@ -50,6 +50,25 @@ typedef struct findtracklets_state {
   bool eval;
   bool greedy;
   bool use_pht;
+  bool elong_query;
+  int beam;
+  long budget;
+  int threads;
+  bool use_plates;
+  double plate_width;
+
+  /* Streaming (exposure at a time) mode.  data only holds the     */
+  /* current window and the window indices are mapped back to the   */
+  /* global detection ids (the AddDataDetection order) through ids. */
+  ivec* ids;             /* Global id of each window detection       */
+  ivec* exp_starts;      /* First window index of each exposure      */
+  dyv*  exp_lo;          /* Earliest time of each exposure           */
+  dyv*  exp_hi;          /* Latest time of each exposure             */
+  int   num_committed;   /* Window detections in committed exposures */
+  int   num_seeded;      /* Exposures whose seeds have been run      */
+  ivec_array* pool;      /* Emitted tracklets (sorted window indices) */
+                         /* that may still be a superset of a later  */
+                         /* tracklet.                                */
 
   /* Results */
   track_array* results;
@@ -90,10 +109,16 @@ int FindTracklets_Init(FindTrackletsStateHandle* ftsh,
   state->maxt    = FT_DEF_MAXT;
   state->etime   = FT_DEF_ETIME;
   state->minobs  = FT_DEF_MINOBS;
-  state->minobs  = FT_DEF_MAXOBS;
+  state->maxobs  = FT_DEF_MAXOBS;
   state->eval    = FALSE;
   state->greedy  = FALSE;
   state->use_pht = FALSE;
+  state->elong_query = TRUE;
+  state->beam        = 0;
+  state->budget      = 0;
+  state->threads = FT_DEF_THREADS;
+  state->use_plates  = FALSE;
+  state->plate_width = FT_DEF_PLATE_WIDTH;
 
   /* Allocate space for the data */
   state->data        = mk_empty_simple_obs_array(128);
@@ -103,6 +128,15 @@ int FindTracklets_Init(FindTrackletsStateHandle* ftsh,
   state->angle       = mk_dyv(0);
   state->exp_time    = mk_dyv(0);
 
+  /* Streaming mode starts with an empty window. */
+  state->ids           = mk_ivec(0);
+  state->exp_starts    = mk_ivec(0);
+  state->exp_lo        = mk_dyv(0);
+  state->exp_hi        = mk_dyv(0);
+  state->num_committed = 0;
+  state->num_seeded    = 0;
+  state->pool          = mk_empty_ivec_array();
+
   /* Set the results to empty. */
   state->results = NULL;
 
@@ -283,6 +317,99 @@ int FindTracklets_set_use_pht(FindTrackletsStateHandle* state, int val) {
 }
 
 
+/* Restrict the endpoint queries of fast movers using their */
+/* elongation angle? (0=NO, 1=YES)                           */
+int FindTracklets_set_elong_query(FindTrackletsStateHandle* state, int val) {
+  findtracklets_state* st = (findtracklets_state*)state;
+
+  if((st->verbosity > 1)&&(st->log_fp != NULL)) {
+    if(val == 0) { fprintf(st->log_fp,"Turned OFF elongation queries.\n"); }
+    if(val == 1) { fprintf(st->log_fp,"Turned ON elongation queries.\n"); }
+  }
+
+  if(val == 1) { st->elong_query = TRUE; }
+  if(val == 0) { st->elong_query = FALSE; }
+
+  return 0;
+}
+
+
+/* Set the number of hypotheses of each length kept by the MHT */
+/* search (0 = all of them).                                   */
+int FindTracklets_set_beam(FindTrackletsStateHandle* state, int nu_val) {
+  findtracklets_state* st = (findtracklets_state*)state;
+
+  if((st->verbosity > 1)&&(st->log_fp != NULL)) {
+    fprintf(st->log_fp,"Setting the beam as %i\n",nu_val);
+  }
+
+  if(nu_val < 0) { nu_val = 0; }
+  st->beam = nu_val;
+
+  return 0;
+}
+
+
+/* Set the number of hypotheses built from each starting detection */
+/* before its search stops (0 = no limit).                         */
+int FindTracklets_set_budget(FindTrackletsStateHandle* state, long nu_val) {
+  findtracklets_state* st = (findtracklets_state*)state;
+
+  if((st->verbosity > 1)&&(st->log_fp != NULL)) {
+    fprintf(st->log_fp,"Setting the budget as %li\n",nu_val);
+  }
+
+  if(nu_val < 0) { nu_val = 0; }
+  st->budget = nu_val;
+
+  return 0;
+}
+
+
+/* Set the number of worker threads used for the search. */
+int FindTracklets_set_threads(FindTrackletsStateHandle* state, int nu_val) {
+  findtracklets_state* st = (findtracklets_state*)state;
+
+  if((st->verbosity > 1)&&(st->log_fp != NULL)) {
+    fprintf(st->log_fp,"Setting the number of threads as %i\n",nu_val);
+  }
+
+  if(nu_val < 1) { nu_val = 1; }
+  st->threads = nu_val;
+
+  return 0;
+}
+
+
+/* Index the detections with one tree per plate? (0=NO, 1=YES) */
+int FindTracklets_set_use_plates(FindTrackletsStateHandle* state, int val) {
+  findtracklets_state* st = (findtracklets_state*)state;
+
+  if((st->verbosity > 1)&&(st->log_fp != NULL)) {
+    fprintf(st->log_fp,"Setting use_plates to %i\n",val);
+  }
+
+  if(val == 1) { st->use_plates = TRUE; }
+  if(val == 0) { st->use_plates = FALSE; }
+
+  return 0;
+}
+
+
+/* Set the maximum time spread of a single plate (in days). */
+int FindTracklets_set_plate_width(FindTrackletsStateHandle* state, double nu_val) {
+  findtracklets_state* st = (findtracklets_state*)state;
+
+  if((st->verbosity > 1)&&(st->log_fp != NULL)) {
+    fprintf(st->log_fp,"Setting the plate width as %f\n",nu_val);
+  }
+
+  st->plate_width = nu_val;
+
+  return 0;
+}
+
+
 /* Add a data detection to the data set.    */
 /* Return the internal FindTracklets number */
 /* for that detections.                     */
@@ -307,6 +434,7 @@ int FindTracklets_AddDataDetection(FindTrackletsStateHandle fph,
   add_to_dyv(state->length, -1.0);
   add_to_dyv(state->angle, 0.0);
   add_to_dyv(state->exp_time, 0.0);
+  add_to_ivec(state->ids, state->num_points-1);
 
   /* Check if we doubled the array size. */
   if(old_maxsize < simple_obs_array_max_size(state->data)) {
@@ -348,6 +476,7 @@ int FindTracklets_AddDataDetection_elong(FindTrackletsStateHandle fph,
   add_to_dyv(state->length, length*DEG_TO_RAD);
   add_to_dyv(state->angle, angle*DEG_TO_RAD);
   add_to_dyv(state->exp_time, exp_time/(24.0*60.0*60.0));
+  add_to_ivec(state->ids, state->num_points-1);
   
   /* Check if we doubled the array size. */
   if(old_maxsize < simple_obs_array_max_size(state->data)) {
@@ -468,6 +597,14 @@ int FindTracklets_Run(FindTrackletsStateHandle fph) {
             state->maxobs,FT_DEF_MAXOBS);
     fprintf(state->log_fp,"Min. Number of Obs.      = %12i   (defaul = %i)\n",
             state->minobs,FT_DEF_MINOBS);
+    fprintf(state->log_fp,"Number of Threads        = %12i   (defaul = %i)\n",
+            state->threads,FT_DEF_THREADS);
+    if(state->use_plates) {
+      fprintf(state->log_fp,"Per-plate trees:             ON (width = %f)\n",
+              state->plate_width);
+    } else {
+      fprintf(state->log_fp,"Per-plate trees:             OFF\n");
+    }
     if(state->greedy) {
       fprintf(state->log_fp,"Greedy mode:                 ON\n");
     } else {
@@ -505,7 +642,13 @@ int FindTracklets_Run(FindTrackletsStateHandle fph) {
                                     state->etime/(24.0*60.0*60.0),
                                     state->maxobs,
                                     state->greedy,
-                                    state->use_pht);  
+                                    state->use_pht,
+                                    state->elong_query,
+                                    state->beam,
+                                    state->budget,
+                                    state->threads,
+                                    (state->use_plates ? state->plate_width :
+                                     0.0));  
 
   /* Do the scoring. */
   if(state->eval == TRUE) {
@@ -555,6 +698,286 @@ int FindTracklets_Run(FindTrackletsStateHandle fph) {
 }
 
 
+/* --- Streaming mode ------------------------------------------------- */
+
+/* Keep only the window detections [lo, hi) (renumbering them from 0). */
+void findtracklets_keep_window(findtracklets_state* state, int lo, int hi) {
+  simple_obs_array* nu_data;
+  ivec* inds = mk_sequence_ivec(lo,hi);
+  ivec* nu_ivec;
+  dyv* nu_dyv;
+  int i;
+
+  nu_data = mk_simple_obs_array_subset(state->data,inds);
+  for(i=0;i<simple_obs_array_size(nu_data);i++) {
+    simple_obs_set_ID(simple_obs_array_ref(nu_data,i),i);
+  }
+  free_simple_obs_array(state->data);
+  state->data = nu_data;
+
+  nu_ivec = mk_ivec_subset(state->ids,inds);
+  free_ivec(state->ids);
+  state->ids = nu_ivec;
+
+  nu_ivec = mk_ivec_subset(state->true_groups,inds);
+  free_ivec(state->true_groups);
+  state->true_groups = nu_ivec;
+
+  nu_dyv = mk_dyv_subset(state->length,inds);
+  free_dyv(state->length);
+  state->length = nu_dyv;
+
+  nu_dyv = mk_dyv_subset(state->angle,inds);
+  free_dyv(state->angle);
+  state->angle = nu_dyv;
+
+  nu_dyv = mk_dyv_subset(state->exp_time,inds);
+  free_dyv(state->exp_time);
+  state->exp_time = nu_dyv;
+
+  free_ivec(inds);
+}
+
+
+/* Evict the first num_exp (fully seeded) exposures from the window. */
+/* The pool tracklets that use an evicted detection are dropped and  */
+/* the rest are renumbered.                                          */
+void findtracklets_evict_exposures(findtracklets_state* state, int num_exp) {
+  ivec_array* nu_pool;
+  ivec* inds;
+  int num_exp_all = ivec_size(state->exp_starts);
+  int e, i, j;
+
+  if(num_exp <= 0) { return; }
+
+  if(num_exp < num_exp_all) {
+    e = ivec_ref(state->exp_starts,num_exp);
+  } else {
+    e = state->num_committed;
+  }
+
+  findtracklets_keep_window(state,e,simple_obs_array_size(state->data));
+
+  for(i=0;i<num_exp;i++) {
+    ivec_remove(state->exp_starts,0);
+    dyv_remove(state->exp_lo,0);
+    dyv_remove(state->exp_hi,0);
+  }
+  for(i=0;i<ivec_size(state->exp_starts);i++) {
+    ivec_increment(state->exp_starts,i,-e);
+  }
+  state->num_committed -= e;
+  state->num_seeded    -= num_exp;
+
+  /* The pool tracklets are sorted, so check the first detection. */
+  nu_pool = mk_empty_ivec_array();
+  for(i=0;i<ivec_array_size(state->pool);i++) {
+    inds = ivec_array_ref(state->pool,i);
+    if(ivec_ref(inds,0) >= e) {
+      for(j=0;j<ivec_size(inds);j++) {
+        ivec_increment(inds,j,-e);
+      }
+      add_to_ivec_array(nu_pool,inds);
+    }
+  }
+  free_ivec_array(state->pool);
+  state->pool = nu_pool;
+}
+
+
+/* Run the seeds of exposures [exp_lo, exp_hi) and add the (global id) */
+/* tracklets that are not a subset of any other tracklet found from    */
+/* these or earlier seeds to the results.                              */
+void findtracklets_emit_exposures(findtracklets_state* state,
+                                  int exp_lo, int exp_hi) {
+  track_array* cands;
+  track_index* ti;
+  track* X;
+  ivec* sizes;
+  ivec* order;
+  ivec* inds;
+  ivec* sinds;
+  int num_exp = ivec_size(state->exp_starts);
+  int seed_lo, seed_hi, N, i, j;
+
+  if(exp_lo >= exp_hi) { return; }
+
+  seed_lo = ivec_ref(state->exp_starts,exp_lo);
+  if(exp_hi < num_exp) {
+    seed_hi = ivec_ref(state->exp_starts,exp_hi);
+  } else {
+    seed_hi = state->num_committed;
+  }
+
+  cands = mk_tracklets_MHT_seeds(state->data,seed_lo,seed_hi,
+                                 state->minv*DEG_TO_RAD,
+                                 state->maxv*DEG_TO_RAD,
+                                 state->thresh*DEG_TO_RAD,
+                                 state->maxt,
+                                 state->minobs,
+                                 TRUE,
+                                 state->angle,
+                                 state->length,
+                                 state->exp_time,
+                                 state->athresh*DEG_TO_RAD,
+                                 state->maxLerr*DEG_TO_RAD,
+                                 state->etime/(24.0*60.0*60.0),
+                                 state->maxobs,
+                                 state->greedy,
+                                 state->use_pht,
+                                 state->elong_query,
+                                 state->beam,
+                                 state->budget,
+                                 state->threads,
+                                 (state->use_plates ? state->plate_width :
+                                  0.0));
+
+  /* Any superset of a new tracklet was found from an earlier seed at */
+  /* most maxt before it, so it is either a new candidate or still in */
+  /* the pool.  Index the pool and then accept the candidates largest */
+  /* to smallest (as mk_tracklet_remove_subsets does).                */
+  ti = mk_empty_track_index(simple_obs_array_size(state->data));
+  for(i=0;i<ivec_array_size(state->pool);i++) {
+    track_index_add(ti,ivec_array_ref(state->pool,i),i);
+  }
+
+  N     = track_array_size(cands);
+  sizes = mk_ivec(N);
+  for(i=0;i<N;i++) {
+    ivec_set(sizes,i,track_num_obs(track_array_ref(cands,i)));
+  }
+  order = mk_indices_of_sorted_ivec(sizes);
+
+  for(i=N-1;i>=0;i--) {
+    X = track_array_ref(cands,ivec_ref(order,i));
+    if(!track_index_has_superset(ti,track_individs(X))) {
+      sinds = mk_sivec_from_ivec(track_individs(X));
+      track_index_add(ti,sinds,track_index_num_tracks(ti));
+      add_to_ivec_array(state->pool,sinds);
+      free_ivec(sinds);
+
+      X    = mk_copy_track(X);
+      inds = track_individs(X);
+      for(j=0;j<ivec_size(inds);j++) {
+        ivec_set(inds,j,ivec_ref(state->ids,ivec_ref(inds,j)));
+      }
+      track_array_add(state->results,X);
+      free_track(X);
+    }
+  }
+
+  if((state->verbosity > 1)&&(state->log_fp != NULL)) {
+    fprintf(state->log_fp,"Seeded %i detections (%i results so far).\n",
+            seed_hi-seed_lo,track_array_size(state->results));
+  }
+
+  free_ivec(sizes);
+  free_ivec(order);
+  free_track_index(ti);
+  free_track_array(cands);
+}
+
+
+/* Start a new set of streaming results. */
+void findtracklets_clear_results(findtracklets_state* state) {
+  if(state->results != NULL) {
+    free_track_array(state->results);
+  }
+  state->results = mk_empty_track_array(10);
+}
+
+
+/* Commit the uncommitted detections as one exposure. */
+int findtracklets_add_exposure(findtracklets_state* state) {
+  int N       = simple_obs_array_size(state->data);
+  int lo      = state->num_committed;
+  int num_exp = ivec_size(state->exp_starts);
+  double tmin, tmax, t, cutoff;
+  int i, k;
+
+  if((num_exp == 0)&&(state->eval)&&(state->verbosity > 0)&&(state->log_fp != NULL)) {
+    fprintf(state->log_fp,"WARNING: Evaluation mode is not supported when streaming.\n");
+  }
+
+  /* An empty exposure finishes nothing. */
+  if(N == lo) {
+    return 0;
+  }
+
+  tmin = simple_obs_time(simple_obs_array_ref(state->data,lo));
+  tmax = tmin;
+  for(i=lo+1;i<N;i++) {
+    t = simple_obs_time(simple_obs_array_ref(state->data,i));
+    tmin = real_min(tmin,t);
+    tmax = real_max(tmax,t);
+  }
+
+  /* Exposures must arrive in time order.  Drop an out of order one. */
+  if((num_exp > 0)&&(tmin < dyv_ref(state->exp_hi,num_exp-1))) {
+    if((state->verbosity > 0)&&(state->log_fp != NULL)) {
+      fprintf(state->log_fp,"ERROR: Exposure at %f is earlier than the previous exposure (%f).  Dropping its %i detections.\n",
+              tmin,dyv_ref(state->exp_hi,num_exp-1),N-lo);
+    }
+    findtracklets_keep_window(state,0,lo);
+    state->num_points -= (N-lo);
+    return 1;
+  }
+
+  add_to_ivec(state->exp_starts,lo);
+  add_to_dyv(state->exp_lo,tmin);
+  add_to_dyv(state->exp_hi,tmax);
+  state->num_committed = N;
+
+  /* A seed is finished once no later detection can be within maxt. */
+  k = state->num_seeded;
+  while((k < num_exp)&&(dyv_ref(state->exp_hi,k) + state->maxt < tmin)) {
+    k++;
+  }
+  findtracklets_emit_exposures(state,state->num_seeded,k);
+  state->num_seeded = k;
+
+  /* Evict the exposures that can be in neither a pending tracklet */
+  /* nor a superset of one.                                        */
+  cutoff = dyv_ref(state->exp_lo,k) - state->maxt;
+  k = 0;
+  while((k < state->num_seeded)&&(dyv_ref(state->exp_hi,k) < cutoff)) {
+    k++;
+  }
+  findtracklets_evict_exposures(state,k);
+
+  return 0;
+}
+
+
+/* Commit all of the detections added since the last call as one */
+/* exposure and emit the tracklets that are now finished.        */
+int FindTracklets_AddExposure(FindTrackletsStateHandle fph) {
+  findtracklets_state* state = (findtracklets_state*)fph;
+
+  findtracklets_clear_results(state);
+
+  return findtracklets_add_exposure(state);
+}
+
+
+/* Commit any remaining detections, emit all of the remaining */
+/* tracklets and empty the window.                            */
+int FindTracklets_Flush(FindTrackletsStateHandle fph) {
+  findtracklets_state* state = (findtracklets_state*)fph;
+  int res;
+
+  findtracklets_clear_results(state);
+  res = findtracklets_add_exposure(state);
+
+  findtracklets_emit_exposures(state,state->num_seeded,
+                               ivec_size(state->exp_starts));
+  state->num_seeded = ivec_size(state->exp_starts);
+  findtracklets_evict_exposures(state,state->num_seeded);
+
+  return res;
+}
+
+
 /* Fetch the total number of result tracklets. */
 int FindTracklets_Num_Tracklets(FindTrackletsStateHandle fph) {
   findtracklets_state* state = (findtracklets_state*)fph;
@@ -626,6 +1049,12 @@ int FindTracklets_Free(FindTrackletsStateHandle fph) {
     free_ivec(st->true_groups);
     free_namer(st->truenames);
 
+    free_ivec(st->ids);
+    free_ivec(st->exp_starts);
+    free_dyv(st->exp_lo);
+    free_dyv(st->exp_hi);
+    free_ivec_array(st->pool);
+
     if(st->results != NULL) {
       free_track_array(st->results);
     }
@@ -27,7 +27,7 @@
 
 #define TRACKLET_VERSION 2
 #define TRACKLET_RELEASE 0
-#define TRACKLET_UPDATE  5
+#define TRACKLET_UPDATE  6
 
 #define FT_DEF_THRESH       0.0003
 #define FT_DEF_ATHRESH      180.0
@@ -38,6 +38,13 @@
 #define FT_DEF_ETIME        30.0
 #define FT_DEF_MINOBS       2
 #define FT_DEF_MAXOBS       100
+#define FT_DEF_THREADS      1
+#define FT_DEF_PLATE_WIDTH  0.001
+#define FT_DEF_COLLAPSE_RA  0.002
+#define FT_DEF_COLLAPSE_DEC 0.002
+#define FT_DEF_COLLAPSE_ANG 5.0
+#define FT_DEF_COLLAPSE_VEL 0.05
+#define FT_DEF_PURIFY_RMS   3.6
 
 typedef void *FindTrackletsStateHandle;
 
@@ -87,6 +94,27 @@ int FindTracklets_set_greedy(FindTrackletsStateHandle* state, int val);
 /* Use PHT (Partial Hough Transform)? (0=NO, 1=YES) */
 int FindTracklets_set_use_pht(FindTrackletsStateHandle* state, int val);
 
+/* Restrict the endpoint queries of fast movers using their */
+/* elongation angle? (0=NO, 1=YES, default YES)              */
+int FindTracklets_set_elong_query(FindTrackletsStateHandle* state, int val);
+
+/* Set the number of hypotheses of each length kept by the MHT */
+/* search (default 0 = all of them).                           */
+int FindTracklets_set_beam(FindTrackletsStateHandle* state, int nu_val);
+
+/* Set the number of hypotheses built from each starting detection */
+/* before its search stops (default 0 = no limit).                 */
+int FindTracklets_set_budget(FindTrackletsStateHandle* state, long nu_val);
+
+/* Set the number of worker threads used for the search. */
+int FindTracklets_set_threads(FindTrackletsStateHandle* state, int nu_val);
+
+/* Index the detections with one tree per plate? (0=NO, 1=YES) */
+int FindTracklets_set_use_plates(FindTrackletsStateHandle* state, int val);
+
+/* Set the maximum time spread of a single plate (in days). */
+int FindTracklets_set_plate_width(FindTrackletsStateHandle* state, double nu_val);
+
 /* Add a data detection to the data set.    */
 /* Return the internal FindTracklets number */
 /* for that detections.                     */
@@ -131,6 +159,21 @@ int FindTracklets_AddTrackletName(FindTrackletsStateHandle fph,
 int FindTracklets_Run(FindTrackletsStateHandle fph);
 
 
+/* Streaming mode: commit all of the detections added since the   */
+/* last call as one exposure.  Exposures must be added in time     */
+/* order (returns 1 and drops the exposure otherwise).  The        */
+/* results are replaced by the tracklets that were finished by     */
+/* this exposure, i.e. those whose seeds are more than maxt before */
+/* it.  Detections that can no longer be used are evicted.         */
+int FindTracklets_AddExposure(FindTrackletsStateHandle fph);
+
+
+/* Streaming mode: commit any remaining detections and replace the */
+/* results with all of the tracklets that have not been emitted.   */
+/* This empties the window, so a new stream can be started.        */
+int FindTracklets_Flush(FindTrackletsStateHandle fph);
+
+
 /* Fetch the total number of result tracklets. */
 int FindTracklets_Num_Tracklets(FindTrackletsStateHandle fph);
 
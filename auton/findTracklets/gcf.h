@@ -7,6 +7,9 @@ Copyright (c) 2010 Sonia Keys
 See external file LICENSE, distributed with this software.
 */
 
+#ifndef GCF_H
+#define GCF_H
+
 #ifndef M_PI
 #define M_PI 3.14159265358979323
 #endif
@@ -43,3 +46,19 @@ double gcRmsRes(gcfparam *gcf, double res[][2]);
 // compute 2d rms of residuals, don't bother to return residuals
 double gcRms(gcfparam *gcf);
 
+// batched fits (gcfbatch.c).  the tracklets are given as a structure of
+// arrays: detection j of tracklet k is element [j * stride + k] of each
+// array (stride >= nTrk), and tracklet k has nObs[k] detections in time
+// order.  rms[k] is set to the 2d rms residual in arcsec, as returned by
+// gcRmsRes.  the fits are done GCF_BATCH tracklets at a time.
+#define GCF_BATCH 16
+
+// detections as mjd, ra and dec in radians.
+void gcRmsBatch(int nTrk, int stride, int nObs[], double mjd[],
+                double ra[], double dec[], double rms[]);
+
+// detections as mjd and unit vectors.
+void gcRmsBatchCart(int nTrk, int stride, int nObs[], double mjd[],
+                    double x[], double y[], double z[], double rms[]);
+
+#endif
@@ -19,11 +19,21 @@
    along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
 #include "am_time.h"
 #include "rdt_tree.h"
+#include "obs_load.h"
+#include "tracklet_file.h"
 #include "tracklet_mht.h"
+#include "tracklet_collapse.h"
 #include "findtrackletsapi.h"
 #include "gcf.h"
+#include "bench.h"
 
 void output_tracklet_results(simple_obs_array* parr, track_array* tarr,
                              char* pairfile, char* sumfile) {
@@ -63,50 +73,22 @@ void output_tracklet_results(simple_obs_array* parr, track_array* tarr,
 }
 
 
-double compute_gcr(simple_obs_array* parr, ivec* inds) {
-    /* Compute the great circle residual to the detections in the tracklet.  */
-    int nobs = ivec_size(inds);
-    double t[nobs];
-    double c[nobs][2];
-    int i;
-    for (i = 0; i < nobs; i++) {
-        simple_obs* obs = simple_obs_array_ref(parr, ivec_ref(inds, i));
-        t[i] = simple_obs_time(obs);
-        c[i][0] = M_PI / 180 * simple_obs_RA(obs) * 15;      // RA stored in hours
-        c[i][1] = M_PI / 180 * simple_obs_DEC(obs);
-
-//        printf("%s %f %f %f\n", simple_obs_id_str(obs), simple_obs_time(obs), simple_obs_RA(obs) * 15, simple_obs_DEC(obs));
-    }
-    gcfparam gcf;
-    gcf.nObs = nobs;
-    double nt[nobs];
-    double rs[nobs][2];
-    gcf.ntime = nt;
-    gcf.rs = rs;
-    gcFit(&gcf, t, c);
-    
-    double res[nobs][2];
-    double rms = gcRmsRes(&gcf, res);
-
-//    printf("RMS=%f\n\n", rms);
-    return rms;
-}
-
-
-void output_tracklet_ids(simple_obs_array* parr, track_array* tarr, char* idsfile) {
+void output_tracklet_ids(simple_obs_array* parr, track_array* tarr,
+                         dyv* gcr, char* idsfile) {
   FILE* fp;
   ivec* inds;
   int i, j;
 
-  /* Just write out lines containing detection IDs.  Each line is a single tracklet: GC_resid_deg detID1 detID2 .... */
+  /* Just write out lines containing detection IDs.  Each line is a single tracklet: [GC_resid_arcsec] detID1 detID2 .... */
   fp = fopen(idsfile,"w");
   if(fp) {
     for(i=0;i<track_array_size(tarr);i++) {
       inds = track_individs(track_array_ref(tarr,i));
 
-      // Compute and emit great circle residual in deg.
-//      float gcr_deg = compute_gcr(parr, inds);
-//      fprintf(fp,"%6.3f ", gcr_deg);
+      /* Emit the great circle residual (arcsec) if it was computed. */
+      if(gcr != NULL) {
+        fprintf(fp,"%6.3f ", dyv_ref(gcr,i));
+      }
 
       for(j=0;j<ivec_size(inds) - 1;j++) {
         fprintf(fp,"%s ", simple_obs_id_str(simple_obs_array_ref(parr,ivec_ref(inds,j))));
@@ -119,32 +101,221 @@ void output_tracklet_ids(simple_obs_array* parr, track_array* tarr, char* idsfil
   }
 }
 
+/* Read the tracklets from one or more pairs files (comma separated */
+/* names), such as those written by the runs of single sky tiles.   */
+/* Returns NULL (after printing why) if a file can not be read or   */
+/* refers to detections that parr does not have.                    */
+track_array* mk_tracklets_from_pair_files(simple_obs_array* parr,
+                                          char* files) {
+  string_array* names = mk_broken_string_using_seppers(files, ",");
+  string_array* line;
+  track_array* res = mk_empty_track_array(10);
+  track* T;
+  ivec* inds;
+  FILE* fp;
+  bool ok = TRUE;
+  int N = simple_obs_array_size(parr);
+  int f, i, ind;
+
+  for(f=0;(f<string_array_size(names))&&(ok);f++) {
+    fp = fopen(string_array_ref(names,f),"r");
+    if(fp == NULL) {
+      printf("ERROR: Unable to open %s.\n", string_array_ref(names,f));
+      ok = FALSE;
+      continue;
+    }
+
+    while(ok && ((line = mk_string_array_from_line(fp)) != NULL)) {
+      if(string_array_size(line) > 0) {
+        inds = mk_ivec(string_array_size(line));
+        for(i=0;i<string_array_size(line);i++) {
+          ind = atoi(string_array_ref(line,i));
+          if((ind < 0) || (ind >= N)) {
+            printf("ERROR: %s refers to detection %i (of %i).\n",
+                   string_array_ref(names,f), ind, N);
+            ok = FALSE;
+          }
+          ivec_set(inds,i,ind);
+        }
+        if(ok) {
+          T = mk_track_from_N_inds(parr,inds);
+          track_array_add_no_copy(res,T);
+        }
+        free_ivec(inds);
+      }
+      free_string_array(line);
+    }
+    fclose(fp);
+  }
+
+  free_string_array(names);
+  if(!ok) {
+    free_track_array(res);
+    res = NULL;
+  }
+
+  return res;
+}
+
+
+/* The search parameters shared by the normal, bench and sweep modes. */
+/* They are as given on the command line (degrees, deg/day and        */
+/* seconds) until tracklet_opts_to_search_units converts them.        */
+typedef struct tracklet_opts {
+  double athresh;
+  double thresh;
+  double maxLerr;
+  double etime;
+  double minv;
+  double maxv;
+  double maxt;
+  int    minobs;
+  int    maxobs;
+  bool   greedy;
+  bool   removedups;
+  bool   use_pht;
+  int    threads;
+  bool   use_plates;
+  double plate_width;
+  double tile_width;
+  bool   elong_query;
+  int    beam;
+  long   budget;
+} tracklet_opts;
+
+
+void tracklet_opts_from_args(tracklet_opts* opts, int argc, char** argv) {
+  opts->athresh = double_from_args("athresh",argc,argv,FT_DEF_ATHRESH);
+  opts->thresh  = double_from_args("thresh",argc,argv,FT_DEF_THRESH);
+  opts->maxLerr = double_from_args("maxLerr",argc,argv,FT_DEF_MAXLERR);
+  opts->etime   = double_from_args("etime",argc,argv,FT_DEF_ETIME);
+  opts->minv    = double_from_args("minv",argc,argv,FT_DEF_MINV);
+  opts->maxv    = double_from_args("maxv",argc,argv,FT_DEF_MAXV);
+  opts->maxt    = double_from_args("maxt",argc,argv,FT_DEF_MAXT);
+  opts->minobs  = double_from_args("minobs",argc,argv,FT_DEF_MINOBS);
+  opts->maxobs  = double_from_args("maxobs",argc,argv,FT_DEF_MAXOBS);
+  opts->greedy      = bool_from_args("greedy",argc,argv,FALSE);
+  opts->removedups  = bool_from_args("remove_subsets",argc,argv,TRUE);
+  opts->use_pht     = bool_from_args("use_pht",argc,argv,FALSE);
+  opts->threads     = int_from_args("threads",argc,argv,FT_DEF_THREADS);
+  opts->use_plates  = bool_from_args("use_plates",argc,argv,FALSE);
+  opts->plate_width = double_from_args("plate_width",argc,argv,
+                                       FT_DEF_PLATE_WIDTH);
+  opts->tile_width  = double_from_args("tile_width",argc,argv,0.0);
+  opts->elong_query = bool_from_args("elong_query",argc,argv,TRUE);
+  opts->beam        = int_from_args("beam",argc,argv,0);
+  opts->budget      = int_from_args("budget",argc,argv,0);
+}
+
+
+/* Convert the angles to radians (and speeds to radians/day) and the */
+/* exposure time to days, as the searches take them.                 */
+void tracklet_opts_to_search_units(tracklet_opts* opts) {
+  opts->minv    = opts->minv * DEG_TO_RAD;
+  opts->maxv    = opts->maxv * DEG_TO_RAD;
+  opts->thresh  = opts->thresh * DEG_TO_RAD;
+  opts->athresh = opts->athresh * DEG_TO_RAD;
+  opts->maxLerr = opts->maxLerr * DEG_TO_RAD;
+
+  /* Make sure the exposure time is realistic and in days. */
+  if(opts->etime < 0.01) { opts->etime = 0.01; }
+  opts->etime = opts->etime / (24.0 * 60.0 * 60.0);
+}
+
+
+/* The plate width to search with (0.0 for a single tree). */
+double tracklet_opts_plate_width(tracklet_opts* opts) {
+  return opts->use_plates ? opts->plate_width : 0.0;
+}
+
+
+/* The MHT search with opts (in search units) over all of obs (with  */
+/* tiles NULL), over all of the sky tiles or over just tile number   */
+/* tile (if tile >= 0).                                               */
+track_array* mk_tracklets_with_opts(simple_obs_array* obs, sky_tiles* tiles,
+                                    int tile, tracklet_opts* opts,
+                                    dyv* angle, dyv* length, dyv* exp_time,
+                                    mht_timing* counts) {
+  double plate_width = tracklet_opts_plate_width(opts);
+
+  if(tiles == NULL) {
+    return mk_tracklets_MHT_timed(obs, opts->minv, opts->maxv, opts->thresh,
+                                  opts->maxt, opts->minobs, opts->removedups,
+                                  angle, length, exp_time, opts->athresh,
+                                  opts->maxLerr, opts->etime, opts->maxobs,
+                                  opts->greedy, opts->use_pht,
+                                  opts->elong_query, opts->beam, opts->budget,
+                                  opts->threads, plate_width, counts);
+  }
+  if(tile >= 0) {
+    return mk_tracklets_MHT_tile_timed(obs, tiles, tile, opts->minv,
+                                       opts->maxv, opts->thresh, opts->maxt,
+                                       opts->minobs, opts->removedups, angle,
+                                       length, exp_time, opts->athresh,
+                                       opts->maxLerr, opts->etime,
+                                       opts->maxobs, opts->greedy,
+                                       opts->use_pht, opts->elong_query,
+                                       opts->beam, opts->budget,
+                                       opts->threads, plate_width, counts);
+  }
+  return mk_tracklets_MHT_tiled_timed(obs, tiles, opts->minv, opts->maxv,
+                                      opts->thresh, opts->maxt, opts->minobs,
+                                      opts->removedups, angle, length,
+                                      exp_time, opts->athresh, opts->maxLerr,
+                                      opts->etime, opts->maxobs, opts->greedy,
+                                      opts->use_pht, opts->elong_query,
+                                      opts->beam, opts->budget, opts->threads,
+                                      plate_width, counts);
+}
+
+
+/* The sky tiles of tile_width for opts (in search units). */
+sky_tiles* mk_sky_tiles_with_opts(simple_obs_array* obs, tracklet_opts* opts,
+                                  dyv* length, dyv* exp_time) {
+  return mk_tracklets_sky_tiles(obs, opts->tile_width, opts->minv,
+                                opts->maxv, opts->thresh, opts->maxt, length,
+                                exp_time, opts->maxLerr, opts->etime);
+}
+
+
 void tracklet_main(int argc,char *argv[]) {
   char* fname = string_from_args("file",argc,argv,NULL);
   char* fout1 = string_from_args("pairfile",argc,argv,"pairs.obs");
   char* fout2 = string_from_args("summaryfile",argc,argv,"pairs.sum");
   char* fout3 =  string_from_args("idsfile",argc,argv,NULL);
   char* fout_mpc = string_from_args("mpc_file",argc,argv,NULL);
-  double athresh = double_from_args("athresh",argc,argv,FT_DEF_ATHRESH);
-  double thresh  = double_from_args("thresh",argc,argv,FT_DEF_THRESH);
-  double maxLerr = double_from_args("maxLerr",argc,argv,FT_DEF_MAXLERR);
-  double etime   = double_from_args("etime",argc,argv,FT_DEF_ETIME);
-  double minv    = double_from_args("minv",argc,argv,FT_DEF_MINV);
-  double maxv    = double_from_args("maxv",argc,argv,FT_DEF_MAXV);
-  double maxt    = double_from_args("maxt",argc,argv,FT_DEF_MAXT);
-  int    minobs  = double_from_args("minobs",argc,argv,FT_DEF_MINOBS);  
-  int    maxobs  = double_from_args("maxobs",argc,argv,FT_DEF_MAXOBS);  
+  char* fout_bin = string_from_args("binfile",argc,argv,NULL);
+  bool   emit_gcr = bool_from_args("gcr",argc,argv,FALSE);
+  double max_gcr  = double_from_args("max_gcr",argc,argv,0.0);
   bool   eval          = bool_from_args("eval",argc,argv,FALSE);
-  bool   greedy        = bool_from_args("greedy",argc,argv,FALSE);
-  bool   removedups    = bool_from_args("remove_subsets",argc,argv,TRUE);
-  bool   use_pht       = bool_from_args("use_pht", argc, argv, FALSE);
+  int    tile          = int_from_args("tile", argc, argv, -1);
+  char*  merge_tiles   = string_from_args("merge_tiles", argc, argv, NULL);
+  bool   collapse      = bool_from_args("collapse", argc, argv, FALSE);
+  double collapse_ra   = double_from_args("collapse_ra", argc, argv,
+                                          FT_DEF_COLLAPSE_RA);
+  double collapse_dec  = double_from_args("collapse_dec", argc, argv,
+                                          FT_DEF_COLLAPSE_DEC);
+  double collapse_ang  = double_from_args("collapse_ang", argc, argv,
+                                          FT_DEF_COLLAPSE_ANG);
+  double collapse_vel  = double_from_args("collapse_vel", argc, argv,
+                                          FT_DEF_COLLAPSE_VEL);
+  double purify_rms    = double_from_args("purify_rms", argc, argv,
+                                          FT_DEF_PURIFY_RMS);
+  int    purify_minobs;
+  tracklet_opts opts;
+  mht_timing counts;
   simple_obs_array* obs;
+  sky_tiles* tiles;
   track_array* trcks;
+  track_array* merged;
+  track_array* kept;
   track_array* cheat;
   ivec_array* obs_to_track;
   dyv* length;
   dyv* angle;
   dyv* exp_time;
+  dyv* gcr = NULL;
+  dyv* kept_gcr;
   ivec* true_groups;
   ivec* cheat_pairs;
   ivec* roc;
@@ -154,6 +325,9 @@ void tracklet_main(int argc,char *argv[]) {
   double percent_found = 0.0;
   int matches_found = 0;
 
+  tracklet_opts_from_args(&opts, argc, argv);
+  purify_minobs = int_from_args("purify_minobs", argc, argv, opts.minobs);
+
   printf("FIND_TRACKLETS VERSION: %i.%i.%i\n",TRACKLET_VERSION,
          TRACKLET_RELEASE,TRACKLET_UPDATE);
   printf("This program comes with ABSOLUTELY NO WARRANTY. This is free "
@@ -180,21 +354,53 @@ void tracklet_main(int argc,char *argv[]) {
     printf("Output file (MPC):     [N/A]\n");
   }
 
-  printf("Fit threshold (degrees)  = %12.8f   (default = %f)\n",thresh,FT_DEF_THRESH);
-  printf("Angle Thresh (degrees)   = %12.8f   (default = %f)\n",athresh,FT_DEF_ATHRESH);
-  printf("maxLerr (degrees)        = %12.8f   (default = %f)\n",maxLerr,FT_DEF_MAXLERR);
-  printf("Min. Velocity (deg/day)  = %12.8f   (default = %f)\n",minv,FT_DEF_MINV);
-  printf("Max. Velocity (deg/day)  = %12.8f   (default = %f)\n",maxv,FT_DEF_MAXV);
-  printf("Max. Spread   (days)     = %12.8f   (default = %f)\n",maxt,FT_DEF_MAXT);
-  printf("Exposure Time (sec)      = %12.8f   (default = %f)\n",etime,FT_DEF_ETIME);
-  printf("Min. Number of Obs.      = %12i   (default = %i)\n",minobs,FT_DEF_MINOBS);
-  printf("Max. Number of Obs.      = %12i   (default = %i)\n",maxobs,FT_DEF_MAXOBS);
-  if(greedy) {
+  if(fout_bin != NULL) {
+    printf("Output file (binary):  "); puts(fout_bin); printf("\n");
+  } else {
+    printf("Output file (binary):  [N/A]\n");
+  }
+
+  printf("Fit threshold (degrees)  = %12.8f   (default = %f)\n",opts.thresh,FT_DEF_THRESH);
+  printf("Angle Thresh (degrees)   = %12.8f   (default = %f)\n",opts.athresh,FT_DEF_ATHRESH);
+  printf("maxLerr (degrees)        = %12.8f   (default = %f)\n",opts.maxLerr,FT_DEF_MAXLERR);
+  printf("Min. Velocity (deg/day)  = %12.8f   (default = %f)\n",opts.minv,FT_DEF_MINV);
+  printf("Max. Velocity (deg/day)  = %12.8f   (default = %f)\n",opts.maxv,FT_DEF_MAXV);
+  printf("Max. Spread   (days)     = %12.8f   (default = %f)\n",opts.maxt,FT_DEF_MAXT);
+  printf("Exposure Time (sec)      = %12.8f   (default = %f)\n",opts.etime,FT_DEF_ETIME);
+  printf("Min. Number of Obs.      = %12i   (default = %i)\n",opts.minobs,FT_DEF_MINOBS);
+  printf("Max. Number of Obs.      = %12i   (default = %i)\n",opts.maxobs,FT_DEF_MAXOBS);
+  printf("Number of Threads        = %12i   (default = %i)\n",opts.threads,FT_DEF_THREADS);
+#ifndef USE_PTHREADS
+  if(opts.threads > 1) {
+    printf("   (Not built with thread=1, so the search runs serially.)\n");
+  }
+#endif
+  if(opts.use_plates) {
+    printf("Per-plate trees:             ON (width = %f)\n",opts.plate_width);
+  } else {
+    printf("Per-plate trees:             OFF\n");
+  }
+  if(opts.greedy) {
     printf("Greedy mode:                 ON\n");
   } else {
     printf("Greedy mode:                 OFF\n");
   }
-  if(use_pht) {
+  if(opts.elong_query) {
+    printf("Elongation query pruning:    ON\n");
+  } else {
+    printf("Elongation query pruning:    OFF\n");
+  }
+  if((opts.beam > 0) || (opts.budget > 0)) {
+    printf("MHT beam / budget        = %12i / %li   (default = off)\n",
+           opts.beam,opts.budget);
+  }
+  if(collapse) {
+    printf("Collapse tolerances      = %g %g %g %g   (RA, DEC, angle, speed)\n",
+           collapse_ra,collapse_dec,collapse_ang,collapse_vel);
+    printf("Purify max. rms (arcsec) = %12.8f   (default = %f)\n",
+           purify_rms,FT_DEF_PURIFY_RMS);
+  }
+  if(opts.use_pht) {
     printf("PHT mode:                    ON\n");
   } else {
     printf("PHT mode:                    OFF\n");
@@ -204,40 +410,130 @@ void tracklet_main(int argc,char *argv[]) {
   } else {
     printf("Evaluation mode:             OFF\n");
   }
-  if(removedups) {
+  if(opts.removedups) {
     printf("Remove subsets/duplicates:   ON\n");
   } else {
     printf("Remove subsets/duplicates:   OFF\n");
   }
+  if(emit_gcr) {
+    printf("Write GC residuals (ids):    ON\n");
+  } else {
+    printf("Write GC residuals (ids):    OFF\n");
+  }
+  if(max_gcr > 0.0) {
+    printf("Max. GC residual (arcsec)= %12.8f   (default = off)\n",max_gcr);
+  }
+  if(merge_tiles != NULL) {
+    printf("Merging tiles from:          %s\n",merge_tiles);
+  } else if(opts.tile_width > 0.0) {
+    printf("Sky tile width (degrees) = %12.8f   (default = off)\n",opts.tile_width);
+    if(tile >= 0) {
+      printf("Only searching tile:     %12i\n",tile);
+    }
+  }
 
-  minv    = minv * DEG_TO_RAD;
-  maxv    = maxv * DEG_TO_RAD;
-  thresh  = thresh * DEG_TO_RAD;
-  athresh = athresh * DEG_TO_RAD;
-  maxLerr = maxLerr * DEG_TO_RAD;
+  /* A single tile only writes its candidates (as a pairs file) for a */
+  /* later merge_tiles run, which does all of the other outputs.      */
+  if((opts.tile_width > 0.0) && (tile >= 0) && (merge_tiles == NULL)) {
+    fout3    = NULL;
+    fout_mpc = NULL;
+    fout_bin = NULL;
+    emit_gcr = FALSE;
+    max_gcr  = 0.0;
+    eval     = FALSE;
+    collapse = FALSE;
+  }
 
-  /* Make sure the exposure time is realistic and in days. */
-  if(etime < 0.01) { etime = 0.01; }
-  etime = etime / (24.0 * 60.0 * 60.0); 
+  tracklet_opts_to_search_units(&opts);
 
   printf("\n\n");
 
   if(fname == NULL) {
     printf("ERROR: No filename given.\n");
   } else {
-    obs = mk_simple_obs_array_from_file_elong(fname, maxt, &true_groups, NULL,
-                                              &length, &angle, &exp_time);
+    obs_load_set_threads(opts.threads);
+    mht_timing_init(&counts);
+    obs = mk_simple_obs_array_from_file_elong(fname, opts.maxt, &true_groups,
+                                              NULL, &length, &angle,
+                                              &exp_time);
 
     if((obs != NULL)&&(simple_obs_array_size(obs) > 0)) {
-      trcks = mk_tracklets_MHT(obs, minv, maxv, thresh, maxt, minobs,
-                               removedups, angle, length, exp_time,
-                               athresh, maxLerr, etime,
-                               maxobs, greedy, use_pht);
+      if(merge_tiles != NULL) {
+        /* Merge the candidates from the tiles' runs. */
+        trcks = mk_tracklets_from_pair_files(obs, merge_tiles);
+        if(trcks == NULL) { trcks = mk_empty_track_array(1); }
+        merged = mk_tracklets_in_seed_order(trcks,
+                                            simple_obs_array_size(obs));
+        free_track_array(trcks);
+        trcks = merged;
+        if(opts.removedups) {
+          merged = mk_tracklet_remove_subsets(trcks, obs);
+          free_track_array(trcks);
+          trcks = merged;
+        }
+      } else if(opts.tile_width > 0.0) {
+        tiles = mk_sky_tiles_with_opts(obs, &opts, length, exp_time);
+        printf(">> Split the detections into %i sky tiles "
+               "(%i detections with the overlaps).\n",
+               sky_tiles_num_tiles(tiles), sky_tiles_total_members(tiles));
+
+        if(tile >= sky_tiles_num_tiles(tiles)) {
+          trcks = mk_empty_track_array(1);
+        } else {
+          trcks = mk_tracklets_with_opts(obs, tiles, tile, &opts, angle,
+                                         length, exp_time, &counts);
+        }
+        free_sky_tiles(tiles);
+      } else {
+        trcks = mk_tracklets_with_opts(obs, NULL, -1, &opts, angle, length,
+                                       exp_time, &counts);
+      }
+
+      /* Merge the tracklets of the same object and then clean */
+      /* their fits (for deep stacks).                          */
+      if(collapse) {
+        merged = mk_tracklets_collapse(obs, trcks, collapse_ra, collapse_dec,
+                                       collapse_ang, collapse_vel,
+                                       purify_rms);
+        kept = mk_tracklets_purify(obs, merged, purify_rms, purify_minobs);
+        printf(">> Collapsed %i tracklets into %i and kept %i after "
+               "purifying.\n", track_array_size(trcks),
+               track_array_size(merged), track_array_size(kept));
+        free_track_array(trcks);
+        free_track_array(merged);
+        trcks = kept;
+        if(opts.removedups) {
+          merged = mk_tracklet_remove_subsets(trcks, obs);
+          free_track_array(trcks);
+          trcks = merged;
+        }
+      }
+
+      if((opts.beam > 0) || (opts.budget > 0)) {
+        printf(">> The beam dropped %li of %li hypotheses and %li searches "
+               "hit the budget.\n", counts.pruned, counts.hypotheses,
+               counts.truncated);
+      }
+
+      /* Score (and optionally filter) the tracklets by their great */
+      /* circle residuals.                                          */
+      if(emit_gcr || (max_gcr > 0.0)) {
+        gcr = mk_tracklets_gc_rms(obs, trcks);
+        if(max_gcr > 0.0) {
+          kept = mk_tracklets_filter_gc_rms(trcks, gcr, max_gcr, &kept_gcr);
+          printf(">> Removed %i tracklets with GC residuals over %f arcsec.\n",
+                 track_array_size(trcks) - track_array_size(kept), max_gcr);
+          free_track_array(trcks);
+          free_dyv(gcr);
+          trcks = kept;
+          gcr   = kept_gcr;
+        }
+      }
 
       printf(">> Dumping tracks to output files.\n");
 
       if (fout3) {
-        output_tracklet_ids(obs,trcks,fout3);
+        output_tracklet_ids(obs,trcks,(emit_gcr ? gcr : NULL),fout3);
       }
       else {
         /* idsfile not specified, so output usual stuff (sum and pairs) */
@@ -248,6 +544,10 @@ void tracklet_main(int argc,char *argv[]) {
         dump_tracks_to_MPC_file(fout_mpc,obs,trcks);
       }
 
+      if(fout_bin != NULL) {
+        write_tracklet_file(fout_bin,obs,trcks,true_groups);
+      }
+
       /* Do the scoring. */
       if(eval == TRUE) {
         printf("\n\nScoring the tracks (");
@@ -256,9 +556,9 @@ void tracklet_main(int argc,char *argv[]) {
 
         obs_to_track = mk_simple_obs_pairing_from_true_groups(obs,
                                                               true_groups,
-                                                              maxt);
+                                                              opts.maxt);
         cheat = mk_track_array_from_matched_simple_obs(obs, obs_to_track,
-                                                       minobs);
+                                                       opts.minobs);
         free_ivec_array(obs_to_track);
      
         /* Fill cheat_pairs with "observation -> true group number" mapping. */
@@ -270,7 +570,8 @@ void tracklet_main(int argc,char *argv[]) {
           }
         }
 
-        roc = mk_track_array_roc_vec(obs, trcks, cheat_pairs, minobs, 1, 0.95);
+        roc = mk_track_array_roc_vec(obs, trcks, cheat_pairs, opts.minobs,
+                                     1, 0.95);
         printf("There are %i true tracklets in the code.\n",
                ivec_max(cheat_pairs)+1);
         printf("The code returned %i suggested tracklets.\n",
@@ -294,6 +595,7 @@ void tracklet_main(int argc,char *argv[]) {
       free_simple_obs_array(obs);
       free_ivec(true_groups);
       free_track_array(trcks);
+      if(gcr != NULL) { free_dyv(gcr); }
       if(length != NULL) { free_dyv(length); }
       if(angle != NULL) { free_dyv(angle); }
       if(exp_time != NULL) { free_dyv(exp_time); }
@@ -316,12 +618,626 @@ void tracklet_main(int argc,char *argv[]) {
   }
 }
 
+/* --------------------------------------------------------------------- */
+/* --- Benchmark mode -------------------------------------------------- */
+/* --------------------------------------------------------------------- */
+
+/* The timings of one run, passed from the child back to the parent. */
+typedef struct bench_result {
+  int    ok;
+  int    num_obs;
+  int    num_true;
+  int    num_tracklets;
+  long   endpoints;
+  long   hypotheses;
+  long   pruned;
+  long   truncated;
+  double load;
+  double tree_build;
+  double queries;
+  double subset_removal;
+  double output;
+} bench_result;
+
+
+/* What a child process is to do: generate the synthetic sky into */
+/* fname or find the tracklets of fname in one mode.               */
+typedef struct bench_job {
+  char*          fname;
+  char*          mode;
+  char*          pairfile;
+  char*          sumfile;
+  synth_sky*     sky;
+  tracklet_opts* opts;
+} bench_job;
+
+
+/* Generate the synthetic sky and write it to the job's file.  Runs */
+/* in a child process so that the sky is never in the memory of the */
+/* parent (and so of the runs that it forks).                       */
+void bench_gen_sky(bench_job* job, bench_result* R) {
+  simple_obs_array* obs;
+  ivec* true_groups;
+  dyv* length;
+  dyv* angle;
+  int i;
+
+  obs = mk_synthetic_sky_obs(job->sky, &true_groups, &length, &angle);
+  R->num_obs  = simple_obs_array_size(obs);
+  R->num_true = 0;
+  for(i=0;i<ivec_size(true_groups);i++) {
+    if(ivec_ref(true_groups,i) >= 0) { R->num_true++; }
+  }
+
+  R->ok = write_synthetic_sky_file(job->fname, obs, true_groups, length,
+                                   angle, job->sky->exp_time);
+
+  free_simple_obs_array(obs);
+  free_ivec(true_groups);
+  if(length != NULL) { free_dyv(length); }
+  if(angle != NULL) { free_dyv(angle); }
+}
+
+
+/* Load the detections and find the tracklets in one mode ("mht", */
+/* "pht" or "greedy"), timing each phase.  Runs in a child process */
+/* so that each run gets its own peak RSS.                          */
+void bench_run_mode(bench_job* job, bench_result* R) {
+  tracklet_opts opts = *(job->opts);
+  simple_obs_array* obs;
+  sky_tiles* tiles = NULL;
+  track_array* trcks;
+  ivec* true_groups = NULL;
+  dyv* length = NULL;
+  dyv* angle = NULL;
+  dyv* exp_time = NULL;
+  mht_timing timing;
+  double t_start;
+
+  opts.use_pht = eq_string(job->mode,"pht");
+  opts.greedy  = eq_string(job->mode,"greedy");
+  tracklet_opts_to_search_units(&opts);
+
+  R->ok = 0;
+  obs_load_set_threads(opts.threads);
+
+  t_start = mht_wall_seconds();
+  obs = mk_simple_obs_array_from_file_elong(job->fname, opts.maxt,
+                                            &true_groups, NULL, &length,
+                                            &angle, &exp_time);
+  R->load = mht_wall_seconds() - t_start;
+  if(obs == NULL) { return; }
+
+  mht_timing_init(&timing);
+  if(opts.tile_width > 0.0) {
+    t_start = mht_wall_seconds();
+    tiles = mk_sky_tiles_with_opts(obs, &opts, length, exp_time);
+    timing.build += mht_wall_seconds() - t_start;
+  }
+  trcks = mk_tracklets_with_opts(obs, tiles, -1, &opts, angle, length,
+                                 exp_time, &timing);
+  if(tiles != NULL) { free_sky_tiles(tiles); }
+
+  t_start = mht_wall_seconds();
+  output_tracklet_results(obs,trcks,job->pairfile,job->sumfile);
+  R->output = mht_wall_seconds() - t_start;
+
+  R->ok             = 1;
+  R->num_obs        = simple_obs_array_size(obs);
+  R->num_tracklets  = track_array_size(trcks);
+  R->tree_build     = timing.build;
+  R->queries        = timing.search;
+  R->subset_removal = timing.subsets;
+  R->endpoints      = timing.endpoints;
+  R->hypotheses     = timing.hypotheses;
+  R->pruned         = timing.pruned;
+  R->truncated      = timing.truncated;
+
+  free_track_array(trcks);
+  free_simple_obs_array(obs);
+  free_ivec(true_groups);
+  if(length != NULL) { free_dyv(length); }
+  if(angle != NULL) { free_dyv(angle); }
+  if(exp_time != NULL) { free_dyv(exp_time); }
+}
+
+
+/* Run run(job, R) in a child process, passing R back through a pipe. */
+/* Returns the child's peak RSS (in KB) or -1 if the run failed.       */
+long bench_fork(void (*run)(bench_job*, bench_result*), bench_job* job,
+                bench_result* R) {
+  struct rusage usage;
+  int fds[2];
+  int status;
+  pid_t pid;
+  ssize_t n;
+
+  R->ok = 0;
+  if(pipe(fds) != 0) { return -1; }
+
+  fflush(stdout);
+  pid = fork();
+  if(pid < 0) {
+    close(fds[0]);
+    close(fds[1]);
+    return -1;
+  }
+
+  if(pid == 0) {
+    /* The child: keep the loader's chatter out of the JSON. */
+    close(fds[0]);
+    if(freopen("/dev/null","w",stdout) == NULL) { _exit(1); }
+    run(job, R);
+    n = write(fds[1], R, sizeof(bench_result));
+    close(fds[1]);
+    _exit(n == sizeof(bench_result) ? 0 : 1);
+  }
+
+  close(fds[1]);
+  n = read(fds[0], R, sizeof(bench_result));
+  close(fds[0]);
+  if(wait4(pid, &status, 0, &usage) != pid) { return -1; }
+  if((n != sizeof(bench_result)) || !WIFEXITED(status) ||
+     (WEXITSTATUS(status) != 0) || !R->ok) {
+    R->ok = 0;
+    return -1;
+  }
+
+  return (long)usage.ru_maxrss;
+}
+
+
+void bench_main(int argc,char *argv[]) {
+  char* fname    = string_from_args("file",argc,argv,NULL);
+  char* genfile  = string_from_args("genfile",argc,argv,NULL);
+  char* jsonfile = string_from_args("jsonfile",argc,argv,NULL);
+  char* modes    = string_from_args("modes",argc,argv,"mht,pht,greedy");
+  char* fout1    = string_from_args("pairfile",argc,argv,"/dev/null");
+  char* fout2    = string_from_args("summaryfile",argc,argv,"/dev/null");
+  int   repeat   = int_from_args("repeat",argc,argv,1);
+  char  tmpname[64];
+  bool  synthetic = (fname == NULL);
+  bool  remove_input = FALSE;
+  string_array* mode_list;
+  tracklet_opts opts;
+  synth_sky sky;
+  bench_job job;
+  bench_result R;
+  bench_result best;
+  double total, best_total;
+  long rss, best_rss;
+  FILE* fp = stdout;
+  int num_true = 0;
+  int m, r, i;
+
+  tracklet_opts_from_args(&opts, argc, argv);
+  job.pairfile = fout1;
+  job.sumfile  = fout2;
+  job.sky      = &sky;
+  job.opts     = &opts;
+
+  /* Generate (and write) the synthetic sky unless given a real file. */
+  if(synthetic) {
+    synth_sky_from_args(&sky, argc, argv);
+
+    if(genfile == NULL) {
+      sprintf(tmpname, "/tmp/ft_bench_XXXXXX");
+      i = mkstemp(tmpname);
+      if(i < 0) {
+        printf("ERROR: Unable to create a temporary file.\n");
+        return;
+      }
+      close(i);
+      genfile = tmpname;
+      remove_input = TRUE;
+    }
+
+    job.fname = genfile;
+    if(bench_fork(bench_gen_sky, &job, &R) < 0) {
+      printf("ERROR: Unable to write the synthetic sky to %s.\n", genfile);
+      if(remove_input) { unlink(genfile); }
+      return;
+    }
+    num_true = R.num_true;
+    fname    = genfile;
+  }
+  job.fname = fname;
+
+  if(jsonfile != NULL) {
+    fp = fopen(jsonfile,"w");
+    if(fp == NULL) {
+      printf("ERROR: Unable to open %s for writing.\n", jsonfile);
+      if(remove_input) { unlink(fname); }
+      return;
+    }
+  }
+
+  fprintf(fp,"{\n");
+  fprintf(fp,"  \"program\": \"findTracklets\",\n");
+  fprintf(fp,"  \"version\": \"%i.%i.%i\",\n",TRACKLET_VERSION,
+          TRACKLET_RELEASE,TRACKLET_UPDATE);
+  if(synthetic) {
+    fprintf(fp,"  \"input\": \"synthetic\",\n");
+    fprintf(fp,"  \"sky\": {\"ra\": %g, \"dec\": %g, \"width\": %g, "
+            "\"density\": %g, \"false_frac\": %g, \"minv\": %g, "
+            "\"maxv\": %g, \"v_dist\": \"%s\", \"num_exp\": %i, "
+            "\"cadence\": %g, \"noise\": %g, \"seed\": %i, "
+            "\"exp_time\": %g, \"num_true\": %i},\n",
+            sky.RA, sky.DEC, sky.width, sky.density, sky.false_frac,
+            sky.minv, sky.maxv,
+            (sky.v_dist == SYNTH_SKY_V_LOG) ? "log" : "uniform",
+            sky.num_exp, sky.cadence, sky.noise, sky.seed, sky.exp_time,
+            num_true);
+  } else {
+    fprintf(fp,"  \"input\": \"%s\",\n", fname);
+  }
+  fprintf(fp,"  \"threads\": %i,\n", opts.threads);
+  fprintf(fp,"  \"tile_width\": %g,\n", opts.tile_width);
+  fprintf(fp,"  \"elong_query\": %s,\n", opts.elong_query ? "true" : "false");
+  fprintf(fp,"  \"beam\": %i, \"budget\": %li,\n", opts.beam, opts.budget);
+  fprintf(fp,"  \"repeat\": %i,\n", repeat);
+  fprintf(fp,"  \"runs\": [");
+
+  /* Run each mode (keeping the fastest of the repeats). */
+  mode_list = mk_broken_string_using_seppers(modes, ",");
+  for(m=0;m<string_array_size(mode_list);m++) {
+    best.ok    = 0;
+    best_total = -1.0;
+    best_rss   = -1;
+    job.mode   = string_array_ref(mode_list,m);
+    for(r=0;r<int_max(repeat,1);r++) {
+      rss = bench_fork(bench_run_mode, &job, &R);
+      if(rss < 0) { break; }
+      total = R.load + R.tree_build + R.queries + R.subset_removal + R.output;
+      if((best_total < 0.0) || (total < best_total)) {
+        best       = R;
+        best_total = total;
+      }
+      best_rss = long_max(best_rss, rss);
+    }
+
+    fprintf(fp,"%s\n    {\"mode\": \"%s\", ", (m > 0) ? "," : "",
+            string_array_ref(mode_list,m));
+    if(!best.ok) {
+      fprintf(fp,"\"ok\": false}");
+      continue;
+    }
+    fprintf(fp,"\"ok\": true, \"num_detections\": %i, "
+            "\"num_tracklets\": %i,\n", best.num_obs, best.num_tracklets);
+    fprintf(fp,"     \"endpoints\": %li, \"hypotheses\": %li, "
+            "\"pruned\": %li, \"truncated\": %li,\n", best.endpoints,
+            best.hypotheses, best.pruned, best.truncated);
+    fprintf(fp,"     \"seconds\": %.6f, \"detections_per_sec\": %.1f, "
+            "\"peak_rss_kb\": %li,\n", best_total,
+            (best_total > 0.0) ? (double)best.num_obs / best_total : 0.0,
+            best_rss);
+    fprintf(fp,"     \"phases\": {\"load\": %.6f, \"tree_build\": %.6f, "
+            "\"queries\": %.6f, \"subset_removal\": %.6f, "
+            "\"output\": %.6f}}", best.load, best.tree_build, best.queries,
+            best.subset_removal, best.output);
+  }
+  fprintf(fp,"\n  ]\n}\n");
+
+  free_string_array(mode_list);
+  if(fp != stdout) { fclose(fp); }
+  if(remove_input) { unlink(fname); }
+}
+
+
+/* --------------------------------------------------------------------- */
+/* --- Sweep mode ------------------------------------------------------ */
+/* --------------------------------------------------------------------- */
+
+/* The values of a comma separated argument (such as "sweep_thresh */
+/* 0.0003,0.0005"), or just deflt if the argument is not given.     */
+dyv* mk_sweep_values(char* name, int argc, char** argv, double deflt) {
+  char* list = string_from_args(name,argc,argv,NULL);
+  string_array* vals;
+  dyv* res;
+  int i;
+
+  if(list == NULL) {
+    res = mk_constant_dyv(1, deflt);
+  } else {
+    vals = mk_broken_string_using_seppers(list, ",");
+    res  = mk_zero_dyv(string_array_size(vals));
+    for(i=0;i<string_array_size(vals);i++) {
+      dyv_set(res, i, atof(string_array_ref(vals,i)));
+    }
+    free_string_array(vals);
+  }
+
+  return res;
+}
+
+
+/* Load the detections once and find the tracklets for every point of */
+/* the grid sweep_thresh x sweep_maxv x sweep_maxt x sweep_maxLerr,    */
+/* writing one line of ROC and exact match scores per point.           */
+void sweep_main(int argc,char *argv[]) {
+  char*  fname     = string_from_args("file",argc,argv,NULL);
+  char*  sweepfile = string_from_args("sweepfile",argc,argv,NULL);
+  dyv* thresh_vals;
+  dyv* maxv_vals;
+  dyv* maxt_vals;
+  dyv* maxLerr_vals;
+  int  K;
+  mht_setting* settings;
+  tracklet_opts opts;
+  track_array** results;
+  track_array* trcks;
+  track_array* cheat;
+  ivec_array* obs_to_track;
+  simple_obs_array* obs;
+  ivec* true_groups = NULL;
+  ivec* cheat_pairs;
+  ivec* roc;
+  ivec* inds;
+  dyv* length = NULL;
+  dyv* angle = NULL;
+  dyv* exp_time = NULL;
+  mht_timing timing;
+  FILE* fp = stdout;
+  double t_start, t_search;
+  double cheat_maxt = 0.0;
+  double percent_correct, percent_found;
+  int matches_found;
+  int a, b, c, d, i, j, k;
+
+  /* The lists default to the usual parameters (in degrees). */
+  tracklet_opts_from_args(&opts, argc, argv);
+  thresh_vals  = mk_sweep_values("sweep_thresh",argc,argv,opts.thresh);
+  maxv_vals    = mk_sweep_values("sweep_maxv",argc,argv,opts.maxv);
+  maxt_vals    = mk_sweep_values("sweep_maxt",argc,argv,opts.maxt);
+  maxLerr_vals = mk_sweep_values("sweep_maxLerr",argc,argv,opts.maxLerr);
+  K = dyv_size(thresh_vals) * dyv_size(maxv_vals) *
+      dyv_size(maxt_vals) * dyv_size(maxLerr_vals);
+  settings = AM_MALLOC_ARRAY(mht_setting, K);
+
+  /* The grid, in the units used by the searches (as tracklet_main). */
+  tracklet_opts_to_search_units(&opts);
+  k = 0;
+  for(a=0;a<dyv_size(thresh_vals);a++) {
+    for(b=0;b<dyv_size(maxv_vals);b++) {
+      for(c=0;c<dyv_size(maxt_vals);c++) {
+        for(d=0;d<dyv_size(maxLerr_vals);d++) {
+          settings[k].minv    = opts.minv;
+          settings[k].maxv    = dyv_ref(maxv_vals,b) * DEG_TO_RAD;
+          settings[k].thresh  = dyv_ref(thresh_vals,a) * DEG_TO_RAD;
+          settings[k].maxt    = dyv_ref(maxt_vals,c);
+          settings[k].athresh = opts.athresh;
+          settings[k].maxLerr = dyv_ref(maxLerr_vals,d) * DEG_TO_RAD;
+          k++;
+        }
+      }
+    }
+  }
+
+  if(fname == NULL) {
+    printf("ERROR: No filename given.\n");
+  } else {
+    obs_load_set_threads(opts.threads);
+    obs = mk_simple_obs_array_from_file_elong(fname, opts.maxt, &true_groups,
+                                              NULL, &length, &angle,
+                                              &exp_time);
+
+    if((obs != NULL) && (sweepfile != NULL)) {
+      fp = fopen(sweepfile,"w");
+      if(fp == NULL) {
+        printf("ERROR: Unable to open %s for writing.\n", sweepfile);
+      }
+    }
+
+    if((obs != NULL) && (simple_obs_array_size(obs) == 0)) {
+      printf("ERROR: No detections in %s.\n", fname);
+    } else if((obs != NULL) && (fp != NULL)) {
+      printf(">> Sweeping %i settings over %i detections.\n", K,
+             simple_obs_array_size(obs));
+      mht_timing_init(&timing);
+      t_start = mht_wall_seconds();
+      results = mk_tracklets_MHT_sweep(obs, settings, K, opts.minobs,
+                                       opts.removedups, angle, length,
+                                       exp_time, opts.etime, opts.maxobs,
+                                       opts.greedy, opts.use_pht,
+                                       opts.elong_query, opts.beam,
+                                       opts.budget, opts.threads,
+                                       tracklet_opts_plate_width(&opts),
+                                       &timing);
+      t_search = mht_wall_seconds() - t_start;
+      printf(">> Searched all settings in %f seconds (tree build %f).\n",
+             t_search, timing.build);
+
+      fprintf(fp,"# thresh maxv maxt maxLerr num_tracklets num_true "
+              "per_correct per_found exact_number exact_found "
+              "exact_correct\n");
+      cheat_pairs = NULL;
+      for(k=0;k<K;k++) {
+        trcks = results[k];
+
+        /* Score against the true tracklets for this setting's maxt */
+        /* (only recomputed when maxt changes).                     */
+        if((cheat_pairs == NULL) || (settings[k].maxt != cheat_maxt)) {
+          if(cheat_pairs != NULL) { free_ivec(cheat_pairs); }
+          cheat_maxt   = settings[k].maxt;
+          obs_to_track = mk_simple_obs_pairing_from_true_groups(obs,
+                                                                true_groups,
+                                                                cheat_maxt);
+          cheat = mk_track_array_from_matched_simple_obs(obs, obs_to_track,
+                                                         opts.minobs);
+          free_ivec_array(obs_to_track);
+          cheat_pairs = mk_constant_ivec(simple_obs_array_size(obs), -1);
+          for(i = 0; i < track_array_size(cheat); i++) {
+            inds = track_individs(track_array_ref(cheat, i));
+            for(j = 0; j < ivec_size(inds); j++) {
+              ivec_set(cheat_pairs, ivec_ref(inds, j), i);
+            }
+          }
+          free_track_array(cheat);
+        }
+
+        roc = mk_track_array_roc_vec(obs, trcks, cheat_pairs, opts.minobs,
+                                     1, 0.95);
+        percent_correct = 0.0;
+        percent_found   = 0.0;
+        matches_found = compute_exact_matches(trcks, cheat_pairs,
+                                              &percent_correct,
+                                              &percent_found);
+
+        fprintf(fp,"%.8f %.8f %.8f %.8f %i %i %f %f %i %f %f\n",
+                settings[k].thresh / DEG_TO_RAD,
+                settings[k].maxv / DEG_TO_RAD, settings[k].maxt,
+                settings[k].maxLerr / DEG_TO_RAD, track_array_size(trcks),
+                ivec_max(cheat_pairs)+1, roc_percent_correct(roc),
+                roc_percent_found(roc, cheat_pairs), matches_found,
+                percent_found, percent_correct);
+
+        free_ivec(roc);
+        free_track_array(trcks);
+      }
+      if(cheat_pairs != NULL) { free_ivec(cheat_pairs); }
+      AM_FREE_ARRAY(results, track_array*, K);
+    }
+
+    if((fp != NULL) && (fp != stdout)) { fclose(fp); }
+    if(obs != NULL) { free_simple_obs_array(obs); }
+    if(true_groups != NULL) { free_ivec(true_groups); }
+    if(length != NULL) { free_dyv(length); }
+    if(angle != NULL) { free_dyv(angle); }
+    if(exp_time != NULL) { free_dyv(exp_time); }
+  }
+
+  AM_FREE_ARRAY(settings, mht_setting, K);
+  free_dyv(thresh_vals);
+  free_dyv(maxv_vals);
+  free_dyv(maxt_vals);
+  free_dyv(maxLerr_vals);
+}
+
+
+/* --------------------------------------------------------------------- */
+/* --- Stream mode ----------------------------------------------------- */
+/* --------------------------------------------------------------------- */
+
+/* Write the API's current results, one tracklet per line: the file */
+/* indices (order maps the API's detection numbers to them) of its  */
+/* detections in increasing order.                                  */
+void stream_write_results(FILE* fp, FindTrackletsStateHandle fph,
+                          ivec* order) {
+  ivec* inds;
+  int N, i, j;
+
+  for(i=0;i<FindTracklets_Num_Tracklets(fph);i++) {
+    N    = FindTracklets_Num_Detections(fph,i);
+    inds = mk_ivec(N);
+    for(j=0;j<N;j++) {
+      ivec_set(inds,j,ivec_ref(order,FindTracklets_Get_Match(fph,i,j)));
+    }
+    ivec_sort(inds,inds);
+
+    for(j=0;j<N;j++) {
+      fprintf(fp,(j > 0) ? " %i" : "%i",ivec_ref(inds,j));
+    }
+    fprintf(fp,"\n");
+    free_ivec(inds);
+  }
+}
+
+
+/* Feed the detections of a file, in time order, to the FindTracklets */
+/* API (with its default parameters).  Each run of detections with    */
+/* the same time is one exposure.  The tracklets are found an         */
+/* exposure at a time with FindTracklets_AddExposure and              */
+/* FindTracklets_Flush or, with batch true, all at once with          */
+/* FindTracklets_Run.                                                  */
+void stream_main(int argc,char *argv[]) {
+  char* fname      = string_from_args("file",argc,argv,NULL);
+  char* streamfile = string_from_args("streamfile",argc,argv,NULL);
+  bool batch       = bool_from_args("batch",argc,argv,FALSE);
+  int threads      = int_from_args("threads",argc,argv,FT_DEF_THREADS);
+  FindTrackletsStateHandle fph;
+  simple_obs_array* obs;
+  simple_obs* X;
+  dyv* times;
+  ivec* order;
+  FILE* fp = stdout;
+  double last_t = 0.0;
+  int i;
+
+  if(fname == NULL) {
+    printf("ERROR: stream mode needs a detection file (file).\n");
+    return;
+  }
+  obs = mk_simple_obs_array_from_file_elong(fname, 0.0, NULL, NULL, NULL,
+                                            NULL, NULL);
+  if(obs == NULL) { return; }
+
+  if(streamfile != NULL) {
+    fp = fopen(streamfile,"w");
+    if(fp == NULL) {
+      printf("ERROR: Unable to open %s for writing.\n", streamfile);
+      free_simple_obs_array(obs);
+      return;
+    }
+  }
+
+  times = mk_dyv(simple_obs_array_size(obs));
+  for(i=0;i<simple_obs_array_size(obs);i++) {
+    dyv_set(times,i,simple_obs_time(simple_obs_array_ref(obs,i)));
+  }
+  order = mk_indices_of_sorted_dyv(times);
+
+  FindTracklets_Init(&fph,0,NULL);
+  FindTracklets_set_threads(&fph,threads);
+  for(i=0;i<ivec_size(order);i++) {
+    X = simple_obs_array_ref(obs,ivec_ref(order,i));
+    if((!batch)&&(i > 0)&&(simple_obs_time(X) != last_t)) {
+      FindTracklets_AddExposure(fph);
+      stream_write_results(fp,fph,order);
+    }
+    FindTracklets_AddDataDetection(fph,simple_obs_RA(X),simple_obs_DEC(X),
+                                   simple_obs_time(X),
+                                   simple_obs_brightness(X));
+    last_t = simple_obs_time(X);
+  }
+
+  if(batch) {
+    FindTracklets_Run(fph);
+  } else {
+    FindTracklets_Flush(fph);
+  }
+  stream_write_results(fp,fph,order);
+  FindTracklets_Free(fph);
+
+  if(fp != stdout) {
+    fclose(fp);
+  }
+  free_ivec(order);
+  free_dyv(times);
+  free_simple_obs_array(obs);
+}
+
 
 int main(int argc,char *argv[]) {
 
   memory_leak_check_args(argc,argv);
   Verbosity = 0.0;
 
+  if((argc > 1) && eq_string(argv[1],"bench")) {
+    bench_main(argc,argv);
+    am_malloc_report_polite();
+    return 0;
+  }
+  if((argc > 1) && eq_string(argv[1],"sweep")) {
+    sweep_main(argc,argv);
+    am_malloc_report_polite();
+    return 0;
+  }
+  if((argc > 1) && eq_string(argv[1],"stream")) {
+    stream_main(argc,argv);
+    am_malloc_report_polite();
+    return 0;
+  }
+
   tracklet_main(argc,argv);
  
   am_malloc_report_polite();
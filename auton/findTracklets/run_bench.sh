@@ -0,0 +1,23 @@
+# Benchmark findTracklets on synthetic skies of increasing density.
+# Each run writes a JSON report (bench_<density>.json) with the time per
+# phase, detections/sec and peak RSS of every search mode.  Extra
+# arguments are passed on (e.g. "sh run_bench.sh threads 4").
+for density in 250 1000 4000; do
+  echo "Running density $density:";
+  ./findtracklets bench density $density false_frac 0.5 num_exp 4 cadence 15 \
+     seed 1 jsonfile bench_$density.json "$@" > /dev/null;
+  grep -E '"mode"|"seconds"' bench_$density.json;
+done
+
+# Trailed fast movers (up to 5 deg/day, found through their trails):
+# the same field with the trail angles used in the tree query and
+# without.  The "hypotheses" of the two runs show how much of the
+# search the wedge prunes (maxt 0.1 so that it applies; the tracklets
+# are the same).
+for q in true false; do
+  echo "Running fast movers (elong_query $q):";
+  ./findtracklets bench density 250 false_frac 0.5 num_exp 4 cadence 15 \
+     minv 0 maxv 0.5 sky_maxv 5 exp_time 60 athresh 10 maxt 0.1 maxobs 4 \
+     elong_query $q seed 1 modes mht jsonfile bench_fast_$q.json "$@" > /dev/null;
+  grep -E '"mode"|"seconds"|"hypotheses"' bench_fast_$q.json;
+done
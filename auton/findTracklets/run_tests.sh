@@ -5,4 +5,43 @@ echo "Running elongation test:";
 ./findtracklets file testcase.dets use_pht true greedy true eval true | grep "Exact Match:" | \
    awk '{if ($9 == "1.000000," && $13 == "1.000000") { print "PASS" } else { print "FAIL" } }';
 
-  
\ No newline at end of file
+echo "Running threaded test:";
+d=`mktemp -d`;
+./findtracklets file testcase.dets threads 1 pairfile $d/serial.obs summaryfile $d/serial.sum > /dev/null;
+./findtracklets file testcase.dets threads 4 pairfile $d/thread.obs summaryfile $d/thread.sum > $d/thread.log;
+if grep -q "runs serially" $d/thread.log; then
+  echo "SKIP (not built with thread=1)";
+elif cmp -s $d/serial.obs $d/thread.obs; then echo "PASS"; else echo "FAIL"; fi;
+rm -rf $d;
+echo "Running per-plate tree test:";
+d=`mktemp -d`;
+./findtracklets file testcase.dets pairfile $d/tree.obs summaryfile $d/tree.sum > /dev/null;
+./findtracklets file testcase.dets use_plates true pairfile $d/plates.obs summaryfile $d/plates.sum > /dev/null;
+sort $d/tree.obs > $d/tree.srt; sort $d/plates.obs > $d/plates.srt;
+if cmp -s $d/tree.srt $d/plates.srt; then echo "PASS"; else echo "FAIL"; fi;
+rm -rf $d;
+echo "Running elongation query test:";
+d=`mktemp -d`;
+./findtracklets bench density 250 minv 0.05 maxv 0.5 sky_maxv 5 exp_time 60 \
+   trail_noise 0.3 noise 0.3 seed 2 modes mht genfile $d/trail.dets > /dev/null;
+for q in true false; do
+  ./findtracklets file $d/trail.dets maxv 0.5 athresh 5 thresh 0.003 maxt 0.1 \
+     maxobs 4 elong_query $q pairfile $d/$q.obs summaryfile $d/$q.sum > /dev/null;
+  sort $d/$q.obs > $d/$q.srt;
+done;
+if cmp -s $d/true.srt $d/false.srt; then echo "PASS"; else echo "FAIL"; fi;
+rm -rf $d;
+echo "Running collapse test:";
+d=`mktemp -d`;
+./findtracklets bench density 5 num_exp 6 seed 2 modes mht genfile $d/deep.dets > /dev/null;
+./findtracklets file $d/deep.dets maxobs 2 collapse true purify_minobs 6 eval true | \
+   grep "Exact Match:" | \
+   awk '{if ($9 >= 0.95 && $13 == "1.000000") { print "PASS" } else { print "FAIL" } }';
+rm -rf $d;
+echo "Running streaming API test:";
+d=`mktemp -d`;
+./findtracklets stream file testcase.dets batch true streamfile $d/batch.txt > /dev/null;
+./findtracklets stream file testcase.dets streamfile $d/stream.txt > /dev/null;
+sort $d/batch.txt > $d/batch.srt; sort $d/stream.txt > $d/stream.srt;
+if [ -s $d/batch.srt ] && cmp -s $d/batch.srt $d/stream.srt; then echo "PASS"; else echo "FAIL"; fi;
+rm -rf $d;
@@ -0,0 +1,245 @@
+/*
+   File:        sky_tiles.c
+   Author(s):   PS1 MOPS
+   Created:     Fri Oct 16, 2026
+   Description: Split a field of detections into sky tiles that can be
+                searched independently.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "sky_tiles.h"
+
+/* Extra margin (radians) to absorb rounding in the distance tests. */
+#define SKY_TILES_SLACK 1e-8
+
+
+/* Wrap an RA difference (degrees) into [-180, 180). */
+double sky_tiles_wrap(double dRA) {
+  while(dRA >= 180.0) { dRA -= 360.0; }
+  while(dRA < -180.0) { dRA += 360.0; }
+  return dRA;
+}
+
+
+/* The first position in the (DEC sorted) order with DEC >= d. */
+int sky_tiles_first_dec(dyv* DEC, ivec* order, double d) {
+  int lo = 0;
+  int hi = ivec_size(order);
+  int mid;
+
+  while(lo < hi) {
+    mid = (lo + hi) / 2;
+    if(dyv_ref(DEC,ivec_ref(order,mid)) < d) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+
+  return lo;
+}
+
+
+sky_tiles* mk_sky_tiles(simple_obs_array* obs, dyv* reach, double width) {
+  sky_tiles* T = AM_MALLOC(sky_tiles);
+  int N = simple_obs_array_size(obs);
+  dyv* off;              /* RA offset from the field center (degrees) */
+  dyv* DEC;
+  ivec* order;
+  ivec* band_start;
+  ivec* band_cells;
+  ivec* inds;
+  ivec* mem;
+  ivec* sorted;
+  ivec_array* core;
+  dyv* band_lo;
+  double sx = 0.0;
+  double sy = 0.0;
+  double RA0, ra, d;
+  double omin, omax, dmin, dmax, h, w, c;
+  double dlo, dhi, olo, ohi, ocen, ohalf;
+  double m, md, mr, s, cmin;
+  int num_bands, num_cells;
+  int b, k, i, j, p, q;
+
+  /* Center the RA offsets on the (circular) mean RA so that a field */
+  /* across RA = 0 is not split in two.                              */
+  for(i=0;i<N;i++) {
+    ra  = simple_obs_RA(simple_obs_array_ref(obs,i)) * 15.0 * DEG_TO_RAD;
+    sx += cos(ra);
+    sy += sin(ra);
+  }
+  RA0 = ((fabs(sx) + fabs(sy)) > 1e-10) ? atan2(sy,sx) * RAD_TO_DEG : 0.0;
+
+  off  = mk_dyv(N);
+  DEC  = mk_dyv(N);
+  omin = 0.0;
+  omax = 0.0;
+  dmin = 0.0;
+  dmax = 0.0;
+  for(i=0;i<N;i++) {
+    dyv_set(off,i,sky_tiles_wrap(simple_obs_RA(simple_obs_array_ref(obs,i))
+                                 * 15.0 - RA0));
+    dyv_set(DEC,i,simple_obs_DEC(simple_obs_array_ref(obs,i)));
+    if((i == 0) || (dyv_ref(off,i) < omin)) { omin = dyv_ref(off,i); }
+    if((i == 0) || (dyv_ref(off,i) > omax)) { omax = dyv_ref(off,i); }
+    if((i == 0) || (dyv_ref(DEC,i) < dmin)) { dmin = dyv_ref(DEC,i); }
+    if((i == 0) || (dyv_ref(DEC,i) > dmax)) { dmax = dyv_ref(DEC,i); }
+  }
+  if(width <= 0.0) { width = 360.0; }
+
+  /* Cut the field into DEC bands and each band into RA cells that */
+  /* are no wider than width on the sky.                           */
+  num_bands = (int)ceil((dmax - dmin) / width);
+  if(num_bands < 1) { num_bands = 1; }
+  h = (dmax - dmin) / (double)num_bands;
+
+  band_lo    = mk_dyv(num_bands);
+  band_start = mk_ivec(num_bands);
+  band_cells = mk_ivec(num_bands);
+  num_cells  = 0;
+  for(b=0;b<num_bands;b++) {
+    dlo = dmin + (double)b * h;
+    dhi = dlo + h;
+    c   = ((dlo <= 0.0) && (dhi >= 0.0)) ? 1.0 :
+          cos(fmin(fabs(dlo),fabs(dhi)) * DEG_TO_RAD);
+    k   = (int)ceil((omax - omin) * c / width);
+    if(k < 1) { k = 1; }
+
+    dyv_set(band_lo,b,dlo);
+    ivec_set(band_start,b,num_cells);
+    ivec_set(band_cells,b,k);
+    num_cells += k;
+  }
+
+  /* Give every detection (seed) to the cell it falls in. */
+  core = mk_array_of_zero_length_ivecs(num_cells);
+  for(i=0;i<N;i++) {
+    b = (h > 0.0) ? (int)((dyv_ref(DEC,i) - dmin) / h) : 0;
+    b = int_min(int_max(b,0),num_bands-1);
+
+    k = ivec_ref(band_cells,b);
+    w = (omax - omin) / (double)k;
+    p = (w > 0.0) ? (int)((dyv_ref(off,i) - omin) / w) : 0;
+    p = int_min(int_max(p,0),k-1);
+
+    add_to_ivec_array_ref(core,ivec_ref(band_start,b) + p,i);
+  }
+
+  /* Build the member list of every tile that owns a seed, using */
+  /* the DEC ordering to only look at the tile's DEC range.      */
+  order = mk_indices_of_sorted_dyv(DEC);
+
+  T->num_tiles = 0;
+  T->core      = mk_array_of_zero_length_ivecs(0);
+  T->members   = mk_array_of_zero_length_ivecs(0);
+  for(b=0;b<num_bands;b++) {
+    k = ivec_ref(band_cells,b);
+    w = (omax - omin) / (double)k;
+
+    for(p=0;p<k;p++) {
+      inds = ivec_array_ref(core,ivec_ref(band_start,b) + p);
+      if(ivec_size(inds) == 0) { continue; }
+
+      /* The tile's margin is the reach of its furthest reaching seed. */
+      m = 0.0;
+      for(i=0;i<ivec_size(inds);i++) {
+        m = fmax(m, dyv_ref(reach,ivec_ref(inds,i)));
+      }
+      m += SKY_TILES_SLACK;
+      md = m * RAD_TO_DEG;
+
+      /* Two points within m of each other differ by at most m in DEC */
+      /* and by at most 2 asin(sin(m/2) / cos(DEC)) in RA, using the   */
+      /* smallest cos(DEC) of the widened band.                        */
+      dlo  = dyv_ref(band_lo,b) - md;
+      dhi  = dyv_ref(band_lo,b) + h + md;
+      mr   = 360.0;
+      if((dlo > -90.0) && (dhi < 90.0)) {
+        cmin = cos(fmax(fabs(dlo),fabs(dhi)) * DEG_TO_RAD);
+        s    = sin(m / 2.0) / cmin;
+        if(s < 1.0) { mr = 2.0 * asin(s) * RAD_TO_DEG; }
+      }
+
+      olo   = omin + (double)p * w;
+      ohi   = olo + w;
+      ocen  = (olo + ohi) / 2.0;
+      ohalf = (ohi - olo) / 2.0 + mr;
+
+      mem = mk_ivec(0);
+      q   = sky_tiles_first_dec(DEC,order,dlo);
+      for(;(q < N) && (dyv_ref(DEC,ivec_ref(order,q)) <= dhi);q++) {
+        j = ivec_ref(order,q);
+        d = sky_tiles_wrap(dyv_ref(off,j) - ocen);
+        if((mr >= 360.0) || (fabs(d) <= ohalf)) {
+          add_to_ivec(mem,j);
+        }
+      }
+      sorted = mk_ivec_sort(mem);
+
+      add_to_ivec_array(T->core,inds);
+      add_to_ivec_array(T->members,sorted);
+      T->num_tiles += 1;
+      free_ivec(sorted);
+      free_ivec(mem);
+    }
+  }
+
+  free_ivec(order);
+  free_ivec_array(core);
+  free_ivec(band_start);
+  free_ivec(band_cells);
+  free_dyv(band_lo);
+  free_dyv(off);
+  free_dyv(DEC);
+
+  return T;
+}
+
+
+void free_sky_tiles(sky_tiles* T) {
+  free_ivec_array(T->core);
+  free_ivec_array(T->members);
+  AM_FREE(T,sky_tiles);
+}
+
+
+int safe_sky_tiles_num_tiles(sky_tiles* T) {
+  return T->num_tiles;
+}
+
+
+ivec* safe_sky_tiles_core(sky_tiles* T, int k) {
+  my_assert((k >= 0) && (k < T->num_tiles));
+  return ivec_array_ref(T->core,k);
+}
+
+
+ivec* safe_sky_tiles_members(sky_tiles* T, int k) {
+  my_assert((k >= 0) && (k < T->num_tiles));
+  return ivec_array_ref(T->members,k);
+}
+
+
+int sky_tiles_total_members(sky_tiles* T) {
+  int total = 0;
+  int k;
+
+  for(k=0;k<sky_tiles_num_tiles(T);k++) {
+    total += ivec_size(sky_tiles_members(T,k));
+  }
+
+  return total;
+}
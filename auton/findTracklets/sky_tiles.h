@@ -0,0 +1,68 @@
+/*
+   File:        sky_tiles.h
+   Author(s):   PS1 MOPS
+   Created:     Fri Oct 16, 2026
+   Description: Split a field of detections into sky tiles that can be
+                searched independently.  Every detection is the seed of
+                exactly one tile (its core).  A tile's members are its
+                core plus every detection that a search from one of the
+                core seeds could reach, so searching the members finds
+                the same tracklets for those seeds as searching the
+                whole field.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SKY_TILES_H
+#define SKY_TILES_H
+
+#include "obs.h"
+
+typedef struct sky_tiles {
+  int num_tiles;
+  ivec_array* core;      /* The seeds owned by each tile (sorted).       */
+  ivec_array* members;   /* The detections each tile searches (sorted).  */
+} sky_tiles;
+
+/* Tile the detections with tiles of (at most) width degrees on a   */
+/* side.  reach[i] is the largest angular distance (in radians) that */
+/* a search seeded at detection i can reach and sets the overlap     */
+/* margin of i's tile.  Tiles with no seeds are dropped.             */
+sky_tiles* mk_sky_tiles(simple_obs_array* obs, dyv* reach, double width);
+
+void free_sky_tiles(sky_tiles* T);
+
+int safe_sky_tiles_num_tiles(sky_tiles* T);
+ivec* safe_sky_tiles_core(sky_tiles* T, int k);
+ivec* safe_sky_tiles_members(sky_tiles* T, int k);
+
+#ifdef AMFAST
+
+#define sky_tiles_num_tiles(T)   ((T)->num_tiles)
+#define sky_tiles_core(T,k)      (ivec_array_ref((T)->core,k))
+#define sky_tiles_members(T,k)   (ivec_array_ref((T)->members,k))
+
+#else
+
+#define sky_tiles_num_tiles(T)   (safe_sky_tiles_num_tiles(T))
+#define sky_tiles_core(T,k)      (safe_sky_tiles_core(T,k))
+#define sky_tiles_members(T,k)   (safe_sky_tiles_members(T,k))
+
+#endif
+
+/* The total number of members over all tiles (the detections in the */
+/* overlaps are counted once for each tile).                         */
+int sky_tiles_total_members(sky_tiles* T);
+
+#endif
@@ -0,0 +1,296 @@
+/*
+   File:        tracklet_collapse.c
+   Author(s):   PS1 MOPS
+   Created:     Fri Oct 16, 2026
+   Description: Collapse and purify stages for the tracklets found in a
+                deep stack.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "tracklet_collapse.h"
+#include "gcf.h"
+
+/* Detections closer than this in time (days) are in the same exposure. */
+#define COLLAPSE_SAME_TIME 1e-5
+
+
+/* Wrap an angle difference (degrees) into [-180, 180). */
+double collapse_wrap(double d) {
+  while(d >= 180.0) { d -= 360.0; }
+  while(d < -180.0) { d += 360.0; }
+  return d;
+}
+
+
+/* The first position in the (DEC sorted) order with DEC >= d. */
+int collapse_first_dec(dyv* DEC, ivec* order, double d) {
+  int lo = 0;
+  int hi = ivec_size(order);
+  int mid;
+
+  while(lo < hi) {
+    mid = (lo + hi) / 2;
+    if(dyv_ref(DEC,ivec_ref(order,mid)) < d) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+
+  return lo;
+}
+
+
+/* The rms of each of the num subsets of detections, where subset k is */
+/* inds without its k-th entry (if drop) or just inds (num = 1).       */
+void collapse_gc_rms_batch(simple_obs_array* obs, ivec* inds, bool drop,
+                           double* rms) {
+  int N = ivec_size(inds);
+  int num = drop ? N : 1;
+  int n = drop ? N-1 : N;
+  double* mjd = AM_MALLOC_ARRAY(double, int_max(n,1) * num);
+  double* ra  = AM_MALLOC_ARRAY(double, int_max(n,1) * num);
+  double* dec = AM_MALLOC_ARRAY(double, int_max(n,1) * num);
+  int* nobs   = AM_MALLOC_ARRAY(int, num);
+  dyv* times  = mk_dyv(N);
+  ivec* order;
+  simple_obs* X;
+  int i, j, k;
+
+  /* The fit wants the detections in time order. */
+  for(i=0;i<N;i++) {
+    dyv_set(times,i,simple_obs_time(simple_obs_array_ref(obs,
+                                                         ivec_ref(inds,i))));
+  }
+  order = mk_indices_of_sorted_dyv(times);
+
+  for(k=0;k<num;k++) {
+    nobs[k] = n;
+    for(i=0,j=0;i<N;i++) {
+      if(drop && (ivec_ref(order,i) == k)) { continue; }
+      X = simple_obs_array_ref(obs, ivec_ref(inds,ivec_ref(order,i)));
+      mjd[j*num+k] = simple_obs_time(X);
+      ra[j*num+k]  = simple_obs_RA_rad(X);
+      dec[j*num+k] = simple_obs_DEC_rad(X);
+      j++;
+    }
+  }
+  gcRmsBatch(num, num, nobs, mjd, ra, dec, rms);
+
+  AM_FREE_ARRAY(mjd, double, int_max(n,1) * num);
+  AM_FREE_ARRAY(ra, double, int_max(n,1) * num);
+  AM_FREE_ARRAY(dec, double, int_max(n,1) * num);
+  AM_FREE_ARRAY(nobs, int, num);
+  free_dyv(times);
+  free_ivec(order);
+}
+
+
+double tracklet_inds_gc_rms(simple_obs_array* obs, ivec* inds) {
+  double rms;
+
+  if(ivec_size(inds) < 3) { return 0.0; }
+  collapse_gc_rms_batch(obs, inds, FALSE, &rms);
+
+  return rms;
+}
+
+
+/* --- Collapse -------------------------------------------------------- */
+
+track_array* mk_tracklets_collapse(simple_obs_array* obs,
+                                   track_array* tracklets,
+                                   double ra_tol, double dec_tol,
+                                   double ang_tol, double vel_tol,
+                                   double max_rms) {
+  int N = track_array_size(tracklets);
+  track_array* res = mk_empty_track_array(int_max(N,1));
+  dyv* RA  = mk_dyv(N);
+  dyv* DEC = mk_dyv(N);
+  dyv* ANG = mk_dyv(N);
+  dyv* VEL = mk_dyv(N);
+  ivec* used = mk_zero_ivec(N);
+  ivec* owner = mk_constant_ivec(simple_obs_array_size(obs), -1);
+  ivec* order;
+  ivec* cands;
+  ivec* sorted;
+  ivec* merged;
+  ivec* trial;
+  ivec* inds;
+  track* T;
+  double t_lo = 0.0, t_hi = 0.0, t_ref;
+  double r, d, vr, vd, t;
+  bool ok;
+  int i, j, k, c, p, q;
+
+  /* Each tracklet's position, direction and speed (degrees and days) */
+  /* at the middle of the time span.                                  */
+  for(i=0;i<N;i++) {
+    T = track_array_ref(tracklets,i);
+    if((i == 0) || (track_first_time(T,obs) < t_lo)) {
+      t_lo = track_first_time(T,obs);
+    }
+    if((i == 0) || (track_last_time(T,obs) > t_hi)) {
+      t_hi = track_last_time(T,obs);
+    }
+  }
+  t_ref = 0.5 * (t_lo + t_hi);
+
+  for(i=0;i<N;i++) {
+    T = track_array_ref(tracklets,i);
+    track_RA_DEC_prediction(T, t_ref - track_time(T), &r, &d);
+    vr = 15.0 * track_vRA(T) * cos(d * DEG_TO_RAD);
+    vd = track_vDEC(T);
+    dyv_set(RA, i, 15.0 * r);
+    dyv_set(DEC, i, d);
+    dyv_set(ANG, i, atan2(vd, vr) / DEG_TO_RAD);
+    dyv_set(VEL, i, sqrt(vr*vr + vd*vd));
+  }
+  order = mk_indices_of_sorted_dyv(DEC);
+
+  for(i=0;i<N;i++) {
+    if(ivec_ref(used,i)) { continue; }
+    ivec_set(used,i,1);
+
+    /* Find the candidates (in tracklet order). */
+    cands = mk_ivec(0);
+    p = collapse_first_dec(DEC, order, dyv_ref(DEC,i) - dec_tol);
+    for(;p<N;p++) {
+      c = ivec_ref(order,p);
+      if(dyv_ref(DEC,c) > dyv_ref(DEC,i) + dec_tol) { break; }
+      if(ivec_ref(used,c)) { continue; }
+      if((fabs(collapse_wrap(dyv_ref(RA,c) - dyv_ref(RA,i))) <= ra_tol) &&
+         (fabs(collapse_wrap(dyv_ref(ANG,c) - dyv_ref(ANG,i))) <= ang_tol) &&
+         (fabs(dyv_ref(VEL,c) - dyv_ref(VEL,i)) <= vel_tol)) {
+        add_to_ivec(cands,c);
+      }
+    }
+    sorted = mk_ivec_sort(cands);
+    free_ivec(cands);
+
+    /* Greedily absorb them.  owner marks the detections already in. */
+    merged = mk_copy_ivec(track_individs(track_array_ref(tracklets,i)));
+    for(k=0;k<ivec_size(merged);k++) {
+      ivec_set(owner,ivec_ref(merged,k),i);
+    }
+
+    for(j=0;j<ivec_size(sorted);j++) {
+      c     = ivec_ref(sorted,j);
+      inds  = track_individs(track_array_ref(tracklets,c));
+      trial = mk_copy_ivec(merged);
+      ok    = TRUE;
+
+      for(k=0;(k<ivec_size(inds))&&ok;k++) {
+        if(ivec_ref(owner,ivec_ref(inds,k)) == i) { continue; }
+
+        /* At most one detection per exposure. */
+        t = simple_obs_time(simple_obs_array_ref(obs,ivec_ref(inds,k)));
+        for(q=0;(q<ivec_size(trial))&&ok;q++) {
+          ok = (fabs(t - simple_obs_time(simple_obs_array_ref(obs,
+                                            ivec_ref(trial,q)))) >
+                COLLAPSE_SAME_TIME);
+        }
+        add_to_ivec(trial,ivec_ref(inds,k));
+      }
+
+      if(ok && (ivec_size(trial) > ivec_size(merged))) {
+        ok = (tracklet_inds_gc_rms(obs,trial) <= max_rms);
+      }
+      if(ok) {
+        for(k=0;k<ivec_size(trial);k++) {
+          ivec_set(owner,ivec_ref(trial,k),i);
+        }
+        free_ivec(merged);
+        merged = trial;
+        ivec_set(used,c,1);
+      } else {
+        free_ivec(trial);
+      }
+    }
+
+    T = mk_track_from_N_inds(obs, merged);
+    track_array_add(res,T);
+    free_track(T);
+
+    /* Release the detections for the later tracklets. */
+    for(k=0;k<ivec_size(merged);k++) {
+      ivec_set(owner,ivec_ref(merged,k),-1);
+    }
+    free_ivec(merged);
+    free_ivec(sorted);
+  }
+
+  free_dyv(RA);
+  free_dyv(DEC);
+  free_dyv(ANG);
+  free_dyv(VEL);
+  free_ivec(used);
+  free_ivec(owner);
+  free_ivec(order);
+
+  return res;
+}
+
+
+/* --- Purify ---------------------------------------------------------- */
+
+track_array* mk_tracklets_purify(simple_obs_array* obs,
+                                 track_array* tracklets,
+                                 double max_rms, int min_obs) {
+  int N = track_array_size(tracklets);
+  track_array* res = mk_empty_track_array(int_max(N,1));
+  double* rms;
+  double best;
+  ivec* inds;
+  track* T;
+  int i, k, worst, n;
+
+  for(i=0;i<N;i++) {
+    inds = mk_copy_ivec(track_individs(track_array_ref(tracklets,i)));
+    best = tracklet_inds_gc_rms(obs,inds);
+
+    /* Drop the worst detection (the one whose removal leaves the */
+    /* best fit) until the fit is good enough.                    */
+    while((best > max_rms) && (ivec_size(inds) > int_max(min_obs,2))) {
+      n   = ivec_size(inds);
+      rms = AM_MALLOC_ARRAY(double, n);
+      if(n - 1 >= 3) {
+        collapse_gc_rms_batch(obs, inds, TRUE, rms);
+      } else {
+        for(k=0;k<n;k++) { rms[k] = 0.0; }
+      }
+      worst = 0;
+      for(k=1;k<n;k++) {
+        if(rms[k] < rms[worst]) { worst = k; }
+      }
+      best = rms[worst];
+      ivec_remove(inds, worst);
+      AM_FREE_ARRAY(rms, double, n);
+    }
+
+    if((best <= max_rms) && (ivec_size(inds) >= min_obs)) {
+      if(ivec_size(inds) == track_num_obs(track_array_ref(tracklets,i))) {
+        track_array_add(res, track_array_ref(tracklets,i));
+      } else {
+        T = mk_track_from_N_inds(obs, inds);
+        track_array_add(res,T);
+        free_track(T);
+      }
+    }
+    free_ivec(inds);
+  }
+
+  return res;
+}
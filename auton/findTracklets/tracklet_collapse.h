@@ -0,0 +1,63 @@
+/*
+   File:        tracklet_collapse.h
+   Author(s):   PS1 MOPS
+   Created:     Fri Oct 16, 2026
+   Description: Collapse and purify stages for the tracklets found in a
+                deep stack.  Collapsing merges tracklets that describe
+                the same motion (position, direction and speed at a
+                common time) into longer ones.  Purifying drops the
+                detections that spoil a tracklet's great circle fit.
+                These do the jobs of the CollapseTracklets and
+                purifyTracklets programs on the tracklets in memory.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TRACKLET_COLLAPSE_H
+#define TRACKLET_COLLAPSE_H
+
+#include "track.h"
+
+/* The 2d rms great circle residual (arcsec) of the detections inds */
+/* (in any order), from the batched fit of gcf.h.                    */
+double tracklet_inds_gc_rms(simple_obs_array* obs, ivec* inds);
+
+/* Collapse the tracklets.  Each tracklet's fitted position and motion  */
+/* are taken at the middle of the detections' time span.  Tracklets    */
+/* within ra_tol and dec_tol (degrees) in position, ang_tol (degrees)  */
+/* in direction and vel_tol (degrees per day) in speed are candidates  */
+/* for merging.  Taking the tracklets in order, each one that has not  */
+/* been merged yet greedily absorbs its candidates (also in order):    */
+/* a candidate's new detections are added unless one of them is at the */
+/* time of a detection already in the tracklet or the merged tracklet's */
+/* great circle rms would exceed max_rms (arcsec).  Candidates that add */
+/* nothing are absorbed as well.  Returns the merged tracklets and the  */
+/* ones that were not absorbed, refitted, in the order of their first  */
+/* tracklet.                                                            */
+track_array* mk_tracklets_collapse(simple_obs_array* obs,
+                                   track_array* tracklets,
+                                   double ra_tol, double dec_tol,
+                                   double ang_tol, double vel_tol,
+                                   double max_rms);
+
+/* Purify the tracklets: while a tracklet's great circle rms is over  */
+/* max_rms (arcsec) and it has more than min_obs detections, drop the */
+/* detection whose removal gives the smallest rms.  Only the          */
+/* tracklets that end with an rms of at most max_rms and at least     */
+/* min_obs detections are kept (in order).                            */
+track_array* mk_tracklets_purify(simple_obs_array* obs,
+                                 track_array* tracklets,
+                                 double max_rms, int min_obs);
+
+#endif
@@ -21,7 +21,41 @@
    along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#ifdef USE_PTHREADS
+#include <pthread.h>
+#endif
+
+#include <sys/time.h>
+
 #include "tracklet_mht.h"
+#include "worker_threads.h"
+
+/* The number of seeds a worker claims at a time in threaded mode. */
+#define MHT_SEED_BLOCK 64
+
+/* Tracklets spanning less than this (days) are always fit linearly */
+/* (see obs_moments_from_sums).                                      */
+#define MHT_LINEAR_MAXT 0.1
+
+
+void mht_timing_init(mht_timing* T) {
+  T->build      = 0.0;
+  T->search     = 0.0;
+  T->subsets    = 0.0;
+  T->endpoints  = 0;
+  T->hypotheses = 0;
+  T->pruned     = 0;
+  T->truncated  = 0;
+}
+
+
+void mht_timing_add_counts(mht_timing* dst, mht_timing* src) {
+  dst->endpoints  += src->endpoints;
+  dst->hypotheses += src->hypotheses;
+  dst->pruned     += src->pruned;
+  dst->truncated  += src->truncated;
+}
+
 
 /* --------------------------------------------------------------------- */
 /* --- Partial Hough Transform Approach -------------------------------- */
@@ -37,20 +71,22 @@ typedef struct PairedVelocity {
 } PairedVelocity;
 
 
-PairedVelocity* mk_PairedVelocity(simple_obs* first, simple_obs* last,
+PairedVelocity* mk_PairedVelocity(obs_store* st, int first, int last,
                                   double error_thresh) {
   PairedVelocity* result = AM_MALLOC(PairedVelocity);
 
   /* Make sure the observations are correctly ordered. */
-  if (simple_obs_time(first) > simple_obs_time(last)) {
-    simple_obs* tmp = first;
+  if (obs_store_time(st, first) > obs_store_time(st, last)) {
+    int tmp = first;
     first = last;
     last = tmp;
   }
 
-  double dt = simple_obs_time(last) - simple_obs_time(first);
-  double dDEC = simple_obs_DEC_rad(last) - simple_obs_DEC_rad(first);
-  double dRA = simple_obs_RA_rad(last) - simple_obs_RA_rad(first);
+  double dt = obs_store_time(st, last) - obs_store_time(st, first);
+  double dDEC = obs_store_DEC(st, last) * DEG_TO_RAD -
+                obs_store_DEC(st, first) * DEG_TO_RAD;
+  double dRA = obs_store_RA(st, last) * 15.0 * DEG_TO_RAD -
+               obs_store_RA(st, first) * 15.0 * DEG_TO_RAD;
   if (dRA > PI)
     dRA -= 2.0*PI;
   if (dRA < -PI)
@@ -66,70 +102,340 @@ PairedVelocity* mk_PairedVelocity(simple_obs* first, simple_obs* last,
   return result;
 }
 
-/* Is A a subset of B?  Assumes that the elements of A and B have an */
-/* underlying ordering (not necessarily the sorted ordering). */
-bool OrderedIvecSubset(ivec* A, ivec* B) {
-  if (ivec_size(A) > ivec_size(B))
-    return FALSE;
-  
-  int curr_a_ind = 0;
-  int curr_b_ind = 0;
-  while ((curr_a_ind < ivec_size(A)) && (curr_b_ind < ivec_size(B))) {
-    if (ivec_ref(A, curr_a_ind) == ivec_ref(B, curr_b_ind)) {
-      curr_a_ind++;
-      curr_b_ind++;
+/* A grid over the PairedVelocities of one seed, so that the entries */
+/* that can overlap a given entry are found without scanning all of  */
+/* them.  Each entry is added to every cell touched by its disc      */
+/* (widened in vRA for the cos(vDEC) scaling of the distance), and    */
+/* entries whose disc covers too many cells are kept on a short list   */
+/* that every lookup checks.                                          */
+typedef struct PHTVelocityGrid {
+  double lo_ra;      /* The low corner of the grid (radians / day). */
+  double lo_dec;
+  double h;          /* The side of a cell. */
+  double cmin;       /* The smallest cos(vDEC) of any entry. */
+  int nx;
+  int ny;
+  ivec_array* cells; /* The entries touching each cell (cell = x*ny + y). */
+  ivec* big;         /* The entries that touch too many cells. */
+  ivec* seen;        /* Scratch: the last lookup that found each entry. */
+} PHTVelocityGrid;
+
+/* Only use the grid for seeds with at least this many endpoints. */
+#define PHT_GRID_MIN_N     64
+
+/* An entry touching more than this many cells goes on the big list. */
+#define PHT_GRID_MAX_SPAN  16
+
+/* Relative slack on the lookup boxes (for rounding). */
+#define PHT_GRID_SLACK     1e-9
+
+
+int PHTVelocityGridCell(double v, double lo, double h, int n) {
+  double c = floor((v - lo) / h);
+
+  if (c < 0.0) { return 0; }
+  if (c > (double)(n-1)) { return n-1; }
+  return (int)c;
+}
+
+
+PHTVelocityGrid* mk_PHTVelocityGrid(PairedVelocity** bounds_array, int N) {
+  PHTVelocityGrid* G;
+  dyv* radius;
+  double lo_ra, hi_ra, lo_dec, hi_dec;
+  double h, r, rr, cmin;
+  int x0, x1, y0, y1, x, y;
+  int i;
+
+  if (N < PHT_GRID_MIN_N) {
+    return NULL;
+  }
+
+  /* The grid covers the velocities themselves (the discs are clipped */
+  /* to its edge cells) and the cell side is twice the median radius. */
+  radius = mk_dyv(N);
+  lo_ra  = hi_ra  = bounds_array[0]->vRA;
+  lo_dec = hi_dec = bounds_array[0]->vDEC;
+  cmin   = 1.0;
+  for (i = 0; i < N; ++i) {
+    dyv_set(radius, i, sqrt(bounds_array[i]->radius_sq));
+    lo_ra  = fmin(lo_ra,  bounds_array[i]->vRA);
+    hi_ra  = fmax(hi_ra,  bounds_array[i]->vRA);
+    lo_dec = fmin(lo_dec, bounds_array[i]->vDEC);
+    hi_dec = fmax(hi_dec, bounds_array[i]->vDEC);
+    cmin   = fmin(cmin, cos(bounds_array[i]->vDEC));
+  }
+  h = 2.0 * dyv_median(radius);
+
+  /* The cos(vDEC) scaling must not blow up the vRA extent. */
+  if ((cmin < 0.01) || (h <= 0.0)) {
+    free_dyv(radius);
+    return NULL;
+  }
+
+  /* Keep the number of cells in proportion to N. */
+  while (((hi_ra - lo_ra) / h + 1.0) * ((hi_dec - lo_dec) / h + 1.0) >
+         (double)(4 * N)) {
+    h = 2.0 * h;
+  }
+
+  G = AM_MALLOC(PHTVelocityGrid);
+  G->lo_ra  = lo_ra;
+  G->lo_dec = lo_dec;
+  G->h      = h;
+  G->cmin   = cmin;
+  G->nx     = (int)((hi_ra - lo_ra) / h) + 1;
+  G->ny     = (int)((hi_dec - lo_dec) / h) + 1;
+  G->cells  = mk_array_of_zero_length_ivecs(G->nx * G->ny);
+  G->big    = mk_ivec(0);
+  G->seen   = mk_constant_ivec(N, -1);
+
+  for (i = 0; i < N; ++i) {
+    r  = dyv_ref(radius, i) * (1.0 + PHT_GRID_SLACK);
+    rr = r / cmin;
+    x0 = PHTVelocityGridCell(bounds_array[i]->vRA - rr, lo_ra, h, G->nx);
+    x1 = PHTVelocityGridCell(bounds_array[i]->vRA + rr, lo_ra, h, G->nx);
+    y0 = PHTVelocityGridCell(bounds_array[i]->vDEC - r, lo_dec, h, G->ny);
+    y1 = PHTVelocityGridCell(bounds_array[i]->vDEC + r, lo_dec, h, G->ny);
+
+    if ((x1 - x0 + 1) * (y1 - y0 + 1) > PHT_GRID_MAX_SPAN) {
+      add_to_ivec(G->big, i);
     } else {
-      curr_b_ind++;  /* Move along until we find a match. */
+      for (x = x0; x <= x1; ++x) {
+        for (y = y0; y <= y1; ++y) {
+          add_to_ivec_array_ref(G->cells, x * G->ny + y, i);
+        }
+      }
     }
   }
 
-  /* A is a subset if every element in A had a match in B. */
-  return (curr_a_ind == ivec_size(A));
+  free_dyv(radius);
+  return G;
 }
 
 
-track_array* mk_tracklets_single_query_PHT(simple_obs_array* arr, int Xind,
-                                           rdt_tree* tr, double minv, double maxv,
-                                           double thresh, double maxt,
-                                           dyv* angle, dyv* length,
-                                           dyv* exp_time, double athresh,
-                                           double maxLerr, double etime,
-                                           bool remove_subsets,
-                                           int max_obs, int min_obs,
-                                           bool greedy) {
-  int i, j;
+void free_PHTVelocityGrid(PHTVelocityGrid* G) {
+  free_ivec_array(G->cells);
+  free_ivec(G->big);
+  free_ivec(G->seen);
+  AM_FREE(G, PHTVelocityGrid);
+}
 
-  /* Use what we know about the elongation to adjust maxv. */
-  /* Only mess with v bounds if we have a fast mover.     */
-//  double estMinV = 0.0;
-  double estMinV = minv;
-  double estMaxV = maxv;
+
+/* Set cand to the entries j <= i (in increasing order) that may     */
+/* overlap entry i.  Two entries overlap when their distance (with vRA */
+/* scaled by cos(vDEC) of entry i) is at most sqrt(r_i^2 + r_j^2),     */
+/* which is at most r_i + r_j, so entry j's (widened) disc must touch  */
+/* entry i's lookup box.                                               */
+void PHTVelocityGridCandidates(PHTVelocityGrid* G,
+                               PairedVelocity** bounds_array, int i,
+                               ivec* cand) {
+  PairedVelocity* end_pt = bounds_array[i];
+  double r  = sqrt(end_pt->radius_sq) * (1.0 + PHT_GRID_SLACK);
+  double rr = r / cos(end_pt->vDEC);
+  ivec* cell;
+  int x0, x1, y0, y1, x, y;
+  int k, j;
+
+  ivec_remove_last_n_elements(cand, ivec_size(cand));
+
+  x0 = PHTVelocityGridCell(end_pt->vRA - rr, G->lo_ra, G->h, G->nx);
+  x1 = PHTVelocityGridCell(end_pt->vRA + rr, G->lo_ra, G->h, G->nx);
+  y0 = PHTVelocityGridCell(end_pt->vDEC - r, G->lo_dec, G->h, G->ny);
+  y1 = PHTVelocityGridCell(end_pt->vDEC + r, G->lo_dec, G->h, G->ny);
+  for (x = x0; x <= x1; ++x) {
+    for (y = y0; y <= y1; ++y) {
+      cell = ivec_array_ref(G->cells, x * G->ny + y);
+      for (k = 0; k < ivec_size(cell); ++k) {
+        j = ivec_ref(cell, k);
+        if ((j <= i) && (ivec_ref(G->seen, j) != i)) {
+          ivec_set(G->seen, j, i);
+          add_to_ivec(cand, j);
+        }
+      }
+    }
+  }
+
+  for (k = 0; k < ivec_size(G->big); ++k) {
+    j = ivec_ref(G->big, k);
+    if ((j <= i) && (ivec_ref(G->seen, j) != i)) {
+      ivec_set(G->seen, j, i);
+      add_to_ivec(cand, j);
+    }
+  }
+
+  ivec_sort(cand, cand);
+}
+
+
+/* Is the candidate a subset of any accepted tracklet?  The candidate */
+/* is given by the (endpoint) positions of its detections other than  */
+/* the seed, which every tracklet shares.  posting[p] lists the       */
+/* accepted tracklets that contain position p and hits is all zero    */
+/* scratch space with one entry per accepted tracklet.  Runs in time  */
+/* linear in the total length of the candidate's posting lists.      */
+bool PHTCandidateIsSubset(ivec* pos, ivec_array* posting, ivec* hits) {
+  int m = ivec_size(pos);
+  int i, j, r;
+  bool is_subset = FALSE;
+
+  /* Every accepted tracklet contains the seed. */
+  if (m == 0)
+    return (ivec_size(hits) > 0);
+
+  /* Count how many of the candidate's detections each tracklet has. */
+  for (i = 0; (i < m) && !is_subset; ++i) {
+    ivec* post = ivec_array_ref(posting, ivec_ref(pos, i));
+    for (j = 0; (j < ivec_size(post)) && !is_subset; ++j) {
+      r = ivec_ref(post, j);
+      ivec_increment(hits, r, 1);
+      is_subset = (ivec_ref(hits, r) == m);
+    }
+  }
+
+  /* Clear the scratch space. */
+  for (i = 0; i < m; ++i) {
+    ivec* post = ivec_array_ref(posting, ivec_ref(pos, i));
+    for (j = 0; j < ivec_size(post); ++j) {
+      ivec_set(hits, ivec_ref(post, j), 0);
+    }
+  }
+
+  return is_subset;
+}
+
+
+/* The speed bounds [lo, hi] (radians per day) used when searching */
+/* from detection Xind.  For a fast mover the elongation (length)   */
+/* replaces [minv, maxv] with the range of speeds it implies.        */
+void mht_seed_speed_bounds(int Xind, dyv* length, dyv* exp_time,
+                           double minv, double maxv, double maxLerr,
+                           double etime, double* lo, double* hi) {
   double curr_etime = etime;
+
+  lo[0] = minv;
+  hi[0] = maxv;
   if ((exp_time != NULL) && (dyv_size(exp_time) > Xind) &&
       (dyv_ref(exp_time, Xind) > 0.0)) {
     curr_etime = dyv_ref(exp_time, Xind); 
   }
   if((length != NULL) && (dyv_ref(length, Xind) >= -1e-10)) {
     if(dyv_ref(length, Xind) / curr_etime > maxv) {
-      estMinV = (dyv_ref(length, Xind) - maxLerr) / curr_etime;
-      estMaxV = (dyv_ref(length, Xind) + maxLerr) / curr_etime;
-      if(estMinV < 0.0) { estMinV = 0.0; }
+      lo[0] = (dyv_ref(length, Xind) - maxLerr) / curr_etime;
+      hi[0] = (dyv_ref(length, Xind) + maxLerr) / curr_etime;
+      if(lo[0] < 0.0) { lo[0] = 0.0; }
     }
   }
+}
 
-  /* Find all feasible second endpoints. */
-  simple_obs* X = simple_obs_array_ref(arr, Xind);
-  ivec* pairs = mk_rdt_tree_moving_pt_query(tr, arr, X,
-                                            simple_obs_time(X)+1e-5,
-                                            simple_obs_time(X)+maxt,
-                                            estMinV, estMaxV, thresh);
+
+/* The seed's exposure time (days). */
+double mht_seed_etime(int Xind, dyv* exp_time, double etime) {
+  if ((exp_time != NULL) && (dyv_size(exp_time) > Xind) &&
+      (dyv_ref(exp_time, Xind) > 0.0)) {
+    return dyv_ref(exp_time, Xind);
+  }
+  return etime;
+}
+
+
+/* The speed range [lo, hi] and the direction wedge W (if use_W) that */
+/* the search from Xind queries the index with.  The speed range is    */
+/* always mht_seed_speed_bounds.                                       */
+/*                                                                     */
+/* The MHT post filter only keeps tracklets whose direction, from the  */
+/* seed to their last detection, fits the angle of each long enough    */
+/* trail.  If the fit is linear (maxt <= MHT_LINEAR_MAXT) every        */
+/* detection D of a kept tracklet is within e of the line from the     */
+/* seed to the last one, where e is the sum of the tracklet's fit      */
+/* residuals (< max_obs * thresh), so D's direction from the seed is   */
+/* within athresh + atan(2 e / d) of the seed's angle.  So a plain MHT */
+/* search (not PHT, greedy, beam or budget limited, whose hypotheses   */
+/* depend on each other) of a fast mover queries just that wedge and   */
+/* finds the same tracklets.                                           */
+void mht_seed_query_bounds(int Xind, dyv* angle, dyv* length,
+                           dyv* exp_time, double minv, double maxv,
+                           double athresh, double maxLerr, double etime,
+                           double thresh, double maxt, int max_obs,
+                           bool use_pht, bool greedy, bool elong_query,
+                           int beam, long budget, double* lo, double* hi,
+                           rdt_wedge* W, bool* use_W) {
+  double curr_etime = mht_seed_etime(Xind, exp_time, etime);
+
+  /* Use what we know about the elongation to adjust maxv. */
+  /* Only mess with v bounds if we have a fast mover.     */
+  mht_seed_speed_bounds(Xind, length, exp_time, minv, maxv, maxLerr, etime,
+                        lo, hi);
+
+  use_W[0] = FALSE;
+  if(!use_pht && !greedy && (beam == 0) && (budget == 0) &&
+     elong_query && (length != NULL) && (angle != NULL) &&
+     (maxt <= MHT_LINEAR_MAXT) && (athresh < PI/2.0) &&
+     (dyv_ref(length,Xind) / curr_etime > maxv) &&
+     (dyv_ref(length,Xind) - 2.0*maxLerr > 0.0)) {
+    W->dir   = dyv_ref(angle,Xind);
+    W->tol   = athresh;
+    W->err   = (double)int_max(max_obs,1) * thresh;
+    use_W[0] = TRUE;
+  }
+}
+
+
+/* Find all feasible second endpoints for X using whichever index */
+/* was built: the single tree (tr) or the per-plate forest (fr).  */
+/* The endpoints are returned in index order so that the search    */
+/* does not depend on the shape of the index (or on which other    */
+/* detections it holds, see the sky tiles below).  If W is not     */
+/* NULL only the endpoints in that direction are returned.         */
+ivec* mk_tracklet_endpoint_query(rdt_tree* tr, rdt_forest* fr,
+                                 obs_store* st, int X,
+                                 double maxt, double minv, double maxv,
+                                 double thresh, rdt_wedge* W) {
+  double ts = obs_store_time(st,X)+1e-5;
+  double te = obs_store_time(st,X)+maxt;
+  ivec* pairs;
+  ivec* sorted;
+
+  if((fr != NULL) && (W != NULL)) {
+    pairs = mk_rdt_forest_wedge_query_store(fr, st, X, ts, te, minv, maxv,
+                                            thresh, W->dir, W->tol, W->err);
+  } else if(fr != NULL) {
+    pairs = mk_rdt_forest_moving_pt_query_store(fr, st, X, ts, te,
+                                                minv, maxv, thresh);
+  } else if(W != NULL) {
+    pairs = mk_rdt_tree_wedge_query_store(tr, st, X, ts, te, minv, maxv,
+                                          thresh, W->dir, W->tol, W->err);
+  } else {
+    pairs = mk_rdt_tree_moving_pt_query_store(tr, st, X, ts, te,
+                                              minv, maxv, thresh);
+  }
+
+  sorted = mk_ivec_sort(pairs);
+  free_ivec(pairs);
+
+  return sorted;
+}
+
+
+/* The PHT search from Xind given its feasible second endpoints */
+/* (pairs, in index order).                                     */
+track_array* mk_tracklets_PHT_from_pairs(simple_obs_array* arr,
+                                         obs_store* st, int Xind,
+                                         ivec* pairs, double thresh,
+                                         bool remove_subsets,
+                                         int max_obs, int min_obs,
+                                         bool greedy, mht_timing* counts) {
+  int i, j;
   int N = ivec_size(pairs);
 
+  /* Each endpoint gives one candidate. */
+  counts->endpoints  += N;
+  counts->hypotheses += N;
+
   /* Find the times and sort them. */
   dyv* times = mk_zero_dyv(N);
   for(i = 0; i < N; i++) {
-    simple_obs* Y = simple_obs_array_ref(arr, ivec_ref(pairs, i));
-    dyv_set(times, i, simple_obs_time(Y));
+    dyv_set(times, i, obs_store_time(st, ivec_ref(pairs, i)));
   }
   ivec* order = mk_ivec_sorted_dyv_indices(times);
   ivec* ordered_pairs = mk_zero_ivec(N);
@@ -143,25 +449,42 @@ track_array* mk_tracklets_single_query_PHT(simple_obs_array* arr, int Xind,
   /* to each candidate. */
   PairedVelocity** bounds_array = AM_MALLOC_ARRAY(PairedVelocity*, N);
   for (i = 0; i < N; i++) {
-    simple_obs* Y = simple_obs_array_ref(arr, ivec_ref(ordered_pairs, i));
-    bounds_array[i] = mk_PairedVelocity(X, Y, thresh);
+    bounds_array[i] = mk_PairedVelocity(st, Xind, ivec_ref(ordered_pairs, i),
+                                        thresh);
   }
 
   /* For each possible end point, create a tracklet from all all other */
-  /* compatible detections (defined by overlap in velocity space).  We */
-  /* could use a tree here to speed things up if this becomes a bottleneck.*/
+  /* compatible detections (defined by overlap in velocity space).  For */
+  /* many endpoints a grid over the velocities gives the entries that   */
+  /* can overlap each end point, in the same order as a full scan.      */
   track_array* res = mk_empty_track_array(1);
-  ivec_array* res_inds = mk_ivec_array(0);
   int length_longest = 0;
+  PHTVelocityGrid* grid = mk_PHTVelocityGrid(bounds_array, N);
+  ivec* cand = mk_ivec(0);
+  int k, nc;
+
+  /* An inverted index from each endpoint position to the accepted */
+  /* tracklets that contain it (for the subset check).             */
+  ivec_array* posting = mk_array_of_zero_length_ivecs(N);
+  ivec* hits = mk_ivec(0);
+
   for (i = N-1; i >= 0; --i) {
     ivec* inds = mk_ivec_1(Xind);
+    ivec* pos  = mk_ivec(0);
     PairedVelocity* end_pt = bounds_array[i];
 
     /* Greedily build the rest of the tracklet, adding the closest */
     /* detection (in velocity space) at each time. */
     double t_last = -1.0;
     double d_last = 0.0;
-    for (j = 0; j <= i; ++j) {
+    if (grid != NULL) {
+      PHTVelocityGridCandidates(grid, bounds_array, i, cand);
+      nc = ivec_size(cand);
+    } else {
+      nc = i + 1;
+    }
+    for (k = 0; k < nc; ++k) {
+      j = (grid != NULL) ? ivec_ref(cand, k) : k;
       PairedVelocity* curr_pt = bounds_array[j];
 
       double dRA = (end_pt->vRA - curr_pt->vRA) * cos(end_pt->vDEC);
@@ -173,11 +496,13 @@ track_array* mk_tracklets_single_query_PHT(simple_obs_array* arr, int Xind,
         if (t_last + 1e-10 > curr_pt->dt) { 
           if (dist < d_last) {
             ivec_set(inds, ivec_size(inds) - 1, ivec_ref(ordered_pairs, j));
+            ivec_set(pos, ivec_size(pos) - 1, j);
             t_last = curr_pt->dt;
             d_last = dist;
           }
         } else {
           add_to_ivec(inds, ivec_ref(ordered_pairs, j));
+          add_to_ivec(pos, j);
           t_last = curr_pt->dt;
           d_last = dist;
         }
@@ -189,15 +514,15 @@ track_array* mk_tracklets_single_query_PHT(simple_obs_array* arr, int Xind,
     if ((ivec_size(inds) >= min_obs) && (ivec_size(inds) <= max_obs)) {
       bool is_subset = FALSE;
       if (remove_subsets) {
-        /* Brute force: We can make this more efficient if needed. */
-        for (j = 0; (j < ivec_array_size(res_inds)) && !is_subset; ++j) {
-          is_subset = OrderedIvecSubset(inds, ivec_array_ref(res_inds, j));
-        }
+        is_subset = PHTCandidateIsSubset(pos, posting, hits);
       }
       if (!is_subset) {
         track* trk = mk_track_from_N_inds(arr, inds);
+        for (j = 0; j < ivec_size(pos); ++j) {
+          add_to_ivec_array_ref(posting, ivec_ref(pos, j), ivec_size(hits));
+        }
+        add_to_ivec(hits, 0);
         track_array_add(res, trk);
-        add_to_ivec_array(res_inds, inds);
         free_track(trk);
 
         if (ivec_size(inds) > length_longest) {
@@ -207,6 +532,7 @@ track_array* mk_tracklets_single_query_PHT(simple_obs_array* arr, int Xind,
     }
 
     free_ivec(inds);
+    free_ivec(pos);
   }
 
   /* If we are in greedy mode, only take the longest tracks.  */
@@ -227,8 +553,45 @@ track_array* mk_tracklets_single_query_PHT(simple_obs_array* arr, int Xind,
     AM_FREE(bounds_array[i], PairedVelocity);
   }
   AM_FREE_ARRAY(bounds_array, PairedVelocity*, N);
-  free_ivec_array(res_inds);
+  if (grid != NULL) {
+    free_PHTVelocityGrid(grid);
+  }
+  free_ivec(cand);
+  free_ivec_array(posting);
+  free_ivec(hits);
   free_ivec(ordered_pairs);
+
+  return res;
+}
+
+
+track_array* mk_tracklets_single_query_PHT(simple_obs_array* arr,
+                                           obs_store* st, int Xind,
+                                           rdt_tree* tr, rdt_forest* fr,
+                                           double minv, double maxv,
+                                           double thresh, double maxt,
+                                           dyv* angle, dyv* length,
+                                           dyv* exp_time, double athresh,
+                                           double maxLerr, double etime,
+                                           bool remove_subsets,
+                                           int max_obs, int min_obs,
+                                           bool greedy, mht_timing* counts) {
+  track_array* res;
+  ivec* pairs;
+  double estMinV, estMaxV;
+  bool use_W;
+  rdt_wedge W;
+
+  /* Find all feasible second endpoints. */
+  mht_seed_query_bounds(Xind, angle, length, exp_time, minv, maxv, athresh,
+                        maxLerr, etime, thresh, maxt, max_obs, TRUE, greedy,
+                        FALSE, 0, 0, &estMinV, &estMaxV, &W, &use_W);
+  pairs = mk_tracklet_endpoint_query(tr, fr, st, Xind, maxt, estMinV,
+                                     estMaxV, thresh, NULL);
+
+  res = mk_tracklets_PHT_from_pairs(arr, st, Xind, pairs, thresh,
+                                    remove_subsets, max_obs, min_obs, greedy,
+                                    counts);
   free_ivec(pairs);
 
   return res;
@@ -239,59 +602,215 @@ track_array* mk_tracklets_single_query_PHT(simple_obs_array* arr, int Xind,
 /* --- Multiple Hypothesis Tracking Approach --------------------------- */
 /* --------------------------------------------------------------------- */
 
-track_array* mk_tracklets_single_query(simple_obs_array* arr, int Xind,
-                                       rdt_tree* tr,  double minv, double maxv,
-                                       double thresh, double maxt,
-                                       dyv* angle, dyv* length, dyv* exp_time,
-                                       double athresh, double maxLerr,
-                                       double etime, bool remove_subsets,
-                                       int max_obs, bool greedy) {
+/* --- Beam ------------------------------------------------------------ */
+
+/* A hypothesis in the beam: its mean fit residual and its position. */
+typedef struct mht_beam_entry {
+  double resid;
+  int    ind;
+} mht_beam_entry;
+
+
+/* Is a ranked below b?  Ties go to the earlier hypothesis. */
+bool mht_beam_worse(mht_beam_entry* a, mht_beam_entry* b) {
+  return ((a->resid > b->resid) ||
+          ((a->resid == b->resid) && (a->ind > b->ind)));
+}
+
+
+/* Offer e to a heap of at most K entries that keeps the K best with */
+/* the worst of them on top.                                          */
+void mht_beam_heap_offer(mht_beam_entry* heap, int* size, int K,
+                         mht_beam_entry e) {
+  mht_beam_entry tmp;
+  int i, c;
+
+  if (size[0] < K) {
+    /* Add e at the bottom and sift it up. */
+    i = size[0];
+    heap[i] = e;
+    size[0] += 1;
+    while ((i > 0) && mht_beam_worse(&heap[i], &heap[(i-1)/2])) {
+      tmp = heap[i]; heap[i] = heap[(i-1)/2]; heap[(i-1)/2] = tmp;
+      i = (i-1)/2;
+    }
+  } else if (mht_beam_worse(&heap[0], &e)) {
+    /* Replace the worst entry with e and sift it down. */
+    heap[0] = e;
+    i = 0;
+    while (2*i+1 < size[0]) {
+      c = 2*i+1;
+      if ((c+1 < size[0]) && mht_beam_worse(&heap[c+1], &heap[c])) { c++; }
+      if (!mht_beam_worse(&heap[c], &heap[i])) { break; }
+      tmp = heap[i]; heap[i] = heap[c]; heap[c] = tmp;
+      i = c;
+    }
+  }
+}
+
+
+/* Keep only the beam best hypotheses of each length in res[0] (and */
+/* in the parallel fits and resid arrays), in their current order.  */
+/* Hypotheses of one or two detections have no residual and there   */
+/* are at most one per endpoint, so they are all kept.  Returns the */
+/* number of hypotheses dropped.                                    */
+int mht_beam_prune(track_array** res, track_fit* fits, double* resid,
+                   int beam) {
+  int H = track_array_size(res[0]);
+  int max_d = 0;
+  int num_kept = 0;
+  mht_beam_entry* heaps;
+  mht_beam_entry e;
+  track_array* kept;
+  ivec* heap_size;
+  ivec* keep;
+  int i, d, n;
+
+  for (i = 0; i < H; i++) {
+    max_d = int_max(max_d, track_num_obs(track_array_ref(res[0],i)));
+  }
+
+  /* Offer every hypothesis to the heap of its length. */
+  heaps     = AM_MALLOC_ARRAY(mht_beam_entry, (max_d+1) * beam);
+  heap_size = mk_zero_ivec(max_d+1);
+  for (i = 0; i < H; i++) {
+    d       = track_num_obs(track_array_ref(res[0],i));
+    if (d <= 2) { continue; }
+    n       = ivec_ref(heap_size,d);
+    e.resid = resid[i];
+    e.ind   = i;
+    mht_beam_heap_offer(heaps + d*beam, &n, beam, e);
+    ivec_set(heap_size,d,n);
+  }
+
+  keep = mk_zero_ivec(H);
+  for (i = 0; i < H; i++) {
+    if (track_num_obs(track_array_ref(res[0],i)) <= 2) { ivec_set(keep,i,1); }
+  }
+  for (d = 3; d <= max_d; d++) {
+    for (i = 0; i < ivec_ref(heap_size,d); i++) {
+      ivec_set(keep, heaps[d*beam + i].ind, 1);
+    }
+  }
+
+  for (i = 0; i < H; i++) { num_kept += ivec_ref(keep,i); }
+  if (num_kept < H) {
+    kept = mk_empty_track_array(int_max(num_kept,1));
+    for (i = 0; i < H; i++) {
+      if (ivec_ref(keep,i)) {
+        fits[track_array_size(kept)]  = fits[i];
+        resid[track_array_size(kept)] = resid[i];
+        track_array_add(kept, track_array_ref(res[0],i));
+      }
+    }
+    free_track_array(res[0]);
+    res[0] = kept;
+  }
+
+  free_ivec(keep);
+  free_ivec(heap_size);
+  AM_FREE_ARRAY(heaps, mht_beam_entry, (max_d+1) * beam);
+
+  return H - num_kept;
+}
+
+
+/* Is the tracklet A (seeded at Xind, with estimated speed vel) */
+/* compatible with the elongation length and angle of each of   */
+/* its detections?                                               */
+bool mht_elong_compatible(simple_obs_array* arr, int Xind, track* A,
+                          double vel, dyv* length, dyv* angle,
+                          double athresh, double maxLerr,
+                          double curr_etime) {
+  simple_obs* X = simple_obs_array_ref(arr,Xind);
+  simple_obs* Y = track_last(A,arr);
+  ivec* inds = track_individs(A);
+  bool valid = (track_size(A) > 1);
+  double ang1, ang2;
+  double dD, dR, diff;
+  double estMinV, estMaxV;
+  int j, Yind;
+
+  /* Check each detection for compatible length. */
+  for(j=0;(j<track_size(A))&&(valid);j++) {
+    Yind = ivec_ref(inds,j);
+    if(dyv_ref(length,Yind) >= 0.0) {
+      estMinV = (dyv_ref(length,Yind) - maxLerr) / curr_etime;
+      estMaxV = (dyv_ref(length,Yind) + maxLerr) / curr_etime;
+      valid   = (estMinV <= vel)&&(estMaxV >= vel);
+    }
+  }
+
+  /* Check each detection for compatible angle. */
+  if(valid) {
+    dR = 15.0*(simple_obs_RA(Y)  - simple_obs_RA(X));
+    if(dR >  180.0) { dR -= 360.0; }
+    if(dR < -180.0) { dR += 360.0; }
+    dD = simple_obs_DEC(Y) - simple_obs_DEC(X);
+    ang1 = atan2(dR,dD);
+    if(ang1 < 0.0) { ang1 += 2.0*PI; }
+
+    /* Only check the angle if the detection          */
+    /* is long enough that the angle means something! */
+    for(j=0;(j<track_size(A))&&(valid);j++) {
+      Yind = ivec_ref(inds,j);
+      if(dyv_ref(length,Yind)-2.0*maxLerr > 0.0) {
+        ang2 = dyv_ref(angle,Yind);
+        if(ang2 < 0.0) { ang2 += 2.0 * PI; }
+
+        diff = fabs(ang1 - ang2);
+        if(diff > 3.0*PI/2.0) { diff = fabs(diff - 2.0*PI); }
+        if(diff > PI/2.0)     { diff = fabs(diff - PI);     }
+        valid = (diff < athresh);
+      }
+    }
+  }
+
+  return valid;
+}
+
+
+/* The MHT search from Xind given its feasible second endpoints */
+/* (pairs, in index order).                                     */
+track_array* mk_tracklets_MHT_from_pairs(simple_obs_array* arr,
+                                         obs_store* st, int Xind,
+                                         ivec* pairs, double thresh,
+                                         double maxt, dyv* angle,
+                                         dyv* length, dyv* exp_time,
+                                         double athresh, double maxLerr,
+                                         double etime, int max_obs,
+                                         bool greedy, int beam, long budget,
+                                         mht_timing* counts) {
   track_array* res = mk_empty_track_array(10);
   track_array* res2;
   track* A;
   track* B;
-  simple_obs* X = simple_obs_array_ref(arr,Xind);
-  simple_obs* Y;
+  track_fit* fits;              /* The running fit of each track in res */
+  track_fit* old_fits;
+  track_fit  nufit;
+  double* resid;                /* The mean residual of each track in res */
+  double* old_resid;
+  double  nuresid;
+  long num_built = 1;
   ivec* ord_pairs;
-  ivec* pairs;
   ivec* order;
   ivec* inds;
   dyv*  times;
   bool  valid;
-  double ang1, ang2;
-  double dD, dR, diff, vel;
-  double estMinV = minv;        /* 0.0 */
-  double estMaxV = maxv;
+  double tY;
+  double curr_etime = mht_seed_etime(Xind, exp_time, etime);
   int N, Nlast;
-  int i, j;
+  int max_fits;
+  int i, j, k;
   int Yind;
 
-  /* Use what we know about the elongation to adjust maxv */
-  /* Only mess with v bounds if we have a fast mover.     */
-  double curr_etime = etime;
-  if ((exp_time != NULL) && (dyv_size(exp_time) > Xind) &&
-      (dyv_ref(exp_time, Xind) > 0.0)) {
-    curr_etime = dyv_ref(exp_time, Xind); 
-  }
-  if((length != NULL) && (dyv_ref(length,Xind) >= -1e-10)) {
-    if(dyv_ref(length, Xind) / curr_etime > maxv) {            /* New test. */
-      estMinV = (dyv_ref(length, Xind) - maxLerr) / curr_etime;
-      estMaxV = (dyv_ref(length, Xind) + maxLerr) / curr_etime;
-
-      if(estMinV < 0.0) { estMinV = 0.0; }
-    }
-  }
-
-  /* Find all feasible second endpoints. */
-  pairs = mk_rdt_tree_moving_pt_query(tr,arr,X,simple_obs_time(X)+1e-5,
-                                      simple_obs_time(X)+maxt,estMinV,
-                                      estMaxV,thresh);
-  N     = ivec_size(pairs);
+  N = ivec_size(pairs);
+  counts->endpoints  += N;
 
   /* Find the times and sort them... */
   times = mk_zero_dyv(N);
   for(i=0;i<N;i++) {
-    dyv_set(times,i,simple_obs_time(simple_obs_array_ref(arr,ivec_ref(pairs,i))));
+    dyv_set(times,i,obs_store_time(st,ivec_ref(pairs,i)));
   }
   order     = mk_ivec_sorted_dyv_indices(times);
   ord_pairs = mk_zero_ivec(N);
@@ -304,41 +823,83 @@ track_array* mk_tracklets_single_query(simple_obs_array* arr, int Xind,
   track_array_add(res,B);
   free_track(B);
 
-  /* Try a large and messy MHT */
-  for(i=0;i<N;i++) {
-    Y = simple_obs_array_ref(arr,ivec_ref(ord_pairs,i));
+  max_fits = 10;
+  fits     = AM_MALLOC_ARRAY(track_fit,max_fits);
+  resid    = AM_MALLOC_ARRAY(double,max_fits);
+  track_fit_init_store(&(fits[0]),st,Xind);
+  resid[0] = 0.0;
+
+  /* Try a large and messy MHT (bounded by the beam and the budget). */
+  for(i=0;(i<N)&&((budget == 0)||(num_built < budget));i++) {
+    Yind = ivec_ref(ord_pairs,i);
+    tY   = obs_store_time(st,Yind);
 
     Nlast = track_array_size(res);
-    for(j=0;j<Nlast;j++) {
-      A = track_array_ref(res,j);
+    for(j=0;(j<Nlast)&&((budget == 0)||(num_built < budget));j++) {
+      A    = track_array_ref(res,j);
+      inds = track_individs(A);
 
       /* Check that the new obs is after the last obs and  */
       /* not too far from the first observation (in time). */
       /* Also allow a max depth branching factor.          */
-      valid = (simple_obs_time(Y) - track_first_time(A,arr) < maxt);
-      valid = valid && (simple_obs_time(Y) - track_last_time(A,arr) > 1e-5);
+      valid = (tY - obs_store_time(st,ivec_ref(inds,0)) < maxt);
+      valid = valid && (tY - obs_store_time(st,ivec_ref(inds,ivec_size(inds)-1)) > 1e-5);
       valid = valid && (track_num_obs(A) < max_obs);
 
       if(valid) {
 
         /* Actually try the track and make sure it is a good enough fit. */
-        /* Also check the restrictions on max velocity.                  */
-        B = mk_track_add_one_ind(A,ivec_ref(ord_pairs,i),arr);
-        if ((track_num_obs(B) <= 2) ||
-            (mean_track_residual_angle(B,arr) < thresh)) {
+        /* Also check the restrictions on max velocity.  The fit is      */
+        /* updated incrementally and B is only built if it survives.     */
+        nufit = fits[j];
+        track_fit_add_store(&nufit,st,Yind);
+        nuresid = 0.0;
+        if (nufit.N > 2) {
+          nuresid = track_fit_mean_residual_angle_store(&nufit,st,inds,Yind);
+        }
+        if ((nufit.N <= 2) || (nuresid < thresh)) {
+          B = mk_track_from_fit(&nufit,inds,Yind);
+          num_built++;
 
           /* No greedy replacement for length 1-2 tracks. */
           if ((track_num_obs(B) <= 3) || !greedy) {
             track_array_add(res,B);
+
+            if(track_array_size(res) > max_fits) {
+              old_fits  = fits;
+              old_resid = resid;
+              fits      = AM_MALLOC_ARRAY(track_fit,2*max_fits);
+              resid     = AM_MALLOC_ARRAY(double,2*max_fits);
+              for(k=0;k<max_fits;k++) {
+                fits[k]  = old_fits[k];
+                resid[k] = old_resid[k];
+              }
+              AM_FREE_ARRAY(old_fits,track_fit,max_fits);
+              AM_FREE_ARRAY(old_resid,double,max_fits);
+              max_fits = 2*max_fits;
+            }
+            fits[track_array_size(res)-1]  = nufit;
+            resid[track_array_size(res)-1] = nuresid;
           } else {
             track_array_set(res,j,B); /* Replace A with B */
+            fits[j]  = nufit;
+            resid[j] = nuresid;
             A = B;                    /* For safety */
           }
+          free_track(B);
         }
-        free_track(B);
       }
 
     }
+
+    /* Only carry the best hypotheses on to the next endpoint. */
+    if(beam > 0) {
+      counts->pruned += mht_beam_prune(&res,fits,resid,beam);
+    }
+  }
+  counts->hypotheses += num_built;
+  if((budget > 0) && (num_built >= budget)) {
+    counts->truncated += 1;
   }
 
   /* Post filter all of the tracklets based on */
@@ -347,56 +908,22 @@ track_array* mk_tracklets_single_query(simple_obs_array* arr, int Xind,
     res2 = mk_empty_track_array(track_array_size(res));
 
     for(i=0;i<track_array_size(res);i++) {
-      A     = track_array_ref(res,i);
-      vel   = linear_track_estimated_angular_vel(A);
-      inds  = track_individs(A);
-      Y     = track_last(A,arr);
-      valid = (track_size(A) > 1);
-
-      /* Check each detection for compatible length. */
-      for(j=0;(j<track_size(A))&&(valid);j++) {
-        Yind = ivec_ref(inds,j);
-        if(dyv_ref(length,Yind) >= 0.0) {
-          estMinV = (dyv_ref(length,Yind) - maxLerr) / curr_etime;
-          estMaxV = (dyv_ref(length,Yind) + maxLerr) / curr_etime;
-          valid   = (estMinV <= vel)&&(estMaxV >= vel);
-        }
-      }
-
-      /* Check each detection for compatible angle. */
-      if(valid) {
-        dR = 15.0*(simple_obs_RA(Y)  - simple_obs_RA(X));
-        if(dR >  180.0) { dR -= 360.0; }
-        if(dR < -180.0) { dR += 360.0; }
-        dD = simple_obs_DEC(Y) - simple_obs_DEC(X);
-        ang1 = atan2(dR,dD);
-        if(ang1 < 0.0) { ang1 += 2.0*PI; }
-
-        /* Only check the angle if the detection          */
-        /* is long enough that the angle means something! */
-        for(j=0;(j<track_size(A))&&(valid);j++) {
-          Yind = ivec_ref(inds,j);
-          if(dyv_ref(length,Yind)-2.0*maxLerr > 0.0) {
-            ang2 = dyv_ref(angle,Yind);
-            if(ang2 < 0.0) { ang2 += 2.0 * PI; }
-
-            diff = fabs(ang1 - ang2);
-            if(diff > 3.0*PI/2.0) { diff = fabs(diff - 2.0*PI); }
-            if(diff > PI/2.0)     { diff = fabs(diff - PI);     }
-            valid = (diff < athresh);
-          }
-        }
+      A = track_array_ref(res,i);
+      if(mht_elong_compatible(arr, Xind, A,
+                              linear_track_estimated_angular_vel(A),
+                              length, angle, athresh, maxLerr,
+                              curr_etime)) {
+        track_array_add(res2,A);
       }
-
-      if(valid) { track_array_add(res2,A); } 
     }
 
     free_track_array(res);
     res = res2;
   }
 
+  AM_FREE_ARRAY(fits,track_fit,max_fits);
+  AM_FREE_ARRAY(resid,double,max_fits);
   free_dyv(times);
-  free_ivec(pairs);
   free_ivec(order);
   free_ivec(ord_pairs);
 
@@ -404,132 +931,1289 @@ track_array* mk_tracklets_single_query(simple_obs_array* arr, int Xind,
 }
 
 
-track_array* mk_tracklets_MHT(simple_obs_array* arr, double minv, double maxv,
-                              double thresh, double maxt, int min_size,
-                              bool remove_subsets,
-                              dyv* angle, dyv* length, dyv* exp_time,
-                              double athresh, double maxLerr, double etime,
-                              int max_obs, bool greedy, bool use_pht) {
-  track_array* res = mk_empty_track_array(10);
-  track_array* subres;
-  track*       T;
-  rdt_tree* tr;
-  int i, j;
+track_array* mk_tracklets_single_query(simple_obs_array* arr,
+                                       obs_store* st, int Xind,
+                                       rdt_tree* tr, rdt_forest* fr,
+                                       double minv, double maxv,
+                                       double thresh, double maxt,
+                                       dyv* angle, dyv* length, dyv* exp_time,
+                                       double athresh, double maxLerr,
+                                       double etime, bool remove_subsets,
+                                       int max_obs, bool greedy,
+                                       bool elong_query, int beam,
+                                       long budget, mht_timing* counts) {
+  track_array* res;
+  ivec* pairs;
+  double estMinV, estMaxV;
+  bool use_W;
+  rdt_wedge W;
+
+  /* Find all feasible second endpoints. */
+  mht_seed_query_bounds(Xind, angle, length, exp_time, minv, maxv, athresh,
+                        maxLerr, etime, thresh, maxt, max_obs, FALSE, greedy,
+                        elong_query, beam, budget, &estMinV, &estMaxV, &W,
+                        &use_W);
+  pairs = mk_tracklet_endpoint_query(tr, fr, st, Xind, maxt, estMinV,
+                                     estMaxV, thresh, (use_W ? &W : NULL));
+
+  res = mk_tracklets_MHT_from_pairs(arr, st, Xind, pairs, thresh, maxt,
+                                    angle, length, exp_time, athresh,
+                                    maxLerr, etime, max_obs, greedy, beam,
+                                    budget, counts);
+  free_ivec(pairs);
+
+  return res;
+}
 
-  /* Create the RDT tree */
-  tr = mk_rdt_tree(arr,NULL,FALSE,RDT_MAX_LEAF_NODES);
 
-  for(i=0;i<simple_obs_array_size(arr);i++) {
-    if (!use_pht) {
-      subres = mk_tracklets_single_query(arr, i, tr, minv, maxv, thresh, maxt,
-                                         angle, length, exp_time, athresh,
-                                         maxLerr, etime, remove_subsets,
-                                         max_obs, greedy);
+/* --------------------------------------------------------------------- */
+/* --- Seed Loop (serial and threaded) --------------------------------- */
+/* --------------------------------------------------------------------- */
+
+/* All of the (read only) state needed to run a range of seeds.  The    */
+/* index and observations are shared by all workers and never modified. */
+typedef struct mht_seed_job {
+  simple_obs_array* arr;
+  obs_store* st;                /* The same detections as columns.   */
+  rdt_tree* tr;                 /* Either the single tree ...        */
+  rdt_forest* fr;               /* ... or the per-plate forest.      */
+  dyv* angle;
+  dyv* length;
+  dyv* exp_time;
+  double minv;
+  double maxv;
+  double thresh;
+  double maxt;
+  double athresh;
+  double maxLerr;
+  double etime;
+  int min_size;
+  int max_obs;
+  bool remove_subsets;
+  bool greedy;
+  bool use_pht;
+  bool elong_query;
+  int beam;
+  long budget;
+  int seed_lo;                  /* The seeds to run are [seed_lo, seed_hi) */
+  int seed_hi;                  /* (positions in seeds if not NULL).       */
+  ivec* seeds;
+  mht_timing counts;            /* Totals over all of the seeds run. */
+
+  /* Work distribution (only used by the threaded version). */
+  int num_blocks;
+  int next_block;
+  track_array** block_res;
+#ifdef USE_PTHREADS
+  pthread_mutex_t lock;
+#endif
+} mht_seed_job;
+
+
+/* Run seeds [lo, hi) and add every result tracklet with at least */
+/* min_size observations to res (in seed order).  The number of    */
+/* search counters are added to counts.                            */
+void mht_seed_range(mht_seed_job* job, int lo, int hi, track_array* res,
+                    mht_timing* counts) {
+  track_array* subres;
+  track* T;
+  int s, i, j;
+
+  for(s=lo;s<hi;s++) {
+    i = (job->seeds != NULL) ? ivec_ref(job->seeds,s) : s;
+    if (!job->use_pht) {
+      subres = mk_tracklets_single_query(job->arr, job->st, i,
+                                         job->tr, job->fr,
+                                         job->minv,
+                                         job->maxv, job->thresh, job->maxt,
+                                         job->angle, job->length,
+                                         job->exp_time, job->athresh,
+                                         job->maxLerr, job->etime,
+                                         job->remove_subsets, job->max_obs,
+                                         job->greedy, job->elong_query,
+                                         job->beam, job->budget, counts);
     } else {
-      subres = mk_tracklets_single_query_PHT(arr, i, tr,  minv, maxv, thresh,
-                                             maxt, angle, length, exp_time,
-                                             athresh, maxLerr, etime,
-                                             remove_subsets, max_obs, min_size,
-                                             greedy);
+      subres = mk_tracklets_single_query_PHT(job->arr, job->st, i,
+                                             job->tr, job->fr,
+                                             job->minv,
+                                             job->maxv, job->thresh,
+                                             job->maxt, job->angle,
+                                             job->length, job->exp_time,
+                                             job->athresh, job->maxLerr,
+                                             job->etime, job->remove_subsets,
+                                             job->max_obs, job->min_size,
+                                             job->greedy, counts);
     }
 
     for(j=0;j<track_array_size(subres);j++) {
       T = track_array_ref(subres,j);
-      if(track_num_obs(T) >= min_size) {
+      if(track_num_obs(T) >= job->min_size) {
         track_array_add(res,T);
       }
     }
    
     free_track_array(subres);
   }
+}
+
+
+#ifdef USE_PTHREADS
+
+/* Worker: repeatedly grab the next unclaimed block of seeds and */
+/* fill that block's own result array.                           */
+void* mht_seed_worker(void* arg) {
+  mht_seed_job* job = (mht_seed_job*)arg;
+  track_array* res;
+  mht_timing counts;
+  int block;
+
+  mht_timing_init(&counts);
+
+  while(TRUE) {
+    pthread_mutex_lock(&job->lock);
+    block = job->next_block;
+    job->next_block += 1;
+    pthread_mutex_unlock(&job->lock);
+
+    if(block >= job->num_blocks) { break; }
+
+    res = mk_empty_track_array(10);
+    mht_seed_range(job, job->seed_lo + block * MHT_SEED_BLOCK,
+                   int_min(job->seed_hi,
+                           job->seed_lo + (block+1) * MHT_SEED_BLOCK), res,
+                   &counts);
+    job->block_res[block] = res;
+  }
+
+  pthread_mutex_lock(&job->lock);
+  mht_timing_add_counts(&job->counts, &counts);
+  pthread_mutex_unlock(&job->lock);
+
+  return NULL;
+}
+
+#endif
+
+
+/* Run all of the seeds, splitting them over "threads" workers.  The */
+/* per-block results are merged in seed order so the output does not */
+/* depend on the number of threads.                                  */
+void mht_run_seeds(mht_seed_job* job, int threads, track_array* res) {
+#ifdef USE_PTHREADS
+  int N = job->seed_hi - job->seed_lo;
+  int b;
+
+  job->num_blocks = (N + MHT_SEED_BLOCK - 1) / MHT_SEED_BLOCK;
+  if(threads > job->num_blocks) { threads = job->num_blocks; }
+
+  if(threads > 1) {
+    job->next_block = 0;
+    job->block_res  = AM_MALLOC_ARRAY(track_array*, job->num_blocks);
+    for(b=0;b<job->num_blocks;b++) { job->block_res[b] = NULL; }
+    pthread_mutex_init(&job->lock, NULL);
+    run_worker_threads(mht_seed_worker, job, threads);
+    pthread_mutex_destroy(&job->lock);
+
+    for(b=0;b<job->num_blocks;b++) {
+      track_array_add_all(res, job->block_res[b]);
+      free_track_array(job->block_res[b]);
+    }
+    AM_FREE_ARRAY(job->block_res, track_array*, job->num_blocks);
+    job->block_res = NULL;
+
+    return;
+  }
+#else
+  if(threads > 1) {
+    printf("WARNING: Compiled without thread support (thread=1). "
+           "Running the seeds serially.\n");
+  }
+#endif
+
+  mht_seed_range(job, job->seed_lo, job->seed_hi, res,
+                 &job->counts);
+}
+
+
+double mht_wall_seconds(void) {
+  struct timeval tv;
+
+  gettimeofday(&tv, NULL);
+  return (double)tv.tv_sec + 1e-6 * (double)tv.tv_usec;
+}
+
+
+/* Run the seeds [seed_lo, seed_hi), or the seeds at those positions */
+/* of the list seeds (if not NULL), as for mk_tracklets_MHT_seeds.    */
+track_array* mk_tracklets_MHT_seed_list(simple_obs_array* arr, ivec* seeds,
+                                        int seed_lo, int seed_hi,
+                                        double minv, double maxv,
+                                        double thresh, double maxt,
+                                        int min_size, bool remove_subsets,
+                                        dyv* angle, dyv* length,
+                                        dyv* exp_time, double athresh,
+                                        double maxLerr, double etime,
+                                        int max_obs, bool greedy,
+                                        bool use_pht, bool elong_query,
+                                        int beam, long budget, int threads,
+                                        double plate_width,
+                                        mht_timing* timing) {
+  track_array* res = mk_empty_track_array(10);
+  mht_seed_job job;
+  rdt_tree*   tr = NULL;
+  rdt_forest* fr = NULL;
+  obs_store*  st;
+  double t_start = mht_wall_seconds();
+  double t_built;
+
+  /* Copy the detections into contiguous columns for the searches */
+  /* and create the RDT tree (or one tree per plate) over them.   */
+  st = mk_obs_store_from_simple_obs_array(arr);
+  if(plate_width > 0.0) {
+    fr = mk_rdt_forest_from_store(st,NULL,plate_width,RDT_MAX_LEAF_NODES);
+  } else {
+    tr = mk_rdt_tree_from_store(st,NULL,FALSE,RDT_MAX_LEAF_NODES);
+  }
+  t_built = mht_wall_seconds();
+
+  job.arr            = arr;
+  job.st             = st;
+  job.tr             = tr;
+  job.fr             = fr;
+  job.angle          = angle;
+  job.length         = length;
+  job.exp_time       = exp_time;
+  job.minv           = minv;
+  job.maxv           = maxv;
+  job.thresh         = thresh;
+  job.maxt           = maxt;
+  job.athresh        = athresh;
+  job.maxLerr        = maxLerr;
+  job.etime          = etime;
+  job.min_size       = min_size;
+  job.max_obs        = max_obs;
+  job.remove_subsets = remove_subsets;
+  job.greedy         = greedy;
+  job.use_pht        = use_pht;
+  job.elong_query    = elong_query;
+  job.beam           = (beam > 0) ? beam : 0;
+  job.budget         = (budget > 0) ? budget : 0;
+  job.seed_lo        = seed_lo;
+  job.seed_hi        = seed_hi;
+  job.seeds          = seeds;
+  mht_timing_init(&job.counts);
+  job.num_blocks     = 0;
+  job.next_block     = 0;
+  job.block_res      = NULL;
+
+  mht_run_seeds(&job, threads, res);
+
+  if(tr != NULL) { free_rdt_tree(tr); }
+  if(fr != NULL) { free_rdt_forest(fr); }
+  free_obs_store(st);
+
+  if(timing != NULL) {
+    timing->build  += t_built - t_start;
+    timing->search += mht_wall_seconds() - t_built;
+    mht_timing_add_counts(timing, &job.counts);
+  }
+  
+  return res;
+}
+
+
+track_array* mk_tracklets_MHT_seeds_timed(simple_obs_array* arr,
+                                          int seed_lo, int seed_hi,
+                                          double minv, double maxv,
+                                          double thresh, double maxt,
+                                          int min_size, bool remove_subsets,
+                                          dyv* angle, dyv* length,
+                                          dyv* exp_time, double athresh,
+                                          double maxLerr, double etime,
+                                          int max_obs, bool greedy,
+                                          bool use_pht, bool elong_query,
+                                          int beam, long budget, int threads,
+                                          double plate_width,
+                                          mht_timing* timing) {
+  return mk_tracklets_MHT_seed_list(arr, NULL, seed_lo, seed_hi, minv, maxv,
+                                    thresh, maxt, min_size, remove_subsets,
+                                    angle, length, exp_time, athresh,
+                                    maxLerr, etime, max_obs, greedy,
+                                    use_pht, elong_query, beam, budget,
+                                    threads, plate_width, timing);
+}
+
+
+track_array* mk_tracklets_MHT_timed(simple_obs_array* arr, double minv,
+                                    double maxv, double thresh, double maxt,
+                                    int min_size, bool remove_subsets,
+                                    dyv* angle, dyv* length, dyv* exp_time,
+                                    double athresh, double maxLerr,
+                                    double etime, int max_obs, bool greedy,
+                                    bool use_pht, bool elong_query,
+                                    int beam, long budget, int threads,
+                                    double plate_width, mht_timing* timing) {
+  track_array* res;
+  track_array* subres;
+  double t_start;
+
+  res = mk_tracklets_MHT_seeds_timed(arr, 0, simple_obs_array_size(arr),
+                                     minv, maxv, thresh, maxt, min_size,
+                                     remove_subsets, angle, length, exp_time,
+                                     athresh, maxLerr, etime, max_obs, greedy,
+                                     use_pht, elong_query, beam, budget,
+                                     threads, plate_width, timing);
 
   if(remove_subsets) {
+    t_start = mht_wall_seconds();
     subres = mk_tracklet_remove_subsets(res,arr);
     free_track_array(res);
     res = subres;
+    if(timing != NULL) {
+      timing->subsets += mht_wall_seconds() - t_start;
+    }
   }
 
-  free_rdt_tree(tr);
-  
   return res;
 }
 
 
-/* --- Functions for removing overlaps ----------------------------- */
+track_array* mk_tracklets_MHT(simple_obs_array* arr, double minv, double maxv,
+                              double thresh, double maxt, int min_size,
+                              bool remove_subsets,
+                              dyv* angle, dyv* length, dyv* exp_time,
+                              double athresh, double maxLerr, double etime,
+                              int max_obs, bool greedy, bool use_pht,
+                              bool elong_query, int beam, long budget,
+                              int threads, double plate_width) {
+  return mk_tracklets_MHT_timed(arr, minv, maxv, thresh, maxt, min_size,
+                                remove_subsets, angle, length, exp_time,
+                                athresh, maxLerr, etime, max_obs, greedy,
+                                use_pht, elong_query, beam, budget, threads,
+                                plate_width, NULL);
+}
 
-track_array* mk_tracklet_remove_subsets(track_array* old, simple_obs_array* obs) {
+
+track_array* mk_tracklets_MHT_seeds(simple_obs_array* arr,
+                                    int seed_lo, int seed_hi,
+                                    double minv, double maxv,
+                                    double thresh, double maxt, int min_size,
+                                    bool remove_subsets,
+                                    dyv* angle, dyv* length, dyv* exp_time,
+                                    double athresh, double maxLerr,
+                                    double etime, int max_obs, bool greedy,
+                                    bool use_pht, bool elong_query,
+                                    int beam, long budget, int threads,
+                                    double plate_width) {
+  return mk_tracklets_MHT_seeds_timed(arr, seed_lo, seed_hi, minv, maxv,
+                                      thresh, maxt, min_size, remove_subsets,
+                                      angle, length, exp_time, athresh,
+                                      maxLerr, etime, max_obs, greedy,
+                                      use_pht, elong_query, beam, budget,
+                                      threads, plate_width, NULL);
+}
+
+
+/* --------------------------------------------------------------------- */
+/* --- Sky Tiles ------------------------------------------------------- */
+/* --------------------------------------------------------------------- */
+
+dyv* mk_tracklets_seed_reach(simple_obs_array* arr, double minv,
+                             double maxv, double thresh, double maxt,
+                             dyv* length, dyv* exp_time, double maxLerr,
+                             double etime) {
+  int N = simple_obs_array_size(arr);
+  dyv* res = mk_dyv(N);
+  double lo, hi;
+  int i;
+
+  /* Every endpoint is within hi * dt + thresh of the seed (see the */
+  /* moving point query) and every later detection of a tracklet is */
+  /* one of the endpoints.                                          */
+  for(i=0;i<N;i++) {
+    mht_seed_speed_bounds(i, length, exp_time, minv, maxv, maxLerr, etime,
+                          &lo, &hi);
+    dyv_set(res,i,hi * maxt + thresh);
+  }
+
+  return res;
+}
+
+
+sky_tiles* mk_tracklets_sky_tiles(simple_obs_array* arr, double width,
+                                  double minv, double maxv, double thresh,
+                                  double maxt, dyv* length, dyv* exp_time,
+                                  double maxLerr, double etime) {
+  sky_tiles* res;
+  dyv* reach;
+
+  reach = mk_tracklets_seed_reach(arr, minv, maxv, thresh, maxt, length,
+                                  exp_time, maxLerr, etime);
+  res   = mk_sky_tiles(arr, reach, width);
+  free_dyv(reach);
+
+  return res;
+}
+
+
+/* The per-detection values x of the detections rows (NULL if x is */
+/* NULL).  Rows past the end of x get -1 (unknown).                */
+dyv* mk_tracklets_tile_dyv(dyv* x, ivec* rows) {
+  dyv* res;
+  int i, r;
+
+  if(x == NULL) { return NULL; }
+
+  res = mk_dyv(ivec_size(rows));
+  for(i=0;i<ivec_size(rows);i++) {
+    r = ivec_ref(rows,i);
+    dyv_set(res,i,(r < dyv_size(x)) ? dyv_ref(x,r) : -1.0);
+  }
+
+  return res;
+}
+
+
+track_array* mk_tracklets_MHT_tile_timed(simple_obs_array* arr,
+                                         sky_tiles* tiles, int k,
+                                         double minv, double maxv,
+                                         double thresh, double maxt,
+                                         int min_size, bool remove_subsets,
+                                         dyv* angle, dyv* length,
+                                         dyv* exp_time, double athresh,
+                                         double maxLerr, double etime,
+                                         int max_obs, bool greedy,
+                                         bool use_pht, bool elong_query,
+                                         int beam, long budget, int threads,
+                                         double plate_width,
+                                         mht_timing* timing) {
+  ivec* mem  = sky_tiles_members(tiles,k);
+  ivec* core = sky_tiles_core(tiles,k);
+  simple_obs_array* sub;
   track_array* res;
-  track *X;
-  ivec_array*  occur;
-  ivec* sizes;
+  dyv* sub_angle;
+  dyv* sub_length;
+  dyv* sub_exp_time;
+  ivec* seeds;
   ivec* inds;
-  ivec* hit;
-  int N = track_array_size(old);
-  int i;
+  int i, j;
+
+  /* Find the positions of the seeds among the members (both sorted). */
+  seeds = mk_ivec(ivec_size(core));
+  j = 0;
+  for(i=0;i<ivec_size(core);i++) {
+    while(ivec_ref(mem,j) < ivec_ref(core,i)) { j++; }
+    ivec_set(seeds,i,j);
+  }
+
+  sub          = mk_simple_obs_array_subset(arr,mem);
+  sub_angle    = mk_tracklets_tile_dyv(angle,mem);
+  sub_length   = mk_tracklets_tile_dyv(length,mem);
+  sub_exp_time = mk_tracklets_tile_dyv(exp_time,mem);
+
+  res = mk_tracklets_MHT_seed_list(sub, seeds, 0, ivec_size(seeds), minv,
+                                   maxv, thresh, maxt, min_size,
+                                   remove_subsets, sub_angle, sub_length,
+                                   sub_exp_time, athresh, maxLerr, etime,
+                                   max_obs, greedy, use_pht, elong_query,
+                                   beam, budget, threads, plate_width,
+                                   timing);
+
+  /* Map the tracklets back to the whole field.  The members are in */
+  /* index order so each tracklet keeps its order.                  */
+  for(i=0;i<track_array_size(res);i++) {
+    inds = track_individs(track_array_ref(res,i));
+    for(j=0;j<ivec_size(inds);j++) {
+      ivec_set(inds,j,ivec_ref(mem,ivec_ref(inds,j)));
+    }
+  }
+
+  free_simple_obs_array(sub);
+  if(sub_angle != NULL) { free_dyv(sub_angle); }
+  if(sub_length != NULL) { free_dyv(sub_length); }
+  if(sub_exp_time != NULL) { free_dyv(sub_exp_time); }
+  free_ivec(seeds);
+
+  return res;
+}
+
 
-  /* Allocate space */
-  occur = mk_array_of_zero_length_ivecs(simple_obs_array_size(obs));
-  res   = mk_empty_track_array(N);
-  sizes = mk_zero_ivec(N);
+track_array* mk_tracklets_in_seed_order(track_array* cands, int num_obs) {
+  int N = track_array_size(cands);
+  track_array* res = mk_empty_track_array(int_max(N,1));
+  ivec* next = mk_zero_ivec(num_obs + 1);
+  ivec* order = mk_ivec(N);
+  int i, s;
 
-  /* Compute the sizes for all of the tracks. */
+  /* A counting sort on the seed (the first detection), which keeps */
+  /* the order of the candidates from each seed.                    */
   for(i=0;i<N;i++) {
-    ivec_set(sizes,i,track_num_obs(track_array_ref(old,i)));
+    s = ivec_ref(track_individs(track_array_ref(cands,i)),0);
+    ivec_increment(next,s+1,1);
+  }
+  for(s=1;s<=num_obs;s++) {
+    ivec_increment(next,s,ivec_ref(next,s-1));
+  }
+  for(i=0;i<N;i++) {
+    s = ivec_ref(track_individs(track_array_ref(cands,i)),0);
+    ivec_set(order,ivec_ref(next,s),i);
+    ivec_increment(next,s,1);
   }
-  inds = mk_indices_of_sorted_ivec(sizes);
 
-  /* Put tracks in the result largest to smallest */
   for(i=0;i<N;i++) {
-    X   = track_array_ref(old,ivec_ref(inds,N-i-1));
-    hit = mk_tracklet_subset_query(occur,track_individs(X));
+    track_array_add(res,track_array_ref(cands,ivec_ref(order,i)));
+  }
+
+  free_ivec(next);
+  free_ivec(order);
+
+  return res;
+}
+
+
+/* The tiles to search and the parameters for the searches.  Each   */
+/* worker claims a whole tile and fills that tile's own result array. */
+typedef struct mht_tile_job {
+  mht_seed_job P;               /* Only the detections and parameters. */
+  sky_tiles* tiles;
+  double plate_width;
+  int threads;                  /* Seed threads within each tile.      */
+  int next_tile;
+  track_array** tile_res;
+  mht_timing* tile_timing;      /* Only the search counters are used.  */
+#ifdef USE_PTHREADS
+  pthread_mutex_t lock;
+#endif
+} mht_tile_job;
+
+
+void mht_run_tile(mht_tile_job* job, int k) {
+  mht_seed_job* P = &(job->P);
+
+  job->tile_res[k] = mk_tracklets_MHT_tile_timed(P->arr, job->tiles, k,
+                                                 P->minv, P->maxv,
+                                                 P->thresh, P->maxt,
+                                                 P->min_size,
+                                                 P->remove_subsets,
+                                                 P->angle, P->length,
+                                                 P->exp_time, P->athresh,
+                                                 P->maxLerr, P->etime,
+                                                 P->max_obs, P->greedy,
+                                                 P->use_pht, P->elong_query,
+                                                 P->beam, P->budget,
+                                                 job->threads,
+                                                 job->plate_width,
+                                                 &(job->tile_timing[k]));
+}
+
+
+void* mht_tile_worker(void* arg) {
+  mht_tile_job* job = (mht_tile_job*)arg;
+  int k;
 
-    if(ivec_size(hit) == 0) {
-      track_array_add(res,X);
-      tracklet_add_to_overlap_array(occur, track_individs(X), track_array_size(res)-1);
+  while(TRUE) {
+#ifdef USE_PTHREADS
+    pthread_mutex_lock(&job->lock);
+#endif
+    k = job->next_tile;
+    job->next_tile += 1;
+#ifdef USE_PTHREADS
+    pthread_mutex_unlock(&job->lock);
+#endif
+
+    if(k >= sky_tiles_num_tiles(job->tiles)) { break; }
+    mht_run_tile(job, k);
+  }
+
+  return NULL;
+}
+
+
+track_array* mk_tracklets_MHT_tiled_timed(simple_obs_array* arr,
+                                          sky_tiles* tiles,
+                                          double minv, double maxv,
+                                          double thresh, double maxt,
+                                          int min_size, bool remove_subsets,
+                                          dyv* angle, dyv* length,
+                                          dyv* exp_time, double athresh,
+                                          double maxLerr, double etime,
+                                          int max_obs, bool greedy,
+                                          bool use_pht, bool elong_query,
+                                          int beam, long budget, int threads,
+                                          double plate_width,
+                                          mht_timing* timing) {
+  int T = sky_tiles_num_tiles(tiles);
+  int tile_threads = int_max(1,int_min(threads,T));
+  track_array* all;
+  track_array* res;
+  track_array* subres;
+  mht_tile_job job;
+  double t_start = mht_wall_seconds();
+  double t_merge;
+  int k;
+
+  job.P.arr            = arr;
+  job.P.angle          = angle;
+  job.P.length         = length;
+  job.P.exp_time       = exp_time;
+  job.P.minv           = minv;
+  job.P.maxv           = maxv;
+  job.P.thresh         = thresh;
+  job.P.maxt           = maxt;
+  job.P.athresh        = athresh;
+  job.P.maxLerr        = maxLerr;
+  job.P.etime          = etime;
+  job.P.min_size       = min_size;
+  job.P.max_obs        = max_obs;
+  job.P.remove_subsets = remove_subsets;
+  job.P.greedy         = greedy;
+  job.P.use_pht        = use_pht;
+  job.P.elong_query    = elong_query;
+  job.P.beam           = beam;
+  job.P.budget         = budget;
+  job.tiles            = tiles;
+  job.plate_width      = plate_width;
+  job.threads          = int_max(1,threads / tile_threads);
+  job.next_tile        = 0;
+  job.tile_res         = AM_MALLOC_ARRAY(track_array*, int_max(T,1));
+  job.tile_timing      = AM_MALLOC_ARRAY(mht_timing, int_max(T,1));
+  for(k=0;k<T;k++) {
+    mht_timing_init(&(job.tile_timing[k]));
+  }
+
+#ifdef USE_PTHREADS
+  pthread_mutex_init(&job.lock, NULL);
+#else
+  if(threads > 1) {
+    printf("WARNING: Compiled without thread support (thread=1). "
+           "Running the tiles serially.\n");
+  }
+  job.threads = 1;
+#endif
+  run_worker_threads(mht_tile_worker, &job, tile_threads);
+#ifdef USE_PTHREADS
+  pthread_mutex_destroy(&job.lock);
+#endif
+
+  /* Put the candidates back in seed order, which is the order the */
+  /* untiled search produces them in.  Every seed belongs to just  */
+  /* one tile so no candidate is seen twice.                       */
+  t_merge = mht_wall_seconds();
+  all = mk_empty_track_array(10);
+  for(k=0;k<T;k++) {
+    track_array_add_all(all,job.tile_res[k]);
+    free_track_array(job.tile_res[k]);
+    if(timing != NULL) {
+      mht_timing_add_counts(timing, &(job.tile_timing[k]));
     }
+  }
+  AM_FREE_ARRAY(job.tile_res, track_array*, int_max(T,1));
+  AM_FREE_ARRAY(job.tile_timing, mht_timing, int_max(T,1));
+
+  res = mk_tracklets_in_seed_order(all,simple_obs_array_size(arr));
+  free_track_array(all);
 
-    free_ivec(hit);
+  if(remove_subsets) {
+    subres = mk_tracklet_remove_subsets(res,arr);
+    free_track_array(res);
+    res = subres;
   }
 
-  free_ivec_array(occur);
-  free_ivec(sizes);
-  free_ivec(inds);
+  if(timing != NULL) {
+    timing->search  += t_merge - t_start;
+    timing->subsets += mht_wall_seconds() - t_merge;
+  }
 
   return res;
 }
 
 
-/* Given an ivec array of observation->tracks it is in  */
-/* AND the observations of a new track, determine which */
-/* tracks the new track is a subset of.                 */
-ivec* mk_tracklet_subset_query(ivec_array* seen, ivec* pts) {
-  ivec* res;
-  ivec* occr;
-  ivec* temp;
-  int i;
+/* --------------------------------------------------------------------- */
+/* --- Parameter Sweeps ------------------------------------------------ */
+/* --------------------------------------------------------------------- */
+
+/* The shared state of a sweep.  As with mht_seed_job the index and the */
+/* observations are read only; each block of seeds has one result array */
+/* per setting.                                                          */
+typedef struct mht_sweep_job {
+  simple_obs_array* arr;
+  obs_store* st;
+  rdt_tree* tr;
+  rdt_forest* fr;
+  dyv* angle;
+  dyv* length;
+  dyv* exp_time;
+  mht_setting* settings;
+  int num_settings;
+  double etime;
+  int min_size;
+  int max_obs;
+  bool remove_subsets;
+  bool greedy;
+  bool use_pht;
+  bool elong_query;
+  int beam;
+  long budget;
+  int num_seeds;
+  mht_timing counts;
+
+  int num_blocks;
+  int next_block;
+  track_array*** block_res;     /* [block][setting] */
+#ifdef USE_PTHREADS
+  pthread_mutex_t lock;
+#endif
+} mht_sweep_job;
+
+
+/* Run setting k's own search from Xind over its endpoints (pairs) */
+/* and add the results with at least min_size observations to res. */
+void mht_sweep_setting_from_pairs(mht_sweep_job* job, int Xind, int k,
+                                  ivec* pairs, track_array* res,
+                                  mht_timing* counts) {
+  mht_setting* S = &(job->settings[k]);
+  track_array* subres;
+  int j;
+
+  if(job->use_pht) {
+    subres = mk_tracklets_PHT_from_pairs(job->arr, job->st, Xind, pairs,
+                                         S->thresh, job->remove_subsets,
+                                         job->max_obs, job->min_size,
+                                         job->greedy, counts);
+  } else {
+    subres = mk_tracklets_MHT_from_pairs(job->arr, job->st, Xind, pairs,
+                                         S->thresh, S->maxt, job->angle,
+                                         job->length, job->exp_time,
+                                         S->athresh, S->maxLerr,
+                                         job->etime, job->max_obs,
+                                         job->greedy, job->beam, job->budget,
+                                         counts);
+  }
+
+  for(j=0;j<track_array_size(subres);j++) {
+    if(track_num_obs(track_array_ref(subres,j)) >= job->min_size) {
+      track_array_add(res, track_array_ref(subres,j));
+    }
+  }
+  free_track_array(subres);
+}
+
+
+/* The MHT search from Xind for all of the settings k with share[k] */
+/* at once.  ord gives the positions of all_pairs in time order and */
+/* allowed[k*N+i] says whether setting k queried all_pairs[i].      */
+/*                                                                  */
+/* Each hypothesis carries the settings whose own search builds it: */
+/* all of its endpoints allowed, each prefix's fit under the        */
+/* setting's thresh and its span under the setting's maxt.  So it is */
+/* only built if at least one setting wants it.  Since the searches  */
+/* only ever append, each setting's hypotheses come out in the order */
+/* of its own search as long as its endpoints sort into the same     */
+/* order as they do here (mht_sweep_range checks this).             */
+void mht_sweep_seed_shared(mht_sweep_job* job, int Xind, ivec* all_pairs,
+                           ivec* ord, unsigned char* allowed,
+                           unsigned char* share, track_array** res,
+                           mht_timing* counts) {
+  int K = job->num_settings;
+  int N = ivec_size(all_pairs);
+  int max_hyps = 10;
+  track_array* hyps = mk_empty_track_array(10);
+  track_fit* fits = AM_MALLOC_ARRAY(track_fit, max_hyps);
+  unsigned char* masks = AM_MALLOC_ARRAY(unsigned char, max_hyps * K);
+  unsigned char* numask = AM_MALLOC_ARRAY(unsigned char, K);
+  mht_setting* S = job->settings;
+  obs_store* st = job->st;
+  track_fit nufit;
+  track_fit* old_fits;
+  unsigned char* old_masks;
+  track* A;
+  track* B;
+  ivec* inds;
+  long num_built = 1;
+  bool any, use_elong;
+  double maxt = 0.0;
+  double nuresid, tY, dt, vel, curr_etime;
+  int i, j, k, c, p, Yind, Nlast;
+
+  B = mk_track_single_ind(job->arr,Xind);
+  track_array_add(hyps,B);
+  free_track(B);
+  track_fit_init_store(&(fits[0]),st,Xind);
+  for(k=0;k<K;k++) {
+    masks[k] = share[k];
+    if(share[k] && (S[k].maxt > maxt)) { maxt = S[k].maxt; }
+  }
+
+  for(i=0;i<N;i++) {
+    p    = ivec_ref(ord,i);
+    Yind = ivec_ref(all_pairs,p);
+    tY   = obs_store_time(st,Yind);
+
+    Nlast = track_array_size(hyps);
+    for(j=0;j<Nlast;j++) {
+      A    = track_array_ref(hyps,j);
+      inds = track_individs(A);
+      dt   = tY - obs_store_time(st,ivec_ref(inds,0));
+      if((dt >= maxt) ||
+         (tY - obs_store_time(st,ivec_ref(inds,ivec_size(inds)-1)) <= 1e-5) ||
+         (track_num_obs(A) >= job->max_obs)) {
+        continue;
+      }
+
+      any = FALSE;
+      for(k=0;k<K;k++) {
+        numask[k] = masks[j*K+k] && allowed[k*N+p] && (dt < S[k].maxt);
+        any = any || numask[k];
+      }
+      if(!any) { continue; }
+
+      nufit = fits[j];
+      track_fit_add_store(&nufit,st,Yind);
+      if(nufit.N > 2) {
+        nuresid = track_fit_mean_residual_angle_store(&nufit,st,inds,Yind);
+        any = FALSE;
+        for(k=0;k<K;k++) {
+          numask[k] = numask[k] && (nuresid < S[k].thresh);
+          any = any || numask[k];
+        }
+        if(!any) { continue; }
+      }
+
+      B = mk_track_from_fit(&nufit,inds,Yind);
+      num_built++;
+      track_array_add(hyps,B);
+      free_track(B);
+
+      if(track_array_size(hyps) > max_hyps) {
+        old_fits  = fits;
+        old_masks = masks;
+        fits      = AM_MALLOC_ARRAY(track_fit, 2*max_hyps);
+        masks     = AM_MALLOC_ARRAY(unsigned char, 2*max_hyps*K);
+        for(c=0;c<max_hyps;c++)   { fits[c]  = old_fits[c]; }
+        for(c=0;c<max_hyps*K;c++) { masks[c] = old_masks[c]; }
+        AM_FREE_ARRAY(old_fits, track_fit, max_hyps);
+        AM_FREE_ARRAY(old_masks, unsigned char, max_hyps * K);
+        max_hyps = 2*max_hyps;
+      }
+      fits[track_array_size(hyps)-1] = nufit;
+      for(k=0;k<K;k++) { masks[(track_array_size(hyps)-1)*K+k] = numask[k]; }
+    }
+  }
+  counts->endpoints  += N;
+  counts->hypotheses += num_built;
+
+  /* Hand each hypothesis to the settings that built it and whose */
+  /* elongation filter (see mk_tracklets_MHT_from_pairs) keeps it. */
+  use_elong  = (job->length != NULL) && (job->angle != NULL);
+  curr_etime = mht_seed_etime(Xind, job->exp_time, job->etime);
+  for(j=0;j<track_array_size(hyps);j++) {
+    A = track_array_ref(hyps,j);
+    if(track_num_obs(A) < job->min_size) { continue; }
+
+    vel = use_elong ? linear_track_estimated_angular_vel(A) : 0.0;
+    for(k=0;k<K;k++) {
+      if(masks[j*K+k] &&
+         (!use_elong || mht_elong_compatible(job->arr, Xind, A, vel,
+                                             job->length, job->angle,
+                                             S[k].athresh, S[k].maxLerr,
+                                             curr_etime))) {
+        track_array_add(res[k],A);
+      }
+    }
+  }
+
+  free_track_array(hyps);
+  AM_FREE_ARRAY(fits, track_fit, max_hyps);
+  AM_FREE_ARRAY(masks, unsigned char, max_hyps * K);
+  AM_FREE_ARRAY(numask, unsigned char, K);
+}
+
+
+/* Run seeds [lo, hi) for every setting, adding the results of setting */
+/* k (with at least min_size observations) to res[k].                  */
+/*                                                                     */
+/* Each seed makes one endpoint query that covers all of the settings */
+/* and then marks the endpoints each setting's own query would return */
+/* (see rdt_moving_pt_store_allows).  Plain MHT searches share one     */
+/* hypothesis search; greedy, beam or budget limited and PHT searches  */
+/* depend on the whole set of hypotheses and so run per setting.       */
+void mht_sweep_range(mht_sweep_job* job, int lo, int hi, track_array** res,
+                     mht_timing* counts) {
+  int K = job->num_settings;
+  double* lo_v = AM_MALLOC_ARRAY(double, K);
+  double* hi_v = AM_MALLOC_ARRAY(double, K);
+  rdt_wedge* W = AM_MALLOC_ARRAY(rdt_wedge, K);
+  bool* use_W  = AM_MALLOC_ARRAY(bool, K);
+  unsigned char* share = AM_MALLOC_ARRAY(unsigned char, K);
+  unsigned char* allowed;
+  bool can_share = !job->use_pht && !job->greedy &&
+                   (job->beam == 0) && (job->budget == 0);
+  mht_setting* S;
+  ivec* all_pairs;
+  ivec* ord = NULL;
+  ivec* ord_k;
+  ivec* pairs;
+  ivec* pos;
+  dyv* times;
+  double env_lo, env_hi, env_thresh, env_maxt, t;
+  int s, k, i, j, N;
+
+  for(s=lo;s<hi;s++) {
+
+    /* The query for each setting and one query that covers them all. */
+    env_lo = 0.0; env_hi = 0.0; env_thresh = 0.0; env_maxt = 0.0;
+    for(k=0;k<K;k++) {
+      S = &(job->settings[k]);
+      mht_seed_query_bounds(s, job->angle, job->length, job->exp_time,
+                            S->minv, S->maxv, S->athresh, S->maxLerr,
+                            job->etime, S->thresh, S->maxt, job->max_obs,
+                            job->use_pht, job->greedy, job->elong_query,
+                            job->beam, job->budget, &lo_v[k], &hi_v[k],
+                            &W[k], &use_W[k]);
+      if((k == 0) || (lo_v[k] < env_lo))       { env_lo = lo_v[k]; }
+      if((k == 0) || (hi_v[k] > env_hi))       { env_hi = hi_v[k]; }
+      if((k == 0) || (S->thresh > env_thresh)) { env_thresh = S->thresh; }
+      if((k == 0) || (S->maxt > env_maxt))     { env_maxt = S->maxt; }
+    }
+    all_pairs = mk_tracklet_endpoint_query(job->tr, job->fr, job->st, s,
+                                           env_maxt, env_lo, env_hi,
+                                           env_thresh, NULL);
+    N = ivec_size(all_pairs);
+
+    t = obs_store_time(job->st, s);
+    allowed = AM_MALLOC_ARRAY(unsigned char, int_max(K*N,1));
+    for(k=0;k<K;k++) {
+      S = &(job->settings[k]);
+      for(j=0;j<N;j++) {
+        allowed[k*N+j] = rdt_moving_pt_store_allows(job->st, s,
+                                                    ivec_ref(all_pairs,j),
+                                                    t+1e-5, t+S->maxt,
+                                                    lo_v[k], hi_v[k],
+                                                    S->thresh,
+                                                    (use_W[k] ? &W[k] :
+                                                     NULL));
+      }
+    }
 
-  occr = ivec_array_ref(seen,ivec_ref(pts,0));
-  res  = mk_copy_ivec(occr);
-  for(i=1;i<ivec_size(pts);i++) {
-    occr = ivec_array_ref(seen,ivec_ref(pts,i));
-    temp = mk_sivec_intersection(occr,res);
+    if(can_share) {
+      times = mk_zero_dyv(N);
+      for(j=0;j<N;j++) {
+        dyv_set(times,j,obs_store_time(job->st,ivec_ref(all_pairs,j)));
+      }
+      ord = mk_ivec_sorted_dyv_indices(times);
+      free_dyv(times);
+    }
 
-    free_ivec(res);
-    res = temp;
+    for(k=0;k<K;k++) {
+
+      /* If none of setting k's endpoints share a time then any sort */
+      /* of them gives the shared order.                             */
+      if(can_share) {
+        share[k] = TRUE;
+        for(i=0,j=-1;(i<N)&&share[k];i++) {
+          if(allowed[k*N+ivec_ref(ord,i)]) {
+            share[k] = (j < 0) ||
+              (obs_store_time(job->st,ivec_ref(all_pairs,ivec_ref(ord,i))) !=
+               obs_store_time(job->st,ivec_ref(all_pairs,j)));
+            j = ivec_ref(ord,i);
+          }
+        }
+        if(share[k]) { continue; }
+      }
+
+      pairs = mk_ivec(0);
+      pos   = mk_ivec(0);
+      for(j=0;j<N;j++) {
+        if(allowed[k*N+j]) {
+          add_to_ivec(pairs, ivec_ref(all_pairs,j));
+          add_to_ivec(pos, j);
+        }
+      }
+
+      /* Otherwise setting k can share the search if its own sort */
+      /* of its endpoints agrees with the shared order.           */
+      share[k] = FALSE;
+      if(can_share) {
+        times = mk_zero_dyv(ivec_size(pairs));
+        for(j=0;j<ivec_size(pairs);j++) {
+          dyv_set(times,j,obs_store_time(job->st,ivec_ref(pairs,j)));
+        }
+        ord_k = mk_ivec_sorted_dyv_indices(times);
+        free_dyv(times);
+
+        share[k] = TRUE;
+        for(i=0,j=0;(i<N)&&share[k];i++) {
+          if(allowed[k*N+ivec_ref(ord,i)]) {
+            share[k] = (ivec_ref(pos,ivec_ref(ord_k,j)) == ivec_ref(ord,i));
+            j++;
+          }
+        }
+        free_ivec(ord_k);
+      }
+
+      if(!share[k]) {
+        mht_sweep_setting_from_pairs(job, s, k, pairs, res[k], counts);
+      }
+      free_ivec(pairs);
+      free_ivec(pos);
+    }
+
+    if(can_share) {
+      mht_sweep_seed_shared(job, s, all_pairs, ord, allowed, share, res,
+                            counts);
+      free_ivec(ord);
+    }
+
+    AM_FREE_ARRAY(allowed, unsigned char, int_max(K*N,1));
+    free_ivec(all_pairs);
+  }
+
+  AM_FREE_ARRAY(lo_v, double, K);
+  AM_FREE_ARRAY(hi_v, double, K);
+  AM_FREE_ARRAY(W, rdt_wedge, K);
+  AM_FREE_ARRAY(use_W, bool, K);
+  AM_FREE_ARRAY(share, unsigned char, K);
+}
+
+
+track_array** mk_empty_track_arrays(int K) {
+  track_array** res = AM_MALLOC_ARRAY(track_array*, K);
+  int k;
+
+  for(k=0;k<K;k++) {
+    res[k] = mk_empty_track_array(10);
   }
 
   return res;
 }
 
 
-/* Given an ivec array of observation->tracks it is in  */
-/* AND a new track, add the new track to the array.     */
-void tracklet_add_to_overlap_array(ivec_array* seen, ivec* pts, int index) {
-  ivec* occr;
+#ifdef USE_PTHREADS
+
+void* mht_sweep_worker(void* arg) {
+  mht_sweep_job* job = (mht_sweep_job*)arg;
+  track_array** res;
+  mht_timing counts;
+  int block;
+
+  mht_timing_init(&counts);
+
+  while(TRUE) {
+    pthread_mutex_lock(&job->lock);
+    block = job->next_block;
+    job->next_block += 1;
+    pthread_mutex_unlock(&job->lock);
+
+    if(block >= job->num_blocks) { break; }
+
+    res = mk_empty_track_arrays(job->num_settings);
+    mht_sweep_range(job, block * MHT_SEED_BLOCK,
+                    int_min(job->num_seeds, (block+1) * MHT_SEED_BLOCK),
+                    res, &counts);
+    job->block_res[block] = res;
+  }
+
+  pthread_mutex_lock(&job->lock);
+  mht_timing_add_counts(&job->counts, &counts);
+  pthread_mutex_unlock(&job->lock);
+
+  return NULL;
+}
+
+#endif
+
+
+track_array** mk_tracklets_MHT_sweep(simple_obs_array* arr,
+                                     mht_setting* settings,
+                                     int num_settings, int min_size,
+                                     bool remove_subsets,
+                                     dyv* angle, dyv* length, dyv* exp_time,
+                                     double etime, int max_obs, bool greedy,
+                                     bool use_pht, bool elong_query,
+                                     int beam, long budget, int threads,
+                                     double plate_width,
+                                     mht_timing* timing) {
+  track_array** res = mk_empty_track_arrays(num_settings);
+  track_array* subres;
+  mht_sweep_job job;
+  double t_start = mht_wall_seconds();
+  double t_built, t_searched;
+  int k;
+
+  job.arr = arr;
+  job.st  = mk_obs_store_from_simple_obs_array(arr);
+  job.tr  = NULL;
+  job.fr  = NULL;
+  if(plate_width > 0.0) {
+    job.fr = mk_rdt_forest_from_store(job.st,NULL,plate_width,
+                                      RDT_MAX_LEAF_NODES);
+  } else {
+    job.tr = mk_rdt_tree_from_store(job.st,NULL,FALSE,RDT_MAX_LEAF_NODES);
+  }
+  t_built = mht_wall_seconds();
+
+  job.angle          = angle;
+  job.length         = length;
+  job.exp_time       = exp_time;
+  job.settings       = settings;
+  job.num_settings   = num_settings;
+  job.etime          = etime;
+  job.min_size       = min_size;
+  job.max_obs        = max_obs;
+  job.remove_subsets = remove_subsets;
+  job.greedy         = greedy;
+  job.use_pht        = use_pht;
+  job.elong_query    = elong_query;
+  job.beam           = (beam > 0) ? beam : 0;
+  job.budget         = (budget > 0) ? budget : 0;
+  job.num_seeds      = simple_obs_array_size(arr);
+  mht_timing_init(&job.counts);
+  job.num_blocks     = (job.num_seeds + MHT_SEED_BLOCK - 1) / MHT_SEED_BLOCK;
+  job.next_block     = 0;
+  job.block_res      = NULL;
+
+#ifdef USE_PTHREADS
+  if(threads > job.num_blocks) { threads = job.num_blocks; }
+  if(threads > 1) {
+    int b;
+
+    job.block_res = AM_MALLOC_ARRAY(track_array**, job.num_blocks);
+    for(b=0;b<job.num_blocks;b++) { job.block_res[b] = NULL; }
+    pthread_mutex_init(&job.lock, NULL);
+    run_worker_threads(mht_sweep_worker, &job, threads);
+    pthread_mutex_destroy(&job.lock);
+
+    /* Merge the blocks in seed order, as mht_run_seeds does. */
+    for(b=0;b<job.num_blocks;b++) {
+      for(k=0;k<num_settings;k++) {
+        track_array_add_all(res[k], job.block_res[b][k]);
+        free_track_array(job.block_res[b][k]);
+      }
+      AM_FREE_ARRAY(job.block_res[b], track_array*, num_settings);
+    }
+    AM_FREE_ARRAY(job.block_res, track_array**, job.num_blocks);
+  } else {
+    mht_sweep_range(&job, 0, job.num_seeds, res, &job.counts);
+  }
+#else
+  if(threads > 1) {
+    printf("WARNING: Compiled without thread support (thread=1). "
+           "Running the seeds serially.\n");
+  }
+  mht_sweep_range(&job, 0, job.num_seeds, res, &job.counts);
+#endif
+  t_searched = mht_wall_seconds();
+
+  if(job.tr != NULL) { free_rdt_tree(job.tr); }
+  if(job.fr != NULL) { free_rdt_forest(job.fr); }
+  free_obs_store(job.st);
+
+  if(remove_subsets) {
+    for(k=0;k<num_settings;k++) {
+      subres = mk_tracklet_remove_subsets(res[k],arr);
+      free_track_array(res[k]);
+      res[k] = subres;
+    }
+  }
+
+  if(timing != NULL) {
+    timing->build   += t_built - t_start;
+    timing->search  += t_searched - t_built;
+    timing->subsets += mht_wall_seconds() - t_searched;
+    mht_timing_add_counts(timing, &job.counts);
+  }
+
+  return res;
+}
+
+
+/* --- Functions for removing overlaps ----------------------------- */
+
+/* Subset and duplicate removal is shared with linkTracklets, */
+/* see track_index.h.                                         */
+track_array* mk_tracklet_remove_subsets(track_array* old, simple_obs_array* obs) {
+  return mk_track_array_remove_subsets(old,obs);
+}
+
+
+/* --- Great circle residuals -------------------------------------- */
+
+/* The number of tracklets gathered at a time for the batched fits. */
+#define MHT_GCR_CHUNK (64 * GCF_BATCH)
+
+dyv* mk_tracklets_gc_rms(simple_obs_array* obs, track_array* tracklets) {
+  int N = track_array_size(tracklets);
+  dyv* res = mk_dyv(N);
+  simple_obs* X;
+  ivec* inds;
+  double* mjd;
+  double* ra;
+  double* dec;
+  double* rms;
+  int* nobs;
+  int size, max_obs, c0, nc, i, j;
+
+  for(c0=0;c0<N;c0+=MHT_GCR_CHUNK) {
+    nc = int_min(MHT_GCR_CHUNK, N - c0);
+
+    max_obs = 1;
+    for(i=0;i<nc;i++) {
+      max_obs = int_max(max_obs, track_num_obs(track_array_ref(tracklets,c0+i)));
+    }
+
+    /* Gather the chunk as [detection][tracklet] columns. */
+    size = max_obs * nc;
+    mjd  = AM_MALLOC_ARRAY(double, size);
+    ra   = AM_MALLOC_ARRAY(double, size);
+    dec  = AM_MALLOC_ARRAY(double, size);
+    rms  = AM_MALLOC_ARRAY(double, nc);
+    nobs = AM_MALLOC_ARRAY(int, nc);
+    for(i=0;i<nc;i++) {
+      inds    = track_individs(track_array_ref(tracklets,c0+i));
+      nobs[i] = ivec_size(inds);
+      for(j=0;j<nobs[i];j++) {
+        X = simple_obs_array_ref(obs, ivec_ref(inds,j));
+        mjd[j*nc+i] = simple_obs_time(X);
+        ra[j*nc+i]  = simple_obs_RA_rad(X);
+        dec[j*nc+i] = simple_obs_DEC_rad(X);
+      }
+    }
+
+    gcRmsBatch(nc, nc, nobs, mjd, ra, dec, rms);
+    for(i=0;i<nc;i++) {
+      dyv_set(res, c0+i, rms[i]);
+    }
+
+    AM_FREE_ARRAY(mjd, double, size);
+    AM_FREE_ARRAY(ra, double, size);
+    AM_FREE_ARRAY(dec, double, size);
+    AM_FREE_ARRAY(rms, double, nc);
+    AM_FREE_ARRAY(nobs, int, nc);
+  }
+
+  return res;
+}
+
+
+track_array* mk_tracklets_filter_gc_rms(track_array* tracklets, dyv* rms,
+                                        double max_rms, dyv** new_rms) {
+  int N = track_array_size(tracklets);
+  track_array* res = mk_empty_track_array(int_max(N,1));
+  dyv* kept = mk_dyv(0);
   int i;
 
-  for(i=0;i<ivec_size(pts);i++) {
-    occr = ivec_array_ref(seen,ivec_ref(pts,i));
-    add_to_sivec(occr,index);
+  for(i=0;i<N;i++) {
+    if(dyv_ref(rms,i) <= max_rms) {
+      track_array_add(res, track_array_ref(tracklets,i));
+      add_to_dyv(kept, dyv_ref(rms,i));
+    }
   }
+
+  if(new_rms != NULL) {
+    new_rms[0] = kept;
+  } else {
+    free_dyv(kept);
+  }
+
+  return res;
 }
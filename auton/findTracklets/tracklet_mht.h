@@ -26,13 +26,194 @@ along with this program.  If not, see <http://www.lsstcorp.org/LegalNotices/>.
 
 #include "track.h"
 #include "rdt_tree.h"
+#include "track_index.h"
+#include "gcf.h"
+#include "sky_tiles.h"
 
+/* elong_query - Use a fast moving seed's trail angle to restrict the */
+/*           endpoint query to the directions that the elongation     */
+/*           post filter could keep.  Only applies to plain (not PHT, */
+/*           greedy, beam or budget limited) searches with maxt <=    */
+/*           0.1 days, where it only changes the work done and not    */
+/*           the tracklets found.                                     */
+/* beam, budget - Bound the MHT search from each starting detection   */
+/*           (0, 0: unbounded).  With beam > 0 only the beam best     */
+/*           hypotheses of each length (of three or more detections)  */
+/*           are kept after each endpoint is tried, ranked by their   */
+/*           mean fit residual.  With budget > 0 a search stops once  */
+/*           it has built budget hypotheses.  Either can lose         */
+/*           tracklets; the pruned and truncated counters of          */
+/*           mht_timing say how often they applied.                   */
+/* threads - The number of worker threads used for the seed loop.      */
+/*           Workers share the (read only) tree and the results do not */
+/*           depend on the thread count.  Requires thread=1 at build   */
+/*           time, otherwise the seeds are always run serially.        */
+/* plate_width - If > 0.0, index the detections with one tree per plate */
+/*           (exposure), grouping detections within plate_width days,   */
+/*           and only search the plates inside each query's time        */
+/*           window.  Otherwise a single tree over all times is used.   */
 track_array* mk_tracklets_MHT(simple_obs_array* arr, double minv, double maxv,
                               double thresh, double maxt, int min_size,
                               bool remove_subsets,
                               dyv* angle, dyv* length, dyv* exp_time,
                               double athresh, double maxLerr, double etime,
-                              int max_obs, bool greedy, bool pht);
+                              int max_obs, bool greedy, bool pht,
+                              bool elong_query, int beam, long budget,
+                              int threads, double plate_width);
+
+/* Run only the seeds [seed_lo, seed_hi) of arr (still searching all */
+/* of arr for their matches) and return every candidate tracklet in */
+/* seed order, WITHOUT the global subset removal pass.  The other   */
+/* parameters are as for mk_tracklets_MHT.                          */
+track_array* mk_tracklets_MHT_seeds(simple_obs_array* arr,
+                                    int seed_lo, int seed_hi,
+                                    double minv, double maxv,
+                                    double thresh, double maxt, int min_size,
+                                    bool remove_subsets,
+                                    dyv* angle, dyv* length, dyv* exp_time,
+                                    double athresh, double maxLerr,
+                                    double etime, int max_obs, bool greedy,
+                                    bool use_pht, bool elong_query,
+                                    int beam, long budget, int threads,
+                                    double plate_width);
+
+
+/* Wall clock seconds spent in each phase of a search.  The *_timed */
+/* versions ADD to the fields (so one struct can sum several runs). */
+typedef struct mht_timing {
+  double build;     /* Copying the detections and building the tree(s). */
+  double search;    /* The per-detection queries (the seed loop).        */
+  double subsets;   /* The global subset/duplicate removal.              */
+  long endpoints;   /* Candidate second endpoints returned by the index. */
+  long hypotheses;  /* Partial tracklets built (MHT) or endpoints (PHT). */
+  long pruned;      /* Hypotheses dropped by the beam.                   */
+  long truncated;   /* Searches stopped by the budget.                   */
+} mht_timing;
+
+/* Set all of the fields to zero. */
+void mht_timing_init(mht_timing* T);
+
+/* Add the counters (not the times) of src to dst. */
+void mht_timing_add_counts(mht_timing* dst, mht_timing* src);
+
+/* The current wall clock time in seconds. */
+double mht_wall_seconds(void);
+
+/* As mk_tracklets_MHT and mk_tracklets_MHT_seeds, but also record */
+/* the time taken by each phase in timing (which may be NULL).     */
+track_array* mk_tracklets_MHT_timed(simple_obs_array* arr, double minv,
+                                    double maxv, double thresh, double maxt,
+                                    int min_size, bool remove_subsets,
+                                    dyv* angle, dyv* length, dyv* exp_time,
+                                    double athresh, double maxLerr,
+                                    double etime, int max_obs, bool greedy,
+                                    bool use_pht, bool elong_query,
+                                    int beam, long budget, int threads,
+                                    double plate_width, mht_timing* timing);
+
+track_array* mk_tracklets_MHT_seeds_timed(simple_obs_array* arr,
+                                          int seed_lo, int seed_hi,
+                                          double minv, double maxv,
+                                          double thresh, double maxt,
+                                          int min_size, bool remove_subsets,
+                                          dyv* angle, dyv* length,
+                                          dyv* exp_time, double athresh,
+                                          double maxLerr, double etime,
+                                          int max_obs, bool greedy,
+                                          bool use_pht, bool elong_query,
+                                          int beam, long budget, int threads,
+                                          double plate_width,
+                                          mht_timing* timing);
+
+
+/* --- Sky tiles -------------------------------------------------- */
+
+/* The largest angular distance (radians) that a search seeded at  */
+/* each detection can reach: its largest speed (see the elongation */
+/* bounds) times maxt, plus thresh.                                 */
+dyv* mk_tracklets_seed_reach(simple_obs_array* arr, double minv,
+                             double maxv, double thresh, double maxt,
+                             dyv* length, dyv* exp_time, double maxLerr,
+                             double etime);
+
+/* Tile the detections with tiles of width degrees (see sky_tiles.h) */
+/* with the overlaps given by mk_tracklets_seed_reach.               */
+sky_tiles* mk_tracklets_sky_tiles(simple_obs_array* arr, double width,
+                                  double minv, double maxv, double thresh,
+                                  double maxt, dyv* length, dyv* exp_time,
+                                  double maxLerr, double etime);
+
+/* Run the seeds of tile k, searching only the tile's members, and   */
+/* return the candidates (as for mk_tracklets_MHT_seeds) with their */
+/* indices in arr.                                                   */
+track_array* mk_tracklets_MHT_tile_timed(simple_obs_array* arr,
+                                         sky_tiles* tiles, int k,
+                                         double minv, double maxv,
+                                         double thresh, double maxt,
+                                         int min_size, bool remove_subsets,
+                                         dyv* angle, dyv* length,
+                                         dyv* exp_time, double athresh,
+                                         double maxLerr, double etime,
+                                         int max_obs, bool greedy,
+                                         bool use_pht, bool elong_query,
+                                         int beam, long budget, int threads,
+                                         double plate_width,
+                                         mht_timing* timing);
+
+/* A copy of the candidates sorted by seed (first detection), keeping */
+/* the order of the candidates from the same seed.  This puts the     */
+/* candidates of several tiles (or processes) into the same order as  */
+/* a single mk_tracklets_MHT_seeds over all of the detections.        */
+track_array* mk_tracklets_in_seed_order(track_array* cands, int num_obs);
+
+/* Search every tile (up to "threads" tiles at a time, splitting any  */
+/* spare threads over each tile's seeds), merge the candidates in     */
+/* seed order and then remove subsets.  The result is the same as     */
+/* mk_tracklets_MHT.  The timing's build is not used: the tiles build */
+/* their trees as part of the search.                                 */
+track_array* mk_tracklets_MHT_tiled_timed(simple_obs_array* arr,
+                                          sky_tiles* tiles,
+                                          double minv, double maxv,
+                                          double thresh, double maxt,
+                                          int min_size, bool remove_subsets,
+                                          dyv* angle, dyv* length,
+                                          dyv* exp_time, double athresh,
+                                          double maxLerr, double etime,
+                                          int max_obs, bool greedy,
+                                          bool use_pht, bool elong_query,
+                                          int beam, long budget, int threads,
+                                          double plate_width,
+                                          mht_timing* timing);
+
+
+/* --- Parameter sweeps -------------------------------------------- */
+
+/* One point of a parameter sweep (the same units as mk_tracklets_MHT). */
+typedef struct mht_setting {
+  double minv;
+  double maxv;
+  double thresh;
+  double maxt;
+  double athresh;
+  double maxLerr;
+} mht_setting;
+
+/* Run mk_tracklets_MHT once for each of the num_settings settings, */
+/* returning an array of num_settings results (free each one and    */
+/* then the array with AM_FREE_ARRAY).  The detections are indexed  */
+/* once and each seed makes a single endpoint query that covers all */
+/* of the settings; each setting then keeps only its own endpoints. */
+/* Every result is the same as a separate mk_tracklets_MHT run.     */
+track_array** mk_tracklets_MHT_sweep(simple_obs_array* arr,
+                                     mht_setting* settings,
+                                     int num_settings, int min_size,
+                                     bool remove_subsets,
+                                     dyv* angle, dyv* length, dyv* exp_time,
+                                     double etime, int max_obs, bool greedy,
+                                     bool use_pht, bool elong_query,
+                                     int beam, long budget, int threads,
+                                     double plate_width,
+                                     mht_timing* timing);
 
 
 /* --- Functions for removing overlaps ----------------------------- */
@@ -40,13 +221,17 @@ track_array* mk_tracklets_MHT(simple_obs_array* arr, double minv, double maxv,
 track_array* mk_tracklet_remove_subsets(track_array* old,
                                         simple_obs_array* obs);
 
-/* Given an ivec array of observation->tracks it is in  */
-/* AND the observations of a new track, determine which */
-/* tracks the new track is a subset of.                 */
-ivec* mk_tracklet_subset_query(ivec_array* seen, ivec* pts);
 
-/* Given an ivec array of observation->tracks it is in  */
-/* AND a new track, add the new track to the array.     */
-void tracklet_add_to_overlap_array(ivec_array* seen, ivec* pts, int index);
+/* --- Great circle residuals -------------------------------------- */
+
+/* The 2d rms great circle residual (in arcseconds) of each tracklet, */
+/* as from gcFit/gcRmsRes but computed in batches (see gcf.h).        */
+dyv* mk_tracklets_gc_rms(simple_obs_array* obs, track_array* tracklets);
+
+/* A copy of the tracklets whose rms (from mk_tracklets_gc_rms) is */
+/* at most max_rms.  Returns the remaining rms values in new_rms    */
+/* (if not NULL).                                                   */
+track_array* mk_tracklets_filter_gc_rms(track_array* tracklets, dyv* rms,
+                                        double max_rms, dyv** new_rms);
 
 #endif
@@ -23,6 +23,11 @@ Copyright 2004, The Auton Lab, CMU
 #include "MHT.h"
 #include "t_tree.h"
 #include "rdvv_tree.h"
+#include "worker_threads.h"
+
+#ifdef USE_PTHREADS
+#include <pthread.h>
+#endif
 
 extern int rdvv_count;
 
@@ -73,69 +78,12 @@ track_array* mk_order_tracks_by_trust(track_array* arr, simple_obs_array* obs) {
 }
 
 
-/* Given an ivec array of observation->tracks it is in  */
-/* AND the observations of a new track, determine which */
-/* tracks the new track intersects.                     */
-ivec* mk_MHT_overlap_query(ivec_array* seen, ivec* pts) {
-  ivec* res = mk_ivec(0);
-  ivec* occr;
-  ivec* temp;
-  int i;
-
-  for(i=0;i<ivec_size(pts);i++) {
-    occr = ivec_array_ref(seen,ivec_ref(pts,i));
-    temp = mk_sivec_union(occr,res);
-    
-    free_ivec(res);
-    res = temp;
-  }
-
-  return res;
-}
-
-
-/* Given an ivec array of observation->tracks it is in  */
-/* AND the observations of a new track, determine which */
-/* tracks the new track is a subset of.                 */
-ivec* mk_MHT_subset_query(ivec_array* seen, ivec* pts) {
-  ivec* res;
-  ivec* occr;
-  ivec* temp;
-  int i;
-
-  occr = ivec_array_ref(seen,ivec_ref(pts,0));
-  res  = mk_copy_ivec(occr);
-  for(i=1;i<ivec_size(pts);i++) {
-    occr = ivec_array_ref(seen,ivec_ref(pts,i));
-    temp = mk_sivec_intersection(occr,res);
-
-    free_ivec(res);
-    res = temp;
-  }
-
-  return res;
-}
-
-
-/* Given an ivec array of observation->tracks it is in  */
-/* AND a new track, add the new track to the array.     */
-void MHT_add_to_overlap_array(ivec_array* seen, ivec* pts, int index) {
-  ivec* occr;
-  int i;
-
-  for(i=0;i<ivec_size(pts);i++) {
-    occr = ivec_array_ref(seen,ivec_ref(pts,i));
-    add_to_sivec(occr,index);
-  }
-}
-
-
 track_array* mk_MHT_remove_overlaps(track_array* old, simple_obs_array* obs,
 				    bool allow_conflicts,
 				    double min_percentage_overlap) {
   track_array* sorted;
   track_array* res;
-  ivec_array*  occur;
+  track_index* occur;
   ivec* inds;
   track *A, *B, *C;
   int N = track_array_size(old);
@@ -144,7 +92,7 @@ track_array* mk_MHT_remove_overlaps(track_array* old, simple_obs_array* obs,
 
   /* Put the track array in "trusted" order and allocate space */
   sorted = mk_order_tracks_by_trust(old, obs);
-  occur  = mk_array_of_zero_length_ivecs(simple_obs_array_size(obs));
+  occur  = mk_empty_track_index(simple_obs_array_size(obs));
   res    = mk_empty_track_array(N);
 
   /* Put in tracks most trusted first and check if there is any overlaps */
@@ -152,7 +100,7 @@ track_array* mk_MHT_remove_overlaps(track_array* old, simple_obs_array* obs,
     found  = FALSE;
     subset = FALSE;
     A      = track_array_ref(old,i);
-    inds   = mk_MHT_overlap_query(occur,track_individs(A));
+    inds   = mk_track_index_overlap_query(occur,track_individs(A));
 
     for(j=0;j<ivec_size(inds);j++) {
       B = track_array_ref(res,ivec_ref(inds,j));
@@ -172,7 +120,7 @@ track_array* mk_MHT_remove_overlaps(track_array* old, simple_obs_array* obs,
 	C = mk_combined_track(A,B,obs);
 
         track_array_set(res,ivec_ref(inds,j),C);
-	MHT_add_to_overlap_array(occur, track_individs(C), ivec_ref(inds,j));
+	track_index_add(occur, track_individs(C), ivec_ref(inds,j));
 
 	free_track(C);
       }
@@ -181,13 +129,13 @@ track_array* mk_MHT_remove_overlaps(track_array* old, simple_obs_array* obs,
     /* If no valid overlaps where found... add the origional point. */
     if((found == FALSE)&&(subset==FALSE)) {
       track_array_add(res,A);
-      MHT_add_to_overlap_array(occur, track_individs(A), track_array_size(res)-1);
+      track_index_add(occur, track_individs(A), track_array_size(res)-1);
     }
 
     free_ivec(inds);
   }
 
-  free_ivec_array(occur);
+  free_track_index(occur);
   free_track_array(sorted);
 
   return res;
@@ -195,44 +143,7 @@ track_array* mk_MHT_remove_overlaps(track_array* old, simple_obs_array* obs,
 
 
 track_array* mk_MHT_remove_subsets(track_array* old, simple_obs_array* obs) {
-  track_array* res;
-  track *X;
-  ivec_array*  occur;
-  ivec* sizes;
-  ivec* inds;
-  ivec* hit;
-  int N = track_array_size(old);
-  int i;
-
-  /* Allocate space */
-  occur = mk_array_of_zero_length_ivecs(simple_obs_array_size(obs));
-  res   = mk_empty_track_array(N);
-  sizes = mk_zero_ivec(N);
-
-  /* Compute the sizes for all of the tracks. */
-  for(i=0;i<N;i++) {
-    ivec_set(sizes,i,track_num_obs(track_array_ref(old,i)));
-  }
-  inds = mk_indices_of_sorted_ivec(sizes);
-
-  /* Put tracks in the result largest to smallest */
-  for(i=0;i<N;i++) {
-    X   = track_array_ref(old,ivec_ref(inds,N-i-1));
-    hit = mk_MHT_subset_query(occur,track_individs(X));
-    
-    if(ivec_size(hit) == 0) {
-      track_array_add(res,X);
-      MHT_add_to_overlap_array(occur, track_individs(X), track_array_size(res)-1);
-    }
-
-    free_ivec(hit);
-  }
-
-  free_ivec_array(occur);
-  free_ivec(sizes);
-  free_ivec(inds);
-
-  return res;
+  return mk_track_array_remove_subsets(old,obs);
 }
 
 
@@ -363,124 +274,213 @@ track_array* mk_linear_matches_recursive(track_array* arr, simple_obs_array* obs
 
 
 
-/* There are several tuning parameters:                                 */
-/*  lin_thresh    - the fit threshold of the linear projection          */
-/*  quad_thresh   - the fit threshold of the quadratic projection       */
-/*  fit_thresh    - the fit threshold for the fitted curve.             */
-/*  max_hyp       - the maximum number of hypothesis after each turn.   */
-/*  indiv_max_hyp - the maximum number of matches for each hypothesis   */
-/*                  to consider.                                        */
-/*  min_obs       - the minimum number of observations for a valid track*/
-track_array* mk_MHT_matches(track_array* arr, simple_obs_array* obs, 
-			    double fit_rd, double mid_rd, double quad_rd,
-			    int max_hyp, int indiv_max_hyp, int min_obs,
-			    bool bwpass) {
-  t_tree*      tr;
-  track_array* single_res;
-  track_array* init_hyp;
-  track_array* res;
-  track* X;
-  ivec*        inds;
+/* The seeds of mk_MHT_matches are searched in chunks of this many. */
+#define MHT_SEED_CHUNK 64
+
+/* The shared (read only) state of a sequential search and the       */
+/* chunks of seeds handed out to the workers.  chunk_res[c] holds     */
+/* chunk c's tracks until it is merged into res in chunk order.       */
+typedef struct MHT_seed_job {
+  track_array* arr;
+  simple_obs_array* obs;
+  t_tree* tr;
   dyv* times;
-  dyv* weights;
   dyv* midpt_thresh;
   dyv* accel_thresh;
   dyv* nearpt_thresh;
-  int i, j, t, N;
-  /*char* tmpstr;*/
-
-  N   = track_array_size(arr);
-  res = mk_empty_track_array(N);
-
-  weights = mk_t_tree_weights(1.0,1.0,1.0,1.0,1.0,0.0);
-  tr      = mk_t_tree(arr,obs,weights,25); 
-  /*tr      = mk_t_tree(arr,obs,weights,10000000);*/
-
-  accel_thresh  = mk_t_tree_accel(1.0,0.02,0.3,10.0,10.0,10.0);
-  midpt_thresh  = mk_t_tree_RADEC_thresh(mid_rd);
-  nearpt_thresh = mk_t_tree_RADEC_thresh(quad_rd);
+  double fit_rd;
+  int max_hyp;
+  int indiv_max_hyp;
+  int min_obs;
+  bool bwpass;
+
+  int threads;
+  int num_chunks;
+  int next_chunk;
+  int next_merge;
+  track_array** chunk_res;
+  track_array* res;
+#ifdef USE_PTHREADS
+  pthread_mutex_t lock;
+#endif
+} MHT_seed_job;
 
-  times = mk_sort_all_track_times(arr);
-  inds  = mk_ivec(1);
 
-  for(i=0;i<N;i++) {
-    if(i % 1000 == 0) {
-      printf("Tracked %i\n",i);
+/* Search forward (and backward if bwpass) from seed i, adding the */
+/* tracks with at least min_obs observations to res.  inds is a    */
+/* scratch ivec of size 1.                                         */
+void MHT_match_seed(MHT_seed_job* job, int i, ivec* inds, track_array* res) {
+  track_array* arr = job->arr;
+  track_array* single_res;
+  track_array* init_hyp;
+  track* X;
+  int j, t;
+
+  ivec_set(inds,0,i);
+  init_hyp = mk_track_array_subset(arr,inds);
+  t        = find_index_in_dyv(job->times,track_time(track_array_ref(arr,i)),1e-8);
+  single_res = mk_linear_matches_recursive(arr,job->obs,job->times,t+1,
+                                           job->max_hyp,job->indiv_max_hyp,
+                                           job->fit_rd,init_hyp,job->tr,
+                                           job->midpt_thresh,job->nearpt_thresh,
+                                           job->accel_thresh,1);
+  for(j=0;j<track_array_size(single_res);j++) {
+    X = track_array_ref(single_res,j);
+
+    if(track_num_obs(X) >= job->min_obs) {
+      track_array_add(res,X);
     }
+  }
+
+  free_track_array(single_res);
+  free_track_array(init_hyp);
 
-    ivec_set(inds,0,i);
+  /* Do the same search backward... */
+  if(job->bwpass) {
     init_hyp = mk_track_array_subset(arr,inds);
-    t        = find_index_in_dyv(times,track_time(track_array_ref(arr,i)),1e-8);
-    single_res = mk_linear_matches_recursive(arr,obs,times,t+1, max_hyp,indiv_max_hyp,
-					     fit_rd,init_hyp,tr,midpt_thresh,
-					     nearpt_thresh,accel_thresh,1);
+    single_res = mk_linear_matches_recursive(arr,job->obs,job->times,t-1,
+                                             job->max_hyp,job->indiv_max_hyp,
+                                             job->fit_rd,init_hyp,job->tr,
+                                             job->midpt_thresh,job->nearpt_thresh,
+                                             job->accel_thresh,-1);
     for(j=0;j<track_array_size(single_res);j++) {
       X = track_array_ref(single_res,j);
 
-      if(track_num_obs(X) >= min_obs) {
-	track_array_add(res,X);
+      if(track_num_obs(X) >= job->min_obs) {
+        track_array_add(res,X);
       }
     }
 
-    /*tmpstr = simple_obs_id_str(track_first(track_array_ref(init_hyp,0),obs));
-    if((tmpstr[0]=='S') && (tmpstr[1]=='0') && (tmpstr[2]=='0') && (tmpstr[3]=='0') &&
-       (tmpstr[4]=='4') && (tmpstr[5]=='u') && (tmpstr[6]=='g')) { 
-      fprintf_track_array_list(stdout,init_hyp);
-      fprintf_track_array_mod_MPC(stdout,init_hyp,obs);
-      fprintf_track_array(stdout,init_hyp);
-      printf("----------\n");
-      fprintf_track_array_list(stdout,single_res);
-      fprintf_track_array_mod_MPC(stdout,single_res,obs);
-      fprintf_track_array(stdout,single_res);
-      wait_for_key();  
-      }*/
-
     free_track_array(single_res);
     free_track_array(init_hyp);
+  }
+}
 
-    /* Do the same search backward... */
-    if(bwpass) {
-      init_hyp = mk_track_array_subset(arr,inds);
-      single_res = mk_linear_matches_recursive(arr,obs,times,t-1, max_hyp,indiv_max_hyp,
-					       fit_rd,init_hyp,tr,
-					       midpt_thresh,nearpt_thresh,accel_thresh,-1);
-      for(j=0;j<track_array_size(single_res);j++) {
-	X = track_array_ref(single_res,j);
-
-	if(track_num_obs(X) >= min_obs) {
-	  track_array_add(res,X);
-	}
+
+/* Worker: repeatedly claim the next chunk of seeds, search them    */
+/* into the chunk's own array and merge the finished chunks (in     */
+/* order) into the result.  The queries on the shared t_tree do not */
+/* modify it, and each seed's hypotheses are its own copies.        */
+void* MHT_seed_worker(void* arg) {
+  MHT_seed_job* job = (MHT_seed_job*)arg;
+  track_array* res;
+  track_array* cres;
+  ivec* inds = mk_ivec(1);
+  int N = track_array_size(job->arr);
+  int c, i, j;
+
+  while(TRUE) {
+#ifdef USE_PTHREADS
+    pthread_mutex_lock(&job->lock);
+#endif
+    c = job->next_chunk;
+    job->next_chunk += 1;
+    for(i=c*MHT_SEED_CHUNK;(i<(c+1)*MHT_SEED_CHUNK)&&(i<N);i++) {
+      if(i % 1000 == 0) {
+        printf("Tracked %i\n",i);
       }
-      /*fprintf_track_array_list(stdout,single_res);
-	wait_for_key();*/
-
-      /*tmpstr = simple_obs_id_str(track_first(track_array_ref(init_hyp,0),obs));
-      if((tmpstr[0]=='S') && (tmpstr[1]=='0') && (tmpstr[2]=='0') && (tmpstr[3]=='0') &&
-	 (tmpstr[4]=='4') && (tmpstr[5]=='u') && (tmpstr[6]=='g')) { 
-	fprintf_track_array_list(stdout,init_hyp);
-	fprintf_track_array_mod_MPC(stdout,init_hyp,obs);
-	fprintf_track_array(stdout,init_hyp);
-	printf("----------\n");
-	fprintf_track_array_list(stdout,single_res);
-	fprintf_track_array_mod_MPC(stdout,single_res,obs);
-	fprintf_track_array(stdout,single_res);
-	wait_for_key();  
-	}*/
+    }
+#ifdef USE_PTHREADS
+    pthread_mutex_unlock(&job->lock);
+#endif
+
+    if(c >= job->num_chunks) { break; }
 
-      free_track_array(single_res);
-      free_track_array(init_hyp); 
+    res = mk_empty_track_array(MHT_SEED_CHUNK);
+    for(i=c*MHT_SEED_CHUNK;(i<(c+1)*MHT_SEED_CHUNK)&&(i<N);i++) {
+      MHT_match_seed(job, i, inds, res);
     }
+
+#ifdef USE_PTHREADS
+    pthread_mutex_lock(&job->lock);
+#endif
+    job->chunk_res[c] = res;
+    while((job->next_merge < job->num_chunks) &&
+          (job->chunk_res[job->next_merge] != NULL)) {
+      cres = job->chunk_res[job->next_merge];
+      for(j=0;j<track_array_size(cres);j++) {
+        track_array_add(job->res,track_array_ref(cres,j));
+      }
+      free_track_array(cres);
+      job->chunk_res[job->next_merge] = NULL;
+      job->next_merge += 1;
+    }
+#ifdef USE_PTHREADS
+    pthread_mutex_unlock(&job->lock);
+#endif
   }
 
-  free_t_tree(tr);
-  free_dyv(times);
-  free_dyv(midpt_thresh);
-  free_dyv(accel_thresh);
-  free_dyv(nearpt_thresh);
-  free_dyv(weights);
   free_ivec(inds);
 
-  return res;
+  return NULL;
+}
+
+
+/* There are several tuning parameters:                                 */
+/*  lin_thresh    - the fit threshold of the linear projection          */
+/*  quad_thresh   - the fit threshold of the quadratic projection       */
+/*  fit_thresh    - the fit threshold for the fitted curve.             */
+/*  max_hyp       - the maximum number of hypothesis after each turn.   */
+/*  indiv_max_hyp - the maximum number of matches for each hypothesis   */
+/*                  to consider.                                        */
+/*  min_obs       - the minimum number of observations for a valid track*/
+/*  threads       - the number of threads searching the seeds.  The     */
+/*                  results are merged in seed order so they do not     */
+/*                  depend on the number of threads.                    */
+track_array* mk_MHT_matches(track_array* arr, simple_obs_array* obs, 
+			    double fit_rd, double mid_rd, double quad_rd,
+			    int max_hyp, int indiv_max_hyp, int min_obs,
+			    bool bwpass, int threads) {
+  MHT_seed_job job;
+  dyv* weights;
+  int N, c;
+
+  N   = track_array_size(arr);
+
+  job.arr           = arr;
+  job.obs           = obs;
+  job.res           = mk_empty_track_array(N);
+  job.fit_rd        = fit_rd;
+  job.max_hyp       = max_hyp;
+  job.indiv_max_hyp = indiv_max_hyp;
+  job.min_obs       = min_obs;
+  job.bwpass        = bwpass;
+  job.threads       = int_max(threads,1);
+
+  weights = mk_t_tree_weights(1.0,1.0,1.0,1.0,1.0,0.0);
+  job.tr  = mk_t_tree(arr,obs,weights,25); 
+  /*tr      = mk_t_tree(arr,obs,weights,10000000);*/
+
+  job.accel_thresh  = mk_t_tree_accel(1.0,0.02,0.3,10.0,10.0,10.0);
+  job.midpt_thresh  = mk_t_tree_RADEC_thresh(mid_rd);
+  job.nearpt_thresh = mk_t_tree_RADEC_thresh(quad_rd);
+
+  job.times = mk_sort_all_track_times(arr);
+
+  job.num_chunks = (N + MHT_SEED_CHUNK - 1) / MHT_SEED_CHUNK;
+  job.next_chunk = 0;
+  job.next_merge = 0;
+  job.chunk_res  = AM_MALLOC_ARRAY(track_array*, int_max(job.num_chunks,1));
+  for(c=0;c<job.num_chunks;c++) { job.chunk_res[c] = NULL; }
+
+#ifdef USE_PTHREADS
+  pthread_mutex_init(&job.lock, NULL);
+#endif
+  run_worker_threads(MHT_seed_worker, &job,
+                     int_min(job.threads, job.num_chunks));
+#ifdef USE_PTHREADS
+  pthread_mutex_destroy(&job.lock);
+#endif
+
+  AM_FREE_ARRAY(job.chunk_res, track_array*, int_max(job.num_chunks,1));
+  free_t_tree(job.tr);
+  free_dyv(job.times);
+  free_dyv(job.midpt_thresh);
+  free_dyv(job.accel_thresh);
+  free_dyv(job.nearpt_thresh);
+  free_dyv(weights);
+
+  return job.res;
 }
 
 
@@ -950,7 +950,7 @@ void test_MHT_main(int argc,char *argv[]) {
 
     printf(">> Doing the tracking...\n");
     t2 = mk_MHT_matches(t1,obs,fit_thresh,lin_thresh,quad_thresh,
-			max_hyp,max_match,min_obs,bwpass);
+			max_hyp,max_match,min_obs,bwpass,1);
     printf("   Found %i potential tracks of %i or more observations.\n",track_array_size(t2),
 	   min_obs);
 
@@ -24,19 +24,15 @@ Copyright 2004, The Auton Lab, CMU
 #define MHT_H
 
 #include "track.h"
+#include "track_index.h"
 
 track_array* mk_order_tracks_by_trust(track_array* arr, simple_obs_array* obs);
 
-ivec* mk_MHT_overlap_query(ivec_array* seen, ivec* pts);
-
-ivec* mk_MHT_subset_query(ivec_array* seen, ivec* pts);
-
-void MHT_add_to_overlap_array(ivec_array* seen, ivec* pts, int index);
-
 track_array* mk_MHT_remove_overlaps(track_array* old, simple_obs_array* obs,
                                     bool allow_conflicts,
                                     double min_percentage_overlap);
 
+/* Remove tracks that are subsets of other tracks (see track_index.h). */
 track_array* mk_MHT_remove_subsets(track_array* old, simple_obs_array* obs);
 
 
@@ -48,9 +44,11 @@ track_array* mk_MHT_remove_subsets(track_array* old, simple_obs_array* obs);
 /*  indiv_max_hyp - the maximum number of matches for each hypothesis   */
 /*                  to consider.                                        */
 /*  min_obs       - the minimum number of observations for a valid track*/
+/*  threads       - the number of threads searching the seeds (the      */
+/*                  results do not depend on it).                       */
 track_array* mk_MHT_matches(track_array* arr, simple_obs_array* obs,
                             double fit_rd, double mid_rd, double quad_rd, 
                             int max_hyp, int indiv_max_hyp, int min_obs,
-			    bool bwpass);
+			    bool bwpass, int threads);
 
 #endif
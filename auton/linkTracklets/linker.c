@@ -21,20 +21,62 @@
 
 #include "linker.h"
 #include "MHT.h"
+#include "worker_threads.h"
+
+#include <sys/time.h>
+#ifdef USE_PTHREADS
+#include <pthread.h>
+#endif
 
 extern int NUM_FOR_QUAD;
 
 #define TBT_VWEIGHT 10.0
 
-int leaf_count = 0;
-int supp_count = 0;
-int pairs_count = 0;
 
+/* The scratch state of a single search.  Each plate pair searched */
+/* by mk_vtrees_tracks gets its own, so that the pairs can be      */
+/* searched at the same time.                                      */
+typedef struct vtree_search {
+
+  /* Skip flip tracks the number of iterations until */
+  /* we test for pruning (it is not alway helpful to */
+  /* test at each level of the search).              */
+  int skip_flip;
+
+  int leaf_count;
+  int supp_count;
+  int pairs_count;
+
+  long nodes;       /* Model and support tree nodes visited. */
 
-/* Skip flip tracks the number of iterations until */
-/* we test for pruning (it is not alway helpful to */
-/* test at each level of the search).              */
-int skip_flip = 2;
+  /* The support lists of the flat search, one per level of the */
+  /* recursion, kept for reuse (see vtree_search_support).      */
+  struct tbt_support** sups;
+  int num_sups;
+  int depth;
+} vtree_search;
+
+
+void vtree_search_init(vtree_search* vs) {
+  vs->skip_flip   = 2;
+  vs->leaf_count  = 0;
+  vs->supp_count  = 0;
+  vs->pairs_count = 0;
+  vs->nodes       = 0;
+  vs->sups        = NULL;
+  vs->num_sups    = 0;
+  vs->depth       = 0;
+}
+
+
+void vtree_run_opts_init(vtree_run_opts* opts) {
+  opts->threads     = 1;
+  opts->progress    = 0.0;
+  opts->status_file = NULL;
+  opts->ckpt_file   = NULL;
+  opts->ckpt_every  = 300.0;
+  opts->ckpt_resume = FALSE;
+}
 
 
 /* ---------------------------------------------------- */
@@ -312,12 +354,11 @@ tbt* mk_tbt_recurse(dym* pts, ivec* inds,
 
 /* use_inds - is the indices to use (NULL to use ALL observations). */
 /* force_t  - forces us to split on time first.                     */
-tbt* mk_tbt(dym* pts, ivec* use_inds, bool force_t, int max_leaf_pts) {
+dyv* mk_tbt_split_widths(dym* pts, ivec* use_inds, bool force_t) {
   tbt *res;
   ivec    *inds;
   dyv     *width;
 
-  /* Store all the indices for the tree. */
   if(use_inds != NULL) {
     inds = mk_copy_ivec(use_inds);
   } else {
@@ -356,9 +397,27 @@ tbt* mk_tbt(dym* pts, ivec* use_inds, bool force_t, int max_leaf_pts) {
   }
 
   free_tbt(res);
+  free_ivec(inds);
+
+  return width;
+}
+
+
+tbt* mk_tbt(dym* pts, ivec* use_inds, bool force_t, int max_leaf_pts) {
+  tbt *res;
+  ivec    *inds;
+  dyv     *width;
+
+  /* Store all the indices for the tree. */
+  if(use_inds != NULL) {
+    inds = mk_copy_ivec(use_inds);
+  } else {
+    inds = mk_sequence_ivec(0,dym_rows(pts));
+  }
 
   /* Build the tree. */
-  res  = mk_tbt_recurse(pts, inds, width, max_leaf_pts);
+  width = mk_tbt_split_widths(pts, inds, force_t);
+  res   = mk_tbt_recurse(pts, inds, width, max_leaf_pts);
 
   /* Free the used memory */
   free_dyv(width);
@@ -424,6 +483,174 @@ void fill_plate_tbt_ptr_array(tbt* tr, tbt_ptr_array* arr) {
 }
 
 
+/* -------------------------------------------------------------------- */
+/* --- Flattened TBT Trees -------------------------------------------- */
+/* -------------------------------------------------------------------- */
+
+int tbt_count_nodes(tbt* tr) {
+  if(tbt_is_leaf(tr)) { return 1; }
+  return 1 + tbt_count_nodes(tbt_left_child(tr))
+           + tbt_count_nodes(tbt_right_child(tr));
+}
+
+
+/* Copy the subtree tr into node i (and its points into pts from */
+/* *p on).  Returns the first node after the subtree.            */
+int tbt_flat_fill(tbt_flat* res, tbt* tr, int i, int* p) {
+  int next, d, k;
+
+  for(d=0;d<TBT_DIM;d++) {
+    res->lo[d][i] = tr->lo[d];
+    res->hi[d][i] = tr->hi[d];
+  }
+  res->num_points[i] = tbt_N(tr);
+  res->first_pt[i]   = p[0];
+
+  if(tbt_is_leaf(tr)) {
+    res->right[i] = -1;
+    for(k=0;k<ivec_size(tbt_pts(tr));k++) {
+      res->pts[p[0]] = ivec_ref(tbt_pts(tr),k);
+      p[0] += 1;
+    }
+    next = i+1;
+  } else {
+    next          = tbt_flat_fill(res, tbt_left_child(tr), i+1, p);
+    res->right[i] = next;
+    next          = tbt_flat_fill(res, tbt_right_child(tr), next, p);
+  }
+
+  return next;
+}
+
+
+tbt_flat* mk_empty_tbt_flat(int num_nodes, int num_pts) {
+  tbt_flat* res = AM_MALLOC(tbt_flat);
+  int N = num_nodes;
+  int d;
+
+  res->num_nodes = N;
+  res->num_pts   = num_pts;
+  for(d=0;d<TBT_DIM;d++) {
+    res->lo[d] = AM_MALLOC_ARRAY(double,int_max(N,1));
+    res->hi[d] = AM_MALLOC_ARRAY(double,int_max(N,1));
+  }
+  res->num_points = AM_MALLOC_ARRAY(int,int_max(N,1));
+  res->right      = AM_MALLOC_ARRAY(int,int_max(N,1));
+  res->first_pt   = AM_MALLOC_ARRAY(int,int_max(N,1));
+  res->pts        = AM_MALLOC_ARRAY(int,int_max(num_pts,1));
+
+  return res;
+}
+
+
+tbt_flat* mk_tbt_flat(tbt* tr) {
+  tbt_flat* res = mk_empty_tbt_flat(tbt_count_nodes(tr), tbt_N(tr));
+  int p = 0;
+
+  tbt_flat_fill(res, tr, 0, &p);
+
+  return res;
+}
+
+
+tbt_flat* mk_copy_tbt_flat(tbt_flat* old) {
+  tbt_flat* res = mk_empty_tbt_flat(old->num_nodes, old->num_pts);
+  int i, d;
+
+  for(i=0;i<old->num_nodes;i++) {
+    for(d=0;d<TBT_DIM;d++) {
+      res->lo[d][i] = old->lo[d][i];
+      res->hi[d][i] = old->hi[d][i];
+    }
+    res->num_points[i] = old->num_points[i];
+    res->right[i]      = old->right[i];
+    res->first_pt[i]   = old->first_pt[i];
+  }
+  for(i=0;i<old->num_pts;i++) {
+    res->pts[i] = old->pts[i];
+  }
+
+  return res;
+}
+
+
+tbt_flat* mk_tbt_flat_forest(tbt_flat** trees, int num_trees, ivec** roots) {
+  tbt_flat* res;
+  tbt_flat* X;
+  int N = 0;
+  int P = 0;
+  int i, j, d, n0, p0;
+
+  for(j=0;j<num_trees;j++) {
+    N += trees[j]->num_nodes;
+    P += trees[j]->num_pts;
+  }
+  res      = mk_empty_tbt_flat(N, P);
+  roots[0] = mk_ivec(num_trees);
+
+  n0 = 0;
+  p0 = 0;
+  for(j=0;j<num_trees;j++) {
+    X = trees[j];
+    ivec_set(roots[0],j,n0);
+
+    for(i=0;i<X->num_nodes;i++) {
+      for(d=0;d<TBT_DIM;d++) {
+        res->lo[d][n0+i] = X->lo[d][i];
+        res->hi[d][n0+i] = X->hi[d][i];
+      }
+      res->num_points[n0+i] = X->num_points[i];
+      res->right[n0+i]      = (X->right[i] < 0) ? -1 : n0 + X->right[i];
+      res->first_pt[n0+i]   = p0 + X->first_pt[i];
+    }
+    for(i=0;i<X->num_pts;i++) {
+      res->pts[p0+i] = X->pts[i];
+    }
+
+    n0 += X->num_nodes;
+    p0 += X->num_pts;
+  }
+
+  return res;
+}
+
+
+void free_tbt_flat(tbt_flat* old) {
+  int N = old->num_nodes;
+  int d;
+
+  for(d=0;d<TBT_DIM;d++) {
+    AM_FREE_ARRAY(old->lo[d],double,int_max(N,1));
+    AM_FREE_ARRAY(old->hi[d],double,int_max(N,1));
+  }
+  AM_FREE_ARRAY(old->num_points,int,int_max(N,1));
+  AM_FREE_ARRAY(old->right,int,int_max(N,1));
+  AM_FREE_ARRAY(old->first_pt,int,int_max(N,1));
+  AM_FREE_ARRAY(old->pts,int,int_max(old->num_pts,1));
+
+  AM_FREE(old,tbt_flat);
+}
+
+
+void tbt_flat_fill_plates(tbt_flat* tr, int i, ivec* res) {
+  if(tbt_flat_is_leaf(tr,i) || (tbt_flat_rad(tr,TBT_T,i) < 1e-10)) {
+    add_to_ivec(res,i);
+  } else {
+    tbt_flat_fill_plates(tr,tbt_flat_left_child(tr,i),res);
+    tbt_flat_fill_plates(tr,tbt_flat_right_child(tr,i),res);
+  }
+}
+
+
+ivec* mk_tbt_flat_plates(tbt_flat* tr) {
+  ivec* res = mk_ivec(0);
+
+  tbt_flat_fill_plates(tr,0,res);
+
+  return res;
+}
+
+
 /* -------------------------------------------------------------------- */
 /* --- TBT Tree Pointer Array ----------------------------------------- */
 /* -------------------------------------------------------------------- */
@@ -947,13 +1174,13 @@ bool check_model_support_compat(tbt* mdl, tbt* sup,  double aR_min, double aR_ma
 }
 
 
-/* This is ONLY called after we have hit a set of compatible model leaf */
-/* nodes and only called with a set of valid support nodes.             */
-void quad_vtree_pairs_leaf_check(simple_obs_array* obs, track_array* pairs,
-                                 tbt_ptr_array* mdl_pts, tbt_ptr_array* sup_pts,
-                                 int min_sup, double fit_rd, double pred_fit,
-                                 double last_start_obs_time, double first_end_obs_time,
-                                 track_array* res) {
+/* Try to build a track from the model tracklets mdl_inds (in time */
+/* order) and the support tracklets sup_inds (indices into pairs).  */
+void vtree_leaf_check_tracklets(vtree_search* vs,
+                                simple_obs_array* obs, track_array* pairs,
+                                ivec* mdl_inds, ivec* sup_inds,
+                                int min_sup, double fit_rd, double pred_fit,
+                                track_array* res) {
   simple_obs* X;
   double rp, dp, tp;
   double dist, t;
@@ -966,26 +1193,17 @@ void quad_vtree_pairs_leaf_check(simple_obs_array* obs, track_array* pairs,
   ivec* inds    = NULL;
   ivec* sorted;
   ivec* temp;
-  int M = tbt_ptr_array_size(mdl_pts);
-  int S = tbt_ptr_array_size(sup_pts);
+  int M = ivec_size(mdl_inds);
+  int S = ivec_size(sup_inds);
   bool overlap;
   int i, j, ind;
   int pos_sup = 0;
   int count = 0;
 
-  pairs_count++;
-
-  /* Check the time bounds. */
-  if((last_start_obs_time < tbt_lo_time(tbt_ptr_array_ref(mdl_pts,0))) ||
-     (first_end_obs_time > tbt_hi_time(tbt_ptr_array_ref(mdl_pts,M-1)))) {
-    printf("PRUNING LEAVES ON TIME.\n");
-    return;
-  }
-
   /* Create the base track from the given tracklets. */
   inds = mk_ivec(0);
   for(i=0;i<M;i++) {
-    ind  = ivec_ref(tbt_pts(tbt_ptr_array_ref(mdl_pts,i)),0);
+    ind  = ivec_ref(mdl_inds,i);
     temp = track_individs(track_array_ref(pairs,ind));
     for(j=0;j<ivec_size(temp);j++) { add_to_ivec(inds,ivec_ref(temp,j)); }
   }
@@ -995,7 +1213,7 @@ void quad_vtree_pairs_leaf_check(simple_obs_array* obs, track_array* pairs,
 
   /* Check each support point... */
   for(i=0;i<S;i++) {    
-    ind = ivec_ref(tbt_pts(tbt_ptr_array_ref(sup_pts,i)),0);
+    ind = ivec_ref(sup_inds,i);
     T   = track_array_ref(pairs,ind);
 
     X    = track_first(T,obs);
@@ -1014,7 +1232,7 @@ void quad_vtree_pairs_leaf_check(simple_obs_array* obs, track_array* pairs,
       pos_sup++;
     }
 
-    leaf_count++;
+    vs->leaf_count++;
   }
 
   /* Only consider which support points to add, */
@@ -1086,7 +1304,48 @@ void quad_vtree_pairs_leaf_check(simple_obs_array* obs, track_array* pairs,
 }
 
 
-int test_and_add_support_final(tbt_ptr_array* mdl_pts, tbt* sup_tr, tbt_ptr_array* nu_support,
+/* This is ONLY called after we have hit a set of compatible model leaf */
+/* nodes and only called with a set of valid support nodes.             */
+void quad_vtree_pairs_leaf_check(vtree_search* vs,
+                                 simple_obs_array* obs, track_array* pairs,
+                                 tbt_ptr_array* mdl_pts, tbt_ptr_array* sup_pts,
+                                 int min_sup, double fit_rd, double pred_fit,
+                                 double last_start_obs_time, double first_end_obs_time,
+                                 track_array* res) {
+  ivec* mdl_inds;
+  ivec* sup_inds;
+  int M = tbt_ptr_array_size(mdl_pts);
+  int S = tbt_ptr_array_size(sup_pts);
+  int i;
+
+  vs->pairs_count++;
+
+  /* Check the time bounds. */
+  if((last_start_obs_time < tbt_lo_time(tbt_ptr_array_ref(mdl_pts,0))) ||
+     (first_end_obs_time > tbt_hi_time(tbt_ptr_array_ref(mdl_pts,M-1)))) {
+    printf("PRUNING LEAVES ON TIME.\n");
+    return;
+  }
+
+  mdl_inds = mk_ivec(M);
+  for(i=0;i<M;i++) {
+    ivec_set(mdl_inds,i,ivec_ref(tbt_pts(tbt_ptr_array_ref(mdl_pts,i)),0));
+  }
+  sup_inds = mk_ivec(S);
+  for(i=0;i<S;i++) {
+    ivec_set(sup_inds,i,ivec_ref(tbt_pts(tbt_ptr_array_ref(sup_pts,i)),0));
+  }
+
+  vtree_leaf_check_tracklets(vs,obs,pairs,mdl_inds,sup_inds,
+                             min_sup,fit_rd,pred_fit,res);
+
+  free_ivec(mdl_inds);
+  free_ivec(sup_inds);
+}
+
+
+int test_and_add_support_final(vtree_search* vs,
+                               tbt_ptr_array* mdl_pts, tbt* sup_tr, tbt_ptr_array* nu_support,
                                double aminR, double amaxR, double aminD, double amaxD) {
   tbt* F = tbt_ptr_array_ref(mdl_pts,0);
   tbt* L = tbt_ptr_array_ref(mdl_pts,1);
@@ -1106,7 +1365,8 @@ int test_and_add_support_final(tbt_ptr_array* mdl_pts, tbt* sup_tr, tbt_ptr_arra
   double dt, dti, dt2, acc;
   double alpha, wid;
 
-  supp_count++;
+  vs->supp_count++;
+  vs->nodes++;
 
   /* Test the support tree for validity against each model tree. */
   for(i=0;(i<M)&&(valid);i++) {
@@ -1190,10 +1450,10 @@ int test_and_add_support_final(tbt_ptr_array* mdl_pts, tbt* sup_tr, tbt_ptr_arra
     split = (split || all_leaf) && (tbt_is_leaf(sup_tr) == FALSE);
 
     if(split) {
-      count = test_and_add_support_final(mdl_pts,tbt_right_child(sup_tr),nu_support,
-                                         minR,maxR,minD,maxD);
-      count += test_and_add_support_final(mdl_pts,tbt_left_child(sup_tr),nu_support,
-                                          minR,maxR,minD,maxD);
+      count = test_and_add_support_final(vs,mdl_pts,tbt_right_child(sup_tr),
+                                         nu_support,minR,maxR,minD,maxD);
+      count += test_and_add_support_final(vs,mdl_pts,tbt_left_child(sup_tr),
+                                          nu_support,minR,maxR,minD,maxD);
     } else {
       tbt_ptr_array_add(nu_support,sup_tr);
       count = 1;
@@ -1204,15 +1464,509 @@ int test_and_add_support_final(tbt_ptr_array* mdl_pts, tbt* sup_tr, tbt_ptr_arra
 }
 
 
-void tracklets_linker_recurse(simple_obs_array* obs, track_array* pairs,
-                              tbt_ptr_array* mdl_pts, tbt_ptr_array* sup_pts,
+/* --- Flat tree search ------------------------------------------------ */
+
+/* The number of support nodes tested together (the loops over a  */
+/* batch are vectorized by the compiler; 2 doubles fill a 128 bit  */
+/* register and the support lists are often short).               */
+#define TBT_BATCH 2
+
+/* A batch of support nodes: their bounds (one array per dimension), */
+/* their acceleration bounds and whether to split them.              */
+typedef struct tbt_batch {
+  double lo[TBT_DIM][TBT_BATCH];
+  double hi[TBT_DIM][TBT_BATCH];
+  double minR[TBT_BATCH];
+  double maxR[TBT_BATCH];
+  double minD[TBT_BATCH];
+  double maxD[TBT_BATCH];
+  double split[TBT_BATCH];   /* 1.0 to split the node, else 0.0. */
+} tbt_batch;
+
+
+/* A list of support nodes of a flat tree with a copy of their bounds */
+/* (one array per dimension), so that a scan of the list reads them   */
+/* in order instead of from all over the tree.  The bound arrays are  */
+/* parts of the single array block.                                   */
+typedef struct tbt_support {
+  int size;
+  int max_size;
+  int* nodes;
+  double* lo[TBT_DIM];
+  double* hi[TBT_DIM];
+  double* block;
+} tbt_support;
+
+
+void tbt_support_alloc(tbt_support* X, int max_size) {
+  int d;
+
+  X->max_size = max_size;
+  X->nodes    = AM_MALLOC_ARRAY(int,max_size);
+  X->block    = AM_MALLOC_ARRAY(double,2*TBT_DIM*max_size);
+  for(d=0;d<TBT_DIM;d++) {
+    X->lo[d] = X->block + (2*d)*max_size;
+    X->hi[d] = X->block + (2*d+1)*max_size;
+  }
+}
+
+
+tbt_support* mk_empty_tbt_support(int max_size) {
+  tbt_support* res = AM_MALLOC(tbt_support);
+
+  res->size = 0;
+  tbt_support_alloc(res, int_max(max_size,1));
+
+  return res;
+}
+
+
+void free_tbt_support(tbt_support* old) {
+  AM_FREE_ARRAY(old->nodes,int,old->max_size);
+  AM_FREE_ARRAY(old->block,double,2*TBT_DIM*old->max_size);
+  AM_FREE(old,tbt_support);
+}
+
+
+/* The (empty) support list for the next level of vs's search, with */
+/* room for at least max_size nodes.  Must be matched by a call to    */
+/* vtree_search_release.  The lists are freed by vtree_search_free.   */
+tbt_support* vtree_search_support(vtree_search* vs, int max_size) {
+  tbt_support** old = vs->sups;
+  tbt_support* X;
+  int i;
+
+  if(vs->depth == vs->num_sups) {
+    vs->sups = AM_MALLOC_ARRAY(tbt_support*,2*vs->num_sups+8);
+    for(i=0;i<2*vs->num_sups+8;i++) {
+      vs->sups[i] = (i < vs->num_sups) ? old[i] : NULL;
+    }
+    if(old != NULL) { AM_FREE_ARRAY(old,tbt_support*,vs->num_sups); }
+    vs->num_sups = 2*vs->num_sups+8;
+  }
+
+  X = vs->sups[vs->depth];
+  if((X != NULL) && (X->max_size < max_size)) {
+    free_tbt_support(X);
+    X = NULL;
+  }
+  if(X == NULL) {
+    X = mk_empty_tbt_support(max_size);
+    vs->sups[vs->depth] = X;
+  }
+  X->size = 0;
+  vs->depth++;
+
+  return X;
+}
+
+
+void vtree_search_release(vtree_search* vs) {
+  vs->depth--;
+}
+
+
+void vtree_search_free(vtree_search* vs) {
+  int i;
+
+  for(i=0;i<vs->num_sups;i++) {
+    if(vs->sups[i] != NULL) { free_tbt_support(vs->sups[i]); }
+  }
+  if(vs->sups != NULL) { AM_FREE_ARRAY(vs->sups,tbt_support*,vs->num_sups); }
+  vs->sups     = NULL;
+  vs->num_sups = 0;
+  vs->depth    = 0;
+}
+
+
+void tbt_support_double_size(tbt_support* X) {
+  tbt_support old = X[0];
+  int i, d;
+
+  tbt_support_alloc(X, 2*old.max_size);
+  for(i=0;i<X->size;i++) {
+    X->nodes[i] = old.nodes[i];
+    for(d=0;d<TBT_DIM;d++) {
+      X->lo[d][i] = old.lo[d][i];
+      X->hi[d][i] = old.hi[d][i];
+    }
+  }
+  AM_FREE_ARRAY(old.nodes,int,old.max_size);
+  AM_FREE_ARRAY(old.block,double,2*TBT_DIM*old.max_size);
+}
+
+
+/* Add node (with its bounds from the tree) to the list. */
+void tbt_support_add(tbt_support* X, tbt_flat* tr, int node) {
+  int d;
+
+  if(X->size >= X->max_size) { tbt_support_double_size(X); }
+  X->nodes[X->size] = node;
+  for(d=0;d<TBT_DIM;d++) {
+    X->lo[d][X->size] = tbt_flat_lo(tr,d,node);
+    X->hi[d][X->size] = tbt_flat_hi(tr,d,node);
+  }
+  X->size += 1;
+}
+
+
+/* Add node k of the batch B to the list. */
+void tbt_support_add_batch(tbt_support* X, tbt_batch* B, int k, int node) {
+  int d;
+
+  if(X->size >= X->max_size) { tbt_support_double_size(X); }
+  X->nodes[X->size] = node;
+  for(d=0;d<TBT_DIM;d++) {
+    X->lo[d][X->size] = B->lo[d][k];
+    X->hi[d][X->size] = B->hi[d][k];
+  }
+  X->size += 1;
+}
+
+
+/* REFINE the acceleration bounds for the model nodes A and B (in   */
+/* time order), as quad_vtree_pairs_determine_abounds_flat does for */
+/* a pair of trees.  Return TRUE iff the two are consistent.        */
+bool tbt_flat_pair_abounds(tbt_flat* tr, int A, int B,
+                           double* aR_min, double* aR_max,
+                           double* aD_min, double* aD_max) {
+  double dt, dt2, dti, acc;
+  bool valid = TRUE;
+
+  dt  = tbt_flat_lo(tr,TBT_T,B) - tbt_flat_hi(tr,TBT_T,A);
+  dt2 = 2.0 / (dt * dt);
+  dti = 1.0/dt;
+
+  /* Determine the accel bounds with both velocity bounds. */
+  acc = (tbt_flat_hi(tr,TBT_VR,B) - tbt_flat_lo(tr,TBT_VR,A))*dti;
+  if(aR_max[0] > acc) { aR_max[0] = acc; }
+  acc = (tbt_flat_lo(tr,TBT_VR,B) - tbt_flat_hi(tr,TBT_VR,A))*dti;
+  if(aR_min[0] < acc) { aR_min[0] = acc; }
+  acc = (tbt_flat_hi(tr,TBT_VD,B) - tbt_flat_lo(tr,TBT_VD,A))*dti;
+  if(aD_max[0] > acc) { aD_max[0] = acc; }
+  acc = (tbt_flat_lo(tr,TBT_VD,B) - tbt_flat_hi(tr,TBT_VD,A))*dti;
+  if(aD_min[0] < acc) { aD_min[0] = acc; }
+  valid = (aD_min[0] <= aD_max[0])&&(aR_min[0] <= aR_max[0]);
+
+  /* Do the velocity+position/position tests. */
+  if(valid) {
+    acc = dt2*((tbt_flat_hi(tr,TBT_R,B)-tbt_flat_lo(tr,TBT_R,A))-tbt_flat_lo(tr,TBT_VR,A)*dt);
+    if(aR_max[0] > acc) { aR_max[0] = acc; }
+    acc = dt2*((tbt_flat_lo(tr,TBT_R,B)-tbt_flat_hi(tr,TBT_R,A))-tbt_flat_hi(tr,TBT_VR,A)*dt);
+    if(aR_min[0] < acc) { aR_min[0] = acc; }
+    acc = dt2*((tbt_flat_hi(tr,TBT_D,B)-tbt_flat_lo(tr,TBT_D,A))-tbt_flat_lo(tr,TBT_VD,A)*dt);
+    if(aD_max[0] > acc) { aD_max[0] = acc; }
+    acc = dt2*((tbt_flat_lo(tr,TBT_D,B)-tbt_flat_hi(tr,TBT_D,A))-tbt_flat_hi(tr,TBT_VD,A)*dt);
+    if(aD_min[0] < acc) { aD_min[0] = acc; }
+    valid = (aD_min[0] <= aD_max[0])&&(aR_min[0] <= aR_max[0]);
+
+    if(valid) {
+      acc = dt2*(tbt_flat_hi(tr,TBT_R,A)-tbt_flat_lo(tr,TBT_R,B)+tbt_flat_hi(tr,TBT_VR,B)*dt);
+      if(aR_max[0] > acc) { aR_max[0] = acc; }
+      acc = dt2*(tbt_flat_lo(tr,TBT_R,A)-tbt_flat_hi(tr,TBT_R,B)+tbt_flat_lo(tr,TBT_VR,B)*dt);
+      if(aR_min[0] < acc) { aR_min[0] = acc; }
+      acc = dt2*(tbt_flat_hi(tr,TBT_D,A)-tbt_flat_lo(tr,TBT_D,B)+tbt_flat_hi(tr,TBT_VD,B)*dt);
+      if(aD_max[0] > acc) { aD_max[0] = acc; }
+      acc = dt2*(tbt_flat_lo(tr,TBT_D,A)-tbt_flat_hi(tr,TBT_D,B)+tbt_flat_lo(tr,TBT_VD,B)*dt);
+      if(aD_min[0] < acc) { aD_min[0] = acc; }
+      valid = (aD_min[0] <= aD_max[0])&&(aR_min[0] <= aR_max[0]);
+    }
+  }
+
+  return valid;
+}
+
+
+/* Shrink the acceleration bounds of lane k of the batch X by the   */
+/* constraints between the earlier node (with the bounds aT, aR_lo, */
+/* ...) and the later node (bT, bR_lo, ...).                        */
+#define TBT_BATCH_LANE_ABOUNDS(X,k) {                                \
+    dt  = bT - aT;                                                   \
+    dt2 = 2.0 / (dt * dt);                                           \
+    dti = 1.0/dt;                                                    \
+                                                                     \
+    acc = dt2*((bR_hi-aR_lo)-avR_lo*dt);                             \
+    X->maxR[k] = (acc < X->maxR[k]) ? acc : X->maxR[k];              \
+    acc = dt2*((bR_lo-aR_hi)-avR_hi*dt);                             \
+    X->minR[k] = (acc > X->minR[k]) ? acc : X->minR[k];              \
+    acc = dt2*((bD_hi-aD_lo)-avD_lo*dt);                             \
+    X->maxD[k] = (acc < X->maxD[k]) ? acc : X->maxD[k];              \
+    acc = dt2*((bD_lo-aD_hi)-avD_hi*dt);                             \
+    X->minD[k] = (acc > X->minD[k]) ? acc : X->minD[k];              \
+                                                                     \
+    acc = dt2*(aR_hi-bR_lo+bvR_hi*dt);                               \
+    X->maxR[k] = (acc < X->maxR[k]) ? acc : X->maxR[k];              \
+    acc = dt2*(aR_lo-bR_hi+bvR_lo*dt);                               \
+    X->minR[k] = (acc > X->minR[k]) ? acc : X->minR[k];              \
+    acc = dt2*(aD_hi-bD_lo+bvD_hi*dt);                               \
+    X->maxD[k] = (acc < X->maxD[k]) ? acc : X->maxD[k];              \
+    acc = dt2*(aD_lo-bD_hi+bvD_lo*dt);                               \
+    X->minD[k] = (acc > X->minD[k]) ? acc : X->minD[k];              \
+                                                                     \
+    acc = (bvR_hi - avR_lo)*dti;                                     \
+    X->maxR[k] = (acc < X->maxR[k]) ? acc : X->maxR[k];              \
+    acc = (bvR_lo - avR_hi)*dti;                                     \
+    X->minR[k] = (acc > X->minR[k]) ? acc : X->minR[k];              \
+    acc = (bvD_hi - avD_lo)*dti;                                     \
+    X->maxD[k] = (acc < X->maxD[k]) ? acc : X->maxD[k];              \
+    acc = (bvD_lo - avD_hi)*dti;                                     \
+    X->minD[k] = (acc > X->minD[k]) ? acc : X->minD[k];              \
+  }
+
+
+/* Shrink the acceleration bounds of a batch of support nodes that  */
+/* are all before the model node (with bounds mlo/mhi).  The loop   */
+/* has no branches, so it is vectorized.                            */
+void tbt_flat_batch_abounds_before(tbt_batch* X, double* mlo, double* mhi) {
+  double bT     = mlo[TBT_T];
+  double bR_lo  = mlo[TBT_R],  bR_hi  = mhi[TBT_R];
+  double bD_lo  = mlo[TBT_D],  bD_hi  = mhi[TBT_D];
+  double bvR_lo = mlo[TBT_VR], bvR_hi = mhi[TBT_VR];
+  double bvD_lo = mlo[TBT_VD], bvD_hi = mhi[TBT_VD];
+  double aT, aR_lo, aR_hi, aD_lo, aD_hi, avR_lo, avR_hi, avD_lo, avD_hi;
+  double dt, dt2, dti, acc;
+  int k;
+
+  for(k=0;k<TBT_BATCH;k++) {
+    aT     = X->hi[TBT_T][k];
+    aR_lo  = X->lo[TBT_R][k];  aR_hi  = X->hi[TBT_R][k];
+    aD_lo  = X->lo[TBT_D][k];  aD_hi  = X->hi[TBT_D][k];
+    avR_lo = X->lo[TBT_VR][k]; avR_hi = X->hi[TBT_VR][k];
+    avD_lo = X->lo[TBT_VD][k]; avD_hi = X->hi[TBT_VD][k];
+    TBT_BATCH_LANE_ABOUNDS(X,k);
+  }
+}
+
+
+/* As tbt_flat_batch_abounds_before for support nodes that are all */
+/* after the model node.                                           */
+void tbt_flat_batch_abounds_after(tbt_batch* X, double* mlo, double* mhi) {
+  double aT     = mhi[TBT_T];
+  double aR_lo  = mlo[TBT_R],  aR_hi  = mhi[TBT_R];
+  double aD_lo  = mlo[TBT_D],  aD_hi  = mhi[TBT_D];
+  double avR_lo = mlo[TBT_VR], avR_hi = mhi[TBT_VR];
+  double avD_lo = mlo[TBT_VD], avD_hi = mhi[TBT_VD];
+  double bT, bR_lo, bR_hi, bD_lo, bD_hi, bvR_lo, bvR_hi, bvD_lo, bvD_hi;
+  double dt, dt2, dti, acc;
+  int k;
+
+  for(k=0;k<TBT_BATCH;k++) {
+    bT     = X->lo[TBT_T][k];
+    bR_lo  = X->lo[TBT_R][k];  bR_hi  = X->hi[TBT_R][k];
+    bD_lo  = X->lo[TBT_D][k];  bD_hi  = X->hi[TBT_D][k];
+    bvR_lo = X->lo[TBT_VR][k]; bvR_hi = X->hi[TBT_VR][k];
+    bvD_lo = X->lo[TBT_VD][k]; bvD_hi = X->hi[TBT_VD][k];
+    TBT_BATCH_LANE_ABOUNDS(X,k);
+  }
+}
+
+
+/* Shrink the acceleration bounds of the batch by its consistency */
+/* with a model node.  Nodes are put in time order by their mid   */
+/* times, as in test_and_add_support_final.  The support lists    */
+/* are in time order, so a batch is almost always on one side of  */
+/* the model node; otherwise both sides are computed.             */
+void tbt_flat_batch_abounds(tbt_batch* X, double* mlo, double* mhi) {
+  tbt_batch Y;
+  double mt = (mhi[TBT_T] + mlo[TBT_T])/2.0;
+  int before = 0;
+  int k;
+
+  for(k=0;k<TBT_BATCH;k++) {
+    if((X->hi[TBT_T][k] + X->lo[TBT_T][k])/2.0 < mt) { before++; }
+  }
+
+  if(before == TBT_BATCH) {
+    tbt_flat_batch_abounds_before(X,mlo,mhi);
+  } else if(before == 0) {
+    tbt_flat_batch_abounds_after(X,mlo,mhi);
+  } else {
+    Y = X[0];
+    tbt_flat_batch_abounds_before(X,mlo,mhi);
+    tbt_flat_batch_abounds_after(&Y,mlo,mhi);
+    for(k=0;k<TBT_BATCH;k++) {
+      if(!((X->hi[TBT_T][k] + X->lo[TBT_T][k])/2.0 < mt)) {
+        X->minR[k] = Y.minR[k];
+        X->maxR[k] = Y.maxR[k];
+        X->minD[k] = Y.minD[k];
+        X->maxD[k] = Y.maxD[k];
+      }
+    }
+  }
+}
+
+
+/* Test the support nodes sup against the model nodes first and last */
+/* (as test_and_add_support_final does), adding the nodes that       */
+/* remain (split as needed) to nu_support.  Returns the number of    */
+/* nodes added.  If count is not NULL, it is incremented for each of */
+/* sup's nodes that added a node and has a later mid time than tlast */
+/* (which is then updated).                                          */
+/*                                                                   */
+/* The nodes are tested TBT_BATCH at a time.  The bounds only ever   */
+/* shrink, so applying every constraint and then checking gives the  */
+/* same answer as stopping at the first one that fails.              */
+int tbt_flat_test_support(vtree_search* vs, tbt_flat* tr, int first, int last,
+                          tbt_support* sup,
+                          double aminR, double amaxR, double aminD, double amaxD,
+                          tbt_support* nu_support, double* tlast, int* count) {
+  tbt_batch X;
+  tbt_support C;
+  double clo[TBT_DIM][2], chi[TBT_DIM][2];
+  int cnodes[2];
+  double mlo[2][TBT_DIM], mhi[2][TBT_DIM];
+  double radF[TBT_DIM], radL[TBT_DIM];
+  double tF = tbt_flat_mid(tr,TBT_T,first);
+  double tL = tbt_flat_mid(tr,TBT_T,last);
+  double alpha, wid, t;
+  bool all_leaf = tbt_flat_is_leaf(tr,first) && tbt_flat_is_leaf(tr,last);
+  bool any;
+  int n = sup->size;
+  int total = 0;
+  int b, nb, k, d, i, node, added;
+
+  vs->supp_count += n;
+  vs->nodes      += n;
+
+  for(d=0;d<TBT_DIM;d++) {
+    mlo[0][d] = tbt_flat_lo(tr,d,first);
+    mhi[0][d] = tbt_flat_hi(tr,d,first);
+    mlo[1][d] = tbt_flat_lo(tr,d,last);
+    mhi[1][d] = tbt_flat_hi(tr,d,last);
+    radF[d]   = tbt_flat_rad(tr,d,first);
+    radL[d]   = tbt_flat_rad(tr,d,last);
+  }
+
+  /* The list for the children of a split node. */
+  C.size     = 0;
+  C.max_size = 2;
+  C.nodes    = cnodes;
+  C.block    = NULL;
+  for(d=0;d<TBT_DIM;d++) {
+    C.lo[d] = clo[d];
+    C.hi[d] = chi[d];
+  }
+
+  for(b=0;b<n;b+=TBT_BATCH) {
+    nb = (n-b < TBT_BATCH) ? n-b : TBT_BATCH;
+
+    /* Load the batch (padded with copies of its last node). */
+    for(d=0;d<TBT_DIM;d++) {
+      for(k=0;k<TBT_BATCH;k++) {
+        i = (k < nb) ? b+k : b+nb-1;
+        X.lo[d][k] = sup->lo[d][i];
+        X.hi[d][k] = sup->hi[d][i];
+      }
+    }
+    for(k=0;k<TBT_BATCH;k++) {
+      X.minR[k] = aminR;
+      X.maxR[k] = amaxR;
+      X.minD[k] = aminD;
+      X.maxD[k] = amaxD;
+    }
+
+    /* Test against each model node (skipping the second if */
+    /* the first has ruled out the whole batch).             */
+    tbt_flat_batch_abounds(&X,mlo[0],mhi[0]);
+    any = FALSE;
+    for(k=0;k<nb;k++) {
+      any = any || ((X.minR[k] <= X.maxR[k])&&(X.minD[k] <= X.maxD[k]));
+    }
+    if(any == FALSE) { continue; }
+    tbt_flat_batch_abounds(&X,mlo[1],mhi[1]);
+
+    /* Determine splitting by the relative width of the node... */
+    for(k=0;k<TBT_BATCH;k++) {
+      alpha      = ((X.hi[TBT_T][k] + X.lo[TBT_T][k])/2.0 - tF)/(tL - tF);
+      X.split[k] = 0.0;
+
+      wid        = (1.0-alpha)*radF[TBT_R] + alpha*radL[TBT_R];
+      X.split[k] = (wid < 4.0*((X.hi[TBT_R][k] - X.lo[TBT_R][k])/2.0)) ? 1.0 : X.split[k];
+      wid        = (1.0-alpha)*radF[TBT_VR] + alpha*radL[TBT_VR];
+      X.split[k] = (wid < 4.0*((X.hi[TBT_VR][k] - X.lo[TBT_VR][k])/2.0)) ? 1.0 : X.split[k];
+      wid        = (1.0-alpha)*radF[TBT_D] + alpha*radL[TBT_D];
+      X.split[k] = (wid < 4.0*((X.hi[TBT_D][k] - X.lo[TBT_D][k])/2.0)) ? 1.0 : X.split[k];
+      wid        = (1.0-alpha)*radF[TBT_VD] + alpha*radL[TBT_VD];
+      X.split[k] = (wid < 4.0*((X.hi[TBT_VD][k] - X.lo[TBT_VD][k])/2.0)) ? 1.0 : X.split[k];
+    }
+
+    /* Keep or split the valid nodes (in order). */
+    for(k=0;k<nb;k++) {
+      if((X.minR[k] <= X.maxR[k])&&(X.minD[k] <= X.maxD[k])) {
+        node = sup->nodes[b+k];
+
+        /* If we are at all leaves, split unless the node is a leaf. */
+        if(((X.split[k] > 0.0) || all_leaf) && (tbt_flat_is_leaf(tr,node) == FALSE)) {
+          C.size = 0;
+          tbt_support_add(&C,tr,tbt_flat_right_child(tr,node));
+          tbt_support_add(&C,tr,tbt_flat_left_child(tr,node));
+          added = tbt_flat_test_support(vs,tr,first,last,&C,
+                                        X.minR[k],X.maxR[k],X.minD[k],X.maxD[k],
+                                        nu_support,NULL,NULL);
+        } else {
+          tbt_support_add_batch(nu_support,&X,k,node);
+          added = 1;
+        }
+
+        t = (X.hi[TBT_T][k] + X.lo[TBT_T][k])/2.0;
+        if((count != NULL) && (added >= 1) && (tlast[0] < t)) {
+          tlast[0] = t;
+          count[0]++;
+        }
+        total += added;
+      }
+    }
+  }
+
+  return total;
+}
+
+
+/* This is ONLY called after we have hit a pair of compatible model */
+/* leaf nodes and only called with a set of valid support nodes.    */
+void tbt_flat_leaf_check(vtree_search* vs,
+                         simple_obs_array* obs, track_array* pairs,
+                         tbt_flat* tr, int first, int last, tbt_support* sup_pts,
+                         int min_sup, double fit_rd, double pred_fit,
+                         double last_start_obs_time, double first_end_obs_time,
+                         track_array* res) {
+  ivec* mdl_inds;
+  ivec* sup_inds;
+  int S = sup_pts->size;
+  int i;
+
+  vs->pairs_count++;
+
+  /* Check the time bounds. */
+  if((last_start_obs_time < tbt_flat_lo(tr,TBT_T,first)) ||
+     (first_end_obs_time > tbt_flat_hi(tr,TBT_T,last))) {
+    printf("PRUNING LEAVES ON TIME.\n");
+    return;
+  }
+
+  mdl_inds = mk_ivec(2);
+  ivec_set(mdl_inds,0,tbt_flat_pt(tr,first,0));
+  ivec_set(mdl_inds,1,tbt_flat_pt(tr,last,0));
+  sup_inds = mk_ivec(S);
+  for(i=0;i<S;i++) {
+    ivec_set(sup_inds,i,tbt_flat_pt(tr,sup_pts->nodes[i],0));
+  }
+
+  vtree_leaf_check_tracklets(vs,obs,pairs,mdl_inds,sup_inds,
+                             min_sup,fit_rd,pred_fit,res);
+
+  free_ivec(mdl_inds);
+  free_ivec(sup_inds);
+}
+
+
+void tracklets_linker_recurse(vtree_search* vs,
+                              simple_obs_array* obs, track_array* pairs,
+                              tbt_flat* tr, int first, int last, tbt_support* sup_pts,
                               double aR_min, double aR_max, double aD_min, double aD_max,
                               int min_sup, track_array* res, double fit_rd, double pred_fit,
                               double last_start_obs_time, double first_end_obs_time) {
-  tbt_ptr_array* nu_support = NULL;
-  tbt*           first = tbt_ptr_array_ref(mdl_pts,0);
-  tbt*           last  = tbt_ptr_array_ref(mdl_pts,1);
-  tbt*           curr;
+  tbt_support* nu_support = NULL;
   double aminD = aD_min;
   double amaxD = aD_max;
   double aminR = aR_min;
@@ -1220,61 +1974,55 @@ void tracklets_linker_recurse(simple_obs_array* obs, track_array* pairs,
   double tlast = 0.0;
   int split_ind = -1;
   double split_val = -1.0;
-  int S = tbt_ptr_array_size(sup_pts);
+  int S = sup_pts->size;
   int count = 0;
-  int added;
-  int i;
   bool all_leaf = TRUE;
   bool valid    = TRUE;
   bool madenu   = FALSE;
 
+  vs->nodes++;
+
   /* Check the time constraints. */
-  valid = (tbt_lo_time(first) <= last_start_obs_time);
-  valid = valid && (tbt_hi_time(last) >= first_end_obs_time);
+  valid = (tbt_flat_lo(tr,TBT_T,first) <= last_start_obs_time);
+  valid = valid && (tbt_flat_hi(tr,TBT_T,last) >= first_end_obs_time);
   if (!valid) {
     printf("Pruning on time (%f vs %f) OR (%f vs %f)\n",
-           tbt_lo_time(first), last_start_obs_time,
-           tbt_hi_time(last), first_end_obs_time);
+           tbt_flat_lo(tr,TBT_T,first), last_start_obs_time,
+           tbt_flat_hi(tr,TBT_T,last), first_end_obs_time);
   }
 
-  valid = valid && quad_vtree_pairs_determine_abounds_flat(mdl_pts,&aminR,&amaxR,
-                                                           &aminD,&amaxD);
+  valid = valid && tbt_flat_pair_abounds(tr,first,last,&aminR,&amaxR,
+                                         &aminD,&amaxD);
 
   /* Prune the support trees using the new vbounds (if possible). */
   if(valid==TRUE) {
 
     /* Check if all of the model trees are at leaves. */
     /* And find the largest (nonleaf) tree to split.  */
-    all_leaf  = tbt_is_leaf(first) && tbt_is_leaf(last);
-    if(tbt_is_leaf(first) == FALSE) {
-      split_val = tbt_rad_RA(first)*tbt_rad_DEC(first);
+    all_leaf  = tbt_flat_is_leaf(tr,first) && tbt_flat_is_leaf(tr,last);
+    if(tbt_flat_is_leaf(tr,first) == FALSE) {
+      split_val = tbt_flat_rad(tr,TBT_R,first)*tbt_flat_rad(tr,TBT_D,first);
       split_ind = 0;
     }
-    if(tbt_is_leaf(last) == FALSE) {
-      if(split_val < tbt_rad_RA(last)*tbt_rad_DEC(last)) {
-        split_val = tbt_rad_RA(last)*tbt_rad_DEC(last);
+    if(tbt_flat_is_leaf(tr,last) == FALSE) {
+      if(split_val < tbt_flat_rad(tr,TBT_R,last)*tbt_flat_rad(tr,TBT_D,last)) {
+        split_val = tbt_flat_rad(tr,TBT_R,last)*tbt_flat_rad(tr,TBT_D,last);
         split_ind = 1;
       }
     }
 
     /* Allocate space for the new array. */
-    skip_flip--;
-    if((skip_flip==0) || all_leaf) {
-      skip_flip = 2;
+    vs->skip_flip--;
+    if((vs->skip_flip==0) || all_leaf) {
+      vs->skip_flip = 2;
 
-      nu_support = mk_sized_empty_tbt_ptr_array(S);
+      nu_support = vtree_search_support(vs,S);
       count      = 2;
       madenu     = TRUE;
 
       /* Check if we can remove the whole tree... */
-      for(i=0; i<S; i++) {  
-        curr  = tbt_ptr_array_ref(sup_pts,i);
-        added = test_and_add_support_final(mdl_pts,curr,nu_support,aminR,amaxR,aminD,amaxD);
-      
-        if(added >= 1) {
-          if(tlast < tbt_time(curr)) { tlast = tbt_time(curr); count++; }
-        }
-      }  
+      tbt_flat_test_support(vs,tr,first,last,sup_pts,aminR,amaxR,aminD,amaxD,
+                            nu_support,&tlast,&count);
     } else {
       nu_support = sup_pts;
       count      = min_sup;
@@ -1286,94 +2034,727 @@ void tracklets_linker_recurse(simple_obs_array* obs, track_array* pairs,
   if(count >= min_sup) {
 
     if(all_leaf) {
-      quad_vtree_pairs_leaf_check(obs,pairs,mdl_pts,nu_support,
-                                  min_sup,fit_rd,pred_fit,
-                                  last_start_obs_time,first_end_obs_time,res);
+      tbt_flat_leaf_check(vs,obs,pairs,tr,first,last,nu_support,
+                          min_sup,fit_rd,pred_fit,
+                          last_start_obs_time,first_end_obs_time,res);
+    } else if(split_ind == 0) {
+      tracklets_linker_recurse(vs,obs,pairs,tr,tbt_flat_right_child(tr,first),
+                               last,nu_support,aminR,amaxR,aminD,amaxD,
+                               min_sup,res,fit_rd,pred_fit,
+                               last_start_obs_time,first_end_obs_time);
+      tracklets_linker_recurse(vs,obs,pairs,tr,tbt_flat_left_child(tr,first),
+                               last,nu_support,aminR,amaxR,aminD,amaxD,
+                               min_sup,res,fit_rd,pred_fit,
+                               last_start_obs_time,first_end_obs_time);
     } else {
-      curr = tbt_ptr_array_ref(mdl_pts,split_ind);
-
-      tbt_ptr_array_set(mdl_pts,split_ind,tbt_right_child(curr));
-      tracklets_linker_recurse(obs,pairs,mdl_pts,nu_support,aminR,amaxR,
-                               aminD,amaxD,min_sup,res,fit_rd,pred_fit,
+      tracklets_linker_recurse(vs,obs,pairs,tr,first,
+                               tbt_flat_right_child(tr,last),nu_support,
+                               aminR,amaxR,aminD,amaxD,
+                               min_sup,res,fit_rd,pred_fit,
                                last_start_obs_time,first_end_obs_time);
-      tbt_ptr_array_set(mdl_pts,split_ind,curr);
-
-      tbt_ptr_array_set(mdl_pts,split_ind,tbt_left_child(curr));
-      tracklets_linker_recurse(obs,pairs,mdl_pts,nu_support,aminR,amaxR,
-                               aminD,amaxD,min_sup,res,fit_rd,pred_fit,
+      tracklets_linker_recurse(vs,obs,pairs,tr,first,
+                               tbt_flat_left_child(tr,last),nu_support,
+                               aminR,amaxR,aminD,amaxD,
+                               min_sup,res,fit_rd,pred_fit,
                                last_start_obs_time,first_end_obs_time);
-      tbt_ptr_array_set(mdl_pts,split_ind,curr);
     }
 
   }
 
-  if(madenu && (nu_support != NULL)) { free_tbt_ptr_array(nu_support); }
+  if(madenu && (nu_support != NULL)) { vtree_search_release(vs); }
 }
 
 
 /* Set up the support points and check time bounds validity. */
-void tracklets_linker_prerecurse(simple_obs_array* obs, track_array* pairs,
-                                 tbt_ptr_array* mdl_pts, tbt_ptr_array* sup_pts,
+/* The model nodes are first and last and the support nodes  */
+/* are the plates sup_pts (all nodes of the flat tree tr).   */
+void tracklets_linker_prerecurse(vtree_search* vs,
+                                 simple_obs_array* obs, track_array* pairs,
+                                 tbt_flat* tr, int first, int last, ivec* sup_pts,
                                  double acc_r, double acc_d, int min_sup, 
                                  track_array* res, double fit_rd,
                                  double pred_fit, bool endpts,
                                  double last_start_obs_time,
                                  double first_end_obs_time) {
-  tbt_ptr_array* nu_support = NULL;
-  tbt* sup_tr;
-  tbt* mdl_tr;
+  tbt_support* nu_support = NULL;
+  int mdl[2];
+  int sup_tr;
   double ts, te;
-  int M = tbt_ptr_array_size(mdl_pts);
-  int S = tbt_ptr_array_size(sup_pts);
+  int M = 2;
+  int S = ivec_size(sup_pts);
   int i, j;
   bool valid  = TRUE;
   bool svalid = TRUE;
 
+  mdl[0] = first;
+  mdl[1] = last;
+
   /* Check that the model trees have the minimum time  */
   /* separation and the time bounds.                   */
   if (last_start_obs_time > 0) {
-    valid = valid && (tbt_lo_time(tbt_ptr_array_ref(mdl_pts,0)) <= last_start_obs_time);
+    valid = valid && (tbt_flat_lo(tr,TBT_T,first) <= last_start_obs_time);
   }
   if (first_end_obs_time > 0) {
-    valid = valid && (tbt_hi_time(tbt_ptr_array_ref(mdl_pts,M-1)) >= first_end_obs_time);
+    valid = valid && (tbt_flat_hi(tr,TBT_T,last) >= first_end_obs_time);
   }
   for(i=0;(i<M-1)&&(valid);i++) {
-    valid = (tbt_mid_time(tbt_ptr_array_ref(mdl_pts,i+1)) -
-             tbt_mid_time(tbt_ptr_array_ref(mdl_pts,i)) >= TBT_MIN_TIME);
+    valid = (tbt_flat_mid(tr,TBT_T,mdl[i+1]) -
+             tbt_flat_mid(tr,TBT_T,mdl[i]) >= TBT_MIN_TIME);
   }
 
   /* Next check that the model trees do not overlap the support trees AND */
   /* that the support trees agree with the endpoint constraints.          */
   if(valid) {
-    nu_support = mk_sized_empty_tbt_ptr_array(S);
+    nu_support = vtree_search_support(vs,S);
 
     for(i=0;i<S;i++) {
       svalid = TRUE;
-      sup_tr = tbt_ptr_array_ref(sup_pts,i);
+      sup_tr = ivec_ref(sup_pts,i);
 
       if(endpts) {
-        ts = tbt_hi_time(tbt_ptr_array_ref(mdl_pts,0));
-        te = tbt_lo_time(tbt_ptr_array_ref(mdl_pts,M-1));
-        svalid = (tbt_lo_time(sup_tr) > ts)&&(tbt_hi_time(sup_tr) < te);
+        ts = tbt_flat_hi(tr,TBT_T,first);
+        te = tbt_flat_lo(tr,TBT_T,last);
+        svalid = (tbt_flat_lo(tr,TBT_T,sup_tr) > ts)&&
+                 (tbt_flat_hi(tr,TBT_T,sup_tr) < te);
       }
 
       for(j=0;(j<M)&&(svalid);j++) {
-        mdl_tr = tbt_ptr_array_ref(mdl_pts,j);
-        svalid = (tbt_lo_time(sup_tr) > tbt_hi_time(mdl_tr));
-        svalid = svalid || (tbt_hi_time(sup_tr) < tbt_lo_time(mdl_tr));
+        svalid = (tbt_flat_lo(tr,TBT_T,sup_tr) > tbt_flat_hi(tr,TBT_T,mdl[j]));
+        svalid = svalid || (tbt_flat_hi(tr,TBT_T,sup_tr) < tbt_flat_lo(tr,TBT_T,mdl[j]));
       }
 
-      if(svalid) { tbt_ptr_array_add(nu_support,sup_tr); }
+      if(svalid) { tbt_support_add(nu_support,tr,sup_tr); }
     }
 
-    if(tbt_ptr_array_size(nu_support)+M >= min_sup) {
-      tracklets_linker_recurse(obs, pairs, mdl_pts, nu_support, -acc_r, acc_r,
-                               -acc_d, acc_d, min_sup, res, fit_rd, pred_fit,
+    if(nu_support->size+M >= min_sup) {
+      tracklets_linker_recurse(vs, obs, pairs, tr, first, last, nu_support,
+                               -acc_r, acc_r, -acc_d, acc_d, min_sup, res,
+                               fit_rd, pred_fit,
                                last_start_obs_time, first_end_obs_time);
     }
 
-    free_tbt_ptr_array(nu_support);
+    vtree_search_release(vs);
+  }
+}
+
+
+/* The plate pairs of a vtree search and the (read only) data that */
+/* every pair's search uses.                                      */
+typedef struct vtree_pair_job {
+  simple_obs_array* obs;
+  track_array* pairs;
+  tbt_flat* tree;               /* The flattened tracklet tree.       */
+  ivec* plates;                 /* Its plate subtrees, in time order. */
+  double acc_r;
+  double acc_d;
+  int min_sup;
+  double fit_rd;
+  double pred_fit;
+  bool endpts;
+  double last_start_obs_time;
+  double first_end_obs_time;
+  vtree_run_opts run;           /* Threads, progress and checkpoints. */
+
+  /* Pair k models the plates pair_first[k] and pair_last[k].  Only */
+  /* the pairs in order are searched, in that order (most expensive */
+  /* first).                                                        */
+  int num_pairs;
+  ivec* pair_first;
+  ivec* pair_last;
+  dyv* pair_cost;
+  ivec* order;
+
+  /* Work distribution.  pair_res[k] holds pair k's tracks. */
+  int next_pair;
+  track_array** pair_res;
+#ifdef USE_PTHREADS
+  pthread_mutex_t lock;
+#endif
+
+  /* Progress (updated as each pair finishes). */
+  double t_start;
+  double t_report;
+  int done_pairs;
+  double done_cost;
+  double total_cost;
+  long num_tracks;
+  long nodes;
+
+  /* Checkpointing (see vtree_run_opts): the open checkpoint file */
+  /* and the time it was last flushed.                             */
+  FILE* ckpt;
+  double t_ckpt;
+
+  /* If not NULL, each pair's tracks go here instead of pair_res. */
+  track_spill* spill;
+} vtree_pair_job;
+
+
+double linker_wall_seconds(void) {
+  struct timeval tv;
+
+  gettimeofday(&tv, NULL);
+  return (double)tv.tv_sec + 1e-6 * (double)tv.tv_usec;
+}
+
+
+/* A rough estimate of the work needed to search each plate pair.  */
+/* The search visits roughly (model tree depth + the expected       */
+/* number of last plate tracklets that a first plate tracklet can   */
+/* reach) nodes for each support tracklet.  The reachable fraction  */
+/* comes from the box a tracklet can reach by the last plate, which */
+/* grows with the time separation (velocity error and accel bound). */
+/* Pairs that fail the time or support tests cost 0.                */
+dyv* mk_vtree_pair_costs(vtree_pair_job* job, dym* tb_arr) {
+  tbt_flat* tr = job->tree;
+  int T = ivec_size(job->plates);
+  int N = dym_rows(tb_arr);
+  dyv* costs = mk_zero_dyv(job->num_pairs);
+  ivec* cum  = mk_zero_ivec(T+1);
+  double wR = 0.0, wD = 0.0, wvR = 0.0, wvD = 0.0;
+  double dt, bR, bD, area, frac, sup, depth;
+  int F, L;
+  int i, j, k;
+
+  /* The mean widths of the tracklets' position and velocity bounds. */
+  for(i=0;i<N;i++) {
+    wR  += dym_ref(tb_arr,i,TBP_R_H)  - dym_ref(tb_arr,i,TBP_R_L);
+    wD  += dym_ref(tb_arr,i,TBP_D_H)  - dym_ref(tb_arr,i,TBP_D_L);
+    wvR += dym_ref(tb_arr,i,TBP_VR_H) - dym_ref(tb_arr,i,TBP_VR_L);
+    wvD += dym_ref(tb_arr,i,TBP_VD_H) - dym_ref(tb_arr,i,TBP_VD_L);
+  }
+  if(N > 0) { wR /= N; wD /= N; wvR /= N; wvD /= N; }
+
+  /* cum[i] = the number of tracklets on plates before i. */
+  for(i=0;i<T;i++) {
+    ivec_set(cum,i+1,ivec_ref(cum,i) + tbt_flat_N(tr,ivec_ref(job->plates,i)));
+  }
+
+  for(k=0;k<job->num_pairs;k++) {
+    i  = ivec_ref(job->pair_first,k);
+    j  = ivec_ref(job->pair_last,k);
+    F  = ivec_ref(job->plates,i);
+    L  = ivec_ref(job->plates,j);
+    dt = tbt_flat_mid(tr,TBT_T,L) - tbt_flat_mid(tr,TBT_T,F);
+
+    if(dt < TBT_MIN_TIME) { continue; }
+    if((job->last_start_obs_time > 0) &&
+       (tbt_flat_lo(tr,TBT_T,F) > job->last_start_obs_time)) { continue; }
+    if((job->first_end_obs_time > 0) &&
+       (tbt_flat_hi(tr,TBT_T,L) < job->first_end_obs_time)) { continue; }
+
+    if(job->endpts) {
+      sup = (double)(ivec_ref(cum,j) - ivec_ref(cum,i+1));
+      if(j - i + 1 < job->min_sup) { continue; }
+    } else {
+      sup = (double)(ivec_ref(cum,T) - tbt_flat_N(tr,F) - tbt_flat_N(tr,L));
+      if(T < job->min_sup) { continue; }
+    }
+
+    bR   = wR + wvR*dt + job->acc_r*dt*dt;
+    bD   = wD + wvD*dt + job->acc_d*dt*dt;
+    area = (tbt_flat_hi(tr,TBT_R,L) - tbt_flat_lo(tr,TBT_R,L) + bR) *
+           (tbt_flat_hi(tr,TBT_D,L) - tbt_flat_lo(tr,TBT_D,L) + bD);
+    frac  = (area > 0.0) ? real_min(1.0, bR*bD/area) : 1.0;
+    depth = log((double)(1 + tbt_flat_N(tr,F))) + log((double)(1 + tbt_flat_N(tr,L)));
+    depth = depth / log(2.0);
+
+    dyv_set(costs,k,(1.0 + sup) * (depth + frac*tbt_flat_N(tr,L)));
+  }
+
+  free_ivec(cum);
+
+  return costs;
+}
+
+
+/* Report the progress to stderr (in the format of the MOPS timing */
+/* messages) and to the status file.  Called with the lock held.   */
+void vtree_report_progress(vtree_pair_job* job, double now) {
+  double elapsed = now - job->t_start;
+  double left    = 0.0;
+  char* tmpname;
+  FILE* fp;
+
+  if(job->done_cost > 0.0) {
+    left = elapsed * (job->total_cost - job->done_cost) / job->done_cost;
+  }
+
+  fprintf(stderr, "TIMING LINKTRACKLETS/VTREE %.3f 0 # pairs %i/%i tracks %li "
+          "nodes %li eta %.0f\n", elapsed, job->done_pairs,
+          ivec_size(job->order), job->num_tracks, job->nodes, left);
+  fflush(stderr);
+
+  /* Write the status under a temporary name and rename it, so that */
+  /* a reader never sees a half written file.                       */
+  if(job->run.status_file != NULL) {
+    tmpname = mk_printf("%s.tmp", job->run.status_file);
+    fp = fopen(tmpname, "w");
+    if(fp != NULL) {
+      fprintf(fp, "pairs_done %i\n", job->done_pairs);
+      fprintf(fp, "pairs_total %i\n", ivec_size(job->order));
+      fprintf(fp, "tracks %li\n", job->num_tracks);
+      fprintf(fp, "nodes %li\n", job->nodes);
+      fprintf(fp, "elapsed %.3f\n", elapsed);
+      fprintf(fp, "remaining %.3f\n", left);
+      fprintf(fp, "finish %.3f\n", now + left);
+      if(fclose(fp) == 0) {
+        rename(tmpname, job->run.status_file);
+      }
+    }
+    free_string(tmpname);
+  }
+
+  job->t_report = now;
+}
+
+
+/* A checkpoint file is this header followed by one record (of ints) */
+/* for each finished plate pair: the pair number k, its number of     */
+/* tracks, each track's number of detections and their indices, and  */
+/* then k again.  Records are appended as the search goes, so a run   */
+/* that is killed leaves the pairs it has finished (a record that was */
+/* cut short at the end of the file is ignored).                      */
+#define VTREE_CKPT_MAGIC      "MOPSVCK"
+#define VTREE_CKPT_VERSION    1
+#define VTREE_CKPT_BYTE_ORDER 0x01020304
+
+typedef struct vtree_ckpt_header
+{
+  char magic[8];           /* VTREE_CKPT_MAGIC                        */
+  int  version;            /* VTREE_CKPT_VERSION                      */
+  int  byte_order;         /* VTREE_CKPT_BYTE_ORDER as written        */
+  int  header_size;        /* sizeof(vtree_ckpt_header)               */
+  int  num_pairs;          /* All of the plate pairs.                 */
+  int  num_search;         /* The pairs that this run searches.       */
+  int  num_obs;
+  int  num_tracklets;
+  unsigned int hash;       /* vtree_ckpt_hash of the search.          */
+} vtree_ckpt_header;
+
+
+/* FNV-1a hash of size bytes, continuing from h. */
+unsigned int vtree_ckpt_hash_bytes(unsigned int h, void* data, int size) {
+  unsigned char* b = (unsigned char*)data;
+  int i;
+
+  for(i=0;i<size;i++) {
+    h = (h ^ b[i]) * 16777619u;
+  }
+
+  return h;
+}
+
+
+/* A hash of what the pairs' tracks depend on: the detections, the */
+/* tracklets, the tree (and so the tracklets' bounds), the search   */
+/* parameters and the pairs searched.                               */
+unsigned int vtree_ckpt_hash(vtree_pair_job* job) {
+  unsigned int h = 2166136261u;
+  tbt_flat* tr = job->tree;
+  simple_obs* X;
+  ivec* inds;
+  double params[8];
+  double x;
+  int i, k, d;
+
+  for(i=0;i<simple_obs_array_size(job->obs);i++) {
+    X = simple_obs_array_ref(job->obs,i);
+    x = simple_obs_time(X); h = vtree_ckpt_hash_bytes(h, &x, sizeof(double));
+    x = simple_obs_RA(X);   h = vtree_ckpt_hash_bytes(h, &x, sizeof(double));
+    x = simple_obs_DEC(X);  h = vtree_ckpt_hash_bytes(h, &x, sizeof(double));
+  }
+  for(i=0;i<track_array_size(job->pairs);i++) {
+    inds = track_individs(track_array_ref(job->pairs,i));
+    for(k=0;k<ivec_size(inds);k++) {
+      d = ivec_ref(inds,k);
+      h = vtree_ckpt_hash_bytes(h, &d, sizeof(int));
+    }
+  }
+
+  for(d=0;d<TBT_DIM;d++) {
+    h = vtree_ckpt_hash_bytes(h, tr->lo[d], tr->num_nodes * sizeof(double));
+    h = vtree_ckpt_hash_bytes(h, tr->hi[d], tr->num_nodes * sizeof(double));
+  }
+  h = vtree_ckpt_hash_bytes(h, tr->pts, tr->num_pts * sizeof(int));
+
+  params[0] = job->acc_r;
+  params[1] = job->acc_d;
+  params[2] = (double)job->min_sup;
+  params[3] = job->fit_rd;
+  params[4] = job->pred_fit;
+  params[5] = job->endpts ? 1.0 : 0.0;
+  params[6] = job->last_start_obs_time;
+  params[7] = job->first_end_obs_time;
+  h = vtree_ckpt_hash_bytes(h, params, 8 * sizeof(double));
+
+  for(i=0;i<ivec_size(job->order);i++) {
+    k = ivec_ref(job->order,i);
+    d = ivec_ref(job->plates,ivec_ref(job->pair_first,k));
+    h = vtree_ckpt_hash_bytes(h, &d, sizeof(int));
+    d = ivec_ref(job->plates,ivec_ref(job->pair_last,k));
+    h = vtree_ckpt_hash_bytes(h, &d, sizeof(int));
+  }
+
+  return h;
+}
+
+
+void vtree_ckpt_make_header(vtree_pair_job* job, vtree_ckpt_header* H) {
+  memset(H, 0, sizeof(vtree_ckpt_header));
+  strcpy(H->magic, VTREE_CKPT_MAGIC);
+  H->version       = VTREE_CKPT_VERSION;
+  H->byte_order    = VTREE_CKPT_BYTE_ORDER;
+  H->header_size   = sizeof(vtree_ckpt_header);
+  H->num_pairs     = job->num_pairs;
+  H->num_search    = ivec_size(job->order);
+  H->num_obs       = simple_obs_array_size(job->obs);
+  H->num_tracklets = track_array_size(job->pairs);
+  H->hash          = vtree_ckpt_hash(job);
+}
+
+
+/* Append the record of pair k (whose tracks are in job->pair_res). */
+bool vtree_ckpt_write_pair(FILE* fp, vtree_pair_job* job, int k) {
+  track_array* res = job->pair_res[k];
+  ivec* inds;
+  bool ok;
+  int n = track_array_size(res);
+  int i, j, x;
+
+  ok = (fwrite(&k, sizeof(int), 1, fp) == 1) &&
+       (fwrite(&n, sizeof(int), 1, fp) == 1);
+  for(i=0;ok&&(i<n);i++) {
+    inds = track_individs(track_array_ref(res,i));
+    x    = ivec_size(inds);
+    ok   = (fwrite(&x, sizeof(int), 1, fp) == 1);
+    for(j=0;ok&&(j<ivec_size(inds));j++) {
+      x  = ivec_ref(inds,j);
+      ok = (fwrite(&x, sizeof(int), 1, fp) == 1);
+    }
+  }
+  ok = ok && (fwrite(&k, sizeof(int), 1, fp) == 1);
+
+  return ok;
+}
+
+
+/* Read the next record.  Returns NULL at the end of the file or if   */
+/* the record is cut short or invalid (a pair that is not searched,   */
+/* or was already read, or a detection that is not in obs); otherwise */
+/* sets k and returns the pair's tracks.  todo[k] is 1 for the pairs  */
+/* that are searched and not yet read.                                */
+track_array* mk_vtree_ckpt_read_pair(FILE* fp, vtree_pair_job* job,
+                                     ivec* todo, int* k) {
+  track_array* res = NULL;
+  int N = simple_obs_array_size(job->obs);
+  ivec* inds;
+  bool ok;
+  int n, m, i, j, x;
+
+  ok = (fread(k, sizeof(int), 1, fp) == 1) &&
+       (fread(&n, sizeof(int), 1, fp) == 1);
+  ok = ok && (k[0] >= 0) && (k[0] < job->num_pairs) && (n >= 0) &&
+       (ivec_ref(todo,k[0]) == 1);
+
+  if(ok) {
+    res = mk_empty_track_array(int_max(n,1));
+    for(i=0;ok&&(i<n);i++) {
+      ok = (fread(&m, sizeof(int), 1, fp) == 1) && (m > 0) && (m <= N);
+      if(ok) {
+        inds = mk_ivec(m);
+        for(j=0;ok&&(j<m);j++) {
+          ok = (fread(&x, sizeof(int), 1, fp) == 1) && (x >= 0) && (x < N);
+          if(ok) { ivec_set(inds,j,x); }
+        }
+        if(ok) { track_array_add_no_copy(res,mk_track_from_N_inds(job->obs,inds)); }
+        free_ivec(inds);
+      }
+    }
+    ok = ok && (fread(&x, sizeof(int), 1, fp) == 1) && (x == k[0]);
+    if(!ok) {
+      free_track_array(res);
+      res = NULL;
+    }
+  }
+
+  return res;
+}
+
+
+/* Start checkpointing the search of job->order (job->pair_res must  */
+/* be set up).  If resuming, the pairs in a valid checkpoint file of */
+/* the same search are taken from it (into pair_res or job->spill)   */
+/* and removed from job->order.                                      */
+/* Then the checkpoint file is rewritten with those pairs (under a   */
+/* temporary name that is then renamed) and left open for the rest.  */
+void vtree_ckpt_start(vtree_pair_job* job) {
+  char* tmpname = mk_printf("%s.tmp", job->run.ckpt_file);
+  vtree_ckpt_header H;
+  vtree_ckpt_header old;
+  track_array* res;
+  ivec* todo;
+  ivec* left;
+  ivec* done = mk_ivec(0);
+  long num_tracks = 0;
+  FILE* fp;
+  bool ok;
+  int p, k;
+
+  job->ckpt   = NULL;
+  job->t_ckpt = linker_wall_seconds();
+  vtree_ckpt_make_header(job, &H);
+
+  /* Read the finished pairs. */
+  fp = job->run.ckpt_resume ? fopen(job->run.ckpt_file,"rb") : NULL;
+  if(job->run.ckpt_resume && (fp == NULL)) {
+    printf("No checkpoint %s yet.\n", job->run.ckpt_file);
+  }
+  if(fp != NULL) {
+    ok = (fread(&old, sizeof(vtree_ckpt_header), 1, fp) == 1) &&
+         (memcmp(&old, &H, sizeof(vtree_ckpt_header)) == 0);
+    if(!ok) {
+      printf("WARNING: The checkpoint %s is not from this search; "
+             "starting over.\n", job->run.ckpt_file);
+    } else {
+      todo = mk_zero_ivec(int_max(job->num_pairs,1));
+      for(p=0;p<ivec_size(job->order);p++) {
+        ivec_set(todo,ivec_ref(job->order,p),1);
+      }
+      while((res = mk_vtree_ckpt_read_pair(fp, job, todo, &k)) != NULL) {
+        job->pair_res[k] = res;
+        ivec_set(todo,k,2);
+        add_to_ivec(done,k);
+        num_tracks += track_array_size(res);
+      }
+      free_ivec(todo);
+    }
+    fclose(fp);
+  }
+
+  if(ivec_size(done) > 0) {
+    printf("Resuming: %i of %i plate pairs (%li tracks) were done.\n",
+           ivec_size(done), ivec_size(job->order), num_tracks);
+    left = mk_ivec(0);
+    for(p=0;p<ivec_size(job->order);p++) {
+      k = ivec_ref(job->order,p);
+      if(job->pair_res[k] == NULL) {
+        add_to_ivec(left,k);
+      } else {
+        job->total_cost -= dyv_ref(job->pair_cost,k);
+      }
+    }
+    free_ivec(job->order);
+    job->order = left;
+  }
+
+  /* Rewrite the file with what is done so far. */
+  fp = fopen(tmpname,"wb");
+  ok = (fp != NULL) && (fwrite(&H, sizeof(vtree_ckpt_header), 1, fp) == 1);
+  for(p=0;ok&&(p<ivec_size(done));p++) {
+    ok = vtree_ckpt_write_pair(fp, job, ivec_ref(done,p));
+  }
+  ok = ok && (fflush(fp) == 0) && (rename(tmpname, job->run.ckpt_file) == 0);
+  if(ok) {
+    job->ckpt = fp;
+  } else {
+    printf("WARNING: Unable to write the checkpoint %s.\n",
+           job->run.ckpt_file);
+    if(fp != NULL) { fclose(fp); }
+  }
+
+  /* The pairs' tracks go on as if they had just been searched. */
+  for(p=0;(job->spill!=NULL)&&(p<ivec_size(done));p++) {
+    k = ivec_ref(done,p);
+    track_spill_add(job->spill, job->pair_res[k], k);
+    free_track_array(job->pair_res[k]);
+    job->pair_res[k] = NULL;
+  }
+
+  free_ivec(done);
+  free_string(tmpname);
+}
+
+
+/* Append pair k (if k >= 0) to the checkpoint and flush the file if */
+/* it is time to (or if flush).  Called with the lock held (or after  */
+/* the workers are done).                                             */
+void vtree_ckpt_add_pair(vtree_pair_job* job, int k, double now, bool flush) {
+  bool ok = TRUE;
+
+  if(k >= 0) {
+    ok = vtree_ckpt_write_pair(job->ckpt, job, k);
+  }
+  if(ok && (flush || (now - job->t_ckpt >= job->run.ckpt_every))) {
+    ok          = (fflush(job->ckpt) == 0);
+    job->t_ckpt = now;
+  }
+  if(!ok) {
+    printf("WARNING: Unable to write the checkpoint %s; not checkpointing "
+           "any more.\n", job->run.ckpt_file);
+    fclose(job->ckpt);
+    job->ckpt = NULL;
+  }
+}
+
+
+/* Search plate pair k, adding the tracks found to res.  Returns */
+/* the number of tree nodes visited.                             */
+long vtree_search_pair(vtree_pair_job* job, int k, track_array* res) {
+  vtree_search vs;
+
+  vtree_search_init(&vs);
+  tracklets_linker_prerecurse(&vs, job->obs, job->pairs, job->tree,
+                              ivec_ref(job->plates,ivec_ref(job->pair_first,k)),
+                              ivec_ref(job->plates,ivec_ref(job->pair_last,k)),
+                              job->plates,
+                              job->acc_r, job->acc_d, job->min_sup, res,
+                              job->fit_rd, job->pred_fit, job->endpts,
+                              job->last_start_obs_time,
+                              job->first_end_obs_time);
+  vtree_search_free(&vs);
+
+  return vs.nodes;
+}
+
+
+/* Worker: repeatedly grab the next unclaimed plate pair (in cost */
+/* order) and fill that pair's own result array.  The pairs'      */
+/* costs differ by orders of magnitude, so they are handed out    */
+/* one at a time.                                                 */
+void* vtree_pair_worker(void* arg) {
+  vtree_pair_job* job = (vtree_pair_job*)arg;
+  track_array* res;
+  double now;
+  long nodes;
+  int p, k;
+
+  while(TRUE) {
+#ifdef USE_PTHREADS
+    pthread_mutex_lock(&job->lock);
+#endif
+    p = job->next_pair;
+    job->next_pair += 1;
+#ifdef USE_PTHREADS
+    pthread_mutex_unlock(&job->lock);
+#endif
+
+    if(p >= ivec_size(job->order)) { break; }
+    k = ivec_ref(job->order,p);
+
+    res   = mk_empty_track_array(10);
+    nodes = vtree_search_pair(job, k, res);
+    job->pair_res[k] = res;
+
+#ifdef USE_PTHREADS
+    pthread_mutex_lock(&job->lock);
+#endif
+    job->done_pairs += 1;
+    job->done_cost  += dyv_ref(job->pair_cost,k);
+    job->num_tracks += track_array_size(res);
+    job->nodes      += nodes;
+    if((job->run.progress > 0.0) || (job->ckpt != NULL)) {
+      now = linker_wall_seconds();
+      if((job->run.progress > 0.0) &&
+         (now - job->t_report >= job->run.progress)) {
+        vtree_report_progress(job, now);
+      }
+      if(job->ckpt != NULL) {
+        vtree_ckpt_add_pair(job, k, now, FALSE);
+      }
+    }
+    if(job->spill != NULL) {
+      track_spill_add(job->spill, res, k);
+      free_track_array(res);
+      job->pair_res[k] = NULL;
+    }
+#ifdef USE_PTHREADS
+    pthread_mutex_unlock(&job->lock);
+#endif
+  }
+
+  return NULL;
+}
+
+
+/* Search the plate pairs in job->order, splitting them over the    */
+/* job's threads.  The per-pair results are merged in pair          */
+/* order so the output does not depend on the number of threads (or */
+/* on the cost estimates).  If pair_ids is not NULL the pair of     */
+/* each result track is appended to it.                             */
+void vtree_run_pairs(vtree_pair_job* job, track_array* res, ivec* pair_ids) {
+  int k, i;
+
+  job->next_pair  = 0;
+  job->done_pairs = 0;
+  job->done_cost  = 0.0;
+  job->num_tracks = 0;
+  job->nodes      = 0;
+  job->t_start    = linker_wall_seconds();
+  job->t_report   = job->t_start;
+  job->pair_res   = AM_MALLOC_ARRAY(track_array*, int_max(job->num_pairs,1));
+  for(k=0;k<job->num_pairs;k++) { job->pair_res[k] = NULL; }
+  job->ckpt       = NULL;
+  if(job->run.ckpt_file != NULL) {
+    vtree_ckpt_start(job);
+  }
+
+#ifdef USE_PTHREADS
+  pthread_mutex_init(&job->lock, NULL);
+#endif
+  run_worker_threads(vtree_pair_worker, job,
+                     int_min(job->run.threads, ivec_size(job->order)));
+#ifdef USE_PTHREADS
+  pthread_mutex_destroy(&job->lock);
+#endif
+
+  if(job->run.progress > 0.0) {
+    vtree_report_progress(job, linker_wall_seconds());
+  }
+  if(job->ckpt != NULL) {
+    vtree_ckpt_add_pair(job, -1, linker_wall_seconds(), TRUE);
+  }
+  if(job->ckpt != NULL) {
+    fclose(job->ckpt);
+    job->ckpt = NULL;
+  }
+
+  for(k=0;k<job->num_pairs;k++) {
+    if(job->pair_res[k] != NULL) {
+      for(i=0;(pair_ids!=NULL)&&(i<track_array_size(job->pair_res[k]));i++) {
+        add_to_ivec(pair_ids,k);
+      }
+      track_array_add_all(res, job->pair_res[k]);
+      free_track_array(job->pair_res[k]);
+    }
   }
+  AM_FREE_ARRAY(job->pair_res, track_array*, int_max(job->num_pairs,1));
+  job->pair_res = NULL;
+}
+
+
+/* Split the pairs (given most expensive first in order) into       */
+/* num_shards shards of about the same total cost: each pair goes to */
+/* the shard with the least cost so far (the lowest numbered one on  */
+/* ties).  Returns each pair's shard.                                */
+ivec* mk_vtree_pair_shards(dyv* costs, ivec* order, int num_shards) {
+  ivec* shard = mk_constant_ivec(dyv_size(costs), 0);
+  dyv* load   = mk_zero_dyv(num_shards);
+  int p, k, s, best;
+
+  for(p=0;p<ivec_size(order);p++) {
+    k    = ivec_ref(order,p);
+    best = 0;
+    for(s=1;s<num_shards;s++) {
+      if(dyv_ref(load,s) < dyv_ref(load,best)) { best = s; }
+    }
+    ivec_set(shard,k,best);
+    dyv_set(load,best,dyv_ref(load,best) + dyv_ref(costs,k));
+  }
+
+  free_dyv(load);
+
+  return shard;
 }
 
 
@@ -1381,44 +2762,218 @@ track_array* mk_vtrees_tracks(simple_obs_array* obs, track_array* pairs,
                               double thresh, double acc_r, double acc_d,
                               int min_sup, int K, double fit_rd, double pred_fit,
                               bool endpts, double plate_width,
-                              double last_start_obs_time, double first_end_obs_time) {
-  track_array*   res = mk_empty_track_array(10);
+                              double last_start_obs_time, double first_end_obs_time,
+                              vtree_run_opts* run) {
+  return mk_vtrees_tracks_shard(obs, pairs, thresh, acc_r, acc_d, min_sup, K,
+                                fit_rd, pred_fit, endpts, plate_width,
+                                last_start_obs_time, first_end_obs_time,
+                                0, 1, NULL, NULL, run);
+}
+
+
+/* Set up the job's parameters (everything but the tree and the */
+/* plate pairs).  run may be NULL (the defaults).                */
+void vtree_pair_job_init(vtree_pair_job* job,
+                         simple_obs_array* obs, track_array* pairs,
+                         double acc_r, double acc_d, int min_sup,
+                         double fit_rd, double pred_fit, bool endpts,
+                         double last_start_obs_time,
+                         double first_end_obs_time, vtree_run_opts* run) {
+  job->obs                 = obs;
+  job->pairs               = pairs;
+  job->acc_r               = acc_r;
+  job->acc_d               = acc_d;
+  job->min_sup             = min_sup;
+  job->fit_rd              = fit_rd;
+  job->pred_fit            = pred_fit;
+  job->endpts              = endpts;
+  job->last_start_obs_time = last_start_obs_time;
+  job->first_end_obs_time  = first_end_obs_time;
+  vtree_run_opts_init(&job->run);
+  if(run != NULL) { job->run = *run; }
+  if(job->run.threads < 1)      { job->run.threads = 1; }
+  if(job->run.progress < 0.0)   { job->run.progress = 0.0; }
+  if(job->run.ckpt_every < 0.0) { job->run.ckpt_every = 0.0; }
+  if((job->run.status_file != NULL) && (job->run.status_file[0] == '\0')) {
+    job->run.status_file = NULL;
+  }
+  if((job->run.ckpt_file != NULL) && (job->run.ckpt_file[0] == '\0')) {
+    job->run.ckpt_file = NULL;
+  }
+  job->spill               = NULL;
+  job->pair_first          = mk_ivec(0);
+  job->pair_last           = mk_ivec(0);
+  job->pair_res            = NULL;
+}
+
+
+/* Search the job's plate pairs (or only shard's share of them), */
+/* adding the tracks found to res, and free the pair lists.      */
+void vtree_search_job_pairs(vtree_pair_job* job, dym* tb_arr,
+                            int shard, int num_shards,
+                            track_array* res, ivec* pair_ids) {
+  dyv*  neg_cost;
+  ivec* order;
+  ivec* shards;
+  int   p;
+
+  job->num_pairs = ivec_size(job->pair_first);
+
+  /* Estimate the pairs' costs and search the largest first. */
+  job->pair_cost = mk_vtree_pair_costs(job, tb_arr);
+  neg_cost       = mk_dyv_scalar_mult(job->pair_cost, -1.0);
+  order          = mk_ivec_sorted_dyv_indices(neg_cost);
+  free_dyv(neg_cost);
+
+  /* Keep only this shard's pairs. */
+  if(num_shards > 1) {
+    shards     = mk_vtree_pair_shards(job->pair_cost, order, num_shards);
+    job->order = mk_ivec(0);
+    for(p=0;p<ivec_size(order);p++) {
+      if(ivec_ref(shards,ivec_ref(order,p)) == shard) {
+        add_to_ivec(job->order,ivec_ref(order,p));
+      }
+    }
+    free_ivec(shards);
+    free_ivec(order);
+  } else {
+    job->order = order;
+  }
+
+  job->total_cost = 0.0;
+  for(p=0;p<ivec_size(job->order);p++) {
+    job->total_cost += dyv_ref(job->pair_cost,ivec_ref(job->order,p));
+  }
+
+  // printf(">> Starting the VTREE run ("); printf(curr_time()); printf(")\n");
+  vtree_run_pairs(job, res, pair_ids);
+
+  free_ivec(job->pair_first);
+  free_ivec(job->pair_last);
+  free_dyv(job->pair_cost);
+  free_ivec(job->order);
+}
+
+
+/* The vtree search over all of the (first, last) plate pairs (or */
+/* shard's share of them).  The tracks go to spill if it is not   */
+/* NULL and are otherwise added to res.                            */
+void vtree_search_all_pairs(simple_obs_array* obs, track_array* pairs,
+                            double thresh, double acc_r, double acc_d,
+                            int min_sup, double fit_rd, double pred_fit,
+                            bool endpts, double plate_width,
+                            double last_start_obs_time,
+                            double first_end_obs_time,
+                            int shard, int num_shards, track_spill* spill,
+                            track_array* res, ivec* pair_ids,
+                            int* num_pairs, vtree_run_opts* run) {
+  vtree_pair_job job;
   dym*           tb_arr;
-  tbt_ptr_array* tr_arr;
-  tbt_ptr_array* mdl;
   tbt*           tr;
   int            T;
   int            i,j;
 
-  skip_flip = 2;
-
   /* Turn the tracklets into bounding boxes and build a tree  */
-  /* on the points.  Turn this tree into an array of subtrees */
-  /* with time width = 0.                                     */
+  /* on the points.  The search uses a flat copy of the tree  */
+  /* and its subtrees with time width = 0 (the plates).       */
   // printf(">> Bounding the tracklets ("); printf(curr_time()); printf(")\n");
   tb_arr = mk_tracklet_bounds(obs,pairs,thresh,plate_width);
   tr = mk_tbt(tb_arr,NULL,TRUE,1);
-  tr_arr = mk_empty_tbt_ptr_array();
-  fill_plate_tbt_ptr_array(tr,tr_arr);
-  T = tbt_ptr_array_size(tr_arr);
-  free_dym(tb_arr);
+  job.tree   = mk_tbt_flat(tr);
+  job.plates = mk_tbt_flat_plates(job.tree);
+  T = ivec_size(job.plates);
+  free_tbt(tr);
 
-  // printf(">> Starting the VTREE run ("); printf(curr_time()); printf(")\n");
-  mdl = mk_sized_empty_tbt_ptr_array(2);
+  /* Each (first, last) pair of plates is an independent search */
+  /* over the (read only) trees.                                */
+  vtree_pair_job_init(&job, obs, pairs, acc_r, acc_d, min_sup, fit_rd,
+                      pred_fit, endpts, last_start_obs_time,
+                      first_end_obs_time, run);
+  job.spill = spill;
   for(i=0;i<T;i++) {
     for(j=i+1;j<T;j++) {
-      tbt_ptr_array_set(mdl,0,tbt_ptr_array_ref(tr_arr,i));
-      tbt_ptr_array_set(mdl,1,tbt_ptr_array_ref(tr_arr,j));      
+      add_to_ivec(job.pair_first,i);
+      add_to_ivec(job.pair_last,j);
+    }
+  }
+  if(num_pairs != NULL) { *num_pairs = ivec_size(job.pair_first); }
+
+  vtree_search_job_pairs(&job, tb_arr, shard, num_shards, res, pair_ids);
+
+  free_dym(tb_arr);
+  free_ivec(job.plates);
+  free_tbt_flat(job.tree);
+}
 
-      tracklets_linker_prerecurse(obs, pairs, mdl, tr_arr, acc_r, acc_d,
-                                  min_sup, res, fit_rd, pred_fit, endpts,
-                                  last_start_obs_time, first_end_obs_time);
+
+track_array* mk_vtrees_tracks_shard(simple_obs_array* obs, track_array* pairs,
+                                    double thresh, double acc_r, double acc_d,
+                                    int min_sup, int K, double fit_rd,
+                                    double pred_fit, bool endpts,
+                                    double plate_width,
+                                    double last_start_obs_time,
+                                    double first_end_obs_time,
+                                    int shard, int num_shards,
+                                    ivec* pair_ids, int* num_pairs,
+                                    vtree_run_opts* run) {
+  track_array* res = mk_empty_track_array(10);
+
+  vtree_search_all_pairs(obs, pairs, thresh, acc_r, acc_d, min_sup, fit_rd,
+                         pred_fit, endpts, plate_width, last_start_obs_time,
+                         first_end_obs_time, shard, num_shards, NULL, res,
+                         pair_ids, num_pairs, run);
+
+  return res;
+}
+
+
+void vtrees_tracks_to_spill(simple_obs_array* obs, track_array* pairs,
+                            double thresh, double acc_r, double acc_d,
+                            int min_sup, double fit_rd, double pred_fit,
+                            bool endpts, double plate_width,
+                            double last_start_obs_time,
+                            double first_end_obs_time, track_spill* spill,
+                            vtree_run_opts* run) {
+  track_array* res = mk_empty_track_array(1);
+
+  vtree_search_all_pairs(obs, pairs, thresh, acc_r, acc_d, min_sup, fit_rd,
+                         pred_fit, endpts, plate_width, last_start_obs_time,
+                         first_end_obs_time, 0, 1, spill, res, NULL, NULL,
+                         run);
+  free_track_array(res);
+}
+
+
+track_array* mk_vtrees_tracks_plates(simple_obs_array* obs, track_array* pairs,
+                                     dym* tb_arr, tbt_flat* tree, ivec* plates,
+                                     ivec* changed,
+                                     double acc_r, double acc_d, int min_sup,
+                                     double fit_rd, double pred_fit,
+                                     bool endpts, double last_start_obs_time,
+                                     double first_end_obs_time,
+                                     vtree_run_opts* run) {
+  track_array*   res = mk_empty_track_array(10);
+  vtree_pair_job job;
+  int            T = ivec_size(plates);
+  int            i, j, next;
+
+  job.tree   = tree;
+  job.plates = plates;
+  vtree_pair_job_init(&job, obs, pairs, acc_r, acc_d, min_sup, fit_rd,
+                      pred_fit, endpts, last_start_obs_time,
+                      first_end_obs_time, run);
+
+  /* Only the pairs with a changed plate between (or at) */
+  /* their ends: next = the first changed plate >= i.    */
+  for(i=0;i<T;i++) {
+    for(next=i;(next<T)&&(ivec_ref(changed,next)==0);next++);
+    for(j=int_max(i+1,next);j<T;j++) {
+      add_to_ivec(job.pair_first,i);
+      add_to_ivec(job.pair_last,j);
     }
   }
 
-  free_tbt_ptr_array(tr_arr);
-  free_tbt_ptr_array(mdl);
-  free_tbt(tr);
+  vtree_search_job_pairs(&job, tb_arr, 0, 1, res, NULL);
 
   return res;
 }
@@ -1431,7 +2986,8 @@ track_array* mk_vtrees_tracks(simple_obs_array* obs, track_array* pairs,
 
 
 /* Find the LAST point recursively (accel only pruning) */
-void seq_accel_findsecond(simple_obs_array* obs, track_array* pairs,
+void seq_accel_findsecond(vtree_search* vs,
+                          simple_obs_array* obs, track_array* pairs,
                           tbt_ptr_array* all_trs, tbt_ptr_array* mdl_pts,
                           double acc_r, double acc_d, int min_sup,
                           double thresh, double fit_rd, double pred_fit,
@@ -1469,14 +3025,15 @@ void seq_accel_findsecond(simple_obs_array* obs, track_array* pairs,
         curr = tbt_ptr_array_ref(all_trs,i);
         if((tbt_mid_time(curr) < tbt_mid_time(last))&&
            (tbt_mid_time(first) < tbt_mid_time(curr))) {
-          added = test_and_add_support_final(mdl_pts,curr,supp,aminR,amaxR,aminD,amaxD);
+          added = test_and_add_support_final(vs,mdl_pts,curr,supp,
+                                             aminR,amaxR,aminD,amaxD);
           if(added >= 1) { count++; }
         }
       }
 
       /* Actually do the leaf test. */
       if(count >= min_sup) {
-        quad_vtree_pairs_leaf_check(obs,pairs,mdl_pts,supp,
+        quad_vtree_pairs_leaf_check(vs,obs,pairs,mdl_pts,supp,
                                     min_sup,fit_rd,pred_fit,
                                     last_start_obs_time,
                                     first_end_obs_time,res);
@@ -1485,12 +3042,12 @@ void seq_accel_findsecond(simple_obs_array* obs, track_array* pairs,
       free_tbt_ptr_array(supp);
     } else {
       tbt_ptr_array_set(mdl_pts,1,tbt_right_child(last));
-      seq_accel_findsecond(obs,pairs,all_trs,mdl_pts,
+      seq_accel_findsecond(vs,obs,pairs,all_trs,mdl_pts,
                            acc_r,acc_d,min_sup,thresh,fit_rd,pred_fit,
                            last_start_obs_time,first_end_obs_time,
                            res);
       tbt_ptr_array_set(mdl_pts,1,tbt_left_child(last));
-      seq_accel_findsecond(obs,pairs,all_trs,mdl_pts,
+      seq_accel_findsecond(vs,obs,pairs,all_trs,mdl_pts,
                            acc_r,acc_d,min_sup,thresh,fit_rd,pred_fit,
                            last_start_obs_time,first_end_obs_time,
                            res);
@@ -1503,7 +3060,8 @@ void seq_accel_findsecond(simple_obs_array* obs, track_array* pairs,
 
 
 /* Find the FIRST point recursively (no pruning). */
-void seq_accel_findfirst(simple_obs_array* obs, track_array* pairs,
+void seq_accel_findfirst(vtree_search* vs,
+                         simple_obs_array* obs, track_array* pairs,
                          tbt_ptr_array* all_trs, tbt_ptr_array* mdl_pts,
                          double acc_r, double acc_d, int min_sup, 
                          double thresh, double fit_rd, double pred_fit,
@@ -1512,16 +3070,16 @@ void seq_accel_findfirst(simple_obs_array* obs, track_array* pairs,
   tbt* curr = tbt_ptr_array_ref(mdl_pts,0);
 
   if(tbt_is_leaf(curr)) {
-    seq_accel_findsecond(obs,pairs,all_trs,mdl_pts,
+    seq_accel_findsecond(vs,obs,pairs,all_trs,mdl_pts,
                          acc_r,acc_d,min_sup,thresh,fit_rd,pred_fit,
                          last_start_obs_time,first_end_obs_time,res);
   } else {
     tbt_ptr_array_set(mdl_pts,0,tbt_right_child(curr));
-    seq_accel_findfirst(obs,pairs,all_trs,mdl_pts,
+    seq_accel_findfirst(vs,obs,pairs,all_trs,mdl_pts,
                         acc_r,acc_d,min_sup,thresh,fit_rd,pred_fit,
                         last_start_obs_time,first_end_obs_time,res);
     tbt_ptr_array_set(mdl_pts,0,tbt_left_child(curr));
-    seq_accel_findfirst(obs,pairs,all_trs,mdl_pts,
+    seq_accel_findfirst(vs,obs,pairs,all_trs,mdl_pts,
                         acc_r,acc_d,min_sup,thresh,fit_rd,pred_fit,
                         last_start_obs_time,first_end_obs_time,res);
     tbt_ptr_array_set(mdl_pts,0,curr);
@@ -1543,12 +3101,11 @@ track_array* mk_sequential_accel_only_tracks(simple_obs_array* obs, track_array*
   tbt_ptr_array* tr_arr;
   tbt_ptr_array* mdl_pts;
   tbt*           tr;
+  vtree_search   vs;
   int            i, j;
   int            T;
 
-  supp_count = 0;
-  leaf_count = 0;
-  pairs_count = 0;
+  vtree_search_init(&vs);
 
   /* Turn the tracklets into bounding boxes and build a tree  */
   /* on the points.  Turn this tree into an array of subtrees */
@@ -1575,14 +3132,14 @@ track_array* mk_sequential_accel_only_tracks(simple_obs_array* obs, track_array*
       tbt_ptr_array_set(mdl_pts,0,tbt_ptr_array_ref(tr_arr,i));
       tbt_ptr_array_set(mdl_pts,1,tbt_ptr_array_ref(tr_arr,j));
 
-      seq_accel_findfirst(obs,pairs,tr_arr,mdl_pts,acc_r,acc_d,min_sup,
+      seq_accel_findfirst(&vs,obs,pairs,tr_arr,mdl_pts,acc_r,acc_d,min_sup,
                           thresh,fit_rd,pred_fit,
                           last_start_obs_time,first_end_obs_time,res);
   
     }
   }
 
-  printf("Stopped at %i leaf pairs.\n",pairs_count);
+  printf("Stopped at %i leaf pairs.\n",vs.pairs_count);
 
   free_tbt_ptr_array(mdl_pts);
   free_tbt_ptr_array(tr_arr);
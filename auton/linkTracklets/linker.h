@@ -23,6 +23,7 @@
 #define LINKER_H
 
 #include "track.h"
+#include "track_spill.h"
 
 /* Information for the tracklet bounds (i.e. hi/lo values */
 /* for the tracklet parameters given an error threshold). */
@@ -73,6 +74,26 @@ typedef struct tbt_ptr_array {
 } tbt_ptr_array;
 
 
+/* A tbt flattened into arrays for the vtree search.  The nodes are   */
+/* numbered in depth first order (the root is 0 and a node's left     */
+/* child follows it), the bounds are kept as one array per dimension, */
+/* and each node's points are a range of the permuted index array pts */
+/* (so a node's points are those of its two children, in order).      */
+typedef struct tbt_flat {
+  int num_nodes;
+  int num_pts;
+
+  /* Bounds: lo[d][i] and hi[d][i] for node i in dimension d. */
+  double* lo[TBT_DIM];
+  double* hi[TBT_DIM];
+
+  int* num_points;
+  int* right;        /* The right child, or -1 for a leaf. */
+  int* first_pt;     /* The node's first entry in pts.     */
+  int* pts;
+} tbt_flat;
+
+
 /* ---------------------------------------------------- */
 /* --- Tracklet Preprocessing/Tree Functions ---------- */
 /* ---------------------------------------------------- */
@@ -96,6 +117,15 @@ tbt* mk_empty_tbt(void);
 /* force_t  - forces us to split on time first.                     */
 tbt* mk_tbt(dym* pts, ivec* use_inds, bool force_t, int max_leaf_pts);
 
+/* The per dimension scales that mk_tbt divides the node widths by  */
+/* to pick the split dimension (they depend on all of the points).  */
+dyv* mk_tbt_split_widths(dym* pts, ivec* use_inds, bool force_t);
+
+/* A tree on the points inds using the given split widths.  With the */
+/* widths of a mk_tbt (force_t) tree and the indices of one plate (in */
+/* ascending order) this is that tree's subtree for the plate.       */
+tbt* mk_tbt_recurse(dym* pts, ivec* inds, dyv* widths, int max_leaf_pts);
+
 void free_tbt(tbt* old);
 
 /* --- Tree Getter/Setter Functions ------------------- */
@@ -223,6 +253,40 @@ double safe_tbt_rad_vDEC(tbt* p);
 void fill_plate_tbt_ptr_array(tbt* tr, tbt_ptr_array* arr);
 
 
+/* -------------------------------------------------------------------- */
+/* --- Flattened TBT Trees -------------------------------------------- */
+/* -------------------------------------------------------------------- */
+
+/* A flat tree of num_nodes nodes and num_pts points (unset). */
+tbt_flat* mk_empty_tbt_flat(int num_nodes, int num_pts);
+
+/* A flat copy of the tree (with the same nodes and splits). */
+tbt_flat* mk_tbt_flat(tbt* tr);
+
+tbt_flat* mk_copy_tbt_flat(tbt_flat* old);
+
+/* The num_trees trees one after the other in one flat array.  Sets */
+/* roots[0] to an ivec of the node number of each tree's root.      */
+tbt_flat* mk_tbt_flat_forest(tbt_flat** trees, int num_trees, ivec** roots);
+
+void free_tbt_flat(tbt_flat* old);
+
+/* The flat tree's nodes that fill_plate_tbt_ptr_array would give */
+/* (the subtrees of time width = 0, in ascending time order).     */
+ivec* mk_tbt_flat_plates(tbt_flat* tr);
+
+#define tbt_flat_N(X,i)           ((X)->num_points[i])
+#define tbt_flat_is_leaf(X,i)     ((X)->right[i] < 0)
+#define tbt_flat_left_child(X,i)  ((i)+1)
+#define tbt_flat_right_child(X,i) ((X)->right[i])
+#define tbt_flat_pt(X,i,k)        ((X)->pts[(X)->first_pt[i] + (k)])
+
+#define tbt_flat_lo(X,d,i)        ((X)->lo[d][i])
+#define tbt_flat_hi(X,d,i)        ((X)->hi[d][i])
+#define tbt_flat_mid(X,d,i)       (((X)->hi[d][i] + (X)->lo[d][i])/2.0)
+#define tbt_flat_rad(X,d,i)       (((X)->hi[d][i] - (X)->lo[d][i])/2.0)
+
+
 /* -------------------------------------------------------------------- */
 /* --- TBT Tree Pointer Array ----------------------------------------- */
 /* -------------------------------------------------------------------- */
@@ -265,11 +329,97 @@ int safe_tbt_ptr_array_max_size(tbt_ptr_array* X);
 /* --- Actual Search Functions ---------------------------------------- */
 /* -------------------------------------------------------------------- */
 
+/* How a vtree search is run.  None of it changes the tracks found.  */
+/*                                                                   */
+/* threads - The number of threads used to search the plate pairs    */
+/*           (default = 1).  Each pair of (first, last) plates is    */
+/*           searched on its own and the results do not depend on    */
+/*           the thread count.  Has no effect unless the code is     */
+/*           built with thread=1.                                    */
+/* progress - Report the progress every "progress" seconds (default  */
+/*           = 0: never): the plate pairs searched, tracks found,    */
+/*           tree nodes visited and the estimated time left (from    */
+/*           the pairs' estimated costs).  Each report is a "TIMING  */
+/*           LINKTRACKLETS/VTREE" line on stderr and, if status_file */
+/*           is not NULL or empty, a rewrite of status_file with one */
+/*           "key value" line per quantity (written to a ".tmp" file */
+/*           and renamed over status_file).                          */
+/* ckpt_file - Checkpoint the search to this file (default = NULL:   */
+/*           none): the tracks of the plate pairs finished are       */
+/*           appended to the file every ckpt_every seconds (default  */
+/*           = 300, 0 = as each pair finishes) and when the search   */
+/*           ends.  With ckpt_resume, a search first takes the pairs */
+/*           that are in the file (if it was written by the same     */
+/*           search: the same detections, tracklets, parameters and  */
+/*           pairs) and only searches the others.                    */
+/*                                                                   */
+/* The strings are not copied.  The search functions below take a    */
+/* vtree_run_opts* (NULL = the defaults).                            */
+typedef struct vtree_run_opts {
+  int threads;
+  double progress;
+  char* status_file;
+  char* ckpt_file;
+  double ckpt_every;
+  bool ckpt_resume;
+} vtree_run_opts;
+
+/* Set all of the options to their defaults. */
+void vtree_run_opts_init(vtree_run_opts* opts);
+
 track_array* mk_vtrees_tracks(simple_obs_array* obs, track_array* pairs,
                               double thresh, double acc_r, double acc_d,
                               int min_sup, int K, double fit_rd, double pred_fit,
                               bool endpts, double plate_width,
-                              double last_start_obs_time, double first_end_obs_time);
+                              double last_start_obs_time, double first_end_obs_time,
+                              vtree_run_opts* run);
+
+/* As mk_vtrees_tracks, but only search shard number "shard" (from 0) */
+/* of num_shards shards of the (first, last) plate pairs.  The pairs  */
+/* are split by their estimated costs so that the shards take about   */
+/* the same time; the split only depends on the input, so separate    */
+/* runs agree on it.  The tracks are returned in pair order, without  */
+/* any subset removal.  If pair_ids is not NULL the pair number of    */
+/* each track is appended to it, and if num_pairs is not NULL it is   */
+/* set to the number of pairs (over all of the shards).  Sorting the  */
+/* tracks of all of the shards by pair number (keeping the order      */
+/* within a pair) gives the result of mk_vtrees_tracks.               */
+track_array* mk_vtrees_tracks_shard(simple_obs_array* obs, track_array* pairs,
+                                    double thresh, double acc_r, double acc_d,
+                                    int min_sup, int K, double fit_rd,
+                                    double pred_fit, bool endpts,
+                                    double plate_width,
+                                    double last_start_obs_time,
+                                    double first_end_obs_time,
+                                    int shard, int num_shards,
+                                    ivec* pair_ids, int* num_pairs,
+                                    vtree_run_opts* run);
+
+/* The search of mk_vtrees_tracks with each plate pair's tracks handed */
+/* to spill (with the pair number as the group) as the pair finishes,  */
+/* instead of being collected in memory.                               */
+void vtrees_tracks_to_spill(simple_obs_array* obs, track_array* pairs,
+                            double thresh, double acc_r, double acc_d,
+                            int min_sup, double fit_rd, double pred_fit,
+                            bool endpts, double plate_width,
+                            double last_start_obs_time,
+                            double first_end_obs_time, track_spill* spill,
+                            vtree_run_opts* run);
+
+/* Search a given tree: tb_arr holds the bounds of the tracklets      */
+/* (pairs), tree is a flat tree (or forest) on them and plates lists  */
+/* its plate subtrees in ascending time order.  Only the (first, last) */
+/* plate pairs with a plate i between them (inclusive) that has       */
+/* changed[i] != 0 are searched.  With every plate changed this gives */
+/* the tracks of mk_vtrees_tracks (without any subset removal).       */
+track_array* mk_vtrees_tracks_plates(simple_obs_array* obs, track_array* pairs,
+                                     dym* tb_arr, tbt_flat* tree, ivec* plates,
+                                     ivec* changed,
+                                     double acc_r, double acc_d, int min_sup,
+                                     double fit_rd, double pred_fit,
+                                     bool endpts, double last_start_obs_time,
+                                     double first_end_obs_time,
+                                     vtree_run_opts* run);
 
 /* A sequential search with accel only based pruning. */
 /* For each starting track, find EACH possible ending */
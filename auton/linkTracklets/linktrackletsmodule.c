@@ -365,7 +365,7 @@ void tracker_main(int argc,char *argv[]) {
         break;
       case 1:
         t2 = mk_MHT_matches(t1,obs,fit_thresh,lin_thresh,quad_thresh,
-                            max_hyp,max_match,min_obs,bwpass);
+                            max_hyp,max_match,min_obs,bwpass,1);
         break;
       case 2:
         t2 = mk_sequential_accel_only_tracks(obs,t1,vtree_thresh,acc_r,acc_d,
@@ -25,10 +25,13 @@
 #include "MHT.h"
 #include "rdt_tree.h"
 #include "linker.h"
+#include "obs_load.h"
+#include "tracklet_file.h"
+#include "vtree_cache.h"
 
 #define NEOS_VERSION 3
 #define NEOS_RELEASE 0
-#define NEOS_UPDATE  2
+#define NEOS_UPDATE  4
 
 
 ivec* mk_count_tracks_iv_ind(ivec* grps) {
@@ -125,16 +128,201 @@ void test_main(int argc,char *argv[]) {
 }
 
 
-void tracker_main(int argc,char *argv[]) {
+/* Write the tracks found by one shard of a vtree search, with the */
+/* number of the plate pair that found each one, for a later merge. */
+/* The first line gives the shard and the sizes that the merge      */
+/* checks: "# shard K of N pairs P detections D".  Each other line  */
+/* is one track: its pair number and then its detection numbers.    */
+/* The file is written under a temporary name and then renamed, so  */
+/* a partly written file is never seen under the final name.        */
+bool output_shard_file(char* fname, int shard, int num_shards, int num_pairs,
+                       simple_obs_array* obs, track_array* tracks,
+                       ivec* pair_ids) {
+  char* tmpname = mk_printf("%s.tmp", fname);
+  FILE* fp;
+  ivec* inds;
+  bool ok;
+  int i, j;
+
+  fp = fopen(tmpname,"w");
+  ok = (fp != NULL);
+  if(ok) {
+    fprintf(fp,"# shard %i of %i pairs %i detections %i\n", shard,
+            num_shards, num_pairs, simple_obs_array_size(obs));
+    for(i=0;i<track_array_size(tracks);i++) {
+      inds = track_individs(track_array_ref(tracks,i));
+      fprintf(fp,"%i",ivec_ref(pair_ids,i));
+      for(j=0;j<ivec_size(inds);j++) {
+        fprintf(fp," %i",ivec_ref(inds,j));
+      }
+      fprintf(fp,"\n");
+    }
+    ok = (fclose(fp) == 0);
+  }
+  ok = ok && (rename(tmpname, fname) == 0);
+  if(!ok) {
+    printf("ERROR: Unable to write the shard file %s.\n", fname);
+  }
+
+  free_string(tmpname);
+
+  return ok;
+}
+
+
+/* Read the tracks from the shard files (a comma separated list of  */
+/* the files written by the "shard" runs) and return them sorted by */
+/* pair number, keeping the order within each pair.  This is the    */
+/* order of the tracks from a single (unsharded) search.  Returns   */
+/* NULL (after printing why) if a file can not be read, does not    */
+/* match obs or the other files, or if a shard is missing.          */
+track_array* mk_tracks_from_shard_files(simple_obs_array* obs, char* files) {
+  string_array* names = mk_broken_string_using_seppers(files, ",");
+  string_array* line;
+  track_array* all = mk_empty_track_array(10);
+  track_array* res = NULL;
+  ivec* pair_ids = mk_ivec(0);
+  ivec* seen = NULL;
+  ivec* counts;
+  ivec* inds;
+  FILE* fp;
+  bool ok = TRUE;
+  int N = simple_obs_array_size(obs);
+  int num_shards = -1;
+  int num_pairs = -1;
+  int f, i, k, ind, shard;
+
+  for(f=0;(f<string_array_size(names))&&(ok);f++) {
+    fp = fopen(string_array_ref(names,f),"r");
+    if(fp == NULL) {
+      printf("ERROR: Unable to open %s.\n", string_array_ref(names,f));
+      ok = FALSE;
+      continue;
+    }
+
+    /* Check the header against obs and the other shards. */
+    line = mk_string_array_from_line(fp);
+    ok = (line != NULL) && (string_array_size(line) == 9) &&
+         eq_string(string_array_ref(line,0),"#") &&
+         eq_string(string_array_ref(line,1),"shard");
+    if(ok) {
+      shard = atoi(string_array_ref(line,2));
+      if(num_shards < 0) {
+        num_shards = atoi(string_array_ref(line,4));
+        num_pairs  = atoi(string_array_ref(line,6));
+        seen       = mk_zero_ivec(int_max(num_shards,1));
+      }
+      ok = (atoi(string_array_ref(line,4)) == num_shards) &&
+           (atoi(string_array_ref(line,6)) == num_pairs) &&
+           (shard >= 0) && (shard < num_shards);
+      if(!ok) {
+        printf("ERROR: %s is not one of the same %i shards.\n",
+               string_array_ref(names,f), num_shards);
+      } else if(atoi(string_array_ref(line,8)) != N) {
+        printf("ERROR: %s was written for %i detections (not %i).\n",
+               string_array_ref(names,f), atoi(string_array_ref(line,8)), N);
+        ok = FALSE;
+      } else if(ivec_ref(seen,shard) > 0) {
+        printf("ERROR: Shard %i is given twice.\n", shard);
+        ok = FALSE;
+      } else {
+        ivec_set(seen,shard,1);
+      }
+    } else {
+      printf("ERROR: %s is not a shard file.\n", string_array_ref(names,f));
+    }
+    if(line != NULL) { free_string_array(line); }
+
+    while(ok && ((line = mk_string_array_from_line(fp)) != NULL)) {
+      if(string_array_size(line) > 1) {
+        k = atoi(string_array_ref(line,0));
+        if((k < 0) || (k >= num_pairs)) {
+          printf("ERROR: %s refers to plate pair %i (of %i).\n",
+                 string_array_ref(names,f), k, num_pairs);
+          ok = FALSE;
+        }
+
+        inds = mk_ivec(string_array_size(line)-1);
+        for(i=1;(i<string_array_size(line))&&ok;i++) {
+          ind = atoi(string_array_ref(line,i));
+          if((ind < 0) || (ind >= N)) {
+            printf("ERROR: %s refers to detection %i (of %i).\n",
+                   string_array_ref(names,f), ind, N);
+            ok = FALSE;
+          }
+          ivec_set(inds,i-1,ind);
+        }
+        if(ok) {
+          track_array_add_no_copy(all,mk_track_from_N_inds(obs,inds));
+          add_to_ivec(pair_ids,k);
+        }
+        free_ivec(inds);
+      }
+      free_string_array(line);
+    }
+    fclose(fp);
+  }
+
+  for(i=0;ok&&(i<num_shards);i++) {
+    if(ivec_ref(seen,i) == 0) {
+      printf("ERROR: Shard %i (of %i) is missing.\n", i, num_shards);
+      ok = FALSE;
+    }
+  }
+
+  /* Put the tracks in pair order (a stable counting sort). */
+  if(ok) {
+    counts = mk_zero_ivec(num_pairs+1);
+    for(i=0;i<ivec_size(pair_ids);i++) {
+      k = ivec_ref(pair_ids,i);
+      ivec_set(counts,k+1,ivec_ref(counts,k+1)+1);
+    }
+    for(k=0;k<num_pairs;k++) {
+      ivec_set(counts,k+1,ivec_ref(counts,k+1)+ivec_ref(counts,k));
+    }
+    inds = mk_ivec(ivec_size(pair_ids));
+    for(i=0;i<ivec_size(pair_ids);i++) {
+      k = ivec_ref(pair_ids,i);
+      ivec_set(inds,ivec_ref(counts,k),i);
+      ivec_set(counts,k,ivec_ref(counts,k)+1);
+    }
+
+    res = mk_empty_track_array(int_max(track_array_size(all),1));
+    for(i=0;i<ivec_size(inds);i++) {
+      track_array_add(res,track_array_ref(all,ivec_ref(inds,i)));
+    }
+    free_ivec(inds);
+    free_ivec(counts);
+  }
+
+  if(seen != NULL) { free_ivec(seen); }
+  free_ivec(pair_ids);
+  free_track_array(all);
+  free_string_array(names);
+
+  return res;
+}
+
+
+/* Returns the exit status: non-zero if a shard or merge of shards */
+/* failed or the tracks could not be written.                      */
+int tracker_main(int argc,char *argv[]) {
   FILE* f1;
   FILE* f3;
   char* fname  = string_from_args("file",argc,argv,NULL);
   char* desfname  = string_from_args("desfile",argc,argv,NULL);
+  char* trkfname  = string_from_args("trackletfile",argc,argv,NULL);
   char* fout1  = string_from_args("trackfile",argc,argv,"tracks.obs");
   char* fout3  = string_from_args("summaryfile",argc,argv,"tracks.sum");
   char* fout4  = string_from_args("idsfile",argc,argv,"tracks.ids");
   char* fout5  = string_from_args("scoresfile",argc,argv,"");
   char* trackids_filename = string_from_args("trackidsfile",argc,argv,"");
+  char* status_filename = string_from_args("statusfile",argc,argv,"");
+  char* shard_filename = string_from_args("shardfile",argc,argv,"tracks.shard");
+  char* shard_files   = string_from_args("shardfiles",argc,argv,NULL);
+  char* cache_filename = string_from_args("vtree_cache",argc,argv,"");
+  char* ckpt_filename = string_from_args("checkpoint",argc,argv,"");
+  char* spill_filename = string_from_args("spill_file",argc,argv,"");
   double fit_thresh    = double_from_args("fit_thresh",argc,argv,0.0001);
   double lin_thresh    = double_from_args("lin_thresh",argc,argv,0.05);
   double quad_thresh   = double_from_args("quad_thresh",argc,argv,0.02);
@@ -150,11 +338,17 @@ void tracker_main(int argc,char *argv[]) {
   double acc_d         = double_from_args("acc_d",argc,argv,0.02);
   double end_t_range   = double_from_args("end_t_range",argc,argv,-1.0);
   double start_t_range = double_from_args("start_t_range",argc,argv,-1.0);
+  double progress      = double_from_args("progress",argc,argv,60.0);
+  double ckpt_every    = double_from_args("checkpoint_every",argc,argv,300.0);
   int    seed          = int_from_args("seed",argc,argv,0);
   int    min_sup       = int_from_args("min_sup",argc,argv,3);
   int    max_hyp       = int_from_args("max_hyp",argc,argv,500);
   int    max_match     = int_from_args("max_match",argc,argv,500);
   int    min_obs       = int_from_args("min_obs",argc,argv,6);
+  int    threads       = int_from_args("threads",argc,argv,1);
+  int    shard         = int_from_args("shard",argc,argv,-1);
+  int    num_shards    = int_from_args("of",argc,argv,1);
+  int    spill_tracks  = int_from_args("spill_tracks",argc,argv,1000000);
   bool   bwpass        = bool_from_args("bwpass",argc,argv,TRUE);
   bool   endpts        = bool_from_args("endpts",argc,argv,TRUE);
   bool   eval          = bool_from_args("eval",argc,argv,FALSE);
@@ -162,8 +356,15 @@ void tracker_main(int argc,char *argv[]) {
   bool   rem_overlap   = bool_from_args("remove_overlaps",argc,argv,FALSE);
   bool   allow_conflicts = bool_from_args("allow_conflicts",argc,argv,FALSE);
   bool   fileout       = bool_from_args("fileout",argc,argv,TRUE);
+  bool   resume        = bool_from_args("resume",argc,argv,FALSE);
   double r_lo_n, r_hi_n, d_lo_n, d_hi_n, t_lo_n, t_hi_n;
   double r_lo, r_hi, d_lo, d_hi, t_lo, t_hi;
+  double r_center, d_center, t_origin;
+  vtree_cache* cache = NULL;
+  vtree_cache* nu_cache = NULL;
+  bool out_ok = TRUE;
+  int status = 0;
+  FILE* fc;
   double last_start_obs_time = -1.0;
   double first_end_obs_time  = -1.0;
   ivec* filtered_true_groups;
@@ -173,6 +374,12 @@ void tracker_main(int argc,char *argv[]) {
   ivec* roc;
   dyv* org_times;
   dyv* times;
+  tracklet_file* tf = NULL;
+  ivec* pair_ids = NULL;
+  int num_pairs = 0;
+  track_spill* spill = NULL;
+  vtree_run_opts run;
+  bool subsets_done = FALSE;
   simple_obs_array* obs;
   simple_obs* A;
   simple_obs* B;
@@ -193,6 +400,33 @@ void tracker_main(int argc,char *argv[]) {
   if( eq_string(s,"vtree") )    { search_type = 0; }
   if( eq_string(s,"seq") )      { search_type = 1; }
   if( eq_string(s,"seqaccel") ) { search_type = 2; }
+  if( eq_string(s,"merge") )    { search_type = 3; }
+
+  /* A shard only applies to the vtree search and only writes its */
+  /* tracks (for a later merge run, which does the other outputs). */
+  if((search_type != 0) || (num_shards < 1) ||
+     (shard < 0) || (shard >= num_shards)) {
+    shard      = -1;
+    num_shards = 1;
+  } else {
+    fileout           = FALSE;
+    eval              = FALSE;
+    removedups        = FALSE;
+    rem_overlap       = FALSE;
+    trackids_filename = NULL;
+  }
+
+  /* The incremental search is a (whole) vtree search. */
+  if((search_type != 0) || (shard >= 0)) {
+    cache_filename = "";
+  }
+
+  /* Spilling the tracks only applies to a whole, plain vtree search */
+  /* that removes subsets (the pass that the spill file is for).     */
+  if((search_type != 0) || (shard >= 0) || (cache_filename[0] != '\0') ||
+     (removedups == FALSE)) {
+    spill_filename = "";
+  }
 
   printf("--------------------------------------------- \n");
   printf("NEOS VERSION: %i.%i.%i\n",NEOS_VERSION,NEOS_RELEASE,NEOS_UPDATE);
@@ -204,15 +438,29 @@ void tracker_main(int argc,char *argv[]) {
   if(search_type == 0) { printf("Using VTREE search.\n"); } 
   if(search_type == 1) { printf("Using SEQUENTIAL search.\n"); }
   if(search_type == 2) { printf("Using SEQUENTIAL ACCEL search.\n"); }
+  if(search_type == 3) { printf("Merging the tracks from shard files.\n"); }
+  if(shard >= 0) {
+    printf("Only searching shard %i of %i.\n",shard,num_shards);
+    printf("Output file (shard):   "); printf(shard_filename); printf("\n");
+  }
+  if(search_type == 3) {
+    printf("Shard files:           ");
+    printf((shard_files != NULL) ? shard_files : "<NOT GIVEN!>");
+    printf("\n");
+  }
 
-  if(fname) {
+  if(trkfname) {
+    printf("Input file (binary):  "); printf(trkfname); printf("\n");
+  } else if(fname) {
     printf("Input file:           "); printf(fname); printf("\n");
   } else {
     printf("Input file:           <NOT GIVEN!>\n");
   }
-  printf("Output file (tracks):  "); printf(fout1); printf("\n");
+  if(shard < 0) {
+    printf("Output file (tracks):  "); printf(fout1); printf("\n");
   printf("Output file (summary): "); printf(fout3); printf("\n");
   printf("Output file (ids):     "); printf(fout4); printf("\n");
+  }
   if((search_type == 0) || (search_type == 2)) {
     printf("VTREES Threshhold (RD)   = %12.8f   (default = 0.0002)\n",vtree_thresh);
     printf("Prediction Threshold (RD)= %12.8f   (default = 0.0005)\n",pred_thresh);
@@ -287,6 +535,29 @@ void tracker_main(int argc,char *argv[]) {
   }
   printf("Minimum Observations = %4i  (default   6)\n",min_obs);
   printf("Min Tracklets/Days   = %4i  (default   3)\n",min_sup);
+  printf("Number of Threads    = %4i  (default   1)\n",threads);
+  if(cache_filename[0] != '\0') {
+    printf("Vtree cache (incremental): "); printf(cache_filename); printf("\n");
+  }
+  if(spill_filename[0] != '\0') {
+    printf("Spill file (tracks):   "); printf(spill_filename); printf("\n");
+    printf("Spill Tracks         = %7i  (default 1000000)\n",spill_tracks);
+  }
+  if(search_type == 0) {
+    printf("Progress Interval (s)    = %12.3f   (default = 60.0)\n",progress);
+    if(status_filename[0] != '\0') {
+      printf("Status file:           "); printf(status_filename); printf("\n");
+    }
+    if(ckpt_filename[0] != '\0') {
+      printf("Checkpoint file:       "); printf(ckpt_filename); printf("\n");
+      printf("Checkpoint Interval (s)  = %12.3f   (default = 300.0)\n",ckpt_every);
+      if(resume) {
+        printf("Resume from checkpoint:      ON\n");
+      } else {
+        printf("Resume from checkpoint:      OFF\n");
+      }
+    }
+  }
   printf("\n\n");
 
   /* Convert things into useful units (radians). */
@@ -294,11 +565,28 @@ void tracker_main(int argc,char *argv[]) {
   acc_r        *= DEG_TO_RAD;
   acc_d        *= DEG_TO_RAD;
 
-  if(fname == NULL && desfname == NULL) {
+  if(fname == NULL && desfname == NULL && trkfname == NULL) {
     printf("ERROR: No filename given.\n");
   } else {
-
-    if (desfname) {
+    obs_load_set_threads(threads);
+    vtree_run_opts_init(&run);
+    run.threads     = threads;
+    run.progress    = progress;
+    run.status_file = status_filename;
+    run.ckpt_file   = ckpt_filename;
+    run.ckpt_every  = ckpt_every;
+    run.ckpt_resume = resume;
+
+    if (trkfname) {
+      printf("Loading detections and tracklets from %s.\n", trkfname);
+      tf  = mk_tracklet_file(trkfname);
+      obs = NULL;
+      if (tf != NULL) {
+        obs         = mk_simple_obs_array_from_tracklet_file(tf);
+        true_groups = mk_true_groups_from_tracklet_file(tf);
+        true_pairs  = NULL;
+      }
+    } else if (desfname) {
       printf("Loading detections in DES format from %s.\n", desfname);
       obs = mk_simple_obs_array_from_DES_file(desfname, 0.5, &true_groups,
                                               &true_pairs, NULL, NULL);
@@ -313,7 +601,48 @@ void tracker_main(int argc,char *argv[]) {
       simple_obs_array_compute_bounds(obs,NULL,&r_lo,&r_hi,&d_lo,&d_hi,&t_lo,&t_hi);
       printf("   Bounds were R=[%12.8f,%12.8f], D=[%12.8f,%12.8f], T=[%12.8f,%12.8f]\n",
              r_lo, r_hi, d_lo, d_hi, t_lo, t_hi);
-      recenter_simple_obs_array(obs,NULL,(r_hi+r_lo)/2.0,12.0,(d_lo+d_hi)/2.0,0.0,t_lo,0.0);
+      r_center = (r_hi+r_lo)/2.0;
+      d_center = (d_lo+d_hi)/2.0;
+      t_origin = t_lo;
+
+      /* An incremental search keeps the frame of the cached plates. */
+      if(cache_filename[0] != '\0') {
+        fc = fopen(cache_filename,"rb");
+        if(fc != NULL) {
+          fclose(fc);
+          cache = mk_vtree_cache_from_file(cache_filename);
+        } else {
+          printf("   No vtree cache yet (searching all of the plates).\n");
+        }
+        if((cache != NULL) && ((fabs(cache->thresh - vtree_thresh) > 1e-15) ||
+                               (fabs(cache->plate_width - plate_width) > 1e-15))) {
+          printf("   The vtree cache used other parameters (searching all of the plates).\n");
+          free_vtree_cache(cache);
+          cache = NULL;
+        }
+        if((cache != NULL) &&
+           ((cache->ra_center < r_lo) || (cache->ra_center > r_hi) ||
+            (cache->dec_center < d_lo) || (cache->dec_center > d_hi))) {
+          printf("   The vtree cache is for another part of the sky (searching all of the plates).\n");
+          free_vtree_cache(cache);
+          cache = NULL;
+        }
+        if(cache != NULL) {
+          r_center = cache->ra_center;
+          d_center = cache->dec_center;
+          t_origin = cache->t_origin;
+          printf("   Using the vtree cache's %i plates and frame.\n",
+                 cache->num_plates);
+        }
+      }
+
+      /* Tracklets from a binary file keep their stored fits (which */
+      /* are rotated along with the detections).                    */
+      if(tf != NULL) {
+        t1 = mk_track_array_from_tracklet_file(tf,obs);
+        recenter_track_array(t1,r_center,12.0,d_center,0.0,t_origin,0.0);
+      }
+      recenter_simple_obs_array(obs,NULL,r_center,12.0,d_center,0.0,t_origin,0.0);
       simple_obs_array_compute_bounds(obs,NULL,&r_lo_n,&r_hi_n,&d_lo_n,&d_hi_n,&t_lo_n,&t_hi_n);
       printf("   Bounds are  R=[%12.8f,%12.8f], D=[%12.8f,%12.8f], T=[%12.8f,%12.8f]\n",
              r_lo_n, r_hi_n, d_lo_n, d_hi_n, t_lo_n, t_hi_n);
@@ -338,7 +667,9 @@ void tracker_main(int argc,char *argv[]) {
         simple_obs_array_add_gaussian_noise(obs, sigma/15.0, sigma, 0.0);
       }
 
-      t1 = mk_true_tracks(obs,true_pairs);
+      if(tf == NULL) {
+        t1 = mk_true_tracks(obs,true_pairs);
+      }
 
       track_sizes = mk_count_tracks_iv_ind(true_groups);
       printf("Loaded %i observations from %i different tracklets\n",
@@ -392,39 +723,120 @@ void tracker_main(int argc,char *argv[]) {
       printf(">> Doing the tracking "); printf(curr_time()); printf("\n");
       switch(search_type) {
       case 0:
-        t2 = mk_vtrees_tracks(obs,t1,vtree_thresh,acc_r,acc_d,min_sup,2,
-                              fit_thresh,pred_thresh,endpts,plate_width,
-                              last_start_obs_time, first_end_obs_time);
+        if(shard >= 0) {
+          pair_ids = mk_ivec(0);
+          t2 = mk_vtrees_tracks_shard(obs,t1,vtree_thresh,acc_r,acc_d,min_sup,
+                                      2,fit_thresh,pred_thresh,endpts,
+                                      plate_width,last_start_obs_time,
+                                      first_end_obs_time,shard,num_shards,
+                                      pair_ids,&num_pairs,&run);
+        } else if(cache_filename[0] != '\0') {
+          t2 = mk_vtrees_tracks_incremental(obs,t1,vtree_thresh,acc_r,acc_d,
+                                            min_sup,fit_thresh,pred_thresh,
+                                            endpts,plate_width,
+                                            last_start_obs_time,
+                                            first_end_obs_time,cache,
+                                            r_center,d_center,t_origin,
+                                            &nu_cache,&run);
+          if(cache != NULL) { free_vtree_cache(cache); }
+        } else if(spill_filename[0] != '\0') {
+          /* Filter the tracks as they are found and remove the subsets */
+          /* with a merge of the spilled runs.                          */
+          t2    = NULL;
+          spill = mk_track_spill(spill_filename,obs,min_sup,min_obs,
+                                 spill_tracks);
+          if(spill != NULL) {
+            vtrees_tracks_to_spill(obs,t1,vtree_thresh,acc_r,acc_d,min_sup,
+                                   fit_thresh,pred_thresh,endpts,plate_width,
+                                   last_start_obs_time,first_end_obs_time,
+                                   spill,&run);
+            printf("   Found %li potential tracks, %li of them long enough (",
+                   track_spill_num_added(spill),track_spill_num_kept(spill));
+            printf(curr_time()); printf(").\n");
+
+            printf(">> Removing subset/duplicate orbits (%i runs) ",
+                   spill->num_runs + ((spill->num_buf > 0) ? 1 : 0));
+            printf(curr_time()); printf("\n");
+            t2 = mk_track_spill_remove_subsets(spill);
+            free_track_spill(spill);
+          }
+          if(t2 == NULL) {
+            printf("ERROR: Unable to spill the tracks.\n");
+            fileout           = FALSE;
+            eval              = FALSE;
+            trackids_filename = NULL;
+            t2 = mk_empty_track_array(1);
+          }
+          printf("   Found %i unique tracks.\n",track_array_size(t2));
+          subsets_done = TRUE;
+        } else {
+          t2 = mk_vtrees_tracks(obs,t1,vtree_thresh,acc_r,acc_d,min_sup,2,
+                                fit_thresh,pred_thresh,endpts,plate_width,
+                                last_start_obs_time, first_end_obs_time,
+                                &run);
+        }
         break;
       case 1:
         t2 = mk_MHT_matches(t1,obs,fit_thresh,lin_thresh,quad_thresh,
-                            max_hyp,max_match,min_obs,bwpass);
+                            max_hyp,max_match,min_obs,bwpass,threads);
         break;
       case 2:
         t2 = mk_sequential_accel_only_tracks(obs,t1,vtree_thresh,acc_r,acc_d,min_sup,
                                              fit_thresh,pred_thresh,plate_width,
                                              last_start_obs_time, first_end_obs_time);
         break;
+      case 3:
+        t2 = NULL;
+        if(shard_files != NULL) {
+          t2 = mk_tracks_from_shard_files(obs,shard_files);
+        }
+        if(t2 == NULL) {
+          printf("ERROR: Unable to merge the shard files.\n");
+          status            = 1;
+          fileout           = FALSE;
+          eval              = FALSE;
+          trackids_filename = NULL;
+          t2 = mk_empty_track_array(1);
+        }
+        break;
       default:
         t2 = NULL;
       }
 
-      printf("   Found %i potential tracks (",track_array_size(t2));
-      printf(curr_time()); printf(").\n");
+      if(!subsets_done) {
+        printf("   Found %i potential tracks (",track_array_size(t2));
+        printf(curr_time()); printf(").\n");
+      }
+
+      /* A shard writes its tracks and stops. */
+      if(shard >= 0) {
+        printf(">> Writing shard %i of %i to %s.\n",shard,num_shards,
+               shard_filename);
+        if(!output_shard_file(shard_filename,shard,num_shards,num_pairs,obs,
+                              t2,pair_ids)) {
+          status = 1;
+        }
+        free_ivec(pair_ids);
+        free_track_array(t2);
+        t2 = mk_empty_track_array(1);
+      }
 
-      printf(">> Removing 'short' tracks (< %i nights, < %i obs)...\n",min_sup,min_obs);
-      t3 = mk_empty_track_array(track_array_size(t2));
-      for(i=0;i<track_array_size(t2);i++) {
-        if(track_num_nights_seen(track_array_ref(t2,i),obs) >= min_sup) {
-          if(track_num_obs(track_array_ref(t2,i)) >= min_obs) {
-            track_array_add(t3,track_array_ref(t2,i));
+      /* (The spilled tracks were filtered as they were found.) */
+      if(!subsets_done) {
+        printf(">> Removing 'short' tracks (< %i nights, < %i obs)...\n",min_sup,min_obs);
+        t3 = mk_empty_track_array(track_array_size(t2));
+        for(i=0;i<track_array_size(t2);i++) {
+          if(track_num_nights_seen(track_array_ref(t2,i),obs) >= min_sup) {
+            if(track_num_obs(track_array_ref(t2,i)) >= min_obs) {
+              track_array_add(t3,track_array_ref(t2,i));
+            }
           }
         }
+        free_track_array(t2);
+        t2 = t3;
       }
-      free_track_array(t2);
-      t2 = t3;
 
-      if(removedups) {
+      if(removedups && !subsets_done) {
         printf(">> Removing subset/duplicate orbits "); printf(curr_time()); printf("\n");
 
         t3 = mk_MHT_remove_subsets(t2,obs);
@@ -452,7 +864,7 @@ void tracker_main(int argc,char *argv[]) {
       /* Put the bounds back they way they were. */
       if(search_type < 5) {
         printf(">> Shifting the observation bounds, back ("); printf(curr_time()); printf(")\n");
-        recenter_simple_obs_array(obs,NULL,12.0,(r_hi+r_lo)/2.0,0.0,(d_lo+d_hi)/2.0,0.0,t_lo);
+        recenter_simple_obs_array(obs,NULL,12.0,r_center,0.0,d_center,0.0,t_origin);
         simple_obs_array_compute_bounds(obs,NULL,&r_lo,&r_hi,&d_lo,&d_hi,&t_lo,&t_hi);
         printf("   Bounds are  R=[%12.8f,%12.8f], D=[%12.8f,%12.8f], T=[%12.8f,%12.8f]\n",
                r_lo, r_hi, d_lo, d_hi, t_lo, t_hi);
@@ -462,23 +874,49 @@ void tracker_main(int argc,char *argv[]) {
         printf(">> Dumping tracks to output files "); printf(curr_time()); printf("\n");
         f1 = fopen(fout1,"w");
         f3 = fopen(fout3,"w");
-        dump_tracks_to_file(f1,f3,fout5,FALSE,obs,t2);
-        fclose(f1);
-        fclose(f3);
+        if((f1 != NULL) && (f3 != NULL)) {
+          dump_tracks_to_file(f1,f3,fout5,FALSE,obs,t2);
+        } else {
+          out_ok = FALSE;
+        }
+        if((f1 != NULL) && (fclose(f1) != 0)) { out_ok = FALSE; }
+        if((f3 != NULL) && (fclose(f3) != 0)) { out_ok = FALSE; }
         f1 = fopen(fout4,"w");
-        fprintf_track_array_ID_list(f1,t2,obs);
-        fclose(f1);
+        if(f1 != NULL) {
+          fprintf_track_array_ID_list(f1,t2,obs);
+          if(fclose(f1) != 0) { out_ok = FALSE; }
+        } else {
+          out_ok = FALSE;
+        }
       }
 
-      if (trackids_filename) {
+      if (trackids_filename && (trackids_filename[0] != '\0')) {
         printf(">> Dumping track IDs to %s.\n", trackids_filename);
         f1 = fopen(trackids_filename, "w");
         if (f1) {
             dump_trackids_to_file(f1,obs,t2);
-            fclose(f1);
+            if (fclose(f1) != 0) { out_ok = FALSE; }
+        } else {
+            out_ok = FALSE;
         }
       }
 
+      /* Only replace the vtree cache once the run's tracks are out, */
+      /* so that a run killed before then is redone in full.         */
+      if(!out_ok) {
+        status = 1;
+      }
+      if(nu_cache != NULL) {
+        if(out_ok) {
+          printf(">> Writing the vtree cache to %s.\n",cache_filename);
+          write_vtree_cache(cache_filename,nu_cache);
+        } else {
+          printf("ERROR: Unable to write the tracks (the vtree cache was not updated).\n");
+        }
+        free_vtree_cache(nu_cache);
+        nu_cache = NULL;
+      }
+
       if(eval == TRUE) {
         printf("\n\nScoring the tracks (");
         printf(curr_time()); 
@@ -526,27 +964,33 @@ void tracker_main(int argc,char *argv[]) {
       free_track_array(t2);
       free_track_array(t1);
       free_ivec(true_groups);
-      free_ivec(true_pairs);
+      if(true_pairs != NULL) { free_ivec(true_pairs); }
       free_dyv(org_times);
     }
 
     if (NULL != obs) {
       free_simple_obs_array(obs);
     }
+    if (NULL != tf) {
+      free_tracklet_file(tf);
+    }
   }
+
+  return status;
 }
 
 
 int main(int argc,char *argv[]) {
   int seed = int_from_args("seed",argc,argv,0);
+  int status;
 
   if (seed) am_srand(seed);
   memory_leak_check_args(argc,argv);
 
   Verbosity = 0.0;
 
-  tracker_main(argc,argv);
+  status = tracker_main(argc,argv);
 
   am_malloc_report_polite();
-  return 0; 
+  return status;
 }
@@ -22,6 +22,7 @@ Copyright 2003, The Auton Lab, CMU
 */
 
 #include "obs.h"
+#include "obs_load.h"
 #include "geometry.h"
 
 #define c_to_i(X)     (X - '0')
@@ -649,8 +650,9 @@ int dyv_count_num_unique(dyv* X, double thresh) {
    will default to M_i = 0.0 if i > floor(log2(# points)) + 1
 */
 dyv* mk_fill_obs_moments(dyv* X, dyv* time, dyv* weights, int num_coefficients) {
-  double A, B, C, D, E, F, G;
-  double a, b, c, t, x;
+  double S[OBS_MOMENT_SUMS];
+  double M[3];
+  double t, x;
   double bot, w, sum;
   double dobN, tspread;
   dyv* res;
@@ -694,9 +696,7 @@ dyv* mk_fill_obs_moments(dyv* X, dyv* time, dyv* weights, int num_coefficients)
     }
     dyv_set(res,0,sum/bot);
   } else {
-    A = 0.0; B = 0.0; C = 0.0;
-    D = 0.0; E = 0.0; F = 0.0;
-    G = 0.0;
+    for(i=0;i<OBS_MOMENT_SUMS;i++) { S[i] = 0.0; }
 
     for(i=0;i<N;i++) {
       w = 1.0;
@@ -707,46 +707,70 @@ dyv* mk_fill_obs_moments(dyv* X, dyv* time, dyv* weights, int num_coefficients)
 
       t  = dyv_ref(time,i);
       x  = dyv_ref(X,i);
-      A += ((t*t*t*t)*w);
-      B += ((t*t*t)*w);
-      C += ((t*t)*w);
-      D += ((t)*w);
-      E += ((x*t*t)*w);
-      F += ((x*t)*w);
-      G += ((x)*w);
+      obs_moment_sums_add(S, t, x, w);
     }
 
-    /* Default to linear for a few points or */
-    /* A very short arc (< 2 hours).         */
-    if((Nv < NUM_FOR_QUAD)||(tspread < 0.1)) {
-      bot = D*D - C*dobN;
+    obs_moments_from_sums(S, dobN, Nv, tspread, M);
+    dyv_set(res,0,M[0]);
+    dyv_set(res,1,M[1]);
+    dyv_set(res,2,M[2]);
+  }
+
+  return res;
+}
+
+
+/* Add a single (time offset, value, squared weight) point to the */
+/* running sums used by obs_moments_from_sums.                    */
+void obs_moment_sums_add(double* S, double t, double x, double w) {
+  S[0] += ((t*t*t*t)*w);
+  S[1] += ((t*t*t)*w);
+  S[2] += ((t*t)*w);
+  S[3] += ((t)*w);
+  S[4] += ((x*t*t)*w);
+  S[5] += ((x*t)*w);
+  S[6] += ((x)*w);
+}
+
+
+/* Solve the normal equations for (M_0, M_1, M_2) given the running  */
+/* sums, the (weighted) number of points, the number of distinct     */
+/* times (Nv > 1) and the time spread.  Matches mk_fill_obs_moments. */
+void obs_moments_from_sums(double* S, double dobN, int Nv, double tspread,
+                           double* M) {
+  double A = S[0], B = S[1], C = S[2], D = S[3];
+  double E = S[4], F = S[5], G = S[6];
+  double a, b, c;
+  double bot;
+
+  /* Default to linear for a few points or */
+  /* A very short arc (< 2 hours).         */
+  if((Nv < NUM_FOR_QUAD)||(tspread < 0.1)) {
+    bot = D*D - C*dobN;
      
-      a = 0.0;    
-      b = (G*D - dobN*F)/bot;
-      c = (F*D - C*G)/bot;
-    } else {
-      bot  = A*D*D - A*dobN*C + dobN*B*B;
-      bot += C*C*C - 2.0*C*B*D;
+    a = 0.0;    
+    b = (G*D - dobN*F)/bot;
+    c = (F*D - C*G)/bot;
+  } else {
+    bot  = A*D*D - A*dobN*C + dobN*B*B;
+    bot += C*C*C - 2.0*C*B*D;
 
-      a  = C*C*G - G*B*D + D*D*E;
-      a += B*dobN*F-dobN*E*C - D*F*C;
-      a  = 2.0 * (a/bot);
+    a  = C*C*G - G*B*D + D*D*E;
+    a += B*dobN*F-dobN*E*C - D*F*C;
+    a  = 2.0 * (a/bot);
 
-      b  = D*A*G - D*E*C - B*G*C;
-      b += B*dobN*E + F*C*C -dobN*A*F;
-      b  = (b/bot);
+    b  = D*A*G - D*E*C - B*G*C;
+    b += B*dobN*E + F*C*C -dobN*A*F;
+    b  = (b/bot);
       
-      c  = E*C*C - E*B*D - A*G*C + A*D*F;
-      c += B*B*G - C*B*F;
-      c  = (c/bot);
-    }
-
-    dyv_set(res,0,c);
-    dyv_set(res,1,b);
-    dyv_set(res,2,a);
+    c  = E*C*C - E*B*D - A*G*C + A*D*F;
+    c += B*B*G - C*B*F;
+    c  = (c/bot);
   }
 
-  return res;
+  M[0] = c;
+  M[1] = b;
+  M[2] = a;
 }
 
 
@@ -891,49 +915,9 @@ simple_obs_array* mk_simple_obs_array_concat(simple_obs_array* A,
 
 simple_obs_array* mk_simple_obs_array_from_MPC_file(char *filename, int start_id) 
 {
-  simple_obs_array* res = NULL;
-  simple_obs* A;
-  FILE *fp = fopen(filename,"r");
-  int size = 0; 
-  int line_number = 0;
-  char *s;
-  int i;
-
-  if (!fp) {
-    printf("ERROR: Unable to open MPC observation file (");
-    printf(filename);
-    printf(") for reading.\n");
-  } else {
-    printf("Loading file...\n");
-
-    /* Read through once to count the number of records */
-    while((s = mk_next_interesting_line_string(fp,&line_number))) {
-      size++;
-      free_string(s);
-    }
-
-    fclose(fp);
-    fp = fopen(filename,"r");
-
-    printf("Found %i observations to read.  Reading...\n",size);
-
-    /* Read through a second time extracting records */
-    i = 0;
-    res = mk_empty_simple_obs_array(size);
-    while((s = mk_next_interesting_line_string(fp,&line_number))) {
-      A = mk_simple_obs_from_MPC_string(s,start_id);
-      simple_obs_array_add(res,A);
-      start_id++;
-
-      free_simple_obs(A);
-      free_string(s);
-    }
-    
-    printf("Done loading.\n");
-    fclose(fp);
-  }
-
-  return res;
+  return mk_simple_obs_array_from_detection_file(filename, OBS_LOAD_MPC,
+                                                 start_id, NULL, NULL,
+                                                 NULL, NULL, NULL);
 }
 
 
@@ -1086,115 +1070,9 @@ simple_obs_array* mk_simple_obs_array_from_PANSTARRS_file(char *filename,
                                                           dyv** length,
                                                           dyv** angle,
                                                           dyv** exp_time) {
-  simple_obs_array* res = NULL;
-  simple_obs*       A;
-  string_array*     strarr;
-  namer*            nm1;
-  namer*            nm2;
-  FILE *fp = fopen(filename,"r");
-  int size = 0; 
-  int line_number = 0;
-  char* s;
-  char* name;
-  double tmp;
-  int i, ind;
-
-  if (!fp) {
-    printf("ERROR: Unable to open observation file (");
-    printf(filename);
-    printf(") for reading.\n");
-  } else {
-    printf("Loading file...\n");
-
-    /* Read through once to count the number of records */
-    while((s = mk_next_interesting_line_string(fp,&line_number))) {
-      size++;
-      free_string(s);
-    }
-
-    fclose(fp);
-    fp = fopen(filename,"r");
-
-    printf("Found %i observations to read.  Reading...\n",size);
-
-    /* Read through a second time extracting records */
-    i = 0;
-    res     = mk_empty_simple_obs_array(size);
-    nm1     = mk_empty_namer(TRUE);
-    nm2     = mk_empty_namer(TRUE);
-    if(pairs != NULL)       { pairs[0]       = mk_constant_ivec(size,-1);   }
-    if(true_groups != NULL) { true_groups[0] = mk_constant_ivec(size,-1);   }
-    if(length != NULL)      { length[0]      = mk_constant_dyv(size, -1.0); }
-    if(angle != NULL)       { angle[0]       = mk_zero_dyv(size);           }
-    if(exp_time != NULL)    { exp_time[0]    = mk_zero_dyv(size);           }
-
-    while((s = mk_next_interesting_line_string(fp,&line_number))) {
-   
-      if((strlen(s) > 2)&&(s[0] != '#')) {
-
-              strarr = mk_broken_string(s);
-              if(string_array_size(strarr) >= 6) {
-          name = string_array_ref(strarr,0);
-          A = mk_simple_obs_time(start_id,atof(string_array_ref(strarr,1)),
-          atof(string_array_ref(strarr,2))/15.0,
-          atof(string_array_ref(strarr,3)),
-          atof(string_array_ref(strarr,4)),'v',
-          atoi(string_array_ref(strarr,5)),name);
-
-          /* Load the tracklet name into pairs if nessecary. */        
-          if(pairs != NULL) {
-            add_to_namer(nm2,name);
-            ind = namer_name_to_index(nm2,name);
-            ivec_set(pairs[0],start_id,ind);
-          }
-
-          /* Load the object name into true_groups if nessecary. */        
-          if((true_groups != NULL)&&(string_array_size(strarr) >= 7)) {
-            name = string_array_ref(strarr, 6);
-
-            /* Get the index of this name */
-            if(!eq_string(name,"FALSE") && !eq_string(name, "NS") &&
-               !eq_string(name, "NA")) {
-              add_to_namer(nm1,name);
-              ind = namer_name_to_index(nm1,name);
-              ivec_set(true_groups[0],start_id,ind);
-            } else {
-              ivec_set(true_groups[0],start_id,-1);
-            }
-          }
-
-          /* Add elongation information (length, angle, and exposure time)  */
-          /* if it is present.                                              */
-          if((length != NULL)&&(string_array_size(strarr) >= 8)) {
-            tmp = atof(string_array_ref(strarr, 7)) * DEG_TO_RAD;
-            dyv_set(length[0], start_id, tmp);
-          }
-          if((angle != NULL)&&(string_array_size(strarr) >= 9)) {
-            tmp = atof(string_array_ref(strarr, 8)) * DEG_TO_RAD;
-            dyv_set(angle[0], start_id, tmp);
-          }
-          if((exp_time != NULL)&&(string_array_size(strarr) >= 10)) {
-            tmp = atof(string_array_ref(strarr, 9));
-            dyv_set(*exp_time, start_id, tmp / (24.0 * 60.0 * 60.0));
-          }
-
-          simple_obs_array_add(res,A);
-          start_id++;
-          free_simple_obs(A);
-        }
-        free_string_array(strarr);
-      }
-      free_string(s);
-    }
-
-    free_namer(nm1);
-    free_namer(nm2);
-    fclose(fp);
-
-    printf("Done loading.\n");
-  }
-
-  return res;
+  return mk_simple_obs_array_from_detection_file(filename, OBS_LOAD_PANSTARRS,
+                                                 start_id, true_groups, pairs,
+                                                 length, angle, exp_time);
 }
 
 
@@ -1217,108 +1095,9 @@ simple_obs_array* mk_simple_obs_array_from_PANSTARRS_file(char *filename,
 simple_obs_array* mk_simple_obs_array_from_DES_file(char *filename, int start_id, 
                                                     ivec** true_groups, ivec** pairs,
                                                     dyv** length, dyv** angle) {
-  simple_obs_array* res = NULL;
-  simple_obs*       A;
-  string_array*     strarr;
-  namer*            nm1;
-  namer*            nm2;
-  FILE *fp = fopen(filename,"r");
-  int size = 0; 
-  int line_number = 0;
-  char* s;
-  char* name;
-  double tmp;
-  int i, ind;
-
-  if (!fp) {
-    printf("ERROR: Unable to open observation file (");
-    printf(filename);
-    printf(") for reading.\n");
-  } else {
-    printf("Scanning file...\n");
-
-    /* Read through once to count the number of records */
-    while((s = mk_next_interesting_line_string(fp,&line_number))) {
-      size++;
-      free_string(s);
-    }
-
-    fclose(fp);
-    fp = fopen(filename,"r");
-
-    printf("Found %i observations to read.  Reading...\n",size);
-
-    /* Read through a second time extracting records */
-    i = 0;
-    res = mk_empty_simple_obs_array(size);
-    nm1 = mk_empty_namer(TRUE);
-    nm2 = mk_empty_namer(TRUE);
-    if(pairs != NULL)       { pairs[0]       = mk_constant_ivec(size,-1);  }
-    if(true_groups != NULL) { true_groups[0] = mk_constant_ivec(size,-1);  }
-    if(length != NULL)      { length[0]      = mk_constant_dyv(size,-1.0); }
-    if(angle != NULL)       { angle[0]       = mk_zero_dyv(size);          }
-
-    while((s = mk_next_interesting_line_string(fp,&line_number))) {
-   
-      if((strlen(s) > 2)&&(s[0] != '#') && !(s[0] == '!' && s[1] == '!')) {
-        strarr = mk_broken_string(s);
-        if(string_array_size(strarr) >= 6) {
-          name = string_array_ref(strarr,0);
-          A = mk_simple_obs_time(start_id,atof(string_array_ref(strarr,1)),
-          atof(string_array_ref(strarr,3))/15.0,
-          atof(string_array_ref(strarr,4)),
-          atof(string_array_ref(strarr,5)),'v',
-          atoi(string_array_ref(strarr,7)),name);
-
-          /* Load the tracklet name into pairs if nessecary. */        
-          if(pairs != NULL) {
-            add_to_namer(nm2,name);
-            ind = namer_name_to_index(nm2,name);
-            ivec_set(pairs[0],start_id,ind);
-          }
-
-          /* Load the object name into true_groups if nessecary. */        
-          if((true_groups != NULL)&&(string_array_size(strarr) >= 12)) {
-            name = string_array_ref(strarr, 12);
-
-            /* Get the index of this name */
-            if(!eq_string(name,"FALSE") && !eq_string(name, "NS") && !eq_string(name, "NA")) {
-              add_to_namer(nm1,name);
-              ind = namer_name_to_index(nm1,name);
-              ivec_set(true_groups[0],start_id,ind);
-            } else {
-              ivec_set(true_groups[0],start_id,-1);
-            }
-          }
-
-          if((length != NULL)&&(string_array_size(strarr) >= 8)) {
-            tmp = atof(string_array_ref(strarr,7)) * DEG_TO_RAD;
-            dyv_set(length[0],start_id,tmp);
-          }
-          if((angle != NULL)&&(string_array_size(strarr) >= 9)) {
-            tmp = atof(string_array_ref(strarr,8)) * DEG_TO_RAD;
-            dyv_set(angle[0],start_id,tmp);
-          }
-
-          simple_obs_array_add(res,A);
-          start_id++;
-          free_simple_obs(A);
-        }
-
-        free_string_array(strarr);
-      }
-      free_string(s);
-    }
-
-    free_namer(nm1);
-    free_namer(nm2);
-
-    printf("Done loading.\n");
-
-    fclose(fp);
-  }
-
-  return res;
+  return mk_simple_obs_array_from_detection_file(filename, OBS_LOAD_DES,
+                                                 start_id, true_groups, pairs,
+                                                 length, angle, NULL);
 }
 
 
@@ -1471,80 +1250,38 @@ simple_obs_array* mk_simple_obs_array_from_file_elong(char *filename,
                                                       dyv** angle,
                                                       dyv** exp_time) {
   simple_obs_array* obs;
-  FILE *fp = fopen(filename,"r");
-  int line_number = 0;
-  bool emptyfile = FALSE;
-  bool MPC = FALSE;
   ivec_array* tarr;
   ivec* pair;
-  char* s;
+  int format;
   int i, j;
 
-  /* Determine if the file is MPC format. */
-  if (!fp) {
-    printf("ERROR: Unable to open observation file (");
-    printf(filename);
-    printf(") for reading.\n");
-  } else {
-    s = mk_next_interesting_line_string(fp,&line_number);
-
-    if(s != NULL) {
-      MPC = ((int)strlen(s) >= 79);
-      MPC = MPC && ((s[0]==' ')&&(s[1]==' '));
-      MPC = MPC && ((s[2]==' ')&&(s[3]==' '));
-      MPC = MPC && ((s[20]=='0')||(s[20]=='1')||(s[20]==' '));
-      MPC = MPC && ((s[22]==' ')&&(s[64]==' ')&&(s[19]==' '));        
-      MPC = MPC && ((s[34]==' ')&&(s[37]==' ')&&(s[47]==' '));
-      MPC = MPC && (s[36]!=' ');
-      MPC = MPC && ((s[52]!=' ')&&(s[33]!=' ')&&(s[7]!=' '));
-      MPC = MPC && ((s[50]==' ')&&(s[58]==' ')&&(s[59]==' '));
-      MPC = MPC && ((s[60]==' ')&&(s[61]==' ')&&(s[62]==' '));
-      MPC = MPC && ((s[63]==' ')&&(s[64]==' ')&&(s[71]==' '));
-      MPC = MPC && ((s[72]==' ')&&(s[73]==' ')&&(s[74]==' '));
-      MPC = MPC && ((s[77]!=' ')&&(s[78]!=' ')&&(s[79]!=' '));
-      MPC = MPC && ((s[75]==' ')&&(s[76]==' '));
-    
-      free_string(s);
-    } else {
-      emptyfile = TRUE;
-    }
-
-    fclose(fp);
-  }
-
-  if(emptyfile == FALSE) {
-    if(MPC) {
-      printf("Loading detections as MPC format.\n");
-      obs = mk_simple_obs_array_from_MPC_file(filename,0);
-    
-      if((true_groups != NULL)&&(obs != NULL)) {
-        true_groups[0] = mk_simple_obs_groups_from_labels(obs, TRUE);
-
-        if(pairs != NULL) {
-          pairs[0] = mk_constant_ivec(ivec_size(true_groups[0]), -1);
-          tarr = mk_simple_obs_pairing_from_true_groups(obs, true_groups[0],
-                                                        max_t_dist);
-          for(i=0; i<ivec_array_size(tarr); i++) {
-            pair = ivec_array_ref(tarr,i);
-            for(j=0; j<ivec_size(pair); j++) {
-              ivec_set(pairs[0], ivec_ref(pair,j), i);
-            }
+  /* Guess the format from the text the loader reads, rather than */
+  /* opening the file twice, so that pipes can be loaded.         */
+  obs = mk_simple_obs_array_from_guessed_file(filename, 0, &format,
+                                              true_groups, pairs, length,
+                                              angle, exp_time);
+
+  if(format == OBS_LOAD_MPC) {
+    if((true_groups != NULL)&&(obs != NULL)) {
+      true_groups[0] = mk_simple_obs_groups_from_labels(obs, TRUE);
+
+      if(pairs != NULL) {
+        pairs[0] = mk_constant_ivec(ivec_size(true_groups[0]), -1);
+        tarr = mk_simple_obs_pairing_from_true_groups(obs, true_groups[0],
+                                                      max_t_dist);
+        for(i=0; i<ivec_array_size(tarr); i++) {
+          pair = ivec_array_ref(tarr,i);
+          for(j=0; j<ivec_size(pair); j++) {
+            ivec_set(pairs[0], ivec_ref(pair,j), i);
           }
-          free_ivec_array(tarr);
         }
+        free_ivec_array(tarr);
       }
-
-      if(length != NULL) { length[0] = NULL; }
-      if(angle != NULL) { angle[0]  = NULL; }
-      if(exp_time != NULL) { exp_time[0]  = NULL; }
-    } else {
-      printf("Loading detections as PanSTARRS format.\n");
-      obs = mk_simple_obs_array_from_PANSTARRS_file(filename, 0, true_groups,
-                                                    pairs, length, angle,
-                                                    exp_time);
     }
-  } else {
-    obs = mk_empty_simple_obs_array(0);
+
+    if(length != NULL) { length[0] = NULL; }
+    if(angle != NULL) { angle[0]  = NULL; }
+    if(exp_time != NULL) { exp_time[0]  = NULL; }
   }
   
   return obs;
@@ -1678,6 +1415,14 @@ void simple_obs_array_add(simple_obs_array* X, simple_obs* A) {
 }
 
 
+void simple_obs_array_add_no_copy(simple_obs_array* X, simple_obs* A) {
+  while(X->size >= X->max_size) { simple_obs_array_double_size(X); }
+
+  X->the_obs[X->size] = A;
+  X->size += 1;
+}
+
+
 int safe_simple_obs_array_size(simple_obs_array* X) {
   return X->size;
 }
@@ -2278,6 +2023,24 @@ void simple_obs_array_compute_bounds(simple_obs_array* arr, ivec* inds,
 
 
 /* Use inds=NULL to compute the information on all the observations. */
+dym* mk_recenter_rotation(double r_old, double r_new,
+                          double d_old, double d_new) {
+  dym *temp1, *temp2, *temp3, *temp4, *rot;
+
+  temp1 = mk_3d_rotation_mat_Z(r_old*15.0*DEG_TO_RAD);
+  temp2 = mk_3d_rotation_mat_Y((d_new-d_old)*DEG_TO_RAD); 
+  temp3 = mk_3d_rotation_mat_Z(-r_new*15.0*DEG_TO_RAD);
+  temp4 = mk_dym_mult(temp3,temp2);
+  rot   = mk_dym_mult(temp4,temp1);
+  free_dym(temp1);
+  free_dym(temp2);
+  free_dym(temp3);
+  free_dym(temp4);
+
+  return rot;
+}
+
+
 void recenter_simple_obs_array(simple_obs_array* arr, ivec* inds,
                                double r_old, double r_new,
                                double d_old, double d_new,
@@ -2285,7 +2048,7 @@ void recenter_simple_obs_array(simple_obs_array* arr, ivec* inds,
   simple_obs* X;
   int N = simple_obs_array_size(arr);
   int i, ind;
-  dym *temp1, *temp2, *temp3, *temp4, *rot;
+  dym* rot;
   dyv* org = mk_zero_dyv(3);
   dyv* res = mk_zero_dyv(3);
   double r, d, x, y, z;
@@ -2293,15 +2056,7 @@ void recenter_simple_obs_array(simple_obs_array* arr, ivec* inds,
   if(inds != NULL) { N = ivec_size(inds); }
 
   /* Compute the rotation matrix! ----------------- */  
-  temp1 = mk_3d_rotation_mat_Z(r_old*15.0*DEG_TO_RAD);
-  temp2 = mk_3d_rotation_mat_Y((d_new-d_old)*DEG_TO_RAD); 
-  temp3 = mk_3d_rotation_mat_Z(-r_new*15.0*DEG_TO_RAD);
-  temp4 = mk_dym_mult(temp3,temp2);
-  rot   = mk_dym_mult(temp4,temp1);
-  free_dym(temp1);
-  free_dym(temp2);
-  free_dym(temp3);
-  free_dym(temp4);
+  rot = mk_recenter_rotation(r_old, r_new, d_old, d_new);
 
   /* Check all of the other observations for bounds. */
   for(i=0;i<N;i++) {
@@ -232,6 +232,18 @@ char* mk_string_from_simple_obs(simple_obs* S);
 */
 dyv* mk_fill_obs_moments(dyv* X, dyv* time, dyv* weights, int num_coefficients);
 
+/* The running sums behind mk_fill_obs_moments, so that a fit can be */
+/* updated one point at a time.  S holds OBS_MOMENT_SUMS values:     */
+/*   sum w*t^4, w*t^3, w*t^2, w*t, w*x*t^2, w*x*t, w*x               */
+/* where w is the squared weight (1.0 if unweighted).                */
+#define OBS_MOMENT_SUMS 7
+
+void obs_moment_sums_add(double* S, double t, double x, double w);
+
+/* Fills M[0..2] from the sums.  Requires Nv > 1 distinct times. */
+void obs_moments_from_sums(double* S, double dobN, int Nv, double tspread,
+                           double* M);
+
 dyv* mk_obs_RA_moments(simple_obs_array* obs, int num_coeff);
 
 dyv* mk_obs_DEC_moments(simple_obs_array* obs, int num_coeff);
@@ -314,6 +326,8 @@ dym* mk_xy_obs_from_megacam_file(char *filename, double min_sigma,
 
 /* Load the detections file from either MPC of PanSTARRS format.              */
 /* Automatically decides which format the file is in (hopefully).             */
+/* The file is read in a single pass by the obs_load module (using           */
+/* obs_load_set_threads() threads).                                           */
 /* If true_groups and pairs are not null then they hold the true_group        */
 /* information and the tracklet information (both need to be FREED if used).  */
 simple_obs_array* mk_simple_obs_array_from_file_elong(char *filename,
@@ -340,6 +354,9 @@ void simple_obs_array_set(simple_obs_array* X, int index, simple_obs* A);
 
 void simple_obs_array_add(simple_obs_array* X, simple_obs* A);
 
+/* Add A itself (not a copy).  X takes ownership of A. */
+void simple_obs_array_add_no_copy(simple_obs_array* X, simple_obs* A);
+
 int safe_simple_obs_array_size(simple_obs_array* X);
 
 int safe_simple_obs_array_max_size(simple_obs_array* X);
@@ -433,6 +450,10 @@ void simple_obs_array_compute_bounds(simple_obs_array* arr, ivec* inds,
                                      double *d_lo, double* d_hi,
                                      double *t_lo, double* t_hi);
 
+/* The 3d rotation used by recenter_simple_obs_array. */
+dym* mk_recenter_rotation(double r_old, double r_new,
+                          double d_old, double d_new);
+
 /* Rotate all of the observations such that IF they were centered */
 /* on (r_old, d_old) they are now centered on (r_new, d_new) AND  */
 /* since it is a rotation all pairwise distances are maintained.  */
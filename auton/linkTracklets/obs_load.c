@@ -0,0 +1,767 @@
+/*
+   File:        obs_load.c
+   Author(s):   PS1 MOPS
+   Created:     Fri Oct 16, 2026
+   Description: A single pass loader for detection files (PanSTARRS/MITI,
+                MPC and DES formats).  The file is memory mapped, cut into
+                line aligned chunks and the chunks are parsed in place
+                (optionally by several threads).  The detections are then
+                collected in file order, so the result is exactly that of
+                the line by line loaders in obs.c.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifdef USE_PTHREADS
+#include <pthread.h>
+#endif
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "obs_load.h"
+#include "worker_threads.h"
+
+/* The most whitespace separated columns any format looks at. */
+#define OBS_LOAD_MAX_TOKENS 13
+
+/* Do not give a thread less than this many bytes of the file. */
+#define OBS_LOAD_MIN_CHUNK  (1 << 20)
+
+/* The first buffer size when reading a pipe, or sniffing a format. */
+#define OBS_LOAD_READ_BYTES (1 << 16)
+
+#define OBS_LOAD_IS_SEP(c) (((c)==' ')||((c)=='\t')||((c)=='\r')||((c)=='\n'))
+
+#define OBS_LOAD_C_TO_I(X)    ((X) - '0')
+#define OBS_LOAD_CC_TO_I(X,Y) (OBS_LOAD_C_TO_I(X)*10 + OBS_LOAD_C_TO_I(Y))
+
+int obs_load_threads = 1;
+
+
+/* --- Settings ---------------------------------------------------------- */
+
+void obs_load_set_threads(int threads) {
+  obs_load_threads = (threads > 1) ? threads : 1;
+}
+
+
+int obs_load_get_threads(void) {
+  return obs_load_threads;
+}
+
+
+/* --- The file text ----------------------------------------------------- */
+
+/* The whole text of a file.  text[size] is always readable and '\0'. */
+/* alloc is the number of bytes mapped or allocated, which may be    */
+/* more than size + 1.                                                */
+typedef struct obs_load_text
+{
+  char*  text;
+  size_t size;
+  size_t alloc;
+  bool   mapped;
+} obs_load_text;
+
+
+/* Double the buffer text (of alloc bytes, the first size of which */
+/* are used).  Returns the new buffer and updates alloc.           */
+char* obs_load_grow(char* text, size_t size, size_t* alloc) {
+  char* res = AM_MALLOC_ARRAY(char, 2 * alloc[0]);
+
+  memcpy(res, text, size);
+  AM_FREE_ARRAY(text, char, alloc[0]);
+  alloc[0] *= 2;
+
+  return res;
+}
+
+
+/* Read fd into T until end of file, for pipes and other files whose */
+/* size is not known in advance.                                     */
+void obs_load_text_read_all(obs_load_text* T, int fd) {
+  ssize_t got;
+
+  T->alloc = OBS_LOAD_READ_BYTES;
+  T->text  = AM_MALLOC_ARRAY(char, T->alloc);
+  T->size  = 0;
+  while(TRUE) {
+    if(T->size + 1 >= T->alloc) {
+      T->text = obs_load_grow(T->text, T->size, &(T->alloc));
+    }
+    got = read(fd, T->text + T->size, T->alloc - 1 - T->size);
+    if(got <= 0) { break; }
+    T->size += (size_t)got;
+  }
+  T->text[T->size] = '\0';
+}
+
+
+obs_load_text* mk_obs_load_text(char* filename) {
+  obs_load_text* T;
+  struct stat sb;
+  long page = sysconf(_SC_PAGESIZE);
+  ssize_t got;
+  size_t done = 0;
+  int fd;
+
+  fd = open(filename, O_RDONLY);
+  if(fd < 0) { return NULL; }
+  if(fstat(fd, &sb) != 0) {
+    close(fd);
+    return NULL;
+  }
+
+  T = AM_MALLOC(obs_load_text);
+  T->text   = NULL;
+  T->size   = 0;
+  T->alloc  = 0;
+  T->mapped = FALSE;
+
+  if(!S_ISREG(sb.st_mode)) {
+    obs_load_text_read_all(T, fd);
+    close(fd);
+    return T;
+  }
+  T->size = (size_t)sb.st_size;
+
+  /* Map the file privately (copy on write) so that the lines can be  */
+  /* cut up in place without touching the file.  The rest of the last */
+  /* page reads as zeros, which terminates the last line, unless the  */
+  /* file fills that page exactly.  Then (or if mapping fails) just   */
+  /* read the file.                                                   */
+  if((T->size > 0)&&(page > 0)&&(T->size % (size_t)page != 0)) {
+    T->text = (char*)mmap(NULL, T->size, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE, fd, 0);
+    if(T->text == (char*)MAP_FAILED) {
+      T->text = NULL;
+    } else {
+      T->alloc  = T->size;
+      T->mapped = TRUE;
+      madvise(T->text, T->size, MADV_SEQUENTIAL);
+    }
+  }
+
+  if(T->text == NULL) {
+    T->alloc = T->size + 1;
+    T->text  = AM_MALLOC_ARRAY(char, T->alloc);
+    while(done < T->size) {
+      got = read(fd, T->text + done, T->size - done);
+      if(got <= 0) { break; }
+      done += (size_t)got;
+    }
+    T->size = done;
+    T->text[T->size] = '\0';
+  }
+  close(fd);
+
+  return T;
+}
+
+
+void free_obs_load_text(obs_load_text* T) {
+  if(T->mapped) {
+    munmap(T->text, T->alloc);
+  } else {
+    AM_FREE_ARRAY(T->text, char, T->alloc);
+  }
+  AM_FREE(T, obs_load_text);
+}
+
+
+/* Cut the line starting at s in place: its end of line becomes '\0' */
+/* (dropping a DOS carriage return).  Returns the start of the next  */
+/* line (end if there is none).                                      */
+char* obs_load_cut_line(char* s, char* end) {
+  char* e = (char*)memchr(s, '\n', end - s);
+
+  if(e == NULL) { e = end; }
+  *e = '\0';
+  if((e > s)&&(e[-1] == '\r')) { e[-1] = '\0'; }
+
+  return (e < end) ? e + 1 : end;
+}
+
+
+/* Break s in place into whitespace separated tokens (the same tokens */
+/* as mk_broken_string, including its handling of quotes).  Records   */
+/* the first max_tok and returns the total number of tokens.          */
+int obs_load_break_line(char* s, char** tok, int max_tok) {
+  bool quoted;
+  int slashes;
+  int N = 0;
+
+  while(*s != '\0') {
+    while(OBS_LOAD_IS_SEP(*s)) { s++; }
+    if(*s == '\0') { break; }
+
+    if(N < max_tok) { tok[N] = s; }
+    N++;
+
+    quoted  = FALSE;
+    slashes = 0;
+    while((*s != '\0')&&(quoted || !OBS_LOAD_IS_SEP(*s))) {
+      if((*s == '\"')&&(slashes % 2 == 0)) { quoted = !quoted; }
+      slashes = (*s == '\\') ? slashes + 1 : 0;
+      s++;
+    }
+    if(*s != '\0') {
+      *s = '\0';
+      s++;
+    }
+  }
+
+  return N;
+}
+
+
+/* --- Chunk parsing ----------------------------------------------------- */
+
+/* One interesting line of the file.  name is NULL if the line */
+/* does not hold a detection.                                   */
+typedef struct obs_load_row
+{
+  char*  name;
+  char*  object;
+  double time;
+  double RA;
+  double DEC;
+  double brightness;
+  double length;
+  double angle;
+  double exp_time;
+  int    obs_code;
+  int    num_tokens;
+  char   type;
+} obs_load_row;
+
+
+/* A line aligned piece of the text and the rows parsed from it. */
+typedef struct obs_load_chunk
+{
+  char* start;
+  char* end;
+  int   format;
+
+  obs_load_row* rows;
+  int num_rows;
+  int max_rows;
+} obs_load_chunk;
+
+
+/* The chunks of a load, handed out to the workers one at a time. */
+typedef struct obs_load_job
+{
+  obs_load_chunk* C;
+  int num_chunks;
+  int next_chunk;
+#ifdef USE_PTHREADS
+  pthread_mutex_t lock;
+#endif
+} obs_load_job;
+
+
+/* atof of the columns [start,end) of s. */
+double obs_load_atof_cols(char* s, int start, int end) {
+  char buf[16];
+  int i;
+
+  for(i=0;(i < end - start)&&(i < 15);i++) { buf[i] = s[start + i]; }
+  buf[i] = '\0';
+
+  return atof(buf);
+}
+
+
+/* Parse the fixed columns of an MPC line, the same fields as      */
+/* mk_simple_obs_from_MPC_string but without allocating (so that   */
+/* it can run in the chunk workers).  The name (columns 5-11) is   */
+/* cut off in place and padded to 8 characters as in simple_obs,   */
+/* so the line is no longer whole afterward.                       */
+void obs_load_parse_MPC_row(obs_load_row* R, char* s) {
+  int year, month;
+  double day;
+
+  if((int)strlen(s) < 80) { return; }
+
+  year  = OBS_LOAD_CC_TO_I(s[15],s[16])*100 + OBS_LOAD_CC_TO_I(s[17],s[18]);
+  month = OBS_LOAD_CC_TO_I(s[20],s[21]);
+  day   = obs_load_atof_cols(s,23,31);
+  R->time = frac_date_to_MJD(year, month, day);
+
+  R->RA  = (double)(OBS_LOAD_CC_TO_I(s[32],s[33]));
+  R->RA += ((double)(OBS_LOAD_CC_TO_I(s[35],s[36]))) / 60.0;
+  R->RA += obs_load_atof_cols(s,38,44) / 3600.0;
+
+  R->DEC  = (double)(OBS_LOAD_CC_TO_I(s[45],s[46]));
+  R->DEC += ((double)(OBS_LOAD_CC_TO_I(s[48],s[49]))) / 60.0;
+  R->DEC += obs_load_atof_cols(s,51,56) / 3600.0;
+  if(s[44] == '-') {
+    R->DEC *= -1.0;
+  }
+
+  R->brightness = obs_load_atof_cols(s,65,69);
+  R->obs_code   = atoi(s + 77);
+  R->type       = s[70];
+
+  s[12]   = ' ';
+  s[13]   = '\0';
+  R->name = s + 5;
+}
+
+
+void obs_load_parse_row(obs_load_row* R, char* s, int format) {
+  char* tok[OBS_LOAD_MAX_TOKENS];
+  int N;
+
+  R->name       = NULL;
+  R->object     = NULL;
+  R->num_tokens = 0;
+  R->type       = 'v';
+
+  if(format == OBS_LOAD_MPC) {
+    obs_load_parse_MPC_row(R, s);
+    return;
+  }
+
+  /* Skip the short lines, (##) comments and DES (!!) headers. */
+  if((s[0] == '\0')||(s[1] == '\0')||(s[2] == '\0')||(s[0] == '#')) {
+    return;
+  }
+  if((format == OBS_LOAD_DES)&&(s[0] == '!')&&(s[1] == '!')) { return; }
+
+  N = obs_load_break_line(s, tok, OBS_LOAD_MAX_TOKENS);
+  R->num_tokens = N;
+
+  if((format == OBS_LOAD_PANSTARRS)&&(N >= 6)) {
+    R->name       = tok[0];
+    R->time       = atof(tok[1]);
+    R->RA         = atof(tok[2]) / 15.0;
+    R->DEC        = atof(tok[3]);
+    R->brightness = atof(tok[4]);
+    R->obs_code   = atoi(tok[5]);
+    if(N >= 7)  { R->object   = tok[6]; }
+    if(N >= 8)  { R->length   = atof(tok[7]) * DEG_TO_RAD; }
+    if(N >= 9)  { R->angle    = atof(tok[8]) * DEG_TO_RAD; }
+    if(N >= 10) { R->exp_time = atof(tok[9]) / (24.0 * 60.0 * 60.0); }
+  }
+
+  /* The DES observatory code is column 7, so shorter lines are skipped. */
+  if((format == OBS_LOAD_DES)&&(N >= 8)) {
+    R->name       = tok[0];
+    R->time       = atof(tok[1]);
+    R->RA         = atof(tok[3]) / 15.0;
+    R->DEC        = atof(tok[4]);
+    R->brightness = atof(tok[5]);
+    R->obs_code   = atoi(tok[7]);
+    R->length     = atof(tok[7]) * DEG_TO_RAD;
+    if(N >= 9)  { R->angle  = atof(tok[8]) * DEG_TO_RAD; }
+    if(N >= 13) { R->object = tok[12]; }
+  }
+}
+
+
+void obs_load_parse_chunk(obs_load_chunk* C) {
+  obs_load_row* nu_rows;
+  char* s = C->start;
+  char* next;
+  int i;
+
+  while(s < C->end) {
+    next = obs_load_cut_line(s, C->end);
+
+    if(line_string_is_interesting(s)) {
+      if(C->num_rows >= C->max_rows) {
+        nu_rows = AM_MALLOC_ARRAY(obs_load_row, 2 * C->max_rows);
+        for(i=0;i<C->num_rows;i++) { nu_rows[i] = C->rows[i]; }
+        AM_FREE_ARRAY(C->rows, obs_load_row, C->max_rows);
+        C->rows      = nu_rows;
+        C->max_rows *= 2;
+      }
+
+      obs_load_parse_row(&(C->rows[C->num_rows]), s, C->format);
+      C->num_rows += 1;
+    }
+
+    s = next;
+  }
+}
+
+
+/* Worker: parse the next unparsed chunk until there are none left. */
+void* obs_load_chunk_worker(void* arg) {
+  obs_load_job* job = (obs_load_job*)arg;
+  int c;
+
+  while(TRUE) {
+#ifdef USE_PTHREADS
+    pthread_mutex_lock(&job->lock);
+#endif
+    c = job->next_chunk;
+    job->next_chunk += 1;
+#ifdef USE_PTHREADS
+    pthread_mutex_unlock(&job->lock);
+#endif
+
+    if(c >= job->num_chunks) { break; }
+    obs_load_parse_chunk(&(job->C[c]));
+  }
+
+  return NULL;
+}
+
+
+/* Cut the text into (at most obs_load_threads) line aligned chunks */
+/* and parse them, in parallel if possible.                         */
+obs_load_chunk* mk_obs_load_chunks(obs_load_text* T, int format,
+                                   int* num_chunks) {
+  obs_load_chunk* C;
+  char* end = T->text + T->size;
+  char* s;
+  obs_load_job job;
+  int N = obs_load_threads;
+  int i;
+
+#ifndef USE_PTHREADS
+  N = 1;
+#endif
+  if((size_t)N > T->size / OBS_LOAD_MIN_CHUNK) {
+    N = (int)(T->size / OBS_LOAD_MIN_CHUNK);
+  }
+  if(N < 1) { N = 1; }
+
+  C = AM_MALLOC_ARRAY(obs_load_chunk, N);
+  s = T->text;
+  for(i=0;i<N;i++) {
+    C[i].start = s;
+    if(i == N-1) {
+      s = end;
+    } else {
+      s = T->text + (T->size / N) * (i+1);
+      if(s < C[i].start) { s = C[i].start; }
+      s = (char*)memchr(s, '\n', end - s);
+      s = (s == NULL) ? end : s + 1;
+    }
+    C[i].end      = s;
+    C[i].format   = format;
+    C[i].num_rows = 0;
+    C[i].max_rows = (int)((C[i].end - C[i].start) / 64) + 16;
+    C[i].rows     = AM_MALLOC_ARRAY(obs_load_row, C[i].max_rows);
+  }
+
+  job.C          = C;
+  job.num_chunks = N;
+  job.next_chunk = 0;
+#ifdef USE_PTHREADS
+  pthread_mutex_init(&job.lock, NULL);
+#endif
+  run_worker_threads(obs_load_chunk_worker, &job, N);
+#ifdef USE_PTHREADS
+  pthread_mutex_destroy(&job.lock);
+#endif
+
+  num_chunks[0] = N;
+
+  return C;
+}
+
+
+void free_obs_load_chunks(obs_load_chunk* C, int num_chunks) {
+  int i;
+
+  for(i=0;i<num_chunks;i++) {
+    AM_FREE_ARRAY(C[i].rows, obs_load_row, C[i].max_rows);
+  }
+  AM_FREE_ARRAY(C, obs_load_chunk, num_chunks);
+}
+
+
+/* --- Loading functions ------------------------------------------------- */
+
+bool obs_load_line_is_MPC(char* s) {
+  bool MPC;
+
+  MPC = ((int)strlen(s) >= 79);
+  MPC = MPC && ((s[0]==' ')&&(s[1]==' '));
+  MPC = MPC && ((s[2]==' ')&&(s[3]==' '));
+  MPC = MPC && ((s[20]=='0')||(s[20]=='1')||(s[20]==' '));
+  MPC = MPC && ((s[22]==' ')&&(s[64]==' ')&&(s[19]==' '));
+  MPC = MPC && ((s[34]==' ')&&(s[37]==' ')&&(s[47]==' '));
+  MPC = MPC && (s[36]!=' ');
+  MPC = MPC && ((s[52]!=' ')&&(s[33]!=' ')&&(s[7]!=' '));
+  MPC = MPC && ((s[50]==' ')&&(s[58]==' ')&&(s[59]==' '));
+  MPC = MPC && ((s[60]==' ')&&(s[61]==' ')&&(s[62]==' '));
+  MPC = MPC && ((s[63]==' ')&&(s[64]==' ')&&(s[71]==' '));
+  MPC = MPC && ((s[72]==' ')&&(s[73]==' ')&&(s[74]==' '));
+  MPC = MPC && ((s[77]!=' ')&&(s[78]!=' ')&&(s[79]!=' '));
+  MPC = MPC && ((s[75]==' ')&&(s[76]==' '));
+
+  return MPC;
+}
+
+
+/* The format of the first interesting line of text[0,size), or     */
+/* OBS_LOAD_EMPTY if there is none.  Unless eof, a last line without */
+/* an end of line may be incomplete and is not looked at.  The text  */
+/* is not changed.                                                    */
+int obs_load_text_format(char* text, size_t size, bool eof) {
+  char* end = text + size;
+  char* s;
+  char* e;
+  char* line;
+  size_t len;
+  int format = OBS_LOAD_EMPTY;
+
+  for(s=text;(s < end)&&(format == OBS_LOAD_EMPTY);s=e+1) {
+    e = (char*)memchr(s, '\n', end - s);
+    if(e == NULL) {
+      if(!eof) { break; }
+      e = end;
+    }
+    len = e - s;
+    if((len > 0)&&(s[len-1] == '\r')) { len--; }
+
+    line = AM_MALLOC_ARRAY(char, len + 1);
+    memcpy(line, s, len);
+    line[len] = '\0';
+    if(line_string_is_interesting(line)) {
+      format = obs_load_line_is_MPC(line) ? OBS_LOAD_MPC : OBS_LOAD_PANSTARRS;
+    }
+    AM_FREE_ARRAY(line, char, len + 1);
+  }
+
+  return format;
+}
+
+
+int obs_load_file_format(char* filename) {
+  int format = OBS_LOAD_EMPTY;
+  size_t alloc = OBS_LOAD_READ_BYTES;
+  size_t size = 0;
+  size_t from = 0;
+  size_t i;
+  bool eof = FALSE;
+  ssize_t got;
+  char* text;
+  int fd;
+
+  fd = open(filename, O_RDONLY);
+  if(fd < 0) { return OBS_LOAD_ERROR; }
+
+  /* Only read as far as the end of the first interesting line. */
+  text = AM_MALLOC_ARRAY(char, alloc);
+  while((format == OBS_LOAD_EMPTY)&&(!eof)) {
+    if(size == alloc) {
+      text = obs_load_grow(text, size, &alloc);
+    }
+    got = read(fd, text + size, alloc - size);
+    if(got > 0) {
+      size += (size_t)got;
+    } else {
+      eof = TRUE;
+    }
+    format = obs_load_text_format(text + from, size - from, eof);
+
+    /* Do not look at the complete lines again. */
+    for(i=size;i > from;i--) {
+      if(text[i-1] == '\n') {
+        from = i;
+        break;
+      }
+    }
+  }
+  AM_FREE_ARRAY(text, char, alloc);
+  close(fd);
+
+  return format;
+}
+
+
+/* The index of name in (the case sensitive) nm, adding it if needed. */
+/* Unlike add_to_namer then namer_name_to_index this hashes a known  */
+/* name only once.                                                    */
+int obs_load_name_index(namer* nm, char* name) {
+  int ind = namer_name_to_index(nm, name);
+
+  if(ind < 0) {
+    ind = namer_num_indexes(nm);
+    add_to_namer(nm, name);
+  }
+
+  return ind;
+}
+
+
+/* Load the file and collect its detections, in file order, into */
+/* arr.  If format is OBS_LOAD_GUESS it is set from the first      */
+/* interesting line of the text read (so a pipe is read only once) */
+/* and a file with no interesting lines gives an empty arr.  Returns */
+/* FALSE if the file could not be read.                              */
+bool obs_load_file(char* filename, int* format, int start_id,
+                   simple_obs_array** arr,
+                   ivec** true_groups, ivec** pairs,
+                   dyv** length, dyv** angle, dyv** exp_time) {
+  obs_load_text*  T;
+  obs_load_chunk* C;
+  obs_load_row*   R;
+  simple_obs* A;
+  namer* nm1;
+  namer* nm2;
+  int num_chunks;
+  int size = 0;
+  int id = start_id;
+  int c, r;
+
+  T = mk_obs_load_text(filename);
+  if(T == NULL) {
+    printf("ERROR: Unable to open observation file (");
+    printf(filename);
+    printf(") for reading.\n");
+    return FALSE;
+  }
+
+  if(format[0] == OBS_LOAD_GUESS) {
+    format[0] = obs_load_text_format(T->text, T->size, TRUE);
+    if(format[0] == OBS_LOAD_MPC) {
+      printf("Loading detections as MPC format.\n");
+    } else if(format[0] == OBS_LOAD_PANSTARRS) {
+      printf("Loading detections as PanSTARRS format.\n");
+    } else {
+      arr[0] = mk_empty_simple_obs_array(0);
+      free_obs_load_text(T);
+      return TRUE;
+    }
+  }
+
+  printf((format[0] == OBS_LOAD_DES) ? "Scanning file...\n" : "Loading file...\n");
+
+  C = mk_obs_load_chunks(T, format[0], &num_chunks);
+  for(c=0;c<num_chunks;c++) {
+    size += C[c].num_rows;
+  }
+
+  printf("Found %i observations to read.  Reading...\n",size);
+
+  arr[0] = mk_empty_simple_obs_array(size);
+  if(format[0] == OBS_LOAD_MPC) {
+    true_groups = NULL;
+    pairs       = NULL;
+    length      = NULL;
+    angle       = NULL;
+    exp_time    = NULL;
+  }
+  nm1 = mk_empty_namer(TRUE);
+  nm2 = mk_empty_namer(TRUE);
+  if(pairs != NULL)       { pairs[0]       = mk_constant_ivec(size,-1);   }
+  if(true_groups != NULL) { true_groups[0] = mk_constant_ivec(size,-1);   }
+  if(length != NULL)      { length[0]      = mk_constant_dyv(size, -1.0); }
+  if(angle != NULL)       { angle[0]       = mk_zero_dyv(size);           }
+  if(exp_time != NULL)    { exp_time[0]    = mk_zero_dyv(size);           }
+
+  /* Collect the rows in order.  The names are interned here so that */
+  /* the indices are the same as a line by line load.               */
+  for(c=0;c<num_chunks;c++) {
+    for(r=0;r<C[c].num_rows;r++) {
+      R = &(C[c].rows[r]);
+
+      if(R->name == NULL) { continue; }
+
+      A = mk_simple_obs_time(id, R->time, R->RA, R->DEC, R->brightness,
+                             R->type, R->obs_code, R->name);
+      simple_obs_array_add_no_copy(arr[0], A);
+      if(format[0] == OBS_LOAD_MPC) {
+        id++;
+        continue;
+      }
+
+      /* Load the tracklet name into pairs if nessecary. */
+      if(pairs != NULL) {
+        ivec_set(pairs[0], id, obs_load_name_index(nm2, R->name));
+      }
+
+      /* Load the object name into true_groups if nessecary. */
+      if((true_groups != NULL)&&(R->object != NULL)) {
+        if(!eq_string(R->object,"FALSE") && !eq_string(R->object,"NS") &&
+           !eq_string(R->object,"NA")) {
+          ivec_set(true_groups[0], id, obs_load_name_index(nm1, R->object));
+        } else {
+          ivec_set(true_groups[0], id, -1);
+        }
+      }
+
+      if((length != NULL)&&(R->num_tokens >= 8)) {
+        dyv_set(length[0], id, R->length);
+      }
+      if((angle != NULL)&&(R->num_tokens >= 9)) {
+        dyv_set(angle[0], id, R->angle);
+      }
+      if((exp_time != NULL)&&(format[0] == OBS_LOAD_PANSTARRS)&&
+         (R->num_tokens >= 10)) {
+        dyv_set(exp_time[0], id, R->exp_time);
+      }
+
+      id++;
+    }
+  }
+
+  free_namer(nm1);
+  free_namer(nm2);
+  free_obs_load_chunks(C, num_chunks);
+  free_obs_load_text(T);
+
+  printf("Done loading.\n");
+
+  return TRUE;
+}
+
+
+simple_obs_array* mk_simple_obs_array_from_detection_file(char* filename,
+                                                          int format,
+                                                          int start_id,
+                                                          ivec** true_groups,
+                                                          ivec** pairs,
+                                                          dyv** length,
+                                                          dyv** angle,
+                                                          dyv** exp_time) {
+  simple_obs_array* res = NULL;
+
+  obs_load_file(filename, &format, start_id, &res, true_groups, pairs,
+                length, angle, exp_time);
+
+  return res;
+}
+
+
+simple_obs_array* mk_simple_obs_array_from_guessed_file(char* filename,
+                                                        int start_id,
+                                                        int* format,
+                                                        ivec** true_groups,
+                                                        ivec** pairs,
+                                                        dyv** length,
+                                                        dyv** angle,
+                                                        dyv** exp_time) {
+  simple_obs_array* res = NULL;
+
+  format[0] = OBS_LOAD_GUESS;
+  if(!obs_load_file(filename, format, start_id, &res, true_groups, pairs,
+                    length, angle, exp_time)) {
+    format[0] = OBS_LOAD_ERROR;
+  }
+
+  return res;
+}
@@ -0,0 +1,90 @@
+/*
+   File:        obs_load.h
+   Author(s):   PS1 MOPS
+   Created:     Fri Oct 16, 2026
+   Description: A single pass loader for detection files (PanSTARRS/MITI,
+                MPC and DES formats).  The file is memory mapped, cut into
+                line aligned chunks and the chunks are parsed in place
+                (optionally by several threads).  The detections are then
+                collected in file order, so the result is exactly that of
+                the line by line loaders in obs.c.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef OBS_LOAD_H
+#define OBS_LOAD_H
+
+#include "obs.h"
+
+/* The detection file formats. */
+#define OBS_LOAD_ERROR     -1   /* The file could not be read. */
+#define OBS_LOAD_EMPTY      0   /* No interesting lines.       */
+#define OBS_LOAD_PANSTARRS  1
+#define OBS_LOAD_MPC        2
+#define OBS_LOAD_DES        3
+#define OBS_LOAD_GUESS      4   /* Guess from the text read.   */
+
+
+/* --- Settings ---------------------------------------------------------- */
+
+/* The number of threads used to parse a file (default = 1).  Has no */
+/* effect unless the code is built with thread=1.                   */
+void obs_load_set_threads(int threads);
+
+int obs_load_get_threads(void);
+
+
+/* --- Loading functions ------------------------------------------------- */
+
+/* Is the (interesting) line an MPC 80 column detection line? */
+bool obs_load_line_is_MPC(char* s);
+
+/* Guess the format of a detection file from its first interesting  */
+/* line: OBS_LOAD_MPC or OBS_LOAD_PANSTARRS (or OBS_LOAD_EMPTY and  */
+/* OBS_LOAD_ERROR).  Reads only up to the end of that line, so on */
+/* a pipe those lines are gone: use mk_simple_obs_array_from_      */
+/* guessed_file to read a pipe.                                     */
+int obs_load_file_format(char* filename);
+
+/* Load a detection file of the given format.  The optional outputs    */
+/* (which may be NULL) are filled in the same way as by               */
+/* mk_simple_obs_array_from_PANSTARRS_file (mk_simple_obs_array_      */
+/* from_DES_file for the DES format) and are ignored for MPC files.   */
+/* Returns NULL if the file could not be read.                         */
+simple_obs_array* mk_simple_obs_array_from_detection_file(char* filename,
+                                                          int format,
+                                                          int start_id,
+                                                          ivec** true_groups,
+                                                          ivec** pairs,
+                                                          dyv** length,
+                                                          dyv** angle,
+                                                          dyv** exp_time);
+
+/* As mk_simple_obs_array_from_detection_file, but the format is      */
+/* guessed (as by obs_load_file_format) from the text once it is read, */
+/* so a pipe or /dev/stdin is read only once.  format is set to the   */
+/* format found: OBS_LOAD_MPC or OBS_LOAD_PANSTARRS, OBS_LOAD_EMPTY    */
+/* (an empty array is returned and the outputs are not set) or         */
+/* OBS_LOAD_ERROR (NULL is returned).                                   */
+simple_obs_array* mk_simple_obs_array_from_guessed_file(char* filename,
+                                                        int start_id,
+                                                        int* format,
+                                                        ivec** true_groups,
+                                                        ivec** pairs,
+                                                        dyv** length,
+                                                        dyv** angle,
+                                                        dyv** exp_time);
+
+#endif
@@ -0,0 +1,172 @@
+/*
+   File:        obs_store.c
+   Author(s):   PS1 MOPS
+   Created:     Fri Oct 16, 2026
+   Description: A columnar (structure of arrays) detection store.  The
+                times, positions and brightnesses of all detections are
+                kept in contiguous arrays so that the tree and fitting
+                inner loops scan memory in order instead of following a
+                pointer per detection.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "obs_store.h"
+
+#define OBS_STORE_MIN_SIZE 16
+
+
+/* --- Memory functions ------------------------------------------------ */
+
+void obs_store_alloc_columns(obs_store* st, int size) {
+  st->max_size   = size;
+
+  st->time       = AM_MALLOC_ARRAY(double,size);
+  st->RA         = AM_MALLOC_ARRAY(double,size);
+  st->DEC        = AM_MALLOC_ARRAY(double,size);
+  st->brightness = AM_MALLOC_ARRAY(float,size);
+  st->x          = AM_MALLOC_ARRAY(double,size);
+  st->y          = AM_MALLOC_ARRAY(double,size);
+  st->z          = AM_MALLOC_ARRAY(double,size);
+}
+
+
+void obs_store_free_columns(obs_store* st) {
+  int size = st->max_size;
+
+  AM_FREE_ARRAY(st->time,double,size);
+  AM_FREE_ARRAY(st->RA,double,size);
+  AM_FREE_ARRAY(st->DEC,double,size);
+  AM_FREE_ARRAY(st->brightness,float,size);
+  AM_FREE_ARRAY(st->x,double,size);
+  AM_FREE_ARRAY(st->y,double,size);
+  AM_FREE_ARRAY(st->z,double,size);
+}
+
+
+obs_store* mk_empty_obs_store(int size) {
+  obs_store* st = AM_MALLOC(obs_store);
+
+  if(size < OBS_STORE_MIN_SIZE) { size = OBS_STORE_MIN_SIZE; }
+
+  st->size = 0;
+  obs_store_alloc_columns(st,size);
+
+  return st;
+}
+
+
+void free_obs_store(obs_store* old) {
+  obs_store_free_columns(old);
+  AM_FREE(old,obs_store);
+}
+
+
+void obs_store_double_size(obs_store* st) {
+  obs_store old = *st;
+  int N = st->size;
+
+  obs_store_alloc_columns(st,2*old.max_size);
+
+  memcpy(st->time,old.time,N*sizeof(double));
+  memcpy(st->RA,old.RA,N*sizeof(double));
+  memcpy(st->DEC,old.DEC,N*sizeof(double));
+  memcpy(st->brightness,old.brightness,N*sizeof(float));
+  memcpy(st->x,old.x,N*sizeof(double));
+  memcpy(st->y,old.y,N*sizeof(double));
+  memcpy(st->z,old.z,N*sizeof(double));
+
+  obs_store_free_columns(&old);
+}
+
+
+int obs_store_add(obs_store* st, double time, double RA, double DEC,
+                  double brightness) {
+  int i = st->size;
+  double r = RA * 15.0 * DEG_TO_RAD;
+  double d = DEC * DEG_TO_RAD;
+
+  if(st->size >= st->max_size) {
+    obs_store_double_size(st);
+  }
+
+  st->time[i]       = time;
+  st->RA[i]         = RA;
+  st->DEC[i]        = DEC;
+  st->brightness[i] = (float)brightness;
+
+  st->x[i] = cos(d) * cos(r);
+  st->y[i] = cos(d) * sin(r);
+  st->z[i] = sin(d);
+
+  st->size += 1;
+
+  return i;
+}
+
+
+obs_store* mk_obs_store_from_simple_obs_array(simple_obs_array* arr) {
+  int N = simple_obs_array_size(arr);
+  obs_store* st = mk_empty_obs_store(N);
+  simple_obs* X;
+  int i;
+
+  for(i=0;i<N;i++) {
+    X = simple_obs_array_ref(arr,i);
+    obs_store_add(st,simple_obs_time(X),simple_obs_RA(X),simple_obs_DEC(X),
+                  simple_obs_brightness(X));
+  }
+
+  return st;
+}
+
+
+/* --- Access functions ------------------------------------------------ */
+
+int safe_obs_store_size(obs_store* st) { return st->size; }
+
+double safe_obs_store_time(obs_store* st, int i) {
+  my_assert((i >= 0)&&(i < st->size));
+  return st->time[i];
+}
+
+double safe_obs_store_RA(obs_store* st, int i) {
+  my_assert((i >= 0)&&(i < st->size));
+  return st->RA[i];
+}
+
+double safe_obs_store_DEC(obs_store* st, int i) {
+  my_assert((i >= 0)&&(i < st->size));
+  return st->DEC[i];
+}
+
+double safe_obs_store_brightness(obs_store* st, int i) {
+  my_assert((i >= 0)&&(i < st->size));
+  return st->brightness[i];
+}
+
+double safe_obs_store_x(obs_store* st, int i) {
+  my_assert((i >= 0)&&(i < st->size));
+  return st->x[i];
+}
+
+double safe_obs_store_y(obs_store* st, int i) {
+  my_assert((i >= 0)&&(i < st->size));
+  return st->y[i];
+}
+
+double safe_obs_store_z(obs_store* st, int i) {
+  my_assert((i >= 0)&&(i < st->size));
+  return st->z[i];
+}
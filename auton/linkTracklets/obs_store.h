@@ -0,0 +1,102 @@
+/*
+   File:        obs_store.h
+   Author(s):   PS1 MOPS
+   Created:     Fri Oct 16, 2026
+   Description: A columnar (structure of arrays) detection store.  The
+                times, positions and brightnesses of all detections are
+                kept in contiguous arrays so that the tree and fitting
+                inner loops scan memory in order instead of following a
+                pointer per detection.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef OBS_STORE_H
+#define OBS_STORE_H
+
+#include "obs.h"
+
+/* Detection i is (time[i], RA[i], DEC[i], brightness[i]) with the   */
+/* same units as simple_obs (RA in hours, DEC in degrees).  The unit */
+/* vector (x[i], y[i], z[i]) of each position is precomputed.        */
+/* Only the columns that the trees and fits read are kept; the other */
+/* fields (and the ID strings) stay with the simple_obs_array.       */
+typedef struct obs_store
+{
+  int size;
+  int max_size;
+
+  double* time;
+  double* RA;
+  double* DEC;
+  float*  brightness;
+
+  double* x;
+  double* y;
+  double* z;
+} obs_store;
+
+
+/* --- Memory functions ------------------------------------------------ */
+
+obs_store* mk_empty_obs_store(int size);
+
+/* Detection i of the store is simple_obs_array_ref(arr,i). */
+obs_store* mk_obs_store_from_simple_obs_array(simple_obs_array* arr);
+
+void free_obs_store(obs_store* old);
+
+/* Add a detection and return its index. */
+int obs_store_add(obs_store* st, double time, double RA, double DEC,
+                  double brightness);
+
+
+/* --- Access functions ------------------------------------------------ */
+
+int safe_obs_store_size(obs_store* st);
+
+double safe_obs_store_time(obs_store* st, int i);
+double safe_obs_store_RA(obs_store* st, int i);
+double safe_obs_store_DEC(obs_store* st, int i);
+double safe_obs_store_brightness(obs_store* st, int i);
+
+double safe_obs_store_x(obs_store* st, int i);
+double safe_obs_store_y(obs_store* st, int i);
+double safe_obs_store_z(obs_store* st, int i);
+
+#ifdef AMFAST
+
+#define obs_store_size(X)           ((X)->size)
+#define obs_store_time(X,i)         ((X)->time[i])
+#define obs_store_RA(X,i)           ((X)->RA[i])
+#define obs_store_DEC(X,i)          ((X)->DEC[i])
+#define obs_store_brightness(X,i)   ((X)->brightness[i])
+#define obs_store_x(X,i)            ((X)->x[i])
+#define obs_store_y(X,i)            ((X)->y[i])
+#define obs_store_z(X,i)            ((X)->z[i])
+
+#else
+
+#define obs_store_size(X)           (safe_obs_store_size(X))
+#define obs_store_time(X,i)         (safe_obs_store_time(X,i))
+#define obs_store_RA(X,i)           (safe_obs_store_RA(X,i))
+#define obs_store_DEC(X,i)          (safe_obs_store_DEC(X,i))
+#define obs_store_brightness(X,i)   (safe_obs_store_brightness(X,i))
+#define obs_store_x(X,i)            (safe_obs_store_x(X,i))
+#define obs_store_y(X,i)            (safe_obs_store_y(X,i))
+#define obs_store_z(X,i)            (safe_obs_store_z(X,i))
+
+#endif
+
+#endif
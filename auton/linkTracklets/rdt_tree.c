@@ -32,16 +32,37 @@ int did_check;
 
 /* --- Useful Helper Functions -------------------------- */
 
-double rdt_tree_radius_given_anchor(simple_obs_array* arr, ivec* inds,
-                                    double ra, double dec) {
+/* The trees can be built either from a simple_obs_array (arr) or */
+/* from a columnar obs_store (st).  Exactly one of them is used.   */
+void rdt_tree_get_pt(simple_obs_array* arr, obs_store* st, int ind,
+                     double* xv) {
   simple_obs* X;
+
+  if(st != NULL) {
+    xv[RDT_T] = obs_store_time(st,ind);
+    xv[RDT_D] = obs_store_DEC(st,ind);
+    xv[RDT_R] = obs_store_RA(st,ind);
+    xv[RDT_B] = obs_store_brightness(st,ind);
+  } else {
+    X = simple_obs_array_ref(arr,ind);
+    xv[RDT_T] = simple_obs_time(X);
+    xv[RDT_D] = simple_obs_DEC(X);
+    xv[RDT_R] = simple_obs_RA(X);
+    xv[RDT_B] = simple_obs_brightness(X);
+  }
+}
+
+
+double rdt_tree_radius_given_anchor(simple_obs_array* arr, obs_store* st,
+                                    ivec* inds, double ra, double dec) {
+  double xv[RDT_DIM];
   double radius = 0.0;
   double dist   = 0.0;
   int i;
 
   for(i=0;i<ivec_size(inds);i++) {
-    X    = simple_obs_array_ref(arr,ivec_ref(inds,i));
-    dist = angular_distance_RADEC(simple_obs_RA(X),ra,simple_obs_DEC(X),dec);
+    rdt_tree_get_pt(arr,st,ivec_ref(inds,i),xv);
+    dist = angular_distance_RADEC(xv[RDT_R],ra,xv[RDT_D],dec);
     if(dist > radius) { radius = dist; }
   }
 
@@ -49,18 +70,14 @@ double rdt_tree_radius_given_anchor(simple_obs_array* arr, ivec* inds,
 }
 
 
-void rdt_tree_fill_bounds(rdt_tree* tr, simple_obs_array* arr, ivec* inds) {
-  simple_obs* X;
+void rdt_tree_fill_bounds(rdt_tree* tr, simple_obs_array* arr, obs_store* st,
+                          ivec* inds) {
   double xv[RDT_DIM];
   int i, j;
 
   /* Set the initial values. */
   if(ivec_size(inds) > 0) {
-    X = simple_obs_array_ref(arr,ivec_ref(inds,0));
-    xv[RDT_T] = simple_obs_time(X);
-    xv[RDT_D] = simple_obs_DEC(X);
-    xv[RDT_R] = simple_obs_RA(X);
-    xv[RDT_B] = simple_obs_brightness(X);
+    rdt_tree_get_pt(arr,st,ivec_ref(inds,0),xv);
 
     for(j=0;j<RDT_DIM;j++) {
       tr->lo[j] = xv[j];
@@ -70,11 +87,7 @@ void rdt_tree_fill_bounds(rdt_tree* tr, simple_obs_array* arr, ivec* inds) {
 
   /* Set the initial values. */
   for(i=1;i<ivec_size(inds);i++) {
-    X = simple_obs_array_ref(arr,ivec_ref(inds,i));
-    xv[RDT_T] = simple_obs_time(X);
-    xv[RDT_D] = simple_obs_DEC(X);
-    xv[RDT_R] = simple_obs_RA(X);
-    xv[RDT_B] = simple_obs_brightness(X);
+    rdt_tree_get_pt(arr,st,ivec_ref(inds,i),xv);
 
     for(j=0;j<RDT_DIM;j++) {
       if(xv[j] > tr->hi[j]) { tr->hi[j] = xv[j]; }
@@ -92,7 +105,8 @@ void rdt_tree_fill_bounds(rdt_tree* tr, simple_obs_array* arr, ivec* inds) {
     tr->mid[j] = (tr->hi[j] + tr->lo[j])/2.0;
     tr->rad[j] = (tr->hi[j] - tr->mid[j]);
   }
-  tr->radius = rdt_tree_radius_given_anchor(arr,inds,tr->mid[RDT_R],tr->mid[RDT_D]);
+  tr->radius = rdt_tree_radius_given_anchor(arr,st,inds,tr->mid[RDT_R],
+                                            tr->mid[RDT_D]);
 }
 
 
@@ -130,9 +144,9 @@ void free_rdt_tree(rdt_tree* old) {
 
 
 
-rdt_tree* mk_rdt_tree_recurse(simple_obs_array* obs, ivec* inds, 
-                              dyv* widths, int max_leaf_pts) {
-  simple_obs* X;
+rdt_tree* mk_rdt_tree_recurse(simple_obs_array* obs, obs_store* st,
+                              ivec* inds, dyv* widths, int max_leaf_pts) {
+  double xv[RDT_DIM];
   rdt_tree* res;
   ivec *left, *right;
   double width;
@@ -144,7 +158,7 @@ rdt_tree* mk_rdt_tree_recurse(simple_obs_array* obs, ivec* inds,
 
   /* Set up the node */
   res  = mk_empty_rdt_tree();
-  rdt_tree_fill_bounds(res, obs, inds);
+  rdt_tree_fill_bounds(res, obs, st, inds);
   res->num_points = ivec_size(inds);
   width = (res->rad[RDT_T] + res->rad[RDT_R] + res->rad[RDT_D]);
 
@@ -176,15 +190,8 @@ rdt_tree* mk_rdt_tree_recurse(simple_obs_array* obs, ivec* inds,
     right = mk_ivec(0);
 
     for(i=0;i<ivec_size(inds);i++) {
-      X = simple_obs_array_ref(obs,ivec_ref(inds,i));
-      val = 0.0;
-
-      switch(sd) {
-      case RDT_T:  val = simple_obs_time(X); break;
-      case RDT_R:  val = simple_obs_RA(X);   break;
-      case RDT_D:  val = simple_obs_DEC(X);  break;
-      case RDT_B:  val = simple_obs_brightness(X);  break;
-      }
+      rdt_tree_get_pt(obs,st,ivec_ref(inds,i),xv);
+      val = xv[sd];
 
       if(val < sv) {
         add_to_ivec(left,ivec_ref(inds,i));
@@ -194,8 +201,8 @@ rdt_tree* mk_rdt_tree_recurse(simple_obs_array* obs, ivec* inds,
     }
 
     /* Build the left and right sub-trees */
-    res->left  = mk_rdt_tree_recurse(obs, left,  widths, max_leaf_pts);
-    res->right = mk_rdt_tree_recurse(obs, right, widths, max_leaf_pts);
+    res->left  = mk_rdt_tree_recurse(obs, st, left,  widths, max_leaf_pts);
+    res->right = mk_rdt_tree_recurse(obs, st, right, widths, max_leaf_pts);
 
     free_ivec(left);
     free_ivec(right);
@@ -205,10 +212,9 @@ rdt_tree* mk_rdt_tree_recurse(simple_obs_array* obs, ivec* inds,
 }
 
 
-/* use_inds - is the indices to use (NULL to use ALL observations). */
-/* force_t  - forces us to split on time first.                     */
-rdt_tree* mk_rdt_tree(simple_obs_array* obs, ivec* use_inds, 
-                      bool force_t, int max_leaf_pts) {
+rdt_tree* mk_rdt_tree_generic(simple_obs_array* obs, obs_store* st,
+                              ivec* use_inds, bool force_t,
+                              int max_leaf_pts) {
   rdt_tree *res;
   ivec    *inds;
   dyv     *width;
@@ -216,13 +222,15 @@ rdt_tree* mk_rdt_tree(simple_obs_array* obs, ivec* use_inds,
   /* Store all the indices for the tree. */
   if(use_inds != NULL) {
     inds = mk_copy_ivec(use_inds);
+  } else if(st != NULL) {
+    inds  = mk_sequence_ivec(0,obs_store_size(st));
   } else {
     inds  = mk_sequence_ivec(0,simple_obs_array_size(obs));
   }
 
   /* Compute the bounds for the tree */
   res  = mk_empty_rdt_tree();
-  rdt_tree_fill_bounds(res, obs, inds);
+  rdt_tree_fill_bounds(res, obs, st, inds);
   width = mk_zero_dyv(RDT_DIM);
   
   dyv_set(width,RDT_B,1e10);       /* Ignore brightness for splitting */
@@ -238,7 +246,7 @@ rdt_tree* mk_rdt_tree(simple_obs_array* obs, ivec* use_inds,
   free_rdt_tree(res);
 
   /* Build the tree. */
-  res  = mk_rdt_tree_recurse(obs, inds, width, max_leaf_pts);
+  res  = mk_rdt_tree_recurse(obs, st, inds, width, max_leaf_pts);
 
   /* Free the used memory */
   free_dyv(width);
@@ -248,6 +256,20 @@ rdt_tree* mk_rdt_tree(simple_obs_array* obs, ivec* use_inds,
 }
 
 
+/* use_inds - is the indices to use (NULL to use ALL observations). */
+/* force_t  - forces us to split on time first.                     */
+rdt_tree* mk_rdt_tree(simple_obs_array* obs, ivec* use_inds, 
+                      bool force_t, int max_leaf_pts) {
+  return mk_rdt_tree_generic(obs,NULL,use_inds,force_t,max_leaf_pts);
+}
+
+
+rdt_tree* mk_rdt_tree_from_store(obs_store* st, ivec* use_inds,
+                                 bool force_t, int max_leaf_pts) {
+  return mk_rdt_tree_generic(NULL,st,use_inds,force_t,max_leaf_pts);
+}
+
+
 /* use_inds - is the indices to use (NULL to use ALL observations).    */
 /* wt       - relative weighting to time (if > 0.0).                   */
 /* wid      - if > 0.0, this is the width to initially split time to   */
@@ -268,7 +290,7 @@ rdt_tree* mk_rdt_tree_wt(simple_obs_array* obs, ivec* use_inds,
 
   /* Compute the bounds for the tree */
   res  = mk_empty_rdt_tree();
-  rdt_tree_fill_bounds(res, obs, inds);
+  rdt_tree_fill_bounds(res, obs, NULL, inds);
   width = mk_zero_dyv(RDT_DIM);
   
   dyv_set(width,RDT_B,1e10);       /* Ignore brightness for splitting */
@@ -290,7 +312,7 @@ rdt_tree* mk_rdt_tree_wt(simple_obs_array* obs, ivec* use_inds,
   free_rdt_tree(res);
 
   /* Build the tree. */
-  res  = mk_rdt_tree_recurse(obs, inds, width, max_leaf_pts);
+  res  = mk_rdt_tree_recurse(obs, NULL, inds, width, max_leaf_pts);
 
   /* Free the used memory */
   free_dyv(width);
@@ -790,6 +812,204 @@ ivec* mk_rdt_tree_moving_pt_query(rdt_tree* tr, simple_obs_array* arr,
 }
 
 
+/* The positional error thresh (radians) as an unscaled offset in */
+/* degrees at declination DEC (the RA offsets grow as 1/cos(DEC)). */
+double rdt_wedge_error(double thresh, double DEC) {
+  if(DEC >= RDT_WEDGE_MAX_DEC) { return 360.0; }
+  return thresh * RAD_TO_DEG / cos(DEC * DEG_TO_RAD);
+}
+
+
+/* Can a point at an offset of (dR, dD) degrees from the query point */
+/* (dR not scaled by cos(DEC)), or any point within R degrees of that  */
+/* offset, lie in the wedge W?  e is the positional error (degrees).   */
+bool rdt_wedge_allows(rdt_wedge* W, double dR, double dD, double R,
+                      double e) {
+  double D = sqrt(dR*dR + dD*dD);
+  double diff;
+
+  if(D <= R + 2.0*e) { return TRUE; }
+
+  diff = fmod(fabs(atan2(dR,dD) - W->dir), PI);
+  if(diff > PI/2.0) { diff = PI - diff; }
+
+  return (diff <= W->tol + asin(R / D) + atan(2.0 * e / (D - R)));
+}
+
+
+/* The (unscaled) RA offset from X, wrapped to [-180, 180] degrees. */
+double rdt_wedge_dRA(double RA_X, double RA_Y) {
+  double dR = 15.0 * (RA_Y - RA_X);
+
+  if(dR >  180.0) { dR -= 360.0; }
+  if(dR < -180.0) { dR += 360.0; }
+
+  return dR;
+}
+
+
+bool rdt_moving_pt_store_allows(obs_store* st, int X, int Y,
+                                double ts, double te,
+                                double minv, double maxv,
+                                double thresh, rdt_wedge* W) {
+  double Xr = obs_store_RA(st,X);
+  double Xd = obs_store_DEC(st,X);
+  double t  = obs_store_time(st,Y);
+  double dist, dt, R;
+  double dx, dy, dz;
+
+  if((ts > t)||(te < t)) { return FALSE; }
+  dt = fabs(t-obs_store_time(st,X));
+
+  /* The chord between the unit vectors is never longer than the */
+  /* arc, so a chord beyond the largest allowed distance rules   */
+  /* the point out without the (trig heavy) exact distance.      */
+  R  = (maxv*dt) + thresh + 1e-12;
+  dx = obs_store_x(st,Y) - obs_store_x(st,X);
+  dy = obs_store_y(st,Y) - obs_store_y(st,X);
+  dz = obs_store_z(st,Y) - obs_store_z(st,X);
+  if(dx*dx + dy*dy + dz*dz > R*R) { return FALSE; }
+
+  dist = angular_distance_RADEC(Xr,obs_store_RA(st,Y),
+                                Xd,obs_store_DEC(st,Y));
+  if((dist > (maxv*dt) + thresh)||(dist < (minv*dt - thresh))) {
+    return FALSE;
+  }
+
+  return ((W == NULL) ||
+          rdt_wedge_allows(W, rdt_wedge_dRA(Xr,obs_store_RA(st,Y)),
+                           obs_store_DEC(st,Y) - Xd, 0.0,
+                           rdt_wedge_error(W->err,
+                                           fmax(fabs(Xd),
+                                                fabs(obs_store_DEC(st,Y))))));
+}
+
+
+/* The same as rdt_tree_moving_pt_query_exh, but on a store.  If W is */
+/* not NULL only the points inside the wedge are returned.            */
+void rdt_tree_moving_pt_query_store_exh(obs_store* st, ivec* inds, int X,
+                                        double ts, double te,
+                                        double minv, double maxv,
+                                        double thresh, rdt_wedge* W,
+                                        ivec* res) {
+  int i, Y;
+
+  for(i=0;i<ivec_size(inds);i++) {
+    Y = ivec_ref(inds,i);
+    if(rdt_moving_pt_store_allows(st,X,Y,ts,te,minv,maxv,thresh,W)) {
+      add_to_ivec(res,Y);
+    }
+  }
+}
+
+
+/* The same as rdt_tree_moving_pt_query_recurse, but on a store.  If */
+/* W is not NULL the nodes outside of the wedge are pruned.          */
+void rdt_tree_moving_pt_query_store_recurse(rdt_tree* tr, obs_store* st,
+                                            int X, double ts, double te,
+                                            double minv, double maxv,
+                                            double thresh, rdt_wedge* W,
+                                            ivec* res) {
+  double Xt = obs_store_time(st,X);
+  double dtmax, dtmin, dts, dte;
+  double dist, ddist, dmax;
+  bool valid;
+
+  /* Make sure the time bounds overlap. */
+  valid = (ts <= rdt_tree_hi_time(tr)+1e-10);
+  valid = valid && (te >= rdt_tree_lo_time(tr)-1e-10);
+
+  if(valid == TRUE) {
+
+    /* Find the maximum and minimum times for movement. */
+    if(ts < rdt_tree_lo_time(tr)) { ts = rdt_tree_lo_time(tr); }
+    if(te > rdt_tree_hi_time(tr)) { te = rdt_tree_hi_time(tr); }
+
+    dts = fabs(Xt-ts);
+    dte = fabs(Xt-te);
+
+    dtmax = dts;
+    dtmin = dts;
+    if(dtmax < dte) { dtmax = dte; }
+    if(dtmin > dte) { dtmin = dte; }
+
+    /* Try just the distance in declination... */
+    ddist = fabs(obs_store_DEC(st,X)-rdt_tree_mid_DEC(tr))*DEG_TO_RAD;
+    valid = (ddist <= rdt_tree_rad_DEC(tr)*DEG_TO_RAD + (maxv*dtmax) + thresh);
+
+    if(valid == TRUE) {
+      dist  = angular_distance_RADEC(obs_store_RA(st,X),rdt_tree_RA(tr),
+                                     obs_store_DEC(st,X),rdt_tree_DEC(tr));
+      valid = (dist <= rdt_tree_radius(tr) + (maxv*dtmax) + thresh);
+      valid = valid && (dist >= (minv*dtmin) - thresh - rdt_tree_radius(tr));
+    }
+
+    /* The node's points are within radius of its center in angle, */
+    /* so within radius / cos(DEC) of it in unscaled RA.           */
+    if((valid == TRUE) && (W != NULL)) {
+      dmax = fabs(rdt_tree_DEC(tr)) + rdt_tree_radius(tr) * RAD_TO_DEG;
+      if(dmax < RDT_WEDGE_MAX_DEC) {
+        valid = rdt_wedge_allows(W, rdt_wedge_dRA(obs_store_RA(st,X),
+                                                  rdt_tree_RA(tr)),
+                                 rdt_tree_DEC(tr) - obs_store_DEC(st,X),
+                                 rdt_tree_radius(tr) * RAD_TO_DEG /
+                                 cos(dmax * DEG_TO_RAD),
+                                 rdt_wedge_error(W->err,
+                                                 fmax(fabs(obs_store_DEC(st,X)),
+                                                      dmax)));
+      }
+    }
+  }
+
+  if(valid == TRUE) {
+    if(rdt_tree_is_leaf(tr) == TRUE) {
+      rdt_tree_moving_pt_query_store_exh(st,rdt_tree_pts(tr),X,ts,te,
+                                         minv,maxv,thresh,W,res);
+    } else {
+      rdt_tree_moving_pt_query_store_recurse(rdt_tree_right_child(tr),st,X,
+                                             ts,te,minv,maxv,thresh,W,res);
+      rdt_tree_moving_pt_query_store_recurse(rdt_tree_left_child(tr),st,X,
+                                             ts,te,minv,maxv,thresh,W,res);
+    }
+  }
+}
+
+
+ivec* mk_rdt_tree_moving_pt_query_store(rdt_tree* tr, obs_store* st, int X,
+                                        double ts, double te, double minv,
+                                        double maxv, double thresh) {
+  ivec* res = mk_ivec(0);
+
+  if((obs_store_time(st,X) >= ts)&&(obs_store_time(st,X) <= te)) {
+    printf("Warning! Code MIGHT have issues if obs time is inside\n");
+    printf("the node's time %f is in [%f,%f]\n",obs_store_time(st,X),ts,te);
+    wait_for_key();
+  }
+
+  rdt_tree_moving_pt_query_store_recurse(tr,st,X,ts,te,minv,maxv,thresh,
+                                         NULL,res);
+
+  return res;
+}
+
+
+ivec* mk_rdt_tree_wedge_query_store(rdt_tree* tr, obs_store* st, int X,
+                                    double ts, double te, double minv,
+                                    double maxv, double thresh,
+                                    double dir, double tol, double err) {
+  ivec* res = mk_ivec(0);
+  rdt_wedge W;
+
+  W.dir = dir;
+  W.tol = tol;
+  W.err = err;
+  rdt_tree_moving_pt_query_store_recurse(tr,st,X,ts,te,minv,maxv,thresh,
+                                         &W,res);
+
+  return res;
+}
+
+
 
 
 /* ------- Line Segment Based Queries ---------------------------------- */
@@ -1029,6 +1249,224 @@ void test_rdt_tree_ls(int argc,char *argv[]) {
 
 
 
+/* -------------------------------------------------------------------- */
+/* --- RDT Forest (one tree per plate) -------------------------------- */
+/* -------------------------------------------------------------------- */
+
+rdt_forest* mk_rdt_forest_generic(simple_obs_array* obs, obs_store* st,
+                                  ivec* use_inds, double plate_width,
+                                  int max_leaf_pts) {
+  rdt_forest* res = AM_MALLOC(rdt_forest);
+  double xv[RDT_DIM];
+  rdt_tree* tr;
+  ivec* inds;
+  ivec* order;
+  ivec* plate;
+  dyv*  times;
+  double t_start;
+  int N, s, e;
+
+  /* Store all the indices for the forest. */
+  if(use_inds != NULL) {
+    inds = mk_copy_ivec(use_inds);
+  } else if(st != NULL) {
+    inds = mk_sequence_ivec(0,obs_store_size(st));
+  } else {
+    inds = mk_sequence_ivec(0,simple_obs_array_size(obs));
+  }
+  N = ivec_size(inds);
+
+  /* Sort the detections by time. */
+  times = mk_zero_dyv(N);
+  for(s=0;s<N;s++) {
+    rdt_tree_get_pt(obs,st,ivec_ref(inds,s),xv);
+    dyv_set(times,s,xv[RDT_T]);
+  }
+  order = mk_ivec_sorted_dyv_indices(times);
+
+  res->num_plates = 0;
+  res->lo_times   = mk_dyv(0);
+  res->hi_times   = mk_dyv(0);
+  res->trs        = mk_empty_rdt_tree_ptr_array();
+
+  /* Sweep through time, starting a new plate whenever */
+  /* we move more than plate_width past its start.     */
+  s = 0;
+  while(s < N) {
+    t_start = dyv_ref(times,ivec_ref(order,s));
+    plate   = mk_ivec(0);
+
+    e = s;
+    while((e < N)&&(dyv_ref(times,ivec_ref(order,e)) - t_start <= plate_width)) {
+      add_to_ivec(plate,ivec_ref(inds,ivec_ref(order,e)));
+      e++;
+    }
+
+    tr = mk_rdt_tree_generic(obs,st,plate,FALSE,max_leaf_pts);
+    add_to_dyv(res->lo_times,t_start);
+    add_to_dyv(res->hi_times,dyv_ref(times,ivec_ref(order,e-1)));
+    rdt_tree_ptr_array_add(res->trs,tr);
+    res->num_plates += 1;
+
+    free_ivec(plate);
+    s = e;
+  }
+
+  free_ivec(order);
+  free_dyv(times);
+  free_ivec(inds);
+
+  return res;
+}
+
+
+/* use_inds    - is the indices to use (NULL to use ALL observations).   */
+/* plate_width - detections within plate_width (days) of the first      */
+/*               detection on a plate are put on the same plate.        */
+rdt_forest* mk_rdt_forest(simple_obs_array* obs, ivec* use_inds,
+                          double plate_width, int max_leaf_pts) {
+  return mk_rdt_forest_generic(obs,NULL,use_inds,plate_width,max_leaf_pts);
+}
+
+
+rdt_forest* mk_rdt_forest_from_store(obs_store* st, ivec* use_inds,
+                                     double plate_width, int max_leaf_pts) {
+  return mk_rdt_forest_generic(NULL,st,use_inds,plate_width,max_leaf_pts);
+}
+
+
+void free_rdt_forest(rdt_forest* old) {
+  int i;
+
+  for(i=0;i<old->num_plates;i++) {
+    free_rdt_tree(rdt_tree_ptr_array_ref(old->trs,i));
+  }
+  free_rdt_tree_ptr_array(old->trs);
+  free_dyv(old->lo_times);
+  free_dyv(old->hi_times);
+
+  AM_FREE(old,rdt_forest);
+}
+
+
+int safe_rdt_forest_num_plates(rdt_forest* fr) { return fr->num_plates; }
+
+rdt_tree* safe_rdt_forest_plate_tree(rdt_forest* fr, int plate) {
+  my_assert((plate >= 0)&&(plate < fr->num_plates));
+  return rdt_tree_ptr_array_ref(fr->trs,plate);
+}
+
+double safe_rdt_forest_lo_time(rdt_forest* fr, int plate) {
+  return dyv_ref(fr->lo_times,plate);
+}
+
+double safe_rdt_forest_hi_time(rdt_forest* fr, int plate) {
+  return dyv_ref(fr->hi_times,plate);
+}
+
+
+/* Returns the index of the first plate whose latest time */
+/* is >= t (or num_plates if there is no such plate).     */
+int rdt_forest_first_plate_after(rdt_forest* fr, double t) {
+  int lo = 0;
+  int hi = rdt_forest_num_plates(fr);
+  int mid;
+
+  /* The plates do not overlap, so hi_times is sorted. */
+  while(lo < hi) {
+    mid = (lo + hi) / 2;
+    if(rdt_forest_hi_time(fr,mid) < t) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+
+  return lo;
+}
+
+
+/* The same as mk_rdt_tree_moving_pt_query, but only the trees of */
+/* the plates that overlap [ts, te] are searched.                 */
+ivec* mk_rdt_forest_moving_pt_query(rdt_forest* fr, simple_obs_array* arr,
+                                    simple_obs* X, double ts, double te,
+                                    double minv, double maxv, double thresh) {
+  ivec* res = mk_ivec(0);
+  int p;
+
+  if((simple_obs_time(X) >= ts)&&(simple_obs_time(X) <= te)) {
+    printf("Warning! Code MIGHT have issues if obs time is inside\n");
+    printf("the node's time %f is in [%f,%f]\n",simple_obs_time(X),ts,te);
+    wait_for_key();
+  }
+
+  /* Each plate tree is narrow in time, so the recursion's velocity */
+  /* cone collapses to a single radius of maxv*dt + thresh.         */
+  p = rdt_forest_first_plate_after(fr,ts-1e-10);
+  while((p < rdt_forest_num_plates(fr))&&
+        (rdt_forest_lo_time(fr,p) <= te+1e-10)) {
+    rdt_tree_moving_pt_query_recurse(rdt_forest_plate_tree(fr,p),arr,X,
+                                     ts,te,minv,maxv,thresh,res);
+    p++;
+  }
+
+  return res;
+}
+
+
+/* The same as mk_rdt_forest_moving_pt_query, but on a store. */
+ivec* mk_rdt_forest_moving_pt_query_store(rdt_forest* fr, obs_store* st,
+                                          int X, double ts, double te,
+                                          double minv, double maxv,
+                                          double thresh) {
+  ivec* res = mk_ivec(0);
+  int p;
+
+  if((obs_store_time(st,X) >= ts)&&(obs_store_time(st,X) <= te)) {
+    printf("Warning! Code MIGHT have issues if obs time is inside\n");
+    printf("the node's time %f is in [%f,%f]\n",obs_store_time(st,X),ts,te);
+    wait_for_key();
+  }
+
+  p = rdt_forest_first_plate_after(fr,ts-1e-10);
+  while((p < rdt_forest_num_plates(fr))&&
+        (rdt_forest_lo_time(fr,p) <= te+1e-10)) {
+    rdt_tree_moving_pt_query_store_recurse(rdt_forest_plate_tree(fr,p),st,X,
+                                           ts,te,minv,maxv,thresh,NULL,res);
+    p++;
+  }
+
+  return res;
+}
+
+
+ivec* mk_rdt_forest_wedge_query_store(rdt_forest* fr, obs_store* st, int X,
+                                      double ts, double te, double minv,
+                                      double maxv, double thresh,
+                                      double dir, double tol,
+                                      double err) {
+  ivec* res = mk_ivec(0);
+  rdt_wedge W;
+  int p;
+
+  W.dir = dir;
+  W.tol = tol;
+  W.err = err;
+
+  p = rdt_forest_first_plate_after(fr,ts-1e-10);
+  while((p < rdt_forest_num_plates(fr))&&
+        (rdt_forest_lo_time(fr,p) <= te+1e-10)) {
+    rdt_tree_moving_pt_query_store_recurse(rdt_forest_plate_tree(fr,p),st,X,
+                                           ts,te,minv,maxv,thresh,&W,res);
+    p++;
+  }
+
+  return res;
+}
+
+
+
+
 /* -------------------------------------------------------------------- */
 /* --- RDT Tree Pointer Array ----------------------------------------- */
 /* -------------------------------------------------------------------- */
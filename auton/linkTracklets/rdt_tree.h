@@ -25,6 +25,7 @@
 #define RDT_TREE_H
 
 #include "track.h"
+#include "obs_store.h"
 
 #define RDT_MAX_LEAF_NODES 10
 
@@ -60,6 +61,19 @@ typedef struct rdt_tree_ptr_array {
 } rdt_tree_ptr_array;
 
 
+/* A forest of RDT trees with one (spatial) tree per plate/exposure. */
+/* The plates are stored in ascending time order so a query only     */
+/* needs to visit the trees that fall inside its time window.        */
+typedef struct rdt_forest {
+  int num_plates;
+
+  dyv* lo_times;              /* Earliest detection time on each plate */
+  dyv* hi_times;              /* Latest detection time on each plate   */
+
+  rdt_tree_ptr_array* trs;
+} rdt_forest;
+
+
 /* --- Tree Memory Functions -------------------------- */
 
 rdt_tree* mk_empty_rdt_tree(void);
@@ -69,6 +83,10 @@ rdt_tree* mk_empty_rdt_tree(void);
 rdt_tree* mk_rdt_tree(simple_obs_array* obs, ivec* use_inds,
                       bool force_t, int max_leaf_pts);
 
+/* The same as mk_rdt_tree, but built from a columnar store. */
+rdt_tree* mk_rdt_tree_from_store(obs_store* st, ivec* use_inds,
+                                 bool force_t, int max_leaf_pts);
+
 
 /* use_inds - is the indices to use (NULL to use ALL observations).    */
 /* wt       - relative weighting to time (if > 0.0).                   */
@@ -232,6 +250,46 @@ ivec* mk_rdt_tree_moving_pt_query(rdt_tree* tr, simple_obs_array* arr,
                                   simple_obs* X, double ts, double te,
                                   double minv, double maxv, double thresh);
 
+/* The same as mk_rdt_tree_moving_pt_query, but the tree indexes a */
+/* store and the query point is the store's detection X.           */
+ivec* mk_rdt_tree_moving_pt_query_store(rdt_tree* tr, obs_store* st, int X,
+                                        double ts, double te, double minv,
+                                        double maxv, double thresh);
+
+/* A direction constraint for the moving point queries: only points  */
+/* whose direction from the query point is within tol of dir, modulo */
+/* PI (a trail does not say which way it moves), are returned.  The   */
+/* directions are atan2(dRA, dDEC) of the offsets in degrees, with     */
+/* dRA not scaled by cos(DEC), as for the elongation angles.  Each     */
+/* direction is allowed an extra atan(2 e / d) for the positional      */
+/* error e (radians, at least the query's thresh) of a point at        */
+/* distance d.                                                         */
+typedef struct rdt_wedge {
+  double dir;
+  double tol;
+  double err;
+} rdt_wedge;
+
+/* Above this |DEC| (degrees) the wedge does not prune. */
+#define RDT_WEDGE_MAX_DEC 89.0
+
+/* Would a moving point query from X (with wedge W, if not NULL)   */
+/* return Y?  This is the exact test the queries apply to each      */
+/* point, so filtering the result of a wider query with it gives    */
+/* the same points as the narrower query.                           */
+bool rdt_moving_pt_store_allows(obs_store* st, int X, int Y,
+                                double ts, double te,
+                                double minv, double maxv,
+                                double thresh, rdt_wedge* W);
+
+/* The same as mk_rdt_tree_moving_pt_query_store, but only returns */
+/* the points inside the wedge (dir, tol, err) and prunes the nodes */
+/* that lie outside of it.  All three are in radians.               */
+ivec* mk_rdt_tree_wedge_query_store(rdt_tree* tr, obs_store* st, int X,
+                                    double ts, double te, double minv,
+                                    double maxv, double thresh,
+                                    double dir, double tol, double err);
+
 
 
 /* ------- Line Segment Based Queries ---------------------------------- */
@@ -244,6 +302,67 @@ ivec* mk_rdt_tree_near_line_segs(rdt_tree* tr, simple_obs_array* arr,
                                  dym* segs, double thresh);
 
 
+/* -------------------------------------------------------------------- */
+/* --- RDT Forest (one tree per plate) -------------------------------- */
+/* -------------------------------------------------------------------- */
+
+/* use_inds    - is the indices to use (NULL to use ALL observations).   */
+/* plate_width - detections within plate_width (days) of the first      */
+/*               detection on a plate are put on the same plate.        */
+rdt_forest* mk_rdt_forest(simple_obs_array* obs, ivec* use_inds,
+                          double plate_width, int max_leaf_pts);
+
+/* The same as mk_rdt_forest, but built from a columnar store. */
+rdt_forest* mk_rdt_forest_from_store(obs_store* st, ivec* use_inds,
+                                     double plate_width, int max_leaf_pts);
+
+void free_rdt_forest(rdt_forest* old);
+
+int safe_rdt_forest_num_plates(rdt_forest* fr);
+rdt_tree* safe_rdt_forest_plate_tree(rdt_forest* fr, int plate);
+double safe_rdt_forest_lo_time(rdt_forest* fr, int plate);
+double safe_rdt_forest_hi_time(rdt_forest* fr, int plate);
+
+#ifdef AMFAST
+
+#define rdt_forest_num_plates(X)     (X->num_plates)
+#define rdt_forest_plate_tree(X,i)   (X->trs->trs[i])
+#define rdt_forest_lo_time(X,i)      (dyv_ref(X->lo_times,i))
+#define rdt_forest_hi_time(X,i)      (dyv_ref(X->hi_times,i))
+
+#else
+
+#define rdt_forest_num_plates(X)     (safe_rdt_forest_num_plates(X))
+#define rdt_forest_plate_tree(X,i)   (safe_rdt_forest_plate_tree(X,i))
+#define rdt_forest_lo_time(X,i)      (safe_rdt_forest_lo_time(X,i))
+#define rdt_forest_hi_time(X,i)      (safe_rdt_forest_hi_time(X,i))
+
+#endif
+
+/* Returns the index of the first plate whose latest time */
+/* is >= t (or num_plates if there is no such plate).     */
+int rdt_forest_first_plate_after(rdt_forest* fr, double t);
+
+/* The same as mk_rdt_tree_moving_pt_query, but only the trees of */
+/* the plates that overlap [ts, te] are searched.                 */
+ivec* mk_rdt_forest_moving_pt_query(rdt_forest* fr, simple_obs_array* arr,
+                                    simple_obs* X, double ts, double te,
+                                    double minv, double maxv, double thresh);
+
+/* The same as mk_rdt_forest_moving_pt_query, but on a store. */
+ivec* mk_rdt_forest_moving_pt_query_store(rdt_forest* fr, obs_store* st,
+                                          int X, double ts, double te,
+                                          double minv, double maxv,
+                                          double thresh);
+
+/* The same as mk_rdt_tree_wedge_query_store, but on a forest. */
+ivec* mk_rdt_forest_wedge_query_store(rdt_forest* fr, obs_store* st, int X,
+                                      double ts, double te, double minv,
+                                      double maxv, double thresh,
+                                      double dir, double tol,
+                                      double err);
+
+
 /* -------------------------------------------------------------------- */
 /* --- RDT Tree Pointer Array ----------------------------------------- */
 /* -------------------------------------------------------------------- */
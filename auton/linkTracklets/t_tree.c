@@ -22,8 +22,6 @@
 
 #include "t_tree.h"
 
-int t_tree_count;
-
 /* --------------------------------------------------------------------- */
 /* --- Useful Helper Functions ----------------------------------------- */
 /* --------------------------------------------------------------------- */
@@ -698,16 +696,17 @@ dyv* mk_t_tree_accel(double time, double ra, double dec,
 /* --- Simple Range Search Queries ----------------------------------- */
 
 
-ivec* mk_t_tree_near_point_slow(track_array* obs, ivec* inds, track* Q, dyv* thresh) {
+/* The leaves of the tree searches append their matches to res */
+/* directly with the brute force scans.                          */
+
+void t_tree_near_point_scan(track_array* obs, ivec* inds, track* Q,
+                            dyv* thresh, ivec* res) {
   double val1, val2, diff, thrsh;
   track* X;
-  ivec*  res;
-  int N = ivec_size(inds);
+  int N = inds ? ivec_size(inds) : track_array_size(obs);
   int i, j, ind;
   bool prune;
 
-  res = mk_ivec(0);
-
   for(i=0;i<N;i++) {
     ind = i;
     if(inds) { ind = ivec_ref(inds,i); }
@@ -715,8 +714,6 @@ ivec* mk_t_tree_near_point_slow(track_array* obs, ivec* inds, track* Q, dyv* thr
     X     = track_array_ref(obs,ind);
     prune = FALSE;
 
-    t_tree_count++;
-
     /* Check EACH of the dimensions... */
     for(j=0;(j<T_NUM_DIMS)&&(prune==FALSE);j++) {
       thrsh = dyv_ref(thresh,j);
@@ -739,6 +736,13 @@ ivec* mk_t_tree_near_point_slow(track_array* obs, ivec* inds, track* Q, dyv* thr
       add_to_ivec(res,ind);
     }
   }
+}
+
+
+ivec* mk_t_tree_near_point_slow(track_array* obs, ivec* inds, track* Q, dyv* thresh) {
+  ivec* res = mk_ivec(0);
+
+  t_tree_near_point_scan(obs, inds, Q, thresh, res);
 
   return res;
 }
@@ -748,13 +752,9 @@ ivec* mk_t_tree_near_point_slow(track_array* obs, ivec* inds, track* Q, dyv* thr
 void t_tree_near_point_recurse(t_tree* tr, track_array* obs, 
                                dyv* Q, track* query, dyv* thresh, ivec* res) {
   double val1, val2, diff, thrsh;
-  ivec*  temp;
-  int i, j, old;
+  int j;
   bool prune = FALSE;
 
-  t_tree_count++;
-  old = ivec_size(res);
-
   /* Check EACH dimension for pruning ops... */
   for(j=0;(j<T_NUM_DIMS)&&(prune==FALSE);j++) {
 
@@ -777,9 +777,7 @@ void t_tree_near_point_recurse(t_tree* tr, track_array* obs,
   /* If we cannot prune this branch... then recurse. */
   if(prune==FALSE) {
     if(t_is_leaf(tr)) {
-      temp = mk_t_tree_near_point_slow(obs, t_tracks(tr), query, thresh);
-      for(i=0;i<ivec_size(temp);i++) { add_to_ivec(res,ivec_ref(temp,i)); }
-      free_ivec(temp);
+      t_tree_near_point_scan(obs, t_tracks(tr), query, thresh, res);
     } else {
       t_tree_near_point_recurse(t_left_child(tr),obs,Q,query,thresh,res);
       t_tree_near_point_recurse(t_right_child(tr),obs,Q,query,thresh,res);
@@ -804,10 +802,10 @@ ivec* mk_t_tree_near_point(t_tree* tr, track_array* obs, track* Q, dyv* thresh)
 
 /* Find all tracks Y such that the midpoint_distance(X,Y) is <= thresh  */
 /* and t_s <= Y.time <= t_e.  If inds == NULL look at all tracks.       */
-ivec* mk_t_tree_find_midpt_slow(track_array* arr, ivec* inds, track* X,
-                                double t_s, double t_e, dyv* thresh, dyv* accel) {
+void t_tree_find_midpt_scan(track_array* arr, ivec* inds, track* X,
+                            double t_s, double t_e, dyv* thresh, dyv* accel,
+                            ivec* res) {
   track* Y;
-  ivec* res = mk_ivec(0);
   double ta, tb, tm, td;
   double vala, valb, acc, diff;
   double thrsh;
@@ -819,7 +817,6 @@ ivec* mk_t_tree_find_midpt_slow(track_array* arr, ivec* inds, track* X,
   if(inds) { N = ivec_size(inds); }
 
   for(i=0;i<N;i++) {
-    t_tree_count++;
     prune = FALSE;
 
     /* Get the index of the new candidate... */
@@ -870,6 +867,14 @@ ivec* mk_t_tree_find_midpt_slow(track_array* arr, ivec* inds, track* X,
       add_to_ivec(res,ind);
     }
   }
+}
+
+
+ivec* mk_t_tree_find_midpt_slow(track_array* arr, ivec* inds, track* X,
+                                double t_s, double t_e, dyv* thresh, dyv* accel) {
+  ivec* res = mk_ivec(0);
+
+  t_tree_find_midpt_scan(arr, inds, X, t_s, t_e, thresh, accel, res);
 
   return res;
 }
@@ -878,16 +883,13 @@ ivec* mk_t_tree_find_midpt_slow(track_array* arr, ivec* inds, track* X,
 void t_tree_find_midpt_recurse(t_tree* tr, track_array* arr, track* X,
                                double t_s, double t_e, dyv* thresh, dyv* accel,
                                ivec* res) {
-  ivec* temp;
   bool prune     = FALSE;
   double ts, te, tq, tqs, tqe;
   double x, v, amin, amax, xmin, xmax;
   double thrsh;
   double a,b,c,d;
   double dist;
-  int i, j, old;
-
-  old = ivec_size(res);
+  int j;
 
   /* Decide whether or not to prune: check time */
   ts    = JK_SIMPLE_MAX(t_s,t_lo_time(tr));
@@ -946,9 +948,7 @@ void t_tree_find_midpt_recurse(t_tree* tr, track_array* arr, track* X,
   /* If we cannot prune this branch... then recurse. */
   if(prune==FALSE) {
     if(t_is_leaf(tr)) {
-      temp = mk_t_tree_find_midpt_slow(arr, t_tracks(tr), X, t_s, t_e, thresh, accel);
-      for(i=0;i<ivec_size(temp);i++) { add_to_ivec(res,ivec_ref(temp,i)); }
-      free_ivec(temp);
+      t_tree_find_midpt_scan(arr, t_tracks(tr), X, t_s, t_e, thresh, accel, res);
     } else {
       t_tree_find_midpt_recurse(t_left_child(tr),arr,X,t_s,t_e,thresh,accel,res);
       t_tree_find_midpt_recurse(t_right_child(tr),arr,X,t_s,t_e,thresh,accel,res);
@@ -305,6 +305,13 @@ dyv* mk_t_tree_accel(double time, double ra, double dec,
 
 /* --- Simple Range Search Queries ----------------------------------- */
 
+/* The queries only read the tree and the tracks, so one tree can be  */
+/* queried from several threads at once.  The _scan versions append   */
+/* the brute force matches to res.                                    */
+
+void t_tree_near_point_scan(track_array* obs, ivec* inds, track* Q,
+                            dyv* thresh, ivec* res);
+
 ivec* mk_t_tree_near_point_slow(track_array* obs, ivec* inds, track* Q, dyv* thresh);
 
 ivec* mk_t_tree_near_point(t_tree* tr, track_array* obs, track* Q, dyv* thresh);
@@ -320,6 +327,10 @@ ivec* mk_t_tree_near_bounded_track(t_tree* tr, track_array* obs, track* Q,
 
 /* --- Midpoint Range Search Queries --------------------------------- */
 
+void t_tree_find_midpt_scan(track_array* arr, ivec* inds, track* X,
+                            double t_s, double t_e, dyv* thresh, dyv* accel,
+                            ivec* res);
+
 ivec* mk_t_tree_find_midpt_slow(track_array* arr, ivec* inds, track* Q,
                                 double t_s, double t_e, dyv* thresh, dyv* accel);
 
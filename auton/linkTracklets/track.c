@@ -149,6 +149,25 @@ track* mk_track_from_N_inds(simple_obs_array* all_obs, ivec* inds) {
 
 
 
+track* mk_track_linear(ivec* inds, double t0, double RA, double vRA,
+                       double DEC, double vDEC, double brightness) {
+  track* X = AM_MALLOC(track);
+
+  X->simp_ind   = mk_copy_ivec(inds);
+  X->time       = t0;
+  X->brightness = (float)brightness;
+
+  X->RA_m[0]  = RA;
+  X->RA_m[1]  = vRA;
+  X->RA_m[2]  = 0.0;
+  X->DEC_m[0] = DEC;
+  X->DEC_m[1] = vDEC;
+  X->DEC_m[2] = 0.0;
+
+  return X;
+}
+
+
 track* mk_combined_track(track* A, track* B, simple_obs_array* all_obs) {
   track* C;
   ivec* Av;
@@ -1134,6 +1153,211 @@ double single_track_residual(track* X, simple_obs* actu) {
 }
 
 
+/* ---------------------------------------------------------------------- */
+/* --- Incremental Track Fits ------------------------------------------- */
+/* ---------------------------------------------------------------------- */
+
+/* Note: all of the sums are accumulated in exactly the same order and */
+/* form as mk_track_from_N_inds, so the fits are bit for bit the same. */
+
+void track_fit_init_pt(track_fit* F, double time, double RA, double DEC,
+                       double brightness) {
+  int i;
+
+  F->N       = 0;
+  F->Nv      = 0;
+  F->t0      = time;
+  F->RA0     = RA;
+  F->DEC0    = DEC;
+  F->tspread = 0.0;
+  F->bsum    = 0.0;
+  F->RA_w    = 0.0;
+  F->RA_w2   = 0.0;
+  F->RA_xw   = 0.0;
+  F->DEC_x   = 0.0;
+  for(i=0;i<OBS_MOMENT_SUMS;i++) {
+    F->RA_S[i]  = 0.0;
+    F->DEC_S[i] = 0.0;
+  }
+
+  track_fit_add_pt(F,time,RA,DEC,brightness);
+}
+
+
+void track_fit_init(track_fit* F, simple_obs* first) {
+  track_fit_init_pt(F,simple_obs_time(first),simple_obs_RA(first),
+                    simple_obs_DEC(first),simple_obs_brightness(first));
+}
+
+
+void track_fit_init_store(track_fit* F, obs_store* st, int first) {
+  track_fit_init_pt(F,obs_store_time(st,first),obs_store_RA(st,first),
+                    obs_store_DEC(st,first),obs_store_brightness(st,first));
+}
+
+
+void track_fit_init_from_track(track_fit* F, track* X,
+                               simple_obs_array* all_obs) {
+  int i;
+
+  track_fit_init(F,track_indiv(X,0,all_obs));
+  for(i=1;i<track_num_obs(X);i++) {
+    track_fit_add(F,track_indiv(X,i,all_obs));
+  }
+}
+
+
+void track_fit_add_pt(track_fit* F, double time, double RA, double DEC,
+                      double brightness) {
+  double dt, dRA, dDEC, w;
+
+  dt   = time - F->t0;
+  dRA  = RA - F->RA0;
+  dDEC = DEC - F->DEC0;
+  if(dRA < -12.0) { dRA += 24.0; }
+  if(dRA >  12.0) { dRA -= 24.0; }
+  w = cos(DEC * DEG_TO_RAD);
+
+  /* Count distinct times as dyv_count_num_unique does. */
+  if((F->N == 0)||(dt - F->tspread > 1e-6)) {
+    F->Nv += 1;
+  }
+  F->N      += 1;
+  F->tspread = dt;
+  F->bsum   += brightness;
+
+  F->RA_w  += w;
+  F->RA_w2 += (w * w);
+  F->RA_xw += (dRA * w);
+  obs_moment_sums_add(F->RA_S, dt, dRA, w * w);
+
+  F->DEC_x += dDEC;
+  obs_moment_sums_add(F->DEC_S, dt, dDEC, 1.0);
+}
+
+
+void track_fit_add(track_fit* F, simple_obs* nu) {
+  track_fit_add_pt(F,simple_obs_time(nu),simple_obs_RA(nu),
+                   simple_obs_DEC(nu),simple_obs_brightness(nu));
+}
+
+
+void track_fit_add_store(track_fit* F, obs_store* st, int nu) {
+  track_fit_add_pt(F,obs_store_time(st,nu),obs_store_RA(st,nu),
+                   obs_store_DEC(st,nu),obs_store_brightness(st,nu));
+}
+
+
+void track_fit_fill(track_fit* F, track* X) {
+  double M[3];
+  int i;
+
+  X->time       = F->t0;
+  X->brightness = (float)(F->bsum / (double)F->N);
+
+  for(i=0;i<3;i++) {
+    X->RA_m[i]  = 0.0;
+    X->DEC_m[i] = 0.0;
+  }
+
+  if(F->Nv == 1) {
+    X->RA_m[0]  = F->RA_xw / F->RA_w;
+    X->DEC_m[0] = F->DEC_x / (double)F->N;
+  } else {
+    obs_moments_from_sums(F->RA_S, F->RA_w2, F->Nv, F->tspread, M);
+    for(i=0;i<3;i++) { X->RA_m[i] = M[i]; }
+
+    obs_moments_from_sums(F->DEC_S, (double)F->N, F->Nv, F->tspread, M);
+    for(i=0;i<3;i++) { X->DEC_m[i] = M[i]; }
+  }
+
+  X->RA_m[0]  += F->RA0;
+  X->DEC_m[0] += F->DEC0;
+}
+
+
+track* mk_track_from_fit(track_fit* F, ivec* inds, int nu_ind) {
+  track* X = AM_MALLOC(track);
+  int N = ivec_size(inds);
+  int i;
+
+  X->simp_ind = mk_ivec((nu_ind >= 0) ? N+1 : N);
+  for(i=0;i<N;i++) {
+    ivec_set(X->simp_ind,i,ivec_ref(inds,i));
+  }
+  if(nu_ind >= 0) {
+    ivec_set(X->simp_ind,N,nu_ind);
+  }
+  track_fit_fill(F,X);
+
+  return X;
+}
+
+
+double track_fit_mean_residual_angle(track_fit* F, simple_obs_array* arr,
+                                     ivec* inds, int nu_ind) {
+  simple_obs* actu;
+  track  T;
+  track* X = &T;
+  double mean = 0.0;
+  double dist, tdif;
+  double RA  = 0.0;
+  double DEC = 0.0;
+  int N = F->N;
+  int i;
+
+  /* A temporary track (without detections) just for the predictions. */
+  X->simp_ind = NULL;
+  track_fit_fill(F,X);
+
+  for(i=0;i<N;i++) {
+    if(i < ivec_size(inds)) {
+      actu = simple_obs_array_ref(arr,ivec_ref(inds,i));
+    } else {
+      actu = simple_obs_array_ref(arr,nu_ind);
+    }
+    tdif = simple_obs_time(actu) - track_time(X);
+    track_RA_DEC_prediction(X, tdif, &RA, &DEC);
+    dist = angular_distance_RADEC(RA, simple_obs_RA(actu),
+                                  DEC,simple_obs_DEC(actu));
+    mean += (dist / (double)N);
+  }
+
+  return mean;
+}
+
+
+double track_fit_mean_residual_angle_store(track_fit* F, obs_store* st,
+                                           ivec* inds, int nu_ind) {
+  track  T;
+  track* X = &T;
+  double mean = 0.0;
+  double dist, tdif;
+  double RA  = 0.0;
+  double DEC = 0.0;
+  int N = F->N;
+  int i, ind;
+
+  X->simp_ind = NULL;
+  track_fit_fill(F,X);
+
+  for(i=0;i<N;i++) {
+    if(i < ivec_size(inds)) {
+      ind = ivec_ref(inds,i);
+    } else {
+      ind = nu_ind;
+    }
+    tdif = obs_store_time(st,ind) - track_time(X);
+    track_RA_DEC_prediction(X, tdif, &RA, &DEC);
+    dist = angular_distance_RADEC(RA, obs_store_RA(st,ind),
+                                  DEC,obs_store_DEC(st,ind));
+    mean += (dist / (double)N);
+  }
+
+  return mean;
+}
+
+
 /* --- Output functions ------------------------------------------------------- */
 
 void printf_track(track* S) {
@@ -1653,6 +1877,16 @@ void track_array_add(track_array* X, track* A) {
 }
 
 
+void track_array_add_no_copy(track_array* X, track* A) {
+  if(X->max_size <= X->size) {
+    track_array_double_size(X);
+  }
+
+  X->the_obs[X->size] = A;
+  X->size += 1;
+}
+
+
 void track_array_add_all(track_array* X, track_array* toadd) {
   track* A;
   int i;
@@ -2317,6 +2551,67 @@ void track_array_unflatten_to_plates(track_array* arr, simple_obs_array* obs,
 }
 
 
+void recenter_track_array(track_array* arr,
+                          double r_old, double r_new,
+                          double d_old, double d_new,
+                          double t_old, double t_new) {
+  track* A;
+  dym* rot;
+  double p[3], v[3], q[3], w[3];
+  double ra, dec, cr, sr, cd, sd, rho2;
+  int N = track_array_size(arr);
+  int i, j;
+
+  rot = mk_recenter_rotation(r_old, r_new, d_old, d_new);
+
+  for(i=0;i<N;i++) {
+    A = track_array_ref(arr,i);
+    if(A == NULL) { continue; }
+
+    /* The unit vector and its time derivative (radians per day). */
+    ra  = track_RA(A) * 15.0 * DEG_TO_RAD;
+    dec = track_DEC(A) * DEG_TO_RAD;
+    cr  = cos(ra);  sr = sin(ra);
+    cd  = cos(dec); sd = sin(dec);
+    p[0] = cd * cr;
+    p[1] = cd * sr;
+    p[2] = sd;
+    v[0] = -cd * sr * track_vRA(A) * 15.0 * DEG_TO_RAD
+           - sd * cr * track_vDEC(A) * DEG_TO_RAD;
+    v[1] =  cd * cr * track_vRA(A) * 15.0 * DEG_TO_RAD
+           - sd * sr * track_vDEC(A) * DEG_TO_RAD;
+    v[2] =  cd * track_vDEC(A) * DEG_TO_RAD;
+
+    for(j=0;j<3;j++) {
+      q[j] = dym_ref(rot,j,0)*p[0] + dym_ref(rot,j,1)*p[1] + dym_ref(rot,j,2)*p[2];
+      w[j] = dym_ref(rot,j,0)*v[0] + dym_ref(rot,j,1)*v[1] + dym_ref(rot,j,2)*v[2];
+    }
+
+    /* Back to RA/DEC (as in recenter_simple_obs_array) and rates. */
+    rho2 = q[0]*q[0] + q[1]*q[1];
+    dec  = atan2(q[2], sqrt(rho2)) * RAD_TO_DEG;
+    ra   = atan2(q[1], q[0]) * RAD_TO_DEG / 15.0;
+    while(ra > 24.0) { ra -= 24.0; }
+    while(ra <  0.0) { ra += 24.0; }
+
+    A->RA_m[0]  = ra;
+    A->DEC_m[0] = dec;
+    A->RA_m[2]  = 0.0;
+    A->DEC_m[2] = 0.0;
+    if(rho2 > 1e-20) {
+      A->RA_m[1]  = (q[0]*w[1] - q[1]*w[0]) / rho2 * RAD_TO_DEG / 15.0;
+      A->DEC_m[1] = w[2] / sqrt(rho2) * RAD_TO_DEG;
+    } else {
+      A->RA_m[1]  = 0.0;
+      A->DEC_m[1] = 0.0;
+    }
+    A->time = t_new + (A->time - t_old);
+  }
+
+  free_dym(rot);
+}
+
+
 /* --- Track evaluation functions --------------------------- */
 
 /* Reduce the list of true groups to only with 'min_obs' */
@@ -30,6 +30,7 @@ Copyright 2003, The Auton Lab, CMU
 #include "neos_header.h"
 #include "am_time.h"
 #include "obs.h"
+#include "obs_store.h"
 #include "sb_graph.h"
 #include "eq_solvers.h"
 
@@ -55,6 +56,30 @@ typedef struct track_array
 } track_array;
 
 
+/* An incrementally updated track fit.  Holds the running sums of the */
+/* normal equations (see mk_fill_obs_moments) so that a detection can  */
+/* be added in O(1) with no allocation.  Detections MUST be added in   */
+/* time order.                                                         */
+typedef struct track_fit
+{
+  int    N;                        /* Number of detections          */
+  int    Nv;                       /* Number of distinct times      */
+  double t0;                       /* First time                    */
+  double RA0;                      /* First RA                      */
+  double DEC0;                     /* First DEC                     */
+  double tspread;                  /* Last time - first time        */
+  double bsum;                     /* Sum of the brightnesses       */
+
+  double RA_S[OBS_MOMENT_SUMS];    /* cos(DEC) weighted RA sums     */
+  double RA_w;                     /* Sum of the weights            */
+  double RA_w2;                    /* Sum of the squared weights    */
+  double RA_xw;                    /* Sum of the weighted RA offset */
+
+  double DEC_S[OBS_MOMENT_SUMS];   /* DEC sums                      */
+  double DEC_x;                    /* Sum of the DEC offsets        */
+} track_fit;
+
+
 
 
 /* -----------------------------------------------------------------------*/
@@ -72,6 +97,12 @@ track* mk_copy_track(track* old);
 
 track* mk_track_from_N_inds(simple_obs_array* all_obs, ivec* inds);
 
+/* Make a track over the (time ordered) detections inds with a given */
+/* linear motion at time t0: RA in hours and DEC in degrees (and per */
+/* day for the velocities).  No fit is done.                          */
+track* mk_track_linear(ivec* inds, double t0, double RA, double vRA,
+                       double DEC, double vDEC, double brightness);
+
 track* mk_combined_track(track* A, track* B, simple_obs_array* all_obs);
 
 track* mk_track_add_one(track* old, simple_obs* nu, simple_obs_array* all_obs);
@@ -310,6 +341,52 @@ double mean_sq_second_track_residual(track* A, track* B, simple_obs_array* arr);
 double single_track_residual(track* X, simple_obs* actu);
 
 
+/* ---------------------------------------------------------------------- */
+/* --- Incremental Track Fits ------------------------------------------- */
+/* ---------------------------------------------------------------------- */
+
+/* Start a fit with a single detection. */
+void track_fit_init(track_fit* F, simple_obs* first);
+
+/* Start a fit with the store's detection first. */
+void track_fit_init_store(track_fit* F, obs_store* st, int first);
+
+/* Start a fit from all of the detections in a track. */
+void track_fit_init_from_track(track_fit* F, track* X,
+                               simple_obs_array* all_obs);
+
+/* Add one detection (at or after the last time) to the fit. */
+void track_fit_add(track_fit* F, simple_obs* nu);
+
+/* Add the store's detection nu (at or after the last time) to the fit. */
+void track_fit_add_store(track_fit* F, obs_store* st, int nu);
+
+/* The same as track_fit_init/track_fit_add given the detection's */
+/* time, RA (hours), DEC (degrees) and brightness.                 */
+void track_fit_init_pt(track_fit* F, double time, double RA, double DEC,
+                       double brightness);
+void track_fit_add_pt(track_fit* F, double time, double RA, double DEC,
+                      double brightness);
+
+/* Set the time, motion coefficients and brightness of X from the  */
+/* fit.  The result is identical to that of mk_track_from_N_inds. */
+void track_fit_fill(track_fit* F, track* X);
+
+/* Make a full track from the fit.  The fit's detections are inds */
+/* (in time order) followed by nu_ind if nu_ind >= 0.             */
+track* mk_track_from_fit(track_fit* F, ivec* inds, int nu_ind);
+
+/* The same as mean_track_residual_angle on the track the fit would */
+/* make, without making it.  Detections are given as above.        */
+double track_fit_mean_residual_angle(track_fit* F, simple_obs_array* arr,
+                                     ivec* inds, int nu_ind);
+
+/* The same as track_fit_mean_residual_angle with the detections */
+/* given as indices into a store.                                */
+double track_fit_mean_residual_angle_store(track_fit* F, obs_store* st,
+                                           ivec* inds, int nu_ind);
+
+
 /* --- Output functions ------------------------------------------------------- */
 
 void printf_track(track* S);
@@ -401,6 +478,9 @@ void track_array_add(track_array* X, track* A);
 
 void track_array_add_all(track_array* X, track_array* toadd);
 
+/* Add A itself (not a copy).  X takes ownership of A. */
+void track_array_add_no_copy(track_array* X, track* A);
+
 /* Find all occurrences of observation "obs_num" in a track. */
 ivec* mk_find_obs_in_tracks(track_array* X, int obs_num);
 
@@ -454,6 +534,16 @@ void track_array_flatten_to_plates(track_array* arr, simple_obs_array* obs,
 void track_array_unflatten_to_plates(track_array* arr, simple_obs_array* obs,
                                      dyv* org_times);
 
+/* Apply the rotation (and time shift) of recenter_simple_obs_array to */
+/* the tracks' motion, so that tracks whose fits were made before the  */
+/* detections were recentered still match them.  The position and     */
+/* velocity are rotated exactly (as a 3d point and its derivative);   */
+/* any acceleration is dropped.                                        */
+void recenter_track_array(track_array* arr,
+                          double r_old, double r_new,
+                          double d_old, double d_new,
+                          double t_old, double t_new);
+
 
 /* --- Track evaluation functions --------------------------- */
 
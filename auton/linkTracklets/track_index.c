@@ -0,0 +1,276 @@
+/*
+   File:        track_index.c
+   Author(s):   PS1 MOPS
+   Created:     Fri Oct 16, 2026
+   Description: An inverted index from observations to the tracks
+                that contain them.  Used for exact subset, duplicate
+                and overlap elimination over large track sets.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "track_index.h"
+
+#define TRACK_INDEX_INIT_SIZE 16
+
+/* The fingerprint bit of a single observation id (multiplicative hash). */
+#define TRACK_INDEX_BIT(id) \
+  (1ULL << ((((unsigned int)(id)) * 2654435761U) >> 26))
+
+
+/* --- Memory functions ------------------------------------------------ */
+
+track_index* mk_empty_track_index(int num_obs) {
+  track_index* ti = AM_MALLOC(track_index);
+
+  ti->num_obs    = num_obs;
+  ti->num_tracks = 0;
+  ti->max_tracks = TRACK_INDEX_INIT_SIZE;
+
+  ti->head       = mk_constant_ivec(num_obs,-1);
+  ti->tail       = mk_constant_ivec(num_obs,-1);
+  ti->count      = mk_zero_ivec(num_obs);
+  ti->post       = mk_ivec(0);
+
+  ti->members    = mk_empty_ivec_array();
+  ti->sigs       = AM_MALLOC_ARRAY(unsigned long long,ti->max_tracks);
+
+  return ti;
+}
+
+
+void free_track_index(track_index* ti) {
+  free_ivec(ti->head);
+  free_ivec(ti->tail);
+  free_ivec(ti->count);
+  free_ivec(ti->post);
+  free_ivec_array(ti->members);
+  AM_FREE_ARRAY(ti->sigs,unsigned long long,ti->max_tracks);
+
+  AM_FREE(ti,track_index);
+}
+
+
+#define TRACK_INDEX_TRACK(ti,e) (ivec_ref((ti)->post,2*(e)))
+#define TRACK_INDEX_NEXT(ti,e)  (ivec_ref((ti)->post,2*(e)+1))
+
+
+/* Insert track index into obs's (sorted) posting list.  New tracks */
+/* always go on the end, so only growing an existing track walks.   */
+void track_index_post(track_index* ti, int obs, int index) {
+  int nu   = ivec_size(ti->post)/2;
+  int prev = ivec_ref(ti->tail,obs);
+  int e    = -1;
+
+  add_to_ivec(ti->post,index);
+  add_to_ivec(ti->post,-1);
+
+  if((prev >= 0)&&(TRACK_INDEX_TRACK(ti,prev) > index)) {
+    prev = -1;
+    e    = ivec_ref(ti->head,obs);
+    while((e >= 0)&&(TRACK_INDEX_TRACK(ti,e) < index)) {
+      prev = e;
+      e    = TRACK_INDEX_NEXT(ti,e);
+    }
+  }
+
+  ivec_set(ti->post,2*nu+1,e);
+  if(prev >= 0) {
+    ivec_set(ti->post,2*prev+1,nu);
+  } else {
+    ivec_set(ti->head,obs,nu);
+  }
+  if(e < 0) {
+    ivec_set(ti->tail,obs,nu);
+  }
+  ivec_increment(ti->count,obs,1);
+}
+
+
+void track_index_add(track_index* ti, ivec* pts, int index) {
+  unsigned long long* nu_sigs;
+  unsigned long long sig = 0ULL;
+  ivec* mem;
+  ivec* spts;
+  int i, obs;
+
+  my_assert((index >= 0)&&(index <= ti->num_tracks));
+
+  if(index == ti->num_tracks) {
+    /* A new track: grow the per-track storage if needed. */
+    if(ti->num_tracks >= ti->max_tracks) {
+      nu_sigs = AM_MALLOC_ARRAY(unsigned long long,2*ti->max_tracks);
+      for(i=0;i<ti->num_tracks;i++) {
+        nu_sigs[i] = ti->sigs[i];
+      }
+      AM_FREE_ARRAY(ti->sigs,unsigned long long,ti->max_tracks);
+      ti->sigs        = nu_sigs;
+      ti->max_tracks *= 2;
+    }
+
+    spts = mk_sivec_from_ivec(pts);
+    for(i=0;i<ivec_size(spts);i++) {
+      obs  = ivec_ref(spts,i);
+      sig |= TRACK_INDEX_BIT(obs);
+      track_index_post(ti,obs,index);
+    }
+    add_to_ivec_array(ti->members,spts);
+    free_ivec(spts);
+
+    ti->sigs[index] = sig;
+    ti->num_tracks += 1;
+  } else {
+    /* An existing track: only index the observations it does not have. */
+    mem = ivec_array_ref(ti->members,index);
+    for(i=0;i<ivec_size(pts);i++) {
+      obs = ivec_ref(pts,i);
+      if(!is_in_sivec(mem,obs)) {
+        add_to_sivec(mem,obs);
+        ti->sigs[index] |= TRACK_INDEX_BIT(obs);
+        track_index_post(ti,obs,index);
+      }
+    }
+  }
+}
+
+
+/* --- Access functions ------------------------------------------------ */
+
+int safe_track_index_num_tracks(track_index* ti) {
+  return ti->num_tracks;
+}
+
+
+/* --- Query functions ------------------------------------------------- */
+
+bool track_index_has_superset(track_index* ti, ivec* pts) {
+  unsigned long long sig = 0ULL;
+  ivec* mem;
+  bool found = FALSE;
+  bool valid;
+  int N = ivec_size(pts);
+  int best, obs, e, r, i;
+
+  if(N == 0) {
+    return (ti->num_tracks > 0);
+  }
+
+  /* Only the tracks that contain the rarest observation can be */
+  /* a superset, so only walk that posting list.                */
+  best = ivec_ref(pts,0);
+  for(i=0;i<N;i++) {
+    obs  = ivec_ref(pts,i);
+    sig |= TRACK_INDEX_BIT(obs);
+    if(ivec_ref(ti->count,obs) < ivec_ref(ti->count,best)) {
+      best = obs;
+    }
+  }
+
+  for(e=ivec_ref(ti->head,best);(e >= 0)&&(!found);e=TRACK_INDEX_NEXT(ti,e)) {
+    r = TRACK_INDEX_TRACK(ti,e);
+
+    /* Quick rejection on the fingerprint and the size. */
+    if((sig & ~(ti->sigs[r])) != 0ULL) { continue; }
+    mem = ivec_array_ref(ti->members,r);
+    if(ivec_size(mem) < N) { continue; }
+
+    /* Exact check. */
+    valid = TRUE;
+    for(i=0;(i<N)&&(valid);i++) {
+      valid = is_in_sivec(mem,ivec_ref(pts,i));
+    }
+    found = valid;
+  }
+
+  return found;
+}
+
+
+ivec* mk_track_index_overlap_query(track_index* ti, ivec* pts) {
+  int N = ivec_size(pts);
+  ivec* res = mk_ivec(0);
+  ivec* cur = mk_ivec(N);
+  int i, e, r, best;
+
+  for(i=0;i<N;i++) {
+    ivec_set(cur,i,ivec_ref(ti->head,ivec_ref(pts,i)));
+  }
+
+  /* Merge the (sorted) posting lists, dropping duplicates. */
+  do {
+    best = -1;
+    for(i=0;i<N;i++) {
+      e = ivec_ref(cur,i);
+      if(e >= 0) {
+        r = TRACK_INDEX_TRACK(ti,e);
+        if((best < 0)||(r < best)) { best = r; }
+      }
+    }
+
+    if(best >= 0) {
+      add_to_ivec(res,best);
+      for(i=0;i<N;i++) {
+        e = ivec_ref(cur,i);
+        if((e >= 0)&&(TRACK_INDEX_TRACK(ti,e) == best)) {
+          ivec_set(cur,i,TRACK_INDEX_NEXT(ti,e));
+        }
+      }
+    }
+  } while(best >= 0);
+
+  free_ivec(cur);
+
+  return res;
+}
+
+
+/* --- Track array functions ------------------------------------------- */
+
+track_array* mk_track_array_remove_subsets(track_array* old,
+                                           simple_obs_array* obs) {
+  track_array* res;
+  track_index* ti;
+  track* X;
+  ivec* sizes;
+  ivec* inds;
+  int N = track_array_size(old);
+  int i;
+
+  /* Allocate space */
+  ti    = mk_empty_track_index(simple_obs_array_size(obs));
+  res   = mk_empty_track_array(N);
+  sizes = mk_zero_ivec(N);
+
+  /* Compute the sizes for all of the tracks. */
+  for(i=0;i<N;i++) {
+    ivec_set(sizes,i,track_num_obs(track_array_ref(old,i)));
+  }
+  inds = mk_indices_of_sorted_ivec(sizes);
+
+  /* Put tracks in the result largest to smallest */
+  for(i=0;i<N;i++) {
+    X = track_array_ref(old,ivec_ref(inds,N-i-1));
+
+    if(!track_index_has_superset(ti,track_individs(X))) {
+      track_array_add(res,X);
+      track_index_add(ti,track_individs(X),track_array_size(res)-1);
+    }
+  }
+
+  free_track_index(ti);
+  free_ivec(sizes);
+  free_ivec(inds);
+
+  return res;
+}
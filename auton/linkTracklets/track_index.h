@@ -0,0 +1,98 @@
+/*
+   File:        track_index.h
+   Author(s):   PS1 MOPS
+   Created:     Fri Oct 16, 2026
+   Description: An inverted index from observations to the tracks
+                that contain them.  Used for exact subset, duplicate
+                and overlap elimination over large track sets.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TRACK_INDEX_H
+#define TRACK_INDEX_H
+
+#include "track.h"
+
+/* The postings for all observations are kept as sorted linked lists  */
+/* inside one flat array (instead of one ivec per observation), so    */
+/* the memory is three ints per observation plus two per (track, obs) */
+/* pair.                                                              */
+/* Each indexed track also keeps its sorted observation ids and a     */
+/* 64 bit fingerprint (one bit per hashed observation id) so most     */
+/* non-subsets are rejected without touching the observation lists.  */
+typedef struct track_index {
+  int num_obs;             /* Observation ids are in [0, num_obs)        */
+  int num_tracks;          /* Tracks are indexed by [0, num_tracks)      */
+  int max_tracks;          /* Allocated size of sigs                     */
+
+  ivec* head;              /* First posting entry of each obs (-1=none)  */
+  ivec* tail;              /* Last posting entry of each obs (-1=none)   */
+  ivec* count;             /* Number of tracks containing each obs       */
+  ivec* post;              /* Posting entry e is (post[2e], post[2e+1]) */
+                           /* = (track, next entry in the same list)     */
+
+  ivec_array* members;     /* Sorted observation ids of each track       */
+  unsigned long long* sigs;/* Fingerprint of each track                  */
+
+} track_index;
+
+
+/* --- Memory functions ------------------------------------------------ */
+
+track_index* mk_empty_track_index(int num_obs);
+
+void free_track_index(track_index* ti);
+
+/* Index the observations pts under track number index.  index must */
+/* either be a new track (index == number of tracks) or an existing */
+/* track, in which case the track grows to the union of the two.    */
+void track_index_add(track_index* ti, ivec* pts, int index);
+
+
+/* --- Access functions ------------------------------------------------ */
+
+int safe_track_index_num_tracks(track_index* ti);
+
+#ifdef AMFAST
+
+#define track_index_num_tracks(X)  ((X)->num_tracks)
+
+#else
+
+#define track_index_num_tracks(X)  (safe_track_index_num_tracks(X))
+
+#endif
+
+
+/* --- Query functions ------------------------------------------------- */
+
+/* Are the observations pts a (not necessarily proper) subset */
+/* of the observations of any indexed track?                  */
+bool track_index_has_superset(track_index* ti, ivec* pts);
+
+/* Returns the (sorted) indices of all tracks that share at least */
+/* one observation with pts.                                      */
+ivec* mk_track_index_overlap_query(track_index* ti, ivec* pts);
+
+
+/* --- Track array functions ------------------------------------------- */
+
+/* Remove all tracks whose observations are a subset of another   */
+/* track's (including exact duplicates).  Tracks are considered   */
+/* largest to smallest and the survivors are returned in order.   */
+track_array* mk_track_array_remove_subsets(track_array* old,
+                                           simple_obs_array* obs);
+
+#endif
@@ -0,0 +1,342 @@
+/*
+   File:        track_spill.c
+   Author(s):   PS1 MOPS
+   Created:     Fri Oct 16, 2026
+   Description: A bounded memory store for the candidate tracks of a
+                search, with subset/duplicate removal as a merge of
+                sorted runs on disk.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "track_spill.h"
+#include "track_index.h"
+
+#define TRACK_SPILL_INIT_SIZE 1024
+
+/* The ints read from the spill file at a time by each run's reader. */
+#define TRACK_SPILL_BLOCK 16384
+
+
+/* --- Memory functions ------------------------------------------------ */
+
+track_spill* mk_track_spill(char* filename, simple_obs_array* obs,
+                            int min_sup, int min_obs, int max_tracks) {
+  track_spill* sp;
+  FILE* fp = fopen(filename,"w+b");
+
+  if(fp == NULL) {
+    printf("ERROR: Unable to create the spill file %s.\n", filename);
+    return NULL;
+  }
+
+  sp = AM_MALLOC(track_spill);
+  sp->filename   = mk_copy_string(filename);
+  sp->fp         = fp;
+  sp->ok         = TRUE;
+
+  sp->obs        = obs;
+  sp->min_sup    = min_sup;
+  sp->min_obs    = min_obs;
+
+  sp->max_tracks = int_max(max_tracks,1);
+  sp->num_buf    = 0;
+  sp->buf_size   = 0;
+  sp->buf_max    = TRACK_SPILL_INIT_SIZE;
+  sp->buf        = AM_MALLOC_ARRAY(int,sp->buf_max);
+
+  sp->num_runs   = 0;
+  sp->max_runs   = 16;
+  sp->run_start  = AM_MALLOC_ARRAY(long long,sp->max_runs);
+  sp->run_end    = AM_MALLOC_ARRAY(long long,sp->max_runs);
+  sp->file_size  = 0;
+
+  sp->num_added  = 0;
+  sp->num_kept   = 0;
+
+  return sp;
+}
+
+
+void free_track_spill(track_spill* sp) {
+  fclose(sp->fp);
+  remove(sp->filename);
+  free_string(sp->filename);
+
+  AM_FREE_ARRAY(sp->buf,int,sp->buf_max);
+  AM_FREE_ARRAY(sp->run_start,long long,sp->max_runs);
+  AM_FREE_ARRAY(sp->run_end,long long,sp->max_runs);
+
+  AM_FREE(sp,track_spill);
+}
+
+
+/* --- Runs ------------------------------------------------------------ */
+
+/* A record's key and where it starts in the buffer. */
+typedef struct track_spill_key {
+  int n;
+  int group;
+  int index;
+  int start;
+} track_spill_key;
+
+
+/* The merge order: larger tracks first and, among tracks of the */
+/* same size, later ones (by group, then index) first.           */
+int track_spill_key_before(int n1, int g1, int i1, int n2, int g2, int i2) {
+  if(n1 != n2) { return (n1 > n2) ? -1 : 1; }
+  if(g1 != g2) { return (g1 > g2) ? -1 : 1; }
+  if(i1 != i2) { return (i1 > i2) ? -1 : 1; }
+  return 0;
+}
+
+
+int compare_track_spill_keys(const void* a, const void* b) {
+  const track_spill_key* A = (const track_spill_key*)a;
+  const track_spill_key* B = (const track_spill_key*)b;
+
+  return track_spill_key_before(A->n, A->group, A->index,
+                                B->n, B->group, B->index);
+}
+
+
+/* Sort the buffered records and append them to the file as a run. */
+void track_spill_write_run(track_spill* sp) {
+  track_spill_key* keys;
+  long long* nu_start;
+  long long* nu_end;
+  int i, p, len;
+
+  if(sp->num_buf == 0) { return; }
+
+  keys = AM_MALLOC_ARRAY(track_spill_key,sp->num_buf);
+  for(i=0,p=0;i<sp->num_buf;i++) {
+    keys[i].n     = sp->buf[p];
+    keys[i].group = sp->buf[p+1];
+    keys[i].index = sp->buf[p+2];
+    keys[i].start = p;
+    p += 3 + sp->buf[p];
+  }
+  qsort(keys, sp->num_buf, sizeof(track_spill_key), compare_track_spill_keys);
+
+  if(sp->num_runs >= sp->max_runs) {
+    nu_start = AM_MALLOC_ARRAY(long long,2*sp->max_runs);
+    nu_end   = AM_MALLOC_ARRAY(long long,2*sp->max_runs);
+    for(i=0;i<sp->num_runs;i++) {
+      nu_start[i] = sp->run_start[i];
+      nu_end[i]   = sp->run_end[i];
+    }
+    AM_FREE_ARRAY(sp->run_start,long long,sp->max_runs);
+    AM_FREE_ARRAY(sp->run_end,long long,sp->max_runs);
+    sp->run_start = nu_start;
+    sp->run_end   = nu_end;
+    sp->max_runs *= 2;
+  }
+
+  sp->run_start[sp->num_runs] = sp->file_size;
+  if(sp->ok) {
+    sp->ok = (fseeko(sp->fp, sp->file_size * (long long)sizeof(int),
+                     SEEK_SET) == 0);
+  }
+  for(i=0;(i<sp->num_buf)&&(sp->ok);i++) {
+    len    = 3 + keys[i].n;
+    sp->ok = (fwrite(sp->buf + keys[i].start, sizeof(int), len, sp->fp) ==
+              (size_t)len);
+    sp->file_size += len;
+  }
+  if(!sp->ok) {
+    printf("ERROR: Unable to write the spill file %s.\n", sp->filename);
+  }
+  sp->run_end[sp->num_runs] = sp->file_size;
+  sp->num_runs += 1;
+
+  AM_FREE_ARRAY(keys,track_spill_key,sp->num_buf);
+  sp->num_buf  = 0;
+  sp->buf_size = 0;
+}
+
+
+/* --- Adding tracks --------------------------------------------------- */
+
+void track_spill_add(track_spill* sp, track_array* tracks, int group) {
+  track* X;
+  ivec* inds;
+  int* nu_buf;
+  int need;
+  int i, j;
+
+  for(i=0;i<track_array_size(tracks);i++) {
+    X = track_array_ref(tracks,i);
+    sp->num_added += 1;
+    if((track_num_nights_seen(X,sp->obs) < sp->min_sup) ||
+       (track_num_obs(X) < sp->min_obs)) {
+      continue;
+    }
+    sp->num_kept += 1;
+
+    inds = track_individs(X);
+    need = sp->buf_size + 3 + ivec_size(inds);
+    if(need > sp->buf_max) {
+      nu_buf = AM_MALLOC_ARRAY(int,int_max(2*sp->buf_max,need));
+      for(j=0;j<sp->buf_size;j++) {
+        nu_buf[j] = sp->buf[j];
+      }
+      AM_FREE_ARRAY(sp->buf,int,sp->buf_max);
+      sp->buf     = nu_buf;
+      sp->buf_max = int_max(2*sp->buf_max,need);
+    }
+
+    sp->buf[sp->buf_size++] = ivec_size(inds);
+    sp->buf[sp->buf_size++] = group;
+    sp->buf[sp->buf_size++] = i;
+    for(j=0;j<ivec_size(inds);j++) {
+      sp->buf[sp->buf_size++] = ivec_ref(inds,j);
+    }
+    sp->num_buf += 1;
+
+    if(sp->num_buf >= sp->max_tracks) {
+      track_spill_write_run(sp);
+    }
+  }
+}
+
+
+long track_spill_num_added(track_spill* sp) {
+  return sp->num_added;
+}
+
+
+long track_spill_num_kept(track_spill* sp) {
+  return sp->num_kept;
+}
+
+
+/* --- Subset removal -------------------------------------------------- */
+
+/* Reads one run a block at a time and holds its current record. */
+typedef struct track_spill_reader {
+  long long pos;           /* The next int to read from the file. */
+  long long end;
+  int  len;                /* Ints in block and the next one.     */
+  int  at;
+  int* block;
+
+  bool  valid;             /* The current record (if valid).      */
+  int   n;
+  int   group;
+  int   index;
+  ivec* inds;
+} track_spill_reader;
+
+
+bool track_spill_reader_int(track_spill* sp, track_spill_reader* r, int* x) {
+  if(r->at >= r->len) {
+    if(r->pos >= r->end) { return FALSE; }
+    r->len = (int)((r->end - r->pos < TRACK_SPILL_BLOCK) ?
+                   (r->end - r->pos) : TRACK_SPILL_BLOCK);
+    r->at  = 0;
+    sp->ok = sp->ok &&
+             (fseeko(sp->fp, r->pos * (long long)sizeof(int), SEEK_SET) == 0) &&
+             (fread(r->block, sizeof(int), r->len, sp->fp) == (size_t)r->len);
+    if(!sp->ok) { return FALSE; }
+    r->pos += r->len;
+  }
+  *x = r->block[r->at++];
+
+  return TRUE;
+}
+
+
+/* Move on to the run's next record (valid = FALSE at the end). */
+void track_spill_reader_next(track_spill* sp, track_spill_reader* r) {
+  int j, x;
+
+  r->valid = track_spill_reader_int(sp, r, &r->n) &&
+             track_spill_reader_int(sp, r, &r->group) &&
+             track_spill_reader_int(sp, r, &r->index);
+  if(r->valid) {
+    if(r->inds != NULL) { free_ivec(r->inds); }
+    r->inds = mk_ivec(r->n);
+    for(j=0;(j<r->n)&&(r->valid);j++) {
+      r->valid = track_spill_reader_int(sp, r, &x);
+      ivec_set(r->inds,j,x);
+    }
+  }
+}
+
+
+track_array* mk_track_spill_remove_subsets(track_spill* sp) {
+  track_spill_reader* readers;
+  track_spill_reader* r;
+  track_spill_reader* best;
+  track_array* res;
+  track_index* ti;
+  int R, i;
+
+  /* Everything left in memory becomes the last run. */
+  track_spill_write_run(sp);
+  fflush(sp->fp);
+
+  R       = sp->num_runs;
+  readers = AM_MALLOC_ARRAY(track_spill_reader,int_max(R,1));
+  for(i=0;i<R;i++) {
+    r        = readers + i;
+    r->pos   = sp->run_start[i];
+    r->end   = sp->run_end[i];
+    r->len   = 0;
+    r->at    = 0;
+    r->block = AM_MALLOC_ARRAY(int,TRACK_SPILL_BLOCK);
+    r->inds  = NULL;
+    track_spill_reader_next(sp, r);
+  }
+
+  /* Merge the runs, keeping each track unless a kept one contains it. */
+  ti  = mk_empty_track_index(simple_obs_array_size(sp->obs));
+  res = mk_empty_track_array(1024);
+  while(sp->ok) {
+    best = NULL;
+    for(i=0;i<R;i++) {
+      r = readers + i;
+      if(r->valid &&
+         ((best == NULL) ||
+          (track_spill_key_before(r->n, r->group, r->index,
+                                  best->n, best->group, best->index) < 0))) {
+        best = r;
+      }
+    }
+    if(best == NULL) { break; }
+
+    if(!track_index_has_superset(ti,best->inds)) {
+      track_array_add_no_copy(res,mk_track_from_N_inds(sp->obs,best->inds));
+      track_index_add(ti,best->inds,track_array_size(res)-1);
+    }
+    track_spill_reader_next(sp, best);
+  }
+
+  for(i=0;i<R;i++) {
+    AM_FREE_ARRAY(readers[i].block,int,TRACK_SPILL_BLOCK);
+    if(readers[i].inds != NULL) { free_ivec(readers[i].inds); }
+  }
+  AM_FREE_ARRAY(readers,track_spill_reader,int_max(R,1));
+  free_track_index(ti);
+
+  if(!sp->ok) {
+    printf("ERROR: Unable to read the spill file %s.\n", sp->filename);
+    free_track_array(res);
+    res = NULL;
+  }
+
+  return res;
+}
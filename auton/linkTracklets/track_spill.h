@@ -0,0 +1,97 @@
+/*
+   File:        track_spill.h
+   Author(s):   PS1 MOPS
+   Created:     Fri Oct 16, 2026
+   Description: A bounded memory store for the candidate tracks of a
+                search.  Tracks pass the per-track filters as they are
+                added, are kept as compact records (their detection
+                indices) and are written out in sorted runs to a spill
+                file.  Subset/duplicate removal is then a merge of the
+                runs, so only the surviving tracks are ever held as
+                track structures.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TRACK_SPILL_H
+#define TRACK_SPILL_H
+
+#include "track.h"
+
+/* A record is the ints [n, group, index, obs_1, ..., obs_n]: the */
+/* track's size, the group it was added with and its position in   */
+/* that group, and its detections.  A run is a sorted block of     */
+/* records in the spill file.                                      */
+typedef struct track_spill {
+  char* filename;
+  FILE* fp;
+  bool  ok;                /* FALSE once a write or read has failed. */
+
+  simple_obs_array* obs;
+  int min_sup;             /* The per-track filters (nights, obs).   */
+  int min_obs;
+
+  int  max_tracks;         /* Tracks held before a run is written.   */
+  int  num_buf;            /* Tracks in buf.                         */
+  int  buf_size;           /* Their records (ints), in the order     */
+  int  buf_max;            /* added.                                 */
+  int* buf;
+
+  int num_runs;
+  int max_runs;
+  long long* run_start;    /* Each run's first and last+1 int in the */
+  long long* run_end;      /* file.                                  */
+  long long  file_size;    /* Ints written.                          */
+
+  long num_added;          /* All of the tracks added.               */
+  long num_kept;           /* The ones that passed the filters.      */
+} track_spill;
+
+
+/* --- Memory functions ------------------------------------------------ */
+
+/* Returns NULL (after printing why) if filename can not be created. */
+/* Tracks added must be seen on at least min_sup nights and have at  */
+/* least min_obs detections.  At most max_tracks tracks are held in  */
+/* memory before they are written out as a run.                      */
+track_spill* mk_track_spill(char* filename, simple_obs_array* obs,
+                            int min_sup, int min_obs, int max_tracks);
+
+/* Closes and removes the spill file. */
+void free_track_spill(track_spill* sp);
+
+
+/* --- Adding tracks --------------------------------------------------- */
+
+/* Add the tracks (in order) as group number "group".  The groups are */
+/* the search's units of work (plate pairs) and the tracks of group g */
+/* come before those of group g+1 in the order of a single search.    */
+void track_spill_add(track_spill* sp, track_array* tracks, int group);
+
+long track_spill_num_added(track_spill* sp);
+
+long track_spill_num_kept(track_spill* sp);
+
+
+/* --- Subset removal -------------------------------------------------- */
+
+/* The result of mk_track_array_remove_subsets on the kept tracks in  */
+/* the order of a single search (by group, then position), from a     */
+/* merge of the sorted runs: the tracks largest to smallest (later    */
+/* ones first among tracks of the same size), each kept unless a kept */
+/* track is a superset of it.  Returns NULL if the spill file could   */
+/* not be written or read.                                            */
+track_array* mk_track_spill_remove_subsets(track_spill* sp);
+
+#endif
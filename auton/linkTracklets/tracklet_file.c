@@ -0,0 +1,482 @@
+/*
+   File:        tracklet_file.c
+   Author(s):   PS1 MOPS
+   Created:     Fri Oct 16, 2026
+   Description: A compact binary tracklet file.  findTracklets writes the
+                detections, the tracklets (as ranges of detection indices)
+                and a linear fit with uncertainties for every tracklet.
+                linkTracklets maps the file and uses the stored fits, so
+                neither the text parse nor the per-tracklet refit is needed.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "tracklet_file.h"
+
+/* Sections are padded to multiples of 8 bytes. */
+#define TRACKLET_FILE_PAD(X) ((((size_t)(X)) + 7) & ~((size_t)7))
+
+
+/* --- Writing ----------------------------------------------------------- */
+
+/* Least squares fit of y = a + b*t.  var_a and var_b are the formal */
+/* variances from the residuals (zero with only two points).         */
+void tracklet_fit_line(double* t, double* y, int N, double* a, double* b,
+                       double* var_a, double* var_b) {
+  double St = 0.0, Stt = 0.0, Sy = 0.0, Sty = 0.0;
+  double D, r, s2 = 0.0;
+  int i;
+
+  for(i=0;i<N;i++) {
+    St  += t[i];
+    Stt += t[i]*t[i];
+    Sy  += y[i];
+    Sty += t[i]*y[i];
+  }
+
+  D = (double)N * Stt - St * St;
+  if(D > 1e-20) {
+    b[0] = ((double)N * Sty - St * Sy) / D;
+    a[0] = (Sy - b[0] * St) / (double)N;
+  } else {
+    b[0] = 0.0;
+    a[0] = Sy / (double)N;
+  }
+
+  if(N > 2) {
+    for(i=0;i<N;i++) {
+      r   = y[i] - a[0] - b[0]*t[i];
+      s2 += r*r;
+    }
+    s2 /= (double)(N-2);
+  }
+
+  if(D > 1e-20) {
+    var_a[0] = s2 * Stt / D;
+    var_b[0] = s2 * (double)N / D;
+  } else {
+    var_a[0] = s2 / (double)N;
+    var_b[0] = 0.0;
+  }
+}
+
+
+void tracklet_fit_from_inds(tracklet_fit* F, simple_obs_array* obs,
+                            ivec* inds) {
+  simple_obs* X;
+  double* t;
+  double* r;
+  double* d;
+  double RA0, DEC0, a, b, va, vb;
+  int N = ivec_size(inds);
+  int i;
+
+  t = AM_MALLOC_ARRAY(double, N);
+  r = AM_MALLOC_ARRAY(double, N);
+  d = AM_MALLOC_ARRAY(double, N);
+
+  /* Fit offsets from the first detection (handling the RA wrap). */
+  X     = simple_obs_array_ref(obs, ivec_ref(inds,0));
+  F->t0 = simple_obs_time(X);
+  RA0   = simple_obs_RA(X) * 15.0;
+  DEC0  = simple_obs_DEC(X);
+  for(i=0;i<N;i++) {
+    X    = simple_obs_array_ref(obs, ivec_ref(inds,i));
+    t[i] = simple_obs_time(X) - F->t0;
+    r[i] = simple_obs_RA(X) * 15.0 - RA0;
+    d[i] = simple_obs_DEC(X) - DEC0;
+    if(r[i] < -180.0) { r[i] += 360.0; }
+    if(r[i] >  180.0) { r[i] -= 360.0; }
+  }
+
+  tracklet_fit_line(t, r, N, &a, &b, &va, &vb);
+  F->RA      = RA0 + a;
+  F->vRA     = b;
+  F->sig_RA  = sqrt(va);
+  F->sig_vRA = sqrt(vb);
+  if(F->RA <    0.0) { F->RA += 360.0; }
+  if(F->RA >= 360.0) { F->RA -= 360.0; }
+
+  tracklet_fit_line(t, d, N, &a, &b, &va, &vb);
+  F->DEC      = DEC0 + a;
+  F->vDEC     = b;
+  F->sig_DEC  = sqrt(va);
+  F->sig_vDEC = sqrt(vb);
+
+  AM_FREE_ARRAY(t, double, N);
+  AM_FREE_ARRAY(r, double, N);
+  AM_FREE_ARRAY(d, double, N);
+}
+
+
+/* Write size bytes and then pad to a multiple of 8.  Returns FALSE */
+/* on a write error.                                                */
+bool tracklet_file_write_section(FILE* fp, void* data, size_t size) {
+  char zeros[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+  size_t pad = TRACKLET_FILE_PAD(size) - size;
+  bool ok = TRUE;
+
+  if(size > 0) { ok = (fwrite(data, 1, size, fp) == size); }
+  if(ok && (pad > 0)) { ok = (fwrite(zeros, 1, pad, fp) == pad); }
+
+  return ok;
+}
+
+
+bool write_tracklet_file(char* filename, simple_obs_array* obs,
+                         track_array* tracklets, ivec* true_groups) {
+  tracklet_file_header H;
+  tracklet_fit* fit;
+  simple_obs* X;
+  track* T;
+  FILE* fp;
+  double* dbuf;
+  float* fbuf;
+  int* ibuf;
+  int* start;
+  int* inds;
+  char* strings;
+  int N = simple_obs_array_size(obs);
+  int M = track_array_size(tracklets);
+  int i, j, k, len;
+  bool ok;
+
+  fp = fopen(filename, "wb");
+  if(fp == NULL) {
+    printf("ERROR: Unable to open tracklet file (");
+    printf(filename);
+    printf(") for writing.\n");
+    return FALSE;
+  }
+
+  /* Lay out the tracklets and the string pool. */
+  start = AM_MALLOC_ARRAY(int, M+1);
+  start[0] = 0;
+  for(i=0;i<M;i++) {
+    start[i+1] = start[i] + track_num_obs(track_array_ref(tracklets,i));
+  }
+  inds = AM_MALLOC_ARRAY(int, int_max(start[M],1));
+  fit  = AM_MALLOC_ARRAY(tracklet_fit, int_max(M,1));
+  for(i=0;i<M;i++) {
+    T = track_array_ref(tracklets,i);
+    for(j=0;j<track_num_obs(T);j++) {
+      inds[start[i]+j] = ivec_ref(track_individs(T),j);
+    }
+    tracklet_fit_from_inds(&fit[i], obs, track_individs(T));
+  }
+
+  memset(&H, 0, sizeof(tracklet_file_header));
+  strncpy(H.magic, TRACKLET_FILE_MAGIC, 8);
+  H.version       = TRACKLET_FILE_VERSION;
+  H.byte_order    = TRACKLET_FILE_BYTE_ORDER;
+  H.header_size   = (int)sizeof(tracklet_file_header);
+  H.num_obs       = N;
+  H.num_tracklets = M;
+  H.num_inds      = start[M];
+  H.str_size      = 0;
+  for(i=0;i<N;i++) {
+    X = simple_obs_array_ref(obs,i);
+    H.str_size += (int)strlen(simple_obs_id_str(X)) + 1;
+  }
+
+  ok   = tracklet_file_write_section(fp, &H, sizeof(tracklet_file_header));
+  dbuf = AM_MALLOC_ARRAY(double, int_max(N,1));
+  fbuf = AM_MALLOC_ARRAY(float, int_max(N,1));
+  ibuf = AM_MALLOC_ARRAY(int, int_max(N,1));
+
+  /* The detection columns. */
+  for(i=0;i<N;i++) { dbuf[i] = simple_obs_time(simple_obs_array_ref(obs,i)); }
+  ok = ok && tracklet_file_write_section(fp, dbuf, N * sizeof(double));
+  for(i=0;i<N;i++) { dbuf[i] = simple_obs_RA(simple_obs_array_ref(obs,i)); }
+  ok = ok && tracklet_file_write_section(fp, dbuf, N * sizeof(double));
+  for(i=0;i<N;i++) { dbuf[i] = simple_obs_DEC(simple_obs_array_ref(obs,i)); }
+  ok = ok && tracklet_file_write_section(fp, dbuf, N * sizeof(double));
+  for(i=0;i<N;i++) {
+    fbuf[i] = (float)simple_obs_brightness(simple_obs_array_ref(obs,i));
+  }
+  ok = ok && tracklet_file_write_section(fp, fbuf, N * sizeof(float));
+  for(i=0;i<N;i++) { ibuf[i] = simple_obs_obs_code(simple_obs_array_ref(obs,i)); }
+  ok = ok && tracklet_file_write_section(fp, ibuf, N * sizeof(int));
+  for(i=0;i<N;i++) {
+    ibuf[i] = ((true_groups != NULL)&&(i < ivec_size(true_groups))) ?
+              ivec_ref(true_groups,i) : -1;
+  }
+  ok = ok && tracklet_file_write_section(fp, ibuf, N * sizeof(int));
+
+  strings = AM_MALLOC_ARRAY(char, int_max(H.str_size,1));
+  k = 0;
+  for(i=0;i<N;i++) {
+    X       = simple_obs_array_ref(obs,i);
+    len     = (int)strlen(simple_obs_id_str(X)) + 1;
+    ibuf[i] = k;
+    memcpy(strings + k, simple_obs_id_str(X), len);
+    k += len;
+  }
+  ok = ok && tracklet_file_write_section(fp, ibuf, N * sizeof(int));
+
+  /* The tracklets. */
+  ok = ok && tracklet_file_write_section(fp, start, (M+1) * sizeof(int));
+  ok = ok && tracklet_file_write_section(fp, inds, start[M] * sizeof(int));
+  ok = ok && tracklet_file_write_section(fp, fit, M * sizeof(tracklet_fit));
+  ok = ok && tracklet_file_write_section(fp, strings, H.str_size);
+
+  ok = (fclose(fp) == 0) && ok;
+  if(!ok) {
+    printf("ERROR: Failed writing tracklet file (");
+    printf(filename);
+    printf(").\n");
+  }
+
+  AM_FREE_ARRAY(strings, char, int_max(H.str_size,1));
+  AM_FREE_ARRAY(dbuf, double, int_max(N,1));
+  AM_FREE_ARRAY(fbuf, float, int_max(N,1));
+  AM_FREE_ARRAY(ibuf, int, int_max(N,1));
+  AM_FREE_ARRAY(inds, int, int_max(start[M],1));
+  AM_FREE_ARRAY(fit, tracklet_fit, int_max(M,1));
+  AM_FREE_ARRAY(start, int, M+1);
+
+  return ok;
+}
+
+
+/* --- Reading ----------------------------------------------------------- */
+
+/* Point *ptr at the next section (of size bytes) and move past it. */
+/* Returns FALSE if the section would run off the end of the file.  */
+bool tracklet_file_next_section(tracklet_file* tf, size_t* off,
+                                size_t size, void** ptr) {
+  if((size > tf->size)||(off[0] > tf->size - size)) { return FALSE; }
+
+  ptr[0]  = tf->data + off[0];
+  off[0] += TRACKLET_FILE_PAD(size);
+  if(off[0] > tf->size) { off[0] = tf->size; }
+
+  return TRUE;
+}
+
+
+tracklet_file* mk_tracklet_file(char* filename) {
+  tracklet_file* tf;
+  tracklet_file_header* H;
+  struct stat sb;
+  size_t off = 0;
+  ssize_t got;
+  size_t done = 0;
+  bool ok;
+  int fd, i, N, M;
+
+  fd = open(filename, O_RDONLY);
+  if((fd < 0)||(fstat(fd, &sb) != 0)) {
+    printf("ERROR: Unable to open tracklet file (");
+    printf(filename);
+    printf(") for reading.\n");
+    if(fd >= 0) { close(fd); }
+    return NULL;
+  }
+
+  tf = AM_MALLOC(tracklet_file);
+  tf->size   = (size_t)sb.st_size;
+  tf->data   = NULL;
+  tf->mapped = FALSE;
+
+  /* Map the file (nothing is copied).  If that fails read it. */
+  if(tf->size > 0) {
+    tf->data = (char*)mmap(NULL, tf->size, PROT_READ, MAP_SHARED, fd, 0);
+    if(tf->data == (char*)MAP_FAILED) {
+      tf->data = NULL;
+    } else {
+      tf->mapped = TRUE;
+    }
+  }
+  if(tf->data == NULL) {
+    tf->data = AM_MALLOC_ARRAY(char, tf->size + 1);
+    while(done < tf->size) {
+      got = read(fd, tf->data + done, tf->size - done);
+      if(got <= 0) { break; }
+      done += (size_t)got;
+    }
+    tf->size = done;
+  }
+  close(fd);
+
+  /* Check the header. */
+  ok = tracklet_file_next_section(tf, &off, sizeof(tracklet_file_header),
+                                  (void**)&(tf->header));
+  H  = tf->header;
+  ok = ok && (strncmp(H->magic, TRACKLET_FILE_MAGIC, 8) == 0);
+  if(ok && (H->byte_order != TRACKLET_FILE_BYTE_ORDER)) {
+    printf("ERROR: Tracklet file was written with a different byte order.\n");
+    ok = FALSE;
+  }
+  if(ok && ((H->version != TRACKLET_FILE_VERSION)||
+            (H->header_size != (int)sizeof(tracklet_file_header)))) {
+    printf("ERROR: Tracklet file is version %i (expected %i).\n",
+           H->version, TRACKLET_FILE_VERSION);
+    ok = FALSE;
+  }
+  ok = ok && (H->num_obs >= 0) && (H->num_tracklets >= 0) &&
+             (H->num_inds >= 0) && (H->str_size >= 0);
+
+  /* Bound the counts by the file size before they are multiplied, */
+  /* so that a section size can not wrap (e.g. a 32 bit size_t).   */
+  ok = ok && ((size_t)H->num_obs <= tf->size / sizeof(double)) &&
+             ((size_t)H->num_tracklets < tf->size / sizeof(tracklet_fit)) &&
+             ((size_t)H->num_inds <= tf->size / sizeof(int));
+
+  /* Find the sections. */
+  if(ok) {
+    N  = H->num_obs;
+    M  = H->num_tracklets;
+    ok = tracklet_file_next_section(tf, &off, N * sizeof(double),
+                                    (void**)&(tf->time));
+    ok = ok && tracklet_file_next_section(tf, &off, N * sizeof(double),
+                                          (void**)&(tf->RA));
+    ok = ok && tracklet_file_next_section(tf, &off, N * sizeof(double),
+                                          (void**)&(tf->DEC));
+    ok = ok && tracklet_file_next_section(tf, &off, N * sizeof(float),
+                                          (void**)&(tf->brightness));
+    ok = ok && tracklet_file_next_section(tf, &off, N * sizeof(int),
+                                          (void**)&(tf->obs_code));
+    ok = ok && tracklet_file_next_section(tf, &off, N * sizeof(int),
+                                          (void**)&(tf->group));
+    ok = ok && tracklet_file_next_section(tf, &off, N * sizeof(int),
+                                          (void**)&(tf->id_off));
+    ok = ok && tracklet_file_next_section(tf, &off, (M+1) * sizeof(int),
+                                          (void**)&(tf->start));
+    ok = ok && tracklet_file_next_section(tf, &off, H->num_inds * sizeof(int),
+                                          (void**)&(tf->inds));
+    ok = ok && tracklet_file_next_section(tf, &off, M * sizeof(tracklet_fit),
+                                          (void**)&(tf->fit));
+    ok = ok && tracklet_file_next_section(tf, &off, H->str_size,
+                                          (void**)&(tf->strings));
+
+    /* Make sure the indices can be trusted. */
+    ok = ok && (tf->start[0] == 0) && (tf->start[M] == H->num_inds);
+    for(i=0;ok && (i<M);i++) {
+      ok = (tf->start[i+1] > tf->start[i]);
+    }
+    for(i=0;ok && (i<H->num_inds);i++) {
+      ok = (tf->inds[i] >= 0) && (tf->inds[i] < N);
+    }
+    for(i=0;ok && (i<N);i++) {
+      ok = (tf->id_off[i] >= 0) && (tf->id_off[i] < H->str_size);
+    }
+    ok = ok && ((H->str_size == 0)||(tf->strings[H->str_size-1] == '\0'));
+  }
+
+  if(!ok) {
+    printf("ERROR: ");
+    printf(filename);
+    printf(" is not a valid tracklet file.\n");
+    free_tracklet_file(tf);
+    tf = NULL;
+  }
+
+  return tf;
+}
+
+
+void free_tracklet_file(tracklet_file* tf) {
+  if(tf->mapped) {
+    munmap(tf->data, tf->size);
+  } else {
+    AM_FREE_ARRAY(tf->data, char, tf->size + 1);
+  }
+  AM_FREE(tf, tracklet_file);
+}
+
+
+int safe_tracklet_file_num_obs(tracklet_file* tf) {
+  return tf->header->num_obs;
+}
+
+
+int safe_tracklet_file_num_tracklets(tracklet_file* tf) {
+  return tf->header->num_tracklets;
+}
+
+
+tracklet_fit* safe_tracklet_file_fit(tracklet_file* tf, int i) {
+  my_assert((i >= 0)&&(i < tf->header->num_tracklets));
+  return &(tf->fit[i]);
+}
+
+
+simple_obs_array* mk_simple_obs_array_from_tracklet_file(tracklet_file* tf) {
+  simple_obs_array* res;
+  simple_obs* X;
+  int N = tracklet_file_num_obs(tf);
+  int i;
+
+  res = mk_empty_simple_obs_array(N);
+  for(i=0;i<N;i++) {
+    X = mk_simple_obs_time(i, tf->time[i], tf->RA[i], tf->DEC[i],
+                           (double)tf->brightness[i], 'v', tf->obs_code[i],
+                           tf->strings + tf->id_off[i]);
+    simple_obs_array_add_no_copy(res, X);
+  }
+
+  return res;
+}
+
+
+ivec* mk_true_groups_from_tracklet_file(tracklet_file* tf) {
+  int N = tracklet_file_num_obs(tf);
+  ivec* res = mk_ivec(N);
+  int i;
+
+  for(i=0;i<N;i++) {
+    ivec_set(res, i, tf->group[i]);
+  }
+
+  return res;
+}
+
+
+track_array* mk_track_array_from_tracklet_file(tracklet_file* tf,
+                                               simple_obs_array* obs) {
+  track_array* res;
+  tracklet_fit* F;
+  ivec* inds;
+  double bsum;
+  int M = tracklet_file_num_tracklets(tf);
+  int i, j, s, n;
+
+  res = mk_empty_track_array(M);
+  for(i=0;i<M;i++) {
+    F = tracklet_file_fit(tf,i);
+    s = tf->start[i];
+    n = tf->start[i+1] - s;
+
+    inds = mk_ivec(n);
+    bsum = 0.0;
+    for(j=0;j<n;j++) {
+      ivec_set(inds, j, tf->inds[s+j]);
+      bsum += simple_obs_brightness(simple_obs_array_ref(obs, tf->inds[s+j]));
+    }
+
+    track_array_add_no_copy(res, mk_track_linear(inds, F->t0, F->RA / 15.0,
+                                                 F->vRA / 15.0, F->DEC,
+                                                 F->vDEC, bsum / (double)n));
+    free_ivec(inds);
+  }
+
+  return res;
+}
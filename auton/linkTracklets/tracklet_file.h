@@ -0,0 +1,153 @@
+/*
+   File:        tracklet_file.h
+   Author(s):   PS1 MOPS
+   Created:     Fri Oct 16, 2026
+   Description: A compact binary tracklet file.  findTracklets writes the
+                detections, the tracklets (as ranges of detection indices)
+                and a linear fit with uncertainties for every tracklet.
+                linkTracklets maps the file and uses the stored fits, so
+                neither the text parse nor the per-tracklet refit is needed.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TRACKLET_FILE_H
+#define TRACKLET_FILE_H
+
+#include "obs.h"
+#include "track.h"
+
+#define TRACKLET_FILE_MAGIC      "MOPSTRK"
+#define TRACKLET_FILE_VERSION    1
+#define TRACKLET_FILE_BYTE_ORDER 0x01020304
+
+/* The file is the header followed by these sections (in order), each */
+/* padded to a multiple of 8 bytes:                                   */
+/*   double time[num_obs]          MJD                                */
+/*   double RA[num_obs]            hours                              */
+/*   double DEC[num_obs]           degrees                            */
+/*   float  brightness[num_obs]                                       */
+/*   int    obs_code[num_obs]                                         */
+/*   int    group[num_obs]         true group (-1 = none)             */
+/*   int    id_off[num_obs]        offset of the ID string in strings */
+/*   int    start[num_tracklets+1] tracklet i is inds[start[i]] to    */
+/*                                 inds[start[i+1]-1], in time order  */
+/*   int    inds[num_inds]                                            */
+/*   tracklet_fit fit[num_tracklets]                                  */
+/*   char   strings[str_size]      '\0' terminated ID strings         */
+typedef struct tracklet_file_header
+{
+  char magic[8];           /* TRACKLET_FILE_MAGIC                        */
+  int  version;            /* TRACKLET_FILE_VERSION                      */
+  int  byte_order;         /* TRACKLET_FILE_BYTE_ORDER as written        */
+  int  header_size;        /* sizeof(tracklet_file_header)               */
+  int  num_obs;
+  int  num_tracklets;
+  int  num_inds;
+  int  str_size;
+  int  reserved;
+} tracklet_file_header;
+
+
+/* A linear fit RA(t) = RA + vRA*(t-t0), DEC(t) = DEC + vDEC*(t-t0)  */
+/* in degrees and degrees per day (vRA is the rate of the coordinate, */
+/* not of the great circle motion).  The sigmas are the formal 1-sigma */
+/* uncertainties from the fit residuals (zero for two detections).     */
+typedef struct tracklet_fit
+{
+  double t0;
+  double RA;
+  double DEC;
+  double vRA;
+  double vDEC;
+  double sig_RA;
+  double sig_DEC;
+  double sig_vRA;
+  double sig_vDEC;
+} tracklet_fit;
+
+
+/* A (read only, memory mapped) tracklet file.  All of the arrays */
+/* point straight into the mapping.                               */
+typedef struct tracklet_file
+{
+  char*  data;
+  size_t size;
+  bool   mapped;
+
+  tracklet_file_header* header;
+
+  double* time;
+  double* RA;
+  double* DEC;
+  float*  brightness;
+  int*    obs_code;
+  int*    group;
+  int*    id_off;
+  int*    start;
+  int*    inds;
+  tracklet_fit* fit;
+  char*   strings;
+} tracklet_file;
+
+
+/* --- Writing ----------------------------------------------------------- */
+
+/* Fit the (time ordered) detections inds with a line. */
+void tracklet_fit_from_inds(tracklet_fit* F, simple_obs_array* obs,
+                            ivec* inds);
+
+/* Write the detections and tracklets.  true_groups may be NULL. */
+/* Returns FALSE if the file could not be written.               */
+bool write_tracklet_file(char* filename, simple_obs_array* obs,
+                         track_array* tracklets, ivec* true_groups);
+
+
+/* --- Reading ----------------------------------------------------------- */
+
+/* Returns NULL (after printing why) if the file can not be read or */
+/* is not a valid tracklet file of this version.                    */
+tracklet_file* mk_tracklet_file(char* filename);
+
+void free_tracklet_file(tracklet_file* tf);
+
+int safe_tracklet_file_num_obs(tracklet_file* tf);
+int safe_tracklet_file_num_tracklets(tracklet_file* tf);
+
+tracklet_fit* safe_tracklet_file_fit(tracklet_file* tf, int i);
+
+#ifdef AMFAST
+
+#define tracklet_file_num_obs(X)       ((X)->header->num_obs)
+#define tracklet_file_num_tracklets(X) ((X)->header->num_tracklets)
+#define tracklet_file_fit(X,i)         (&((X)->fit[i]))
+
+#else
+
+#define tracklet_file_num_obs(X)       (safe_tracklet_file_num_obs(X))
+#define tracklet_file_num_tracklets(X) (safe_tracklet_file_num_tracklets(X))
+#define tracklet_file_fit(X,i)         (safe_tracklet_file_fit(X,i))
+
+#endif
+
+/* The detections (with ids 0..N-1).  */
+simple_obs_array* mk_simple_obs_array_from_tracklet_file(tracklet_file* tf);
+
+ivec* mk_true_groups_from_tracklet_file(tracklet_file* tf);
+
+/* The tracklets as tracks over obs, using the stored fits. */
+track_array* mk_track_array_from_tracklet_file(tracklet_file* tf,
+                                               simple_obs_array* obs);
+
+#endif
@@ -0,0 +1,648 @@
+/*
+   File:        vtree_cache.c
+   Author(s):   PS1 MOPS
+   Created:     Fri Oct 16, 2026
+   Description: Incremental vtree linking with a cache of the plates of
+                earlier runs.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "vtree_cache.h"
+#include "namer.h"
+
+/* Sections are padded to multiples of 8 bytes. */
+#define VTREE_CACHE_PAD(X) ((((size_t)(X)) + 7) & ~((size_t)7))
+
+/* Tracklets (flattened to plates) within this of each other in */
+/* time are on the same plate.                                  */
+#define VTREE_CACHE_SAME_TIME 1e-10
+
+
+/* --- Memory and access ------------------------------------------------- */
+
+vtree_cache* mk_empty_vtree_cache(double ra_center, double dec_center,
+                                  double t_origin, double thresh,
+                                  double plate_width, dyv* widths) {
+  vtree_cache* res = AM_MALLOC(vtree_cache);
+
+  res->ra_center   = ra_center;
+  res->dec_center  = dec_center;
+  res->t_origin    = t_origin;
+  res->thresh      = thresh;
+  res->plate_width = plate_width;
+  res->widths      = mk_copy_dyv(widths);
+
+  res->num_plates  = 0;
+  res->max_plates  = 16;
+  res->plates      = AM_MALLOC_ARRAY(vtree_cache_plate*,res->max_plates);
+
+  return res;
+}
+
+
+void free_vtree_cache_plate(vtree_cache_plate* old) {
+  free_string_array(old->keys);
+  free_dym(old->bounds);
+  free_tbt_flat(old->tree);
+  AM_FREE(old,vtree_cache_plate);
+}
+
+
+void free_vtree_cache(vtree_cache* old) {
+  int i;
+
+  for(i=0;i<old->num_plates;i++) {
+    free_vtree_cache_plate(old->plates[i]);
+  }
+  AM_FREE_ARRAY(old->plates,vtree_cache_plate*,old->max_plates);
+  free_dyv(old->widths);
+  AM_FREE(old,vtree_cache);
+}
+
+
+/* Add a plate (without copying its parts). */
+void vtree_cache_add_plate_no_copy(vtree_cache* C, double time,
+                                   string_array* keys, dym* bounds,
+                                   tbt_flat* tree, bool changed) {
+  vtree_cache_plate** nu_arr;
+  vtree_cache_plate* P = AM_MALLOC(vtree_cache_plate);
+  int i;
+
+  if(C->num_plates == C->max_plates) {
+    nu_arr = AM_MALLOC_ARRAY(vtree_cache_plate*,2*C->max_plates);
+    for(i=0;i<C->num_plates;i++) {
+      nu_arr[i] = C->plates[i];
+    }
+    AM_FREE_ARRAY(C->plates,vtree_cache_plate*,C->max_plates);
+    C->plates     = nu_arr;
+    C->max_plates = 2*C->max_plates;
+  }
+
+  P->time   = time;
+  P->keys   = keys;
+  P->bounds = bounds;
+  P->tree   = tree;
+  P->changed = changed;
+
+  C->plates[C->num_plates] = P;
+  C->num_plates++;
+}
+
+
+void vtree_cache_add_plate(vtree_cache* C, double time, string_array* keys,
+                           dym* bounds, tbt_flat* tree, bool changed) {
+  vtree_cache_add_plate_no_copy(C, time, mk_copy_string_array(keys),
+                                mk_copy_dym(bounds), mk_copy_tbt_flat(tree),
+                                changed);
+}
+
+
+vtree_cache_plate* vtree_cache_find_plate(vtree_cache* C, double time) {
+  int i;
+
+  for(i=0;i<C->num_plates;i++) {
+    if(fabs(C->plates[i]->time - time) < VTREE_CACHE_SAME_TIME) {
+      return C->plates[i];
+    }
+  }
+
+  return NULL;
+}
+
+
+char* mk_tracklet_cache_key(track* T, simple_obs_array* obs) {
+  ivec* inds = track_individs(T);
+  char* res;
+  char* id;
+  int len = 0;
+  int i, k;
+
+  for(i=0;i<ivec_size(inds);i++) {
+    id   = simple_obs_id_str(simple_obs_array_ref(obs,ivec_ref(inds,i)));
+    len += (int)strlen(id) + 1;
+  }
+
+  res = AM_MALLOC_ARRAY(char,int_max(len,1));
+  k   = 0;
+  for(i=0;i<ivec_size(inds);i++) {
+    id = simple_obs_id_str(simple_obs_array_ref(obs,ivec_ref(inds,i)));
+    if(i > 0) { res[k++] = ' '; }
+    memcpy(res + k, id, strlen(id));
+    k += (int)strlen(id);
+  }
+  res[k] = '\0';
+
+  return res;
+}
+
+
+/* --- Files ------------------------------------------------------------- */
+
+/* Write size bytes and then pad to a multiple of 8.  Returns FALSE */
+/* on a write error.                                                */
+bool vtree_cache_write_section(FILE* fp, void* data, size_t size) {
+  char zeros[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+  size_t pad = VTREE_CACHE_PAD(size) - size;
+  bool ok = TRUE;
+
+  if(size > 0) { ok = (fwrite(data, 1, size, fp) == size); }
+  if(ok && (pad > 0)) { ok = (fwrite(zeros, 1, pad, fp) == pad); }
+
+  return ok;
+}
+
+
+/* Read size bytes and skip the padding.  Returns FALSE if the */
+/* file ends first.                                            */
+bool vtree_cache_read_section(FILE* fp, void* data, size_t size) {
+  char pad[8];
+  size_t np = VTREE_CACHE_PAD(size) - size;
+  bool ok = TRUE;
+
+  if(size > 0) { ok = (fread(data, 1, size, fp) == size); }
+  if(ok && (np > 0)) { ok = (fread(pad, 1, np, fp) == np); }
+
+  return ok;
+}
+
+
+bool write_vtree_cache(char* filename, vtree_cache* C) {
+  char* tmpname = mk_printf("%s.tmp", filename);
+  FILE* fp;
+  vtree_cache_header H;
+  vtree_cache_plate_header PH;
+  vtree_cache_plate* P;
+  tbt_flat* X;
+  double* dbuf;
+  char* kbuf;
+  int i, j, k, d, n, len;
+  bool ok;
+
+  fp = fopen(tmpname, "wb");
+  if(fp == NULL) {
+    printf("ERROR: Unable to open vtree cache (");
+    printf(tmpname);
+    printf(") for writing.\n");
+    free_string(tmpname);
+    return FALSE;
+  }
+
+  memset(&H, 0, sizeof(vtree_cache_header));
+  strncpy(H.magic, VTREE_CACHE_MAGIC, 8);
+  H.version     = VTREE_CACHE_VERSION;
+  H.byte_order  = VTREE_CACHE_BYTE_ORDER;
+  H.header_size = (int)sizeof(vtree_cache_header);
+  H.num_plates  = C->num_plates;
+  H.ra_center   = C->ra_center;
+  H.dec_center  = C->dec_center;
+  H.t_origin    = C->t_origin;
+  H.thresh      = C->thresh;
+  H.plate_width = C->plate_width;
+  for(d=0;d<TBT_DIM;d++) { H.widths[d] = dyv_ref(C->widths,d); }
+  ok = vtree_cache_write_section(fp, &H, sizeof(vtree_cache_header));
+
+  for(i=0;ok&&(i<C->num_plates);i++) {
+    P = C->plates[i];
+    X = P->tree;
+    n = string_array_size(P->keys);
+
+    memset(&PH, 0, sizeof(vtree_cache_plate_header));
+    PH.time          = P->time;
+    PH.num_tracklets = n;
+    PH.num_nodes     = X->num_nodes;
+    PH.key_size      = 0;
+    PH.changed       = P->changed ? 1 : 0;
+    for(j=0;j<n;j++) {
+      PH.key_size += (int)strlen(string_array_ref(P->keys,j)) + 1;
+    }
+    ok = vtree_cache_write_section(fp, &PH, sizeof(vtree_cache_plate_header));
+
+    /* The keys and bounds. */
+    kbuf = AM_MALLOC_ARRAY(char,int_max(PH.key_size,1));
+    k    = 0;
+    for(j=0;j<n;j++) {
+      len = (int)strlen(string_array_ref(P->keys,j)) + 1;
+      memcpy(kbuf + k, string_array_ref(P->keys,j), len);
+      k += len;
+    }
+    ok = ok && vtree_cache_write_section(fp, kbuf, PH.key_size);
+    AM_FREE_ARRAY(kbuf,char,int_max(PH.key_size,1));
+
+    dbuf = AM_MALLOC_ARRAY(double,int_max(n*MTRACKLET_NTBP,1));
+    for(j=0;j<n;j++) {
+      for(k=0;k<MTRACKLET_NTBP;k++) {
+        dbuf[j*MTRACKLET_NTBP+k] = dym_ref(P->bounds,j,k);
+      }
+    }
+    ok = ok && vtree_cache_write_section(fp, dbuf,
+                                         n*MTRACKLET_NTBP*sizeof(double));
+    AM_FREE_ARRAY(dbuf,double,int_max(n*MTRACKLET_NTBP,1));
+
+    /* The tree. */
+    for(d=0;d<TBT_DIM;d++) {
+      ok = ok && vtree_cache_write_section(fp, X->lo[d],
+                                           X->num_nodes*sizeof(double));
+    }
+    for(d=0;d<TBT_DIM;d++) {
+      ok = ok && vtree_cache_write_section(fp, X->hi[d],
+                                           X->num_nodes*sizeof(double));
+    }
+    ok = ok && vtree_cache_write_section(fp, X->num_points,
+                                         X->num_nodes*sizeof(int));
+    ok = ok && vtree_cache_write_section(fp, X->right,
+                                         X->num_nodes*sizeof(int));
+    ok = ok && vtree_cache_write_section(fp, X->first_pt,
+                                         X->num_nodes*sizeof(int));
+    ok = ok && vtree_cache_write_section(fp, X->pts, X->num_pts*sizeof(int));
+  }
+
+  ok = (fclose(fp) == 0) && ok;
+  ok = ok && (rename(tmpname, filename) == 0);
+  if(!ok) {
+    printf("ERROR: Failed writing vtree cache (");
+    printf(filename);
+    printf(").\n");
+    remove(tmpname);
+  }
+  free_string(tmpname);
+
+  return ok;
+}
+
+
+/* Read the next plate of the file into C.  Returns FALSE if the file */
+/* is short or the plate is not valid.                                */
+bool vtree_cache_read_plate(FILE* fp, vtree_cache* C) {
+  vtree_cache_plate_header PH;
+  string_array* keys;
+  dym* bounds;
+  tbt_flat* X;
+  double* dbuf;
+  char* kbuf;
+  int j, k, d, n, m;
+  bool ok;
+
+  ok = vtree_cache_read_section(fp, &PH, sizeof(vtree_cache_plate_header));
+  ok = ok && (PH.num_tracklets >= 0) && (PH.num_nodes >= 1) &&
+             (PH.key_size >= PH.num_tracklets);
+  if(!ok) { return FALSE; }
+  n = PH.num_tracklets;
+  m = PH.num_nodes;
+
+  /* The keys must be n '\0' terminated strings. */
+  kbuf = AM_MALLOC_ARRAY(char,PH.key_size+1);
+  ok   = vtree_cache_read_section(fp, kbuf, PH.key_size);
+  kbuf[PH.key_size] = '\0';
+  keys = mk_string_array(0);
+  for(j=0,k=0;ok&&(j<n);j++) {
+    ok = (k < PH.key_size);
+    if(ok) {
+      add_to_string_array(keys, kbuf + k);
+      k += (int)strlen(kbuf + k) + 1;
+    }
+  }
+  ok = ok && (k == PH.key_size);
+  AM_FREE_ARRAY(kbuf,char,PH.key_size+1);
+
+  bounds = mk_dym(n,MTRACKLET_NTBP);
+  dbuf   = AM_MALLOC_ARRAY(double,int_max(n*MTRACKLET_NTBP,1));
+  ok = ok && vtree_cache_read_section(fp, dbuf,
+                                      n*MTRACKLET_NTBP*sizeof(double));
+  for(j=0;ok&&(j<n);j++) {
+    for(k=0;k<MTRACKLET_NTBP;k++) {
+      dym_set(bounds,j,k,dbuf[j*MTRACKLET_NTBP+k]);
+    }
+  }
+  AM_FREE_ARRAY(dbuf,double,int_max(n*MTRACKLET_NTBP,1));
+
+  X = mk_empty_tbt_flat(m,n);
+  for(d=0;d<TBT_DIM;d++) {
+    ok = ok && vtree_cache_read_section(fp, X->lo[d], m*sizeof(double));
+  }
+  for(d=0;d<TBT_DIM;d++) {
+    ok = ok && vtree_cache_read_section(fp, X->hi[d], m*sizeof(double));
+  }
+  ok = ok && vtree_cache_read_section(fp, X->num_points, m*sizeof(int));
+  ok = ok && vtree_cache_read_section(fp, X->right, m*sizeof(int));
+  ok = ok && vtree_cache_read_section(fp, X->first_pt, m*sizeof(int));
+  ok = ok && vtree_cache_read_section(fp, X->pts, n*sizeof(int));
+
+  /* Check the tree's indices (the search trusts them). */
+  ok = ok && (X->num_points[0] == n) && (X->first_pt[0] == 0);
+  for(j=0;ok&&(j<m);j++) {
+    ok = (X->first_pt[j] >= 0) && (X->num_points[j] >= 0) &&
+         (X->first_pt[j] + X->num_points[j] <= n) &&
+         ((X->right[j] < 0) || ((X->right[j] > j+1) && (X->right[j] < m)));
+  }
+  for(j=0;ok&&(j<n);j++) {
+    ok = (X->pts[j] >= 0) && (X->pts[j] < n);
+  }
+
+  if(ok) {
+    vtree_cache_add_plate_no_copy(C, PH.time, keys, bounds, X,
+                                  (PH.changed != 0));
+  } else {
+    free_string_array(keys);
+    free_dym(bounds);
+    free_tbt_flat(X);
+  }
+
+  return ok;
+}
+
+
+vtree_cache* mk_vtree_cache_from_file(char* filename) {
+  FILE* fp;
+  vtree_cache_header H;
+  vtree_cache* res = NULL;
+  dyv* widths;
+  int i, d;
+  bool ok;
+
+  fp = fopen(filename, "rb");
+  if(fp == NULL) {
+    printf("ERROR: Unable to open vtree cache (");
+    printf(filename);
+    printf(") for reading.\n");
+    return NULL;
+  }
+
+  /* Check the header. */
+  ok = vtree_cache_read_section(fp, &H, sizeof(vtree_cache_header));
+  ok = ok && (strncmp(H.magic, VTREE_CACHE_MAGIC, 8) == 0);
+  if(ok && (H.byte_order != VTREE_CACHE_BYTE_ORDER)) {
+    printf("ERROR: Vtree cache was written with a different byte order.\n");
+    ok = FALSE;
+  }
+  if(ok && ((H.version != VTREE_CACHE_VERSION)||
+            (H.header_size != (int)sizeof(vtree_cache_header)))) {
+    printf("ERROR: Vtree cache is version %i (expected %i).\n",
+           H.version, VTREE_CACHE_VERSION);
+    ok = FALSE;
+  }
+  ok = ok && (H.num_plates >= 0);
+
+  if(ok) {
+    widths = mk_dyv(TBT_DIM);
+    for(d=0;d<TBT_DIM;d++) { dyv_set(widths,d,H.widths[d]); }
+    res = mk_empty_vtree_cache(H.ra_center, H.dec_center, H.t_origin,
+                               H.thresh, H.plate_width, widths);
+    free_dyv(widths);
+
+    for(i=0;ok&&(i<H.num_plates);i++) {
+      ok = vtree_cache_read_plate(fp, res);
+    }
+    if(!ok) {
+      free_vtree_cache(res);
+      res = NULL;
+    }
+  }
+  fclose(fp);
+
+  if(res == NULL) {
+    printf("ERROR: Invalid vtree cache (");
+    printf(filename);
+    printf(").\n");
+  }
+
+  return res;
+}
+
+
+/* --- Incremental search ------------------------------------------------ */
+
+/* Is the plate of the tracklets inds (with keys and bounds tb_arr) */
+/* the cached plate P?  If so fill local[k] with the position in    */
+/* inds of P's tracklet k and set in_order if local[k] = k.         */
+bool vtree_cache_plate_matches(vtree_cache_plate* P, ivec* inds,
+                               string_array* keys, dym* tb_arr,
+                               ivec* local, bool* in_order) {
+  namer* nm = mk_empty_namer(TRUE);
+  int n = ivec_size(inds);
+  int j, k, ind;
+  bool ok;
+
+  ok = (P != NULL) && (string_array_size(P->keys) == n);
+  for(j=0;ok&&(j<n);j++) {
+    add_to_namer(nm, string_array_ref(keys,ivec_ref(inds,j)));
+  }
+  ok = ok && (namer_num_indexes(nm) == n);
+
+  in_order[0] = TRUE;
+  for(j=0;ok&&(j<n);j++) {
+    ind = namer_name_to_index(nm, string_array_ref(P->keys,j));
+    ok  = (ind >= 0);
+    if(ok) {
+      ivec_set(local,j,ind);
+      in_order[0] = in_order[0] && (ind == j);
+      for(k=0;ok&&(k<MTRACKLET_NTBP);k++) {
+        ok = (dym_ref(P->bounds,j,k) == dym_ref(tb_arr,ivec_ref(inds,ind),k));
+      }
+    }
+  }
+  free_namer(nm);
+
+  return ok;
+}
+
+
+track_array* mk_vtrees_tracks_incremental(simple_obs_array* obs,
+                                          track_array* pairs,
+                                          double thresh, double acc_r,
+                                          double acc_d, int min_sup,
+                                          double fit_rd, double pred_fit,
+                                          bool endpts, double plate_width,
+                                          double last_start_obs_time,
+                                          double first_end_obs_time,
+                                          vtree_cache* old,
+                                          double ra_center, double dec_center,
+                                          double t_origin,
+                                          vtree_cache** nu_cache,
+                                          vtree_run_opts* run) {
+  track_array* res;
+  track_array* all;
+  string_array* keys;
+  string_array* pkeys;
+  tbt_flat** ptrees;
+  tbt_flat* forest;
+  vtree_cache_plate* P;
+  ivec** pinds;
+  ivec* plates;
+  ivec* changed;
+  ivec* order;
+  ivec* local;
+  ivec* new_obs;
+  ivec* inds;
+  dyv* times;
+  dyv* widths;
+  dym* tb_arr;
+  dym* pbounds;
+  tbt* tr;
+  char* key;
+  double t0;
+  int N = track_array_size(pairs);
+  int T = 0;
+  int num_changed = 0;
+  int i, j, k, p;
+  bool matched, in_order, keep;
+
+  /* The tracklets' bounds and keys (both cheap to compute). */
+  tb_arr = mk_tracklet_bounds(obs,pairs,thresh,plate_width);
+  keys   = mk_string_array(0);
+  for(i=0;i<N;i++) {
+    key = mk_tracklet_cache_key(track_array_ref(pairs,i),obs);
+    add_to_string_array(keys,key);
+    free_string(key);
+  }
+
+  /* Group the tracklets into plates (in time order, with */
+  /* the indices of each plate in ascending order).       */
+  times = mk_dyv(N);
+  for(i=0;i<N;i++) { dyv_set(times,i,dym_ref(tb_arr,i,TBP_T)); }
+  order = mk_indices_of_sorted_dyv(times);
+  pinds = AM_MALLOC_ARRAY(ivec*,int_max(N,1));
+  for(i=0;i<N;i=j) {
+    t0 = dyv_ref(times,ivec_ref(order,i));
+    pinds[T] = mk_ivec(0);
+    for(j=i;(j<N)&&(dyv_ref(times,ivec_ref(order,j)) - t0 < VTREE_CACHE_SAME_TIME);j++) {
+      add_to_ivec(pinds[T],ivec_ref(order,j));
+    }
+    ivec_sort(pinds[T],pinds[T]);
+    T++;
+  }
+  free_ivec(order);
+
+  /* The split widths must stay those of the first run for the */
+  /* cached trees to be the trees this run would build.        */
+  if(old != NULL) {
+    widths = mk_copy_dyv(old->widths);
+  } else {
+    widths = mk_tbt_split_widths(tb_arr,NULL,TRUE);
+  }
+
+  /* Reuse or build each plate's tree (with indices into pairs). */
+  ptrees  = AM_MALLOC_ARRAY(tbt_flat*,int_max(T,1));
+  changed = mk_zero_ivec(T);
+  for(p=0;p<T;p++) {
+    inds  = pinds[p];
+    P     = (old != NULL) ? vtree_cache_find_plate(old,dyv_ref(times,ivec_ref(inds,0))) : NULL;
+    local = mk_ivec(ivec_size(inds));
+
+    matched = vtree_cache_plate_matches(P,inds,keys,tb_arr,local,&in_order);
+    if(!matched) {
+      ivec_set(changed,p,1);
+      num_changed++;
+    }
+
+    if(matched && in_order) {
+      ptrees[p] = mk_copy_tbt_flat(P->tree);
+      for(k=0;k<ptrees[p]->num_pts;k++) {
+        ptrees[p]->pts[k] = ivec_ref(inds,ptrees[p]->pts[k]);
+      }
+    } else {
+      tr        = mk_tbt_recurse(tb_arr,inds,widths,1);
+      ptrees[p] = mk_tbt_flat(tr);
+      free_tbt(tr);
+    }
+    free_ivec(local);
+  }
+  printf("   %i of %i plates are new or changed.\n", num_changed, T);
+
+  /* A rerun over the cached plates searches the last run's new */
+  /* and changed plates again (and so finds its tracks again).  */
+  if((old != NULL) && (num_changed == 0) && (T == old->num_plates)) {
+    for(p=0;p<T;p++) {
+      P = vtree_cache_find_plate(old,dyv_ref(times,ivec_ref(pinds[p],0)));
+      if(P->changed) {
+        ivec_set(changed,p,1);
+        num_changed++;
+      }
+    }
+    printf("   The plates are those of the cached run (searching its %i new or changed plates again).\n",
+           num_changed);
+  }
+
+  /* Search the pairs that involve them. */
+  forest = mk_tbt_flat_forest(ptrees,T,&plates);
+  all = mk_vtrees_tracks_plates(obs,pairs,tb_arr,forest,plates,changed,
+                                acc_r,acc_d,min_sup,fit_rd,pred_fit,endpts,
+                                last_start_obs_time,first_end_obs_time,run);
+
+  /* Keep the tracks with a tracklet on a changed plate (the others */
+  /* were found by the earlier run).                                */
+  if(old != NULL) {
+    new_obs = mk_zero_ivec(simple_obs_array_size(obs));
+    for(p=0;p<T;p++) {
+      if(ivec_ref(changed,p) == 0) { continue; }
+      for(j=0;j<ivec_size(pinds[p]);j++) {
+        inds = track_individs(track_array_ref(pairs,ivec_ref(pinds[p],j)));
+        for(k=0;k<ivec_size(inds);k++) {
+          ivec_set(new_obs,ivec_ref(inds,k),1);
+        }
+      }
+    }
+
+    res = mk_empty_track_array(int_max(track_array_size(all),1));
+    for(i=0;i<track_array_size(all);i++) {
+      inds = track_individs(track_array_ref(all,i));
+      keep = FALSE;
+      for(k=0;(k<ivec_size(inds))&&(!keep);k++) {
+        keep = (ivec_ref(new_obs,ivec_ref(inds,k)) == 1);
+      }
+      if(keep) { track_array_add(res,track_array_ref(all,i)); }
+    }
+    free_track_array(all);
+    free_ivec(new_obs);
+  } else {
+    res = all;
+  }
+
+  /* The cache for the next run (with indices into each plate). */
+  nu_cache[0] = mk_empty_vtree_cache(ra_center,dec_center,t_origin,thresh,
+                                     plate_width,widths);
+  local = mk_ivec(int_max(N,1));
+  for(p=0;p<T;p++) {
+    inds    = pinds[p];
+    pkeys   = mk_string_array(0);
+    pbounds = mk_dym(ivec_size(inds),MTRACKLET_NTBP);
+    for(j=0;j<ivec_size(inds);j++) {
+      ivec_set(local,ivec_ref(inds,j),j);
+      add_to_string_array(pkeys,string_array_ref(keys,ivec_ref(inds,j)));
+      for(k=0;k<MTRACKLET_NTBP;k++) {
+        dym_set(pbounds,j,k,dym_ref(tb_arr,ivec_ref(inds,j),k));
+      }
+    }
+    for(k=0;k<ptrees[p]->num_pts;k++) {
+      ptrees[p]->pts[k] = ivec_ref(local,ptrees[p]->pts[k]);
+    }
+    vtree_cache_add_plate_no_copy(nu_cache[0],dyv_ref(times,ivec_ref(inds,0)),
+                                  pkeys,pbounds,ptrees[p],
+                                  (ivec_ref(changed,p) == 1));
+    free_ivec(inds);
+  }
+  free_ivec(local);
+
+  AM_FREE_ARRAY(ptrees,tbt_flat*,int_max(T,1));
+  AM_FREE_ARRAY(pinds,ivec*,int_max(N,1));
+  free_tbt_flat(forest);
+  free_ivec(plates);
+  free_ivec(changed);
+  free_dyv(widths);
+  free_dyv(times);
+  free_string_array(keys);
+  free_dym(tb_arr);
+
+  return res;
+}
@@ -0,0 +1,168 @@
+/*
+   File:        vtree_cache.h
+   Author(s):   PS1 MOPS
+   Created:     Fri Oct 16, 2026
+   Description: Incremental vtree linking.  A cache file keeps the plates
+                (the tracklets of each exposure, their bounds and their
+                tree) of an earlier run.  A later run over an overlapping
+                window reuses the plates that have not changed and only
+                searches the (first, last) plate pairs that can give a
+                track with a tracklet on a new or changed plate.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef VTREE_CACHE_H
+#define VTREE_CACHE_H
+
+#include "linker.h"
+
+#define VTREE_CACHE_MAGIC      "MOPSVTC"
+#define VTREE_CACHE_VERSION    1
+#define VTREE_CACHE_BYTE_ORDER 0x01020304
+
+/* The file is the header followed by each plate: a plate header and  */
+/* then these sections (in order), each padded to a multiple of 8     */
+/* bytes (n = num_tracklets, m = num_nodes):                           */
+/*   char   keys[key_size]         '\0' terminated tracklet keys       */
+/*   double bounds[n][MTRACKLET_NTBP]                                  */
+/*   double lo[TBT_DIM][m]                                             */
+/*   double hi[TBT_DIM][m]                                             */
+/*   int    num_points[m]                                              */
+/*   int    right[m]                                                   */
+/*   int    first_pt[m]                                                */
+/*   int    pts[n]                 indices into the plate's tracklets  */
+typedef struct vtree_cache_header
+{
+  char   magic[8];         /* VTREE_CACHE_MAGIC                          */
+  int    version;          /* VTREE_CACHE_VERSION                        */
+  int    byte_order;       /* VTREE_CACHE_BYTE_ORDER as written          */
+  int    header_size;      /* sizeof(vtree_cache_header)                 */
+  int    num_plates;
+  double ra_center;        /* The frame of the bounds (the recentering   */
+  double dec_center;       /* of the detections: hours, degrees, MJD).   */
+  double t_origin;
+  double thresh;           /* The mk_tracklet_bounds parameters.         */
+  double plate_width;
+  double widths[TBT_DIM];  /* The tree's split widths.                   */
+} vtree_cache_header;
+
+typedef struct vtree_cache_plate_header
+{
+  double time;             /* The plate's (recentered) time.             */
+  int    num_tracklets;
+  int    num_nodes;
+  int    key_size;
+  int    changed;          /* 1 if new or changed in the run that wrote  */
+} vtree_cache_plate_header; /* the cache.                                */
+
+
+/* One plate: its tracklets' keys (see mk_tracklet_cache_key) and */
+/* bounds, and its subtree with points indexing those tracklets.  */
+/* changed is set if the plate was new or changed in the run that  */
+/* wrote the cache (so that a rerun over the same plates can find  */
+/* that run's tracks again).                                       */
+typedef struct vtree_cache_plate
+{
+  double        time;
+  string_array* keys;
+  dym*          bounds;
+  tbt_flat*     tree;
+  bool          changed;
+} vtree_cache_plate;
+
+typedef struct vtree_cache
+{
+  double ra_center;
+  double dec_center;
+  double t_origin;
+  double thresh;
+  double plate_width;
+  dyv*   widths;
+
+  int    num_plates;
+  int    max_plates;
+  vtree_cache_plate** plates;
+} vtree_cache;
+
+
+/* --- Memory and access ------------------------------------------------- */
+
+vtree_cache* mk_empty_vtree_cache(double ra_center, double dec_center,
+                                  double t_origin, double thresh,
+                                  double plate_width, dyv* widths);
+
+void free_vtree_cache(vtree_cache* old);
+
+/* Add (copies of) a plate. */
+void vtree_cache_add_plate(vtree_cache* C, double time, string_array* keys,
+                           dym* bounds, tbt_flat* tree, bool changed);
+
+/* The plate with the given time (within 1e-10) or NULL. */
+vtree_cache_plate* vtree_cache_find_plate(vtree_cache* C, double time);
+
+/* A key that identifies the tracklet from one run to the next: the */
+/* ID strings of its detections (in order) separated by spaces.     */
+char* mk_tracklet_cache_key(track* T, simple_obs_array* obs);
+
+
+/* --- Files ------------------------------------------------------------- */
+
+/* Returns NULL (after printing why) if the file can not be read or */
+/* is not a valid cache of this version.                            */
+vtree_cache* mk_vtree_cache_from_file(char* filename);
+
+/* Returns FALSE if the file could not be written.  The cache is   */
+/* written to filename.tmp and then renamed, so filename is either */
+/* the old cache or the new one.                                   */
+bool write_vtree_cache(char* filename, vtree_cache* C);
+
+
+/* --- Incremental search ------------------------------------------------ */
+
+/* The vtree search of mk_vtrees_tracks for detections obs that have */
+/* been recentered with the frame of old (if not NULL) and flattened */
+/* to plates.  The plates of old whose tracklets (by key) and bounds */
+/* are unchanged are reused (so are their trees, if the tracklets    */
+/* are in the same order) and only the plate pairs that have a new   */
+/* or changed plate between them (inclusive) are searched.  The       */
+/* tracks returned are the tracks of mk_vtrees_tracks (in the frame  */
+/* of old, and before any subset removal) that use a tracklet on a   */
+/* new or changed plate.  With old = NULL every plate is new and the */
+/* result is that of mk_vtrees_tracks.                               */
+/*                                                                   */
+/* If the plates are exactly those of old (a rerun of the same       */
+/* window), the plates that were new or changed in the run that      */
+/* wrote old are searched again, so the rerun gives that run's       */
+/* tracks.                                                           */
+/*                                                                   */
+/* Sets nu_cache[0] to the cache for the next run: the plates of the */
+/* current tracklets (old plates that are not in pairs are dropped)  */
+/* in the frame ra_center, dec_center, t_origin (which must be that  */
+/* of old if old is not NULL).  run is as for mk_vtrees_tracks.     */
+track_array* mk_vtrees_tracks_incremental(simple_obs_array* obs,
+                                          track_array* pairs,
+                                          double thresh, double acc_r,
+                                          double acc_d, int min_sup,
+                                          double fit_rd, double pred_fit,
+                                          bool endpts, double plate_width,
+                                          double last_start_obs_time,
+                                          double first_end_obs_time,
+                                          vtree_cache* old,
+                                          double ra_center, double dec_center,
+                                          double t_origin,
+                                          vtree_cache** nu_cache,
+                                          vtree_run_opts* run);
+
+#endif
@@ -0,0 +1,59 @@
+/*
+   File:        worker_threads.c
+   Author(s):   PS1 MOPS
+   Created:     Sat Oct 17, 2026
+   Description: Runs a worker function on several threads that share one
+                job.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifdef USE_PTHREADS
+#include <pthread.h>
+#endif
+
+#include "worker_threads.h"
+
+
+int run_worker_threads(void* (*worker)(void*), void* job, int threads) {
+#ifdef USE_PTHREADS
+  pthread_t* workers;
+  int num_started = 0;
+  int i;
+
+  if(threads > 1) {
+    workers = AM_MALLOC_ARRAY(pthread_t, threads);
+    for(i=0;i<threads;i++) {
+      if(pthread_create(&workers[num_started], NULL, worker, job) == 0) {
+        num_started++;
+      }
+    }
+
+    /* If no thread could be started, do the work here. */
+    if(num_started == 0) {
+      worker(job);
+    }
+    for(i=0;i<num_started;i++) {
+      pthread_join(workers[i], NULL);
+    }
+    AM_FREE_ARRAY(workers, pthread_t, threads);
+
+    return int_max(num_started,1);
+  }
+#endif
+
+  worker(job);
+
+  return 1;
+}
@@ -0,0 +1,36 @@
+/*
+   File:        worker_threads.h
+   Author(s):   PS1 MOPS
+   Created:     Sat Oct 17, 2026
+   Description: Runs a worker function on several threads that share one
+                job (the seed loops, the plate pair search and the
+                chunked file loads).
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef WORKER_THREADS_H
+#define WORKER_THREADS_H
+
+#include "neos_header.h"
+
+/* Run worker(job) on "threads" threads at once and return when all  */
+/* of them are done.  The workers share job and claim their work from */
+/* it (under the job's own lock), so any one of them can do all of   */
+/* the work: if threads <= 1, the code is built without thread=1 or  */
+/* no thread could be started, worker(job) is just called here.      */
+/* Returns the number of threads that ran worker.                    */
+int run_worker_threads(void* (*worker)(void*), void* job, int threads);
+
+#endif
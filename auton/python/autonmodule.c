@@ -779,11 +779,11 @@ PyListObject* linktracklets_main(ivec* true_groups,
   case 0:
     t2 = mk_vtrees_tracks(obs,t1,vtree_thresh,acc_r,acc_d,min_sup,2,
                           fit_thresh,pred_thresh,endpts,plate_width,
-                          last_start_obs_time, first_end_obs_time);
+                          last_start_obs_time, first_end_obs_time, NULL);
     break;
   case 1:
     t2 = mk_MHT_matches(t1,obs,fit_thresh,lin_thresh,quad_thresh,
-                        max_hyp,max_match,min_obs,bwpass);
+                        max_hyp,max_match,min_obs,bwpass,1);
     break;
   case 2:
     t2 = mk_sequential_accel_only_tracks(obs,t1,vtree_thresh,acc_r,acc_d,
@@ -1206,6 +1206,12 @@ PyListObject* wrap_findtracklets_main(PyObject *self,
                            "remove_subsets",
                            "greedy",
 			   "pht",
+                           "elong_query",
+                           "beam",
+                           "budget",
+                           "threads",
+                           "plate_width",
+                           "max_gcr",
                            NULL};
   /* Define all the vars and give optional keywords default values */
   double athresh = 180.0;
@@ -1220,10 +1226,18 @@ PyListObject* wrap_findtracklets_main(PyObject *self,
   bool removedups = true;
   bool greedy = false;
   bool pht = false;
+  bool elong_query = true;
+  int beam = 0;
+  long budget = 0;
+  int threads = 1;
+  double plate_width = 0.0;
+  double max_gcr = 0.0;
 
   /* Support variables */
   simple_obs_array* obs;
   track_array* trcks;
+  track_array* kept;
+  dyv*  gcr;
   dyv*  length;
   dyv*  angle;
   dyv*  exp_time;
@@ -1238,7 +1252,7 @@ PyListObject* wrap_findtracklets_main(PyObject *self,
   /* Parse args and keywords */
   if(!PyArg_ParseTupleAndKeywords(args, 
                                   kw, 
-                                  "O|dddddddiibbb",
+                                  "O|dddddddiibbbbilidd",
                                   kwlist,
                                   &detectionList,
                                   &athresh, 
@@ -1252,7 +1266,13 @@ PyListObject* wrap_findtracklets_main(PyObject *self,
                                   &maxobs,
                                   &removedups,
                                   &greedy,
-                                  &pht)) {
+                                  &pht,
+                                  &elong_query,
+                                  &beam,
+                                  &budget,
+                                  &threads,
+                                  &plate_width,
+                                  &max_gcr)) {
     Py_INCREF(Py_None);
     return((PyListObject*)Py_None);
   }
@@ -1302,9 +1322,23 @@ PyListObject* wrap_findtracklets_main(PyObject *self,
                            etime,
                            maxobs,
                            greedy,
-                           pht);
+                           pht,
+                           elong_query,
+                           beam,
+                           budget,
+                           threads,
+                           plate_width);
    /*printf("got %d tracklets\n", track_array_size(trcks)); */
 
+  /* Drop the tracklets with large great circle residuals (arcsec). */
+  if(max_gcr > 0.0) {
+    gcr   = mk_tracklets_gc_rms(obs, trcks);
+    kept  = mk_tracklets_filter_gc_rms(trcks, gcr, max_gcr, NULL);
+    free_track_array(trcks);
+    free_dyv(gcr);
+    trcks = kept;
+  }
+
   /* Convert the tracklets to a Python list */
   num_trks = track_array_size(trcks);
   tracklets = (PyListObject*)PyList_New((Py_ssize_t)num_trks);
@@ -1352,6 +1386,94 @@ PyListObject* wrap_findtracklets_main(PyObject *self,
   return(tracklets);
 };
 
+/* Great circle residuals */
+static char gcrms_main__doc__[] = "\
+gcrms(tracklets)\n \
+\
+    tracklets is a list of tracklets, each a list of the form \
+    [(MJD, RA, Dec), ] in time order. \
+    The return object is a list with the 2d rms great circle \
+    residual (in arcseconds) of each tracklet. \
+Note: RA and Dec are assumed to be in decimal degrees.";
+PyListObject* wrap_gcrms_main(PyObject *self, 
+                              PyObject *args, 
+                              PyObject *kw){
+  static char *kwlist[] = {"tracklets", NULL};
+  PyObject* trackletList;
+  PyObject* seq;
+  PyObject* trk;
+  PyObject* det;
+  PyListObject* result;
+  double* mjd;
+  double* ra;
+  double* dec;
+  double* rms;
+  int* nobs;
+  long num_trks;
+  int max_obs = 1;
+  int i, j;
+
+  if(!PyArg_ParseTupleAndKeywords(args, kw, "O", kwlist, &trackletList)) {
+    Py_INCREF(Py_None);
+    return((PyListObject*)Py_None);
+  }
+
+  seq = PySequence_Fast(trackletList, "expected a sequence");
+  if(seq == NULL) {
+    return(NULL);
+  }
+  num_trks = PySequence_Fast_GET_SIZE(seq);
+
+  /* Find the longest tracklet to size the [detection][tracklet] arrays. */
+  nobs = AM_MALLOC_ARRAY(int, int_max(num_trks,1));
+  for(i=0; i<num_trks; i++) {
+    nobs[i] = (int)PySequence_Size(PySequence_Fast_GET_ITEM(seq, i));
+    if(nobs[i] < 0) {
+      AM_FREE_ARRAY(nobs, int, int_max(num_trks,1));
+      Py_DECREF(seq);
+      return(NULL);
+    }
+    max_obs = int_max(max_obs, nobs[i]);
+  }
+
+  mjd = AM_MALLOC_ARRAY(double, int_max(max_obs * num_trks,1));
+  ra  = AM_MALLOC_ARRAY(double, int_max(max_obs * num_trks,1));
+  dec = AM_MALLOC_ARRAY(double, int_max(max_obs * num_trks,1));
+  rms = AM_MALLOC_ARRAY(double, int_max(num_trks,1));
+  for(i=0; i<num_trks; i++) {
+    trk = PySequence_Fast(PySequence_Fast_GET_ITEM(seq, i),
+                          "expected a sequence");
+    for(j=0; j<nobs[i]; j++) {
+      det = PySequence_Fast(PySequence_Fast_GET_ITEM(trk, j),
+                            "expected a sequence");
+      mjd[j*num_trks+i] = PyFloat_AsDouble(PySequence_Fast_GET_ITEM(det, 0));
+      ra[j*num_trks+i]  = PyFloat_AsDouble(PySequence_Fast_GET_ITEM(det, 1)) 
+                          * DEG_TO_RAD;
+      dec[j*num_trks+i] = PyFloat_AsDouble(PySequence_Fast_GET_ITEM(det, 2)) 
+                          * DEG_TO_RAD;
+      Py_DECREF(det);
+    }
+    Py_DECREF(trk);
+  }
+  Py_DECREF(seq);
+
+  gcRmsBatch((int)num_trks, (int)num_trks, nobs, mjd, ra, dec, rms);
+
+  result = (PyListObject*)PyList_New((Py_ssize_t)num_trks);
+  if(result == NULL) 
+    Py_FatalError("Cannot init residual list.");
+  for(i=0; i<num_trks; i++) {
+    PyList_SET_ITEM(result, (Py_ssize_t)i, PyFloat_FromDouble(rms[i]));
+  }
+
+  AM_FREE_ARRAY(mjd, double, int_max(max_obs * num_trks,1));
+  AM_FREE_ARRAY(ra, double, int_max(max_obs * num_trks,1));
+  AM_FREE_ARRAY(dec, double, int_max(max_obs * num_trks,1));
+  AM_FREE_ARRAY(rms, double, int_max(num_trks,1));
+  AM_FREE_ARRAY(nobs, int, int_max(num_trks,1));
+  return(result);
+};
+
 /* FieldProximity */
 static char fieldproximity_main__doc__[] = "\
 fieldproximity(fieldList, orbitList, thresh, method, \
@@ -1545,6 +1667,10 @@ static PyMethodDef auton_methods[] = {
    (PyCFunction)wrap_findtracklets_main, 
    METH_KEYWORDS, 
    findtracklets_main__doc__},
+  {"gcrms", 
+   (PyCFunction)wrap_gcrms_main, 
+   METH_KEYWORDS, 
+   gcrms_main__doc__},
   {"fieldproximity", 
    (PyCFunction)wrap_fieldproximity_main, 
    METH_KEYWORDS, 
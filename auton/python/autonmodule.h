@@ -42,6 +42,7 @@ simple_obs_array* mk_simple_obs_array_from_PANSTARRS_list(PyObject*, int,
                                                           dyv**,  dyv**, dyv**);
 PyDictObject* wrap_fieldproximity_main(PyObject*, PyObject*, PyObject*);
 PyListObject* wrap_findtracklets_main(PyObject*, PyObject*, PyObject*);
+PyListObject* wrap_gcrms_main(PyObject*, PyObject*, PyObject*);
 PyListObject* wrap_linktracklets_main(PyObject*, PyObject*, PyObject*);
 PyDictObject* wrap_orbitproximity_main(PyObject*, PyObject*, PyObject*);
 PyDictObject* dump_fp_results(rd_plate_array*, namer*, ivec_array*);
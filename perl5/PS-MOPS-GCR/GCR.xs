@@ -129,3 +129,98 @@ compute_vel(dets_aref)
         RETVAL = gcVel(&gcf);
     OUTPUT:
         RETVAL
+
+SV *
+compute_gcr_batch(trks_aref)
+    SV *trks_aref
+    INIT:
+        I32 numtrks = 0;
+        I32 maxdets = 1;
+        I32 numdets;
+        int i, j;
+        AV *trk_av;
+        AV *res_av;
+        HV *det_hv;
+        SV **trk_svp;
+        SV **det_svp;
+        SV **mjd_svp;
+        SV **ra_svp;
+        SV **dec_svp;
+        int *n;
+        double *t, *ra, *dec, *gcr;
+        int ok = 1;
+
+        if ((!SvROK(trks_aref))
+            || (SvTYPE(SvRV(trks_aref)) != SVt_PVAV)) {
+            XSRETURN_UNDEF;
+        }
+        numtrks = av_len((AV *) SvRV(trks_aref)) + 1;
+
+        /* Every tracklet must be a non-empty list of detections. */
+        for (i = 0; i < numtrks; i++) {
+            trk_svp = av_fetch((AV *) SvRV(trks_aref), i, 0);
+            if (trk_svp == NULL || !SvROK(*trk_svp)
+                || SvTYPE(SvRV(*trk_svp)) != SVt_PVAV
+                || av_len((AV *) SvRV(*trk_svp)) < 0) {
+                XSRETURN_UNDEF;
+            }
+            numdets = av_len((AV *) SvRV(*trk_svp)) + 1;
+            if (numdets > maxdets)
+                maxdets = numdets;
+        }
+    CODE:
+        /* The blocks grow with the caller's batch, so they live on */
+        /* the heap rather than the stack.                           */
+        Newx(n, numtrks > 0 ? numtrks : 1, int);
+        Newx(t, maxdets * (numtrks > 0 ? numtrks : 1), double);
+        Newx(ra, maxdets * (numtrks > 0 ? numtrks : 1), double);
+        Newx(dec, maxdets * (numtrks > 0 ? numtrks : 1), double);
+        Newx(gcr, numtrks > 0 ? numtrks : 1, double);
+
+        /* Gather the detections as [detection][tracklet] arrays and */
+        /* fit all of the great circles in one call.                 */
+        for (i = 0; ok && i < numtrks; i++) {
+            trk_av = (AV *) SvRV(*av_fetch((AV *) SvRV(trks_aref), i, 0));
+            n[i] = av_len(trk_av) + 1;
+            for (j = 0; ok && j < n[i]; j++) {
+                det_svp = av_fetch(trk_av, j, 0);
+                if (det_svp == NULL || !SvROK(*det_svp)) {
+                    ok = 0;
+                    break;
+                }
+                det_hv = (HV *) SvRV(*det_svp);
+
+                mjd_svp = hv_fetch(det_hv, "epoch", sizeof("epoch") - 1, 0);
+                ra_svp = hv_fetch(det_hv, "ra", sizeof("ra") - 1, 0);
+                dec_svp = hv_fetch(det_hv, "dec", sizeof("dec") - 1, 0);
+                if (mjd_svp == NULL || ra_svp == NULL || dec_svp == NULL) {
+                    ok = 0;
+                    break;
+                }
+
+                t[j * numtrks + i] = SvNV(*mjd_svp);
+                ra[j * numtrks + i] = SvNV(*ra_svp) * M_PI / 180;
+                dec[j * numtrks + i] = SvNV(*dec_svp) * M_PI / 180;
+            }
+        }
+
+        if (ok && numtrks > 0)
+            gcRmsBatch(numtrks, numtrks, n, t, ra, dec, gcr);
+
+        if (ok) {
+            res_av = newAV();
+            for (i = 0; i < numtrks; i++)
+                av_push(res_av, newSVnv(gcr[i]));
+        }
+
+        Safefree(n);
+        Safefree(t);
+        Safefree(ra);
+        Safefree(dec);
+        Safefree(gcr);
+
+        if (!ok)
+            XSRETURN_UNDEF;
+        RETVAL = newRV_noinc((SV *) res_av);
+    OUTPUT:
+        RETVAL
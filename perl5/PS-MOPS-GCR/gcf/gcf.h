@@ -46,3 +46,17 @@ double gcRms(gcfparam *gcf);
 // compute velocity of great circle fit.
 double gcVel(gcfparam *gcf);
 
+// batched fits (gcfbatch.c).  the tracklets are given as a structure of
+// arrays: detection j of tracklet k is element [j * stride + k] of each
+// array (stride >= nTrk), and tracklet k has nObs[k] detections in time
+// order.  rms[k] is set to the 2d rms residual in arcsec, as returned by
+// gcRmsRes.  the fits are done GCF_BATCH tracklets at a time.
+#define GCF_BATCH 16
+
+// detections as mjd, ra and dec in radians.
+void gcRmsBatch(int nTrk, int stride, int nObs[], double mjd[],
+                double ra[], double dec[], double rms[]);
+
+// detections as mjd and unit vectors.
+void gcRmsBatchCart(int nTrk, int stride, int nObs[], double mjd[],
+                    double x[], double y[], double z[], double rms[]);
@@ -0,0 +1,308 @@
+//! C99
+
+/* gcfbatch.c
+
+Batched great circle fits.
+
+The fit is the one done by gcFit: rotate the detections so that the
+first and last lie on the equator, fit RA and Dec in the rotated frame
+linearly in time and take the 2d rms of the residuals.  Here the fits of
+a block of GCF_BATCH tracklets are done together.  Every array is laid
+out as [detection][tracklet], so each step of the fit is a loop across
+the tracklets of the block with a fixed trip count, which the compiler
+can turn into SIMD code.  Short tracklets are padded and masked out.
+
+Compared with gcFit + gcRmsRes this avoids most of the trigonometry:
+the residuals are measured in the rotated frame (the 2d distance does
+not depend on the frame) so nothing is rotated back, and the unit
+vectors may be given directly.  The rms agrees with gcRmsRes to well
+below a micro-arcsecond for tracklet sized arcs, except within an
+arcminute or so of the poles, where the RA*cos(Dec) residuals of
+gcRes are themselves inaccurate.  Unlike gcFit, motion along the
+equator and stationary tracklets give a finite rms.
+
+See external file LICENSE, distributed with this software.
+*/
+
+#include <math.h>
+#include <string.h>
+#include "gcf.h"
+
+#define GCF_PI        3.14159265358979323846
+#define GCF_TWO_PI    (2.0 * GCF_PI)
+#define GCF_ARCSECRAD (GCF_PI / (180.0 * 3600.0))
+
+// The block of tracklets given to gcRmsBlock.  Detection j of tracklet k
+// is element [j * GCF_BATCH + k]; rows j >= nObs[k] are ignored.
+typedef struct {
+   int    nObs[GCF_BATCH];
+   int    maxObs;
+   double *mjd;
+   double *x;
+   double *y;
+   double *z;
+} gcfblock;
+
+// Degenerate tracklets (first and last detections at the same place)
+// have no great circle.  Use the rms distance from their mean position.
+static double gcRmsStationary(gcfblock *b, int k)
+{
+   int n = b->nObs[k];
+   double m[3] = { 0, 0, 0 };
+   double s = 0;
+   int j;
+
+   for (j = 0; j < n; j++) {
+      m[0] += b->x[j * GCF_BATCH + k];
+      m[1] += b->y[j * GCF_BATCH + k];
+      m[2] += b->z[j * GCF_BATCH + k];
+   }
+   double mm = sqrt(m[0] * m[0] + m[1] * m[1] + m[2] * m[2]);
+   if (mm <= 0)
+      return 0;
+   for (j = 0; j < 3; j++)
+      m[j] /= mm;
+   for (j = 0; j < n; j++) {
+      double dx = b->x[j * GCF_BATCH + k] - m[0];
+      double dy = b->y[j * GCF_BATCH + k] - m[1];
+      double dz = b->z[j * GCF_BATCH + k] - m[2];
+      s += dx * dx + dy * dy + dz * dz;
+   }
+   return sqrt(s / n) / GCF_ARCSECRAD;
+}
+
+static void gcRmsBlock(gcfblock *b, double rms[GCF_BATCH])
+{
+   int maxObs = b->maxObs;
+   double r[9][GCF_BATCH];
+   double lon[maxObs][GCF_BATCH];
+   double lat[maxObs][GCF_BATCH];
+   double nt[maxObs][GCF_BATCH];
+   double w[maxObs][GCF_BATCH];
+   double n[GCF_BATCH];
+   double t0[GCF_BATCH], lon0[GCF_BATCH];
+   double st[GCF_BATCH], st2[GCF_BATCH];
+   double sra[GCF_BATCH], sdec[GCF_BATCH];
+   double stra[GCF_BATCH], stdec[GCF_BATCH];
+   double r0[GCF_BATCH], rr[GCF_BATCH], d0[GCF_BATCH], dr[GCF_BATCH];
+   double s[GCF_BATCH];
+   int degenerate[GCF_BATCH];
+   int j, k;
+
+   // The rotation taking the first and last detections to the equator
+   // (built exactly as in gcFit, but not transposed).
+   for (k = 0; k < GCF_BATCH; k++) {
+      int last = (b->nObs[k] > 1 ? b->nObs[k] - 1 : 0) * GCF_BATCH + k;
+      double ax = b->x[k], ay = b->y[k], az = b->z[k];
+      double bx = b->x[last], by = b->y[last], bz = b->z[last];
+      double nx = ay * bz - az * by;
+      double ny = az * bx - ax * bz;
+      double nz = ax * by - ay * bx;
+      double nmag2 = nx * nx + ny * ny + nz * nz;
+      double nxy2 = nx * nx + ny * ny;
+
+      degenerate[k] = (nmag2 <= 0);
+      if (degenerate[k]) {
+         nx = 0;
+         ny = 0;
+         nz = 1;
+         nmag2 = 1;
+         nxy2 = 0;
+      }
+
+      // If the motion is already along the equator any axis will do.
+      double nmag = sqrt(nmag2);
+      double gcix = 1, gciy = 0;
+      if (nxy2 > 0) {
+         double nxy = 1 / sqrt(nxy2);
+         gcix = ny * nxy;
+         gciy = -nx * nxy;
+      }
+      double sina = sqrt(nxy2) / nmag;
+      double cosa = nz / nmag;
+      double sinagx = sina * gcix;
+      double sinagy = sina * gciy;
+      double onemcosa = 1 - cosa;
+      double onemcosagx = onemcosa * gcix;
+      double onemcosagxgy = onemcosagx * gciy;
+      r[0][k] = cosa + onemcosagx * gcix;
+      r[1][k] = onemcosagxgy;
+      r[2][k] = sinagy;
+      r[3][k] = onemcosagxgy;
+      r[4][k] = cosa + onemcosa * gciy * gciy;
+      r[5][k] = -sinagx;
+      r[6][k] = -sinagy;
+      r[7][k] = sinagx;
+      r[8][k] = cosa;
+      n[k] = b->nObs[k];
+      t0[k] = b->mjd[k];
+   }
+
+   // Rotate (the cylindrical projection of gcFit).
+   for (j = 0; j < maxObs; j++) {
+      double *x = b->x + j * GCF_BATCH;
+      double *y = b->y + j * GCF_BATCH;
+      double *z = b->z + j * GCF_BATCH;
+      double px[GCF_BATCH], py[GCF_BATCH], pz[GCF_BATCH];
+
+      for (k = 0; k < GCF_BATCH; k++) {
+         px[k] = r[0][k] * x[k] + r[1][k] * y[k] + r[2][k] * z[k];
+         py[k] = r[3][k] * x[k] + r[4][k] * y[k] + r[5][k] * z[k];
+         pz[k] = r[6][k] * x[k] + r[7][k] * y[k] + r[8][k] * z[k];
+         pz[k] = pz[k] > 1 ? 1 : (pz[k] < -1 ? -1 : pz[k]);
+         nt[j][k] = b->mjd[j * GCF_BATCH + k] - t0[k];
+         w[j][k] = j < b->nObs[k] ? 1 : 0;
+      }
+      for (k = 0; k < GCF_BATCH; k++) {
+         lon[j][k] = atan2(py[k], px[k]);
+         lat[j][k] = asin(pz[k]);
+         if (j == 0)
+            lon0[k] = lon[0][k];
+      }
+   }
+
+   // Longitudes relative to the first detection.
+   for (j = 0; j < maxObs; j++)
+      for (k = 0; k < GCF_BATCH; k++) {
+         double d = lon[j][k] - lon0[k];
+         d = d > GCF_PI ? d - GCF_TWO_PI : d;
+         d = d < -GCF_PI ? d + GCF_TWO_PI : d;
+         lon[j][k] = d * w[j][k];
+         lat[j][k] *= w[j][k];
+         nt[j][k] *= w[j][k];
+      }
+
+   // The least squares fit.
+   for (k = 0; k < GCF_BATCH; k++) {
+      st[k] = st2[k] = sra[k] = sdec[k] = stra[k] = stdec[k] = 0;
+   }
+   for (j = 0; j < maxObs; j++)
+      for (k = 0; k < GCF_BATCH; k++) {
+         st[k] += nt[j][k];
+         st2[k] += nt[j][k] * nt[j][k];
+         sra[k] += lon[j][k];
+         sdec[k] += lat[j][k];
+         stra[k] += nt[j][k] * lon[j][k];
+         stdec[k] += nt[j][k] * lat[j][k];
+      }
+   for (k = 0; k < GCF_BATCH; k++) {
+      double det = n[k] * st2[k] - st[k] * st[k];
+      double invd = det != 0 ? 1 / det : 0;
+      double it1 = (maxObs > 1 && nt[1][k] != 0) ? 1 / nt[1][k] : 0;
+      if (n[k] == 2) {
+         r0[k] = 0;
+         rr[k] = lon[1][k] * it1;
+         d0[k] = 0;
+         dr[k] = 0;
+      } else {
+         r0[k] = invd * (sra[k] * st2[k] - stra[k] * st[k]);
+         rr[k] = invd * (n[k] * stra[k] - sra[k] * st[k]);
+         d0[k] = invd * (sdec[k] * st2[k] - stdec[k] * st[k]);
+         dr[k] = invd * (n[k] * stdec[k] - sdec[k] * st[k]);
+      }
+      s[k] = 0;
+   }
+
+   // The residuals, as local offsets at the fitted position
+   // (cos^2(d) = 1 - d^2 + d^4/3 is plenty close to the equator).
+   for (j = 0; j < maxObs; j++)
+      for (k = 0; k < GCF_BATCH; k++) {
+         double dc = d0[k] + dr[k] * nt[j][k];
+         double dl = lon[j][k] - (r0[k] + rr[k] * nt[j][k]);
+         double dd = lat[j][k] - dc;
+         double dc2 = dc * dc;
+         double c2 = 1 - dc2 + dc2 * dc2 / 3;
+         s[k] += w[j][k] * (dl * dl * c2 + dd * dd);
+      }
+
+   for (k = 0; k < GCF_BATCH; k++) {
+      if (b->nObs[k] <= 0)
+         rms[k] = 0;
+      else if (degenerate[k])
+         rms[k] = gcRmsStationary(b, k);
+      else
+         rms[k] = sqrt(s[k] / n[k]) / GCF_ARCSECRAD;
+   }
+}
+
+// Copy tracklets [k0, k0 + nb) into the block, converting from spherical
+// coordinates if ra and dec are given.
+static void gcFillBlock(gcfblock *b, int k0, int nb, int stride,
+                        int nObs[], double mjd[], double x[], double y[],
+                        double z[], double ra[], double dec[])
+{
+   int j, k;
+
+   b->maxObs = 1;
+   for (k = 0; k < GCF_BATCH; k++) {
+      b->nObs[k] = k < nb ? nObs[k0 + k] : 0;
+      if (b->nObs[k] > b->maxObs)
+         b->maxObs = b->nObs[k];
+   }
+
+   for (j = 0; j < b->maxObs; j++)
+      for (k = 0; k < GCF_BATCH; k++) {
+         int o = j * GCF_BATCH + k;
+         int i = j * stride + k0 + k;
+         if (j >= b->nObs[k]) {
+            // Padding: a copy of the first detection (or the pole).
+            b->mjd[o] = j > 0 ? b->mjd[k] : 0;
+            b->x[o] = j > 0 ? b->x[k] : 0;
+            b->y[o] = j > 0 ? b->y[k] : 0;
+            b->z[o] = j > 0 ? b->z[k] : 1;
+         } else if (ra != NULL) {
+            double t = cos(dec[i]);
+            b->mjd[o] = mjd[i];
+            b->x[o] = t * cos(ra[i]);
+            b->y[o] = t * sin(ra[i]);
+            b->z[o] = sin(dec[i]);
+         } else {
+            b->mjd[o] = mjd[i];
+            b->x[o] = x[i];
+            b->y[o] = y[i];
+            b->z[o] = z[i];
+         }
+      }
+}
+
+static void gcRmsRun(int nTrk, int stride, int nObs[], double mjd[],
+                     double x[], double y[], double z[],
+                     double ra[], double dec[], double rms[])
+{
+   int maxObs = 1;
+   int k0, k;
+
+   for (k = 0; k < nTrk; k++)
+      if (nObs[k] > maxObs)
+         maxObs = nObs[k];
+
+   double bmjd[maxObs * GCF_BATCH];
+   double bx[maxObs * GCF_BATCH];
+   double by[maxObs * GCF_BATCH];
+   double bz[maxObs * GCF_BATCH];
+   double brms[GCF_BATCH];
+   gcfblock b;
+   b.mjd = bmjd;
+   b.x = bx;
+   b.y = by;
+   b.z = bz;
+
+   for (k0 = 0; k0 < nTrk; k0 += GCF_BATCH) {
+      int nb = nTrk - k0 < GCF_BATCH ? nTrk - k0 : GCF_BATCH;
+      gcFillBlock(&b, k0, nb, stride, nObs, mjd, x, y, z, ra, dec);
+      gcRmsBlock(&b, brms);
+      memcpy(rms + k0, brms, nb * sizeof(double));
+   }
+}
+
+void gcRmsBatch(int nTrk, int stride, int nObs[], double mjd[],
+                double ra[], double dec[], double rms[])
+{
+   gcRmsRun(nTrk, stride, nObs, mjd, NULL, NULL, NULL, ra, dec, rms);
+}
+
+void gcRmsBatchCart(int nTrk, int stride, int nObs[], double mjd[],
+                    double x[], double y[], double z[], double rms[])
+{
+   gcRmsRun(nTrk, stride, nObs, mjd, x, y, z, NULL, NULL, rms);
+}